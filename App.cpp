@@ -1,6 +1,19 @@
 #include "App.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdio>
 #include <limits>
 
+App::App(const AppConfig& config)
+    : mConfig(config)
+    , mHostAllocator(config.hostAllocator)
+    , mAllocationCallbacks(config.useHostAllocator ? mHostAllocator.getAllocationCallbacks() : nullptr)
+    , mInstance(VK_NULL_HANDLE)
+    , mPhysicalDeviceIndex(0u)
+    , mDevice(VK_NULL_HANDLE)
+{
+}
+
 VkResult App::init()
 {
     // Initialize Vulkan instance
@@ -11,8 +24,36 @@ VkResult App::init()
 
     VkResult result = VK_SUCCESS;
 
+    mInitPhaseDurations.fill(std::chrono::nanoseconds::zero());
+    beginInitPhase();
+
+    // Open the loader (at runtime with MK_VULKAN_DYNAMIC_LOADING) and get its global functions
+    result = mVulkanLibrary.load();
+    if (result == VK_SUCCESS)
+        result = mGlobalDispatch.load(mVulkanLibrary.getInstanceProcAddr());
+    endInitPhase(InitPhase::LoadVulkanLibrary);
+
     // applicationInfo and instanceCreateInfo will be consumed (internal copy)
+    if (result == VK_SUCCESS)
     {
+        // Optional extensions the instance supports, the extensions are only enumerated when one is requested
+        std::vector<const char*> enabledExtensionNames;
+        mEnabledInstanceExtensions.clear();
+        const auto enableOptionalExtension = [this, &enabledExtensionNames](const NameHash& name)
+        {
+            if (hasInstanceExtension(name) && !mEnabledInstanceExtensions.contains(name))
+            {
+                enabledExtensionNames.push_back(name.name);
+                mEnabledInstanceExtensions.insert(name.name);
+            }
+        };
+
+        // command buffer labels of profiler zones for capture tools
+        if (mConfig.profiler.enabled && mConfig.profiler.debugLabels)
+            enableOptionalExtension(KnownExtensions::DebugUtils);
+        for (const std::string& extensionName : mConfig.optionalInstanceExtensions)
+            enableOptionalExtension(extensionName.c_str());
+
         const VkApplicationInfo applicationInfo = {
             VK_STRUCTURE_TYPE_APPLICATION_INFO,     // VkStructureType sType;                       // type of applicaiton info structure
             nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
@@ -30,58 +71,172 @@ VkResult App::init()
             &applicationInfo,                       // const VkApplicationInfo* pApplicationInfo;   // optional for another struct describing user app (should be filled)
             0,                                      // uint32_t enabledLayerCount;	                // number of instance layer to enable (possible 0)
             nullptr,                                // const char* const* ppEnabledLayerNames;      // names for enabled layer instances (possible nullptr)
-            0,                                      // uint32_t enabledExtensionCount;              // number of extensions to enable (possible 0)
-            nullptr                                 // const char* const* ppEnabledExtensionNames;  // names of enabled extensions (possible nullptr)
+            static_cast<uint32_t>(enabledExtensionNames.size()), // uint32_t enabledExtensionCount; // number of extensions to enable (possible 0)
+            enabledExtensionNames.data()            // const char* const* ppEnabledExtensionNames;  // names of enabled extensions (possible nullptr)
         };
 
-        result = vkCreateInstance(	                // creates VkInstance
+        result = mGlobalDispatch.vkCreateInstance( // creates VkInstance
             &instanceCreateInfo,                    // const VkInstanceCreateInfo* pCreateInfo,     // parameters describing VkInstance
-            nullptr,                                // const VkAllocationCallbacks* pAllocator,     // host memory for user app and Vulkan systems (nullptr to use Vulkan internal allocator)
+            mAllocationCallbacks,                   // const VkAllocationCallbacks* pAllocator,     // host memory for user app and Vulkan systems (nullptr to use Vulkan internal allocator)
             &mInstance                              // VkInstance* pInstance);                      // Vulkan handle (64-bits) for calling other functions
         );
+
+        // all other calls go through the tables, never through the loader's exports
+        if (result == VK_SUCCESS)
+            mInstanceDispatch.load(mGlobalDispatch, mInstance);
     }
+    endInitPhase(InitPhase::CreateInstance);
 
-    // Query instance layers
-    if (result == VK_SUCCESS) result = queryInstanceLayerProperties();
-    // Query instance extensions
-    if (result == VK_SUCCESS) result = queryInstanceExtensionProperties();
     // Query physical devices
     if (result == VK_SUCCESS) result = queryPhysicalDevices();
-    // Query physical device layers
-    if (result == VK_SUCCESS) result = queryPhysicalDeviceLayerProperties();
-    // Query physical device extensions
-    if (result == VK_SUCCESS) result = queryPhysicalDeviceExtensionProperties();
-    // Query properties of physical devices
-    if (result == VK_SUCCESS) result = queryPhysicalDeviceProperties();
-    // Query features of physical devices
-    if (result == VK_SUCCESS) result = queryPhysicalDeviceFeatures();
-    // Query memory properties of physical devices
-    if (result == VK_SUCCESS) result = queryPhysicalDeviceMemoryProperties();
-
-    // Query queue familty properties of physical devices
-    if (result == VK_SUCCESS) queryPhysicalDeviceQueueFamilyProperties();
+    endInitPhase(InitPhase::QueryPhysicalDevices);
+    // Reuse capabilities of a previous run when the drivers did not change
+    bool capabilityCacheHit{ false };
+    if (result == VK_SUCCESS) capabilityCacheHit = loadCapabilityCache();
+    endInitPhase(InitPhase::LoadCapabilityCache);
+    // Query layers, extensions, properties, features, memory and queue family properties of physical devices
+    if (result == VK_SUCCESS && !capabilityCacheHit) result = queryPhysicalDeviceRecords();
+    endInitPhase(InitPhase::QueryPhysicalDeviceRecords);
+    // Rewrite capability cache for the next run
+    if (result == VK_SUCCESS && !capabilityCacheHit) storeCapabilityCache();
+    endInitPhase(InitPhase::StoreCapabilityCache);
+
+    // Select physical device by score (or forced by config)
+    std::vector<uint32_t> multiDeviceIndices;   // physical devices of the multi-device scheduler, selected device first
+    if (result == VK_SUCCESS)
+    {
+        DeviceSelector deviceSelector(mConfig.deviceSelection);
+        const int32_t selectedIndex{ deviceSelector.select(mPhysicalDeviceRecords) };
+
+        if (selectedIndex < 0)
+            result = VK_ERROR_INITIALIZATION_FAILED;
+        else
+            mPhysicalDeviceIndex = static_cast<size_t>(selectedIndex);
+
+        if (result == VK_SUCCESS && mConfig.multiDevice.maxPhysicalDevices > 0u)
+        {
+            multiDeviceIndices.push_back(static_cast<uint32_t>(selectedIndex));
+            for (uint32_t index : deviceSelector.getRanking())
+                if (index != static_cast<uint32_t>(selectedIndex) && multiDeviceIndices.size() < mConfig.multiDevice.maxPhysicalDevices)
+                    multiDeviceIndices.push_back(index);
+        }
+    }
+    endInitPhase(InitPhase::SelectPhysicalDevice);
 
     // Initialize logical device
     if (result == VK_SUCCESS)
     {
-        // NVIDIA GeForce GTX 1060
-        size_t physicalDeviceIndex{ 0u };
+        const size_t physicalDeviceIndex{ mPhysicalDeviceIndex };
 
-        // Find queueFamilyIndex for input queueFlags
+        // Find queue families for graphics, async compute and transfer queues
+        if (!selectQueueFamilies(physicalDeviceIndex))
+            result = VK_ERROR_UNKNOWN;
 
-        // queueFlags - combination of VkQueueFlagBits, where each flag means that queues in this family that supports or not the following :
-        // VK_QUEUE_GRAPHICS_BIT                    // graphics operations : drawing points, lines, triangles
-        // VK_QUEUE_COMPUTE_BIT                     // computer operations : e.g.dispatching compute shaders
-        // VK_QUEUE_TRANSFER_BIT                    // transfer operations : e.g.copying bufferand image contents
-        // VK_QUEUE_SPARSE_BINDING_BIT              // memory binding operations used to update sparse resources
+        // Create logical device with queues of all families
+        if (result == VK_SUCCESS)
+            result = createLogicalDevice(physicalDeviceIndex);
+        endInitPhase(InitPhase::CreateLogicalDevice);
 
-        VkQueueFlags queueFlags{ VK_QUEUE_GRAPHICS_BIT };
-        uint32_t queueFamilyIndex{ 0u };
-        if (!getQueueFamilyIndex(physicalDeviceIndex, queueFlags, queueFamilyIndex))
-            return VK_ERROR_UNKNOWN;
+        // Timestamp queries of GPU zones, calibrated against CPU time on a queue of every family the subsystems record zones on
+        if (result == VK_SUCCESS && mConfig.profiler.enabled)
+        {
+            std::vector<uint32_t> queueFamilyIndices;
+            std::vector<VkQueue> queues;
+            for (size_t type{ 0u }; type < QueueTypeCount; ++type)
+            {
+                queueFamilyIndices.push_back(getQueueFamilyIndex(static_cast<QueueType>(type)));
+                queues.push_back(getQueue(static_cast<QueueType>(type)));
+            }
+            result = mProfiler.init(mDevice, mDeviceDispatch, mPhysicalDeviceRecords[physicalDeviceIndex], queueFamilyIndices, queues,
+                mAllocationCallbacks, mEnabledFeatures.features12.hostQueryReset == VK_TRUE,
+                isInstanceExtensionEnabled(KnownExtensions::DebugUtils),
+                mConfig.profiler);
+        }
+        endInitPhase(InitPhase::CreateProfiler);
 
-        // Create logical device
-        result = createLogicalDevice(physicalDeviceIndex, queueFamilyIndex);
+        // Sub-allocate device memory from large blocks of the memory types of the device
+        if (result == VK_SUCCESS)
+            result = mMemoryAllocator.init(mDevice, mDeviceDispatch, mPhysicalDeviceRecords[physicalDeviceIndex], mAllocationCallbacks, mConfig.deviceMemory);
+        endInitPhase(InitPhase::CreateMemoryAllocator);
+
+        // Staging ring for uploads, batches are submitted to the Transfer queue
+        if (result == VK_SUCCESS && mConfig.staging.ringSize > 0u)
+            result = mStagingUploader.init(mDevice, mDeviceDispatch, mMemoryAllocator, getQueueFamilyIndex(QueueType::Transfer),
+                getQueue(QueueType::Transfer), mAllocationCallbacks, mEnabledFeatures.features12.timelineSemaphore == VK_TRUE, mConfig.staging);
+        endInitPhase(InitPhase::CreateStagingUploader);
+
+        // Pipeline cache of the previous run (if written for this device and driver) merged with caches of worker processes
+        if (result == VK_SUCCESS)
+            result = mPipelineCache.init(mDevice, mDeviceDispatch, mPhysicalDeviceRecords[physicalDeviceIndex], mAllocationCallbacks,
+                mConfig.pipelineCachePath, isDeviceExtensionEnabled(KnownExtensions::PipelineCreationFeedback));
+        if (result == VK_SUCCESS && !mConfig.pipelineCacheMergePaths.empty())
+            result = mPipelineCache.merge(mConfig.pipelineCacheMergePaths);
+        endInitPhase(InitPhase::CreatePipelineCache);
+
+        // Command buffer, descriptor pool and staging buffers for compute kernels on the AsyncCompute queue
+        if (result == VK_SUCCESS && mConfig.compute.maxDescriptorSets > 0u)
+            result = mComputeEngine.init(mDevice, mDeviceDispatch, mPhysicalDeviceRecords[physicalDeviceIndex], mMemoryAllocator, mPipelineCache,
+                getQueueFamilyIndex(QueueType::AsyncCompute), getQueue(QueueType::AsyncCompute), mAllocationCallbacks, mConfig.compute);
+        endInitPhase(InitPhase::CreateComputeEngine);
+
+        // Recording threads with a command pool per thread and frame in flight
+        if (result == VK_SUCCESS && mConfig.commandRecorder.framesInFlight > 0u)
+            result = mCommandRecorder.init(mDevice, mDeviceDispatch, getQueueFamilyIndex(QueueType::Graphics), getQueue(QueueType::Graphics),
+                mAllocationCallbacks, mConfig.commandRecorder);
+        endInitPhase(InitPhase::CreateCommandRecorder);
+
+        // Timeline semaphore of every queue role for cross queue waits and retiring resources by value
+        if (result == VK_SUCCESS && mConfig.submission.maxBatchesInFlight > 0u && mEnabledFeatures.features12.timelineSemaphore)
+        {
+            std::vector<VkQueue> queues;
+            for (size_t type{ 0u }; type < QueueTypeCount; ++type)
+                queues.push_back(getQueue(static_cast<QueueType>(type)));
+            result = mSubmissionScheduler.init(mDevice, mDeviceDispatch, queues, mAllocationCallbacks, mConfig.submission);
+        }
+        endInitPhase(InitPhase::CreateSubmissionScheduler);
+
+        // Offscreen color images with mapped readback buffers, one per frame in flight
+        if (result == VK_SUCCESS && mConfig.headless.framesInFlight > 0u)
+            result = mHeadlessRenderer.init(mDevice, mDeviceDispatch, mMemoryAllocator, getQueueFamilyIndex(QueueType::Graphics),
+                getQueue(QueueType::Graphics), mAllocationCallbacks, mConfig.headless);
+        endInitPhase(InitPhase::CreateHeadlessRenderer);
+
+        // Budgets of the device local heaps, evicted buffers are copied on a Transfer queue
+        if (result == VK_SUCCESS && mConfig.residency.framesInFlight > 0u)
+            result = mResidencyManager.init(mDevice, mDeviceDispatch, mInstanceDispatch, mPhysicalDeviceRecords[physicalDeviceIndex], mMemoryAllocator,
+                getQueueFamilyIndex(QueueType::Transfer), getQueue(QueueType::Transfer, 1u), mAllocationCallbacks,
+                isDeviceExtensionEnabled(KnownExtensions::MemoryBudget), mConfig.residency);
+
+        endInitPhase(InitPhase::CreateResidencyManager);
+
+        // roles wrap onto the same VkQueue on devices with few queues, every subsystem submits under the lock of its queue
+        if (result == VK_SUCCESS)
+        {
+            mStagingUploader.setQueueMutex(getQueueMutex(QueueType::Transfer));
+            mComputeEngine.setQueueMutex(getQueueMutex(QueueType::AsyncCompute));
+            mCommandRecorder.setQueueMutex(getQueueMutex(QueueType::Graphics));
+            for (uint32_t queue{ 0u }; queue < mSubmissionScheduler.getQueueCount(); ++queue)
+                mSubmissionScheduler.setQueueMutex(queue, getQueueMutex(static_cast<QueueType>(queue)));
+            mHeadlessRenderer.setQueueMutex(getQueueMutex(QueueType::Graphics));
+            mResidencyManager.setQueueMutex(getQueueMutex(QueueType::Transfer, 1u));
+        }
+
+        // Logical device per selected physical device (several per device on request) and the threads driving them
+        if (result == VK_SUCCESS && !multiDeviceIndices.empty())
+            result = createDeviceContexts(multiDeviceIndices);
+        endInitPhase(InitPhase::CreateMultiDeviceScheduler);
+
+        // subsystems skip their zones with no profiler
+        if (result == VK_SUCCESS && mConfig.profiler.enabled)
+        {
+            mStagingUploader.setProfiler(&mProfiler);
+            mComputeEngine.setProfiler(&mProfiler);
+            mCommandRecorder.setProfiler(&mProfiler);
+            mSubmissionScheduler.setProfiler(&mProfiler);
+            mHeadlessRenderer.setProfiler(&mProfiler);
+            mResidencyManager.setProfiler(&mProfiler);
+            mMultiDeviceScheduler.setProfiler(&mProfiler);
+        }
     }
 
     return result;
@@ -91,15 +246,169 @@ VkResult App::deinit()
 {
     VkResult result = VK_SUCCESS;
 
-    result = vkDeviceWaitIdle(mDevice);
-    if (result == VK_SUCCESS)
-        vkDestroyDevice(mDevice, nullptr);
+    beginInitPhase();
+
+    // logical devices of the scheduler do not depend on mDevice
+    mMultiDeviceScheduler.deinit();
+    for (std::unique_ptr<DeviceContext>& deviceContext : mDeviceContexts)
+        deviceContext->deinit();
+    mDeviceContexts.clear();
+
+    // init() may have failed before the device or instance was created. A failed wait (device lost)
+    // still destroys every object - commands of a lost device count as complete - so the host
+    // allocator below never releases memory of objects that are alive.
+    if (mDevice != VK_NULL_HANDLE)
+    {
+        result = mDeviceDispatch.vkDeviceWaitIdle(mDevice);
+
+        // all GPU zones finished, zones recorded by deinit() below are not written
+        if (mConfig.profiler.enabled && result == VK_SUCCESS)
+        {
+            mProfiler.flush();
+            if (!mConfig.profiler.tracePath.empty() && !mProfiler.writeChromeTrace(mConfig.profiler.tracePath))
+                std::printf("Failed to write trace %s\n", mConfig.profiler.tracePath.c_str());
+        }
+
+        // retire functions may release resources of the subsystems below
+        mSubmissionScheduler.deinit();
+        mHeadlessRenderer.deinit();
+        mCommandRecorder.deinit();
+        mComputeEngine.deinit();
+        mResidencyManager.deinit();
+
+        // a failed save keeps the previous file
+        mPipelineCache.save();
+        if (mConfig.printPipelineCacheStatistics)
+            mPipelineCache.printStatistics();
+        mPipelineCache.deinit();
+
+        mStagingUploader.deinit();
+
+        if (mConfig.printDeviceMemoryStatistics)
+            mMemoryAllocator.printStatistics();
+        mMemoryAllocator.deinit();
+
+        mProfiler.deinit();
+
+        mDeviceDispatch.vkDestroyDevice(mDevice, mAllocationCallbacks);
+        mDevice = VK_NULL_HANDLE;
+    }
+
+    if (mInstance != VK_NULL_HANDLE)
+        mInstanceDispatch.vkDestroyInstance(mInstance, mAllocationCallbacks);
+    mInstance = VK_NULL_HANDLE;
+    mVulkanLibrary.unload();
+
+    // instance tables belong to the loader, enumerated again when the next init() asks
+    mInstanceLayerProperties.clear();
+    mInstanceExtensionProperties.clear();
+    mInstanceLayerSet.clear();
+    mInstanceExtensionSet.clear();
 
-    vkDestroyInstance(mInstance, nullptr);
+    // records may point into the capability cache mapping
+    mPhysicalDeviceRecords.clear();
+    mCapabilityCache.close();
+
+    // all objects created with the callbacks are gone, arena memory can be released
+    if (mAllocationCallbacks)
+    {
+        if (mConfig.printHostAllocatorSummary)
+            mHostAllocator.printSummary();
+        mHostAllocator.reset();
+    }
+
+    endInitPhase(InitPhase::Deinit);
 
     return result;
 }
 
+const char* App::getInitPhaseName(InitPhase phase)
+{
+    switch (phase)
+    {
+    case InitPhase::LoadVulkanLibrary:                          return "LoadVulkanLibrary";
+    case InitPhase::CreateInstance:                             return "CreateInstance";
+    case InitPhase::QueryPhysicalDevices:                       return "QueryPhysicalDevices";
+    case InitPhase::LoadCapabilityCache:                        return "LoadCapabilityCache";
+    case InitPhase::QueryPhysicalDeviceRecords:                 return "QueryPhysicalDeviceRecords";
+    case InitPhase::StoreCapabilityCache:                       return "StoreCapabilityCache";
+    case InitPhase::SelectPhysicalDevice:                       return "SelectPhysicalDevice";
+    case InitPhase::CreateLogicalDevice:                        return "CreateLogicalDevice";
+    case InitPhase::CreateProfiler:                             return "CreateProfiler";
+    case InitPhase::CreateMemoryAllocator:                      return "CreateMemoryAllocator";
+    case InitPhase::CreateStagingUploader:                      return "CreateStagingUploader";
+    case InitPhase::CreatePipelineCache:                        return "CreatePipelineCache";
+    case InitPhase::CreateComputeEngine:                        return "CreateComputeEngine";
+    case InitPhase::CreateCommandRecorder:                      return "CreateCommandRecorder";
+    case InitPhase::CreateSubmissionScheduler:                  return "CreateSubmissionScheduler";
+    case InitPhase::CreateHeadlessRenderer:                     return "CreateHeadlessRenderer";
+    case InitPhase::CreateResidencyManager:                     return "CreateResidencyManager";
+    case InitPhase::CreateMultiDeviceScheduler:                 return "CreateMultiDeviceScheduler";
+    case InitPhase::Deinit:                                     return "Deinit";
+    default:                                                    return "Unknown";
+    }
+}
+
+void App::beginInitPhase()
+{
+    mInitPhaseStart = Clock::now();
+}
+
+void App::endInitPhase(InitPhase phase)
+{
+    // Store time since the previous phase ended and start timing the next one
+    const Clock::time_point now{ Clock::now() };
+    mInitPhaseDurations[static_cast<size_t>(phase)] = std::chrono::duration_cast<std::chrono::nanoseconds>(now - mInitPhaseStart);
+    mInitPhaseStart = now;
+}
+
+const std::vector<VkLayerProperties>& App::getInstanceLayerProperties()
+{
+    // a failed enumeration is not retried, the list stays empty
+    if (!mInstanceLayerSet.isBuilt() && mGlobalDispatch.vkEnumerateInstanceLayerProperties)
+    {
+        if (queryInstanceLayerProperties() != VK_SUCCESS)
+            mInstanceLayerProperties.clear();
+        mInstanceLayerSet.build(mInstanceLayerProperties.size(), [this](size_t i) { return mInstanceLayerProperties[i].layerName; });
+    }
+
+    return mInstanceLayerProperties;
+}
+
+const std::vector<VkExtensionProperties>& App::getInstanceExtensionProperties()
+{
+    if (!mInstanceExtensionSet.isBuilt() && mGlobalDispatch.vkEnumerateInstanceExtensionProperties)
+    {
+        if (queryInstanceExtensionProperties() != VK_SUCCESS)
+            mInstanceExtensionProperties.clear();
+        mInstanceExtensionSet.build(mInstanceExtensionProperties.size(), [this](size_t i) { return mInstanceExtensionProperties[i].extensionName; });
+    }
+
+    return mInstanceExtensionProperties;
+}
+
+bool App::hasInstanceLayer(const NameHash& name)
+{
+    getInstanceLayerProperties();
+    return mInstanceLayerSet.contains(name);
+}
+
+bool App::hasInstanceExtension(const NameHash& name)
+{
+    getInstanceExtensionProperties();
+    return mInstanceExtensionSet.contains(name);
+}
+
+bool App::hasDeviceLayer(const NameHash& name) const
+{
+    return mPhysicalDeviceIndex < mPhysicalDeviceRecords.size() && mPhysicalDeviceRecords[mPhysicalDeviceIndex].hasLayer(name);
+}
+
+bool App::hasDeviceExtension(const NameHash& name) const
+{
+    return mPhysicalDeviceIndex < mPhysicalDeviceRecords.size() && mPhysicalDeviceRecords[mPhysicalDeviceIndex].hasExtension(name);
+}
+
 VkResult App::queryInstanceLayerProperties()
 {
     // Query instance layers
@@ -108,7 +417,7 @@ VkResult App::queryInstanceLayerProperties()
 
     uint32_t propertyCount{ 0u };
 
-    result = vkEnumerateInstanceLayerProperties(    // discover available layers to instance on system
+    result = mGlobalDispatch.vkEnumerateInstanceLayerProperties( // discover available layers to instance on system
         &propertyCount,                             // uint32_t * pPropertyCount,               // output - get number of layer properties
         nullptr                                     // VkLayerProperties * pProperties);        // nullptr
     );
@@ -117,7 +426,7 @@ VkResult App::queryInstanceLayerProperties()
     {
         mInstanceLayerProperties.resize(propertyCount);
 
-        result = vkEnumerateInstanceLayerProperties( // discover available layers to instance on system
+        result = mGlobalDispatch.vkEnumerateInstanceLayerProperties( // discover available layers to instance on system
             &propertyCount,                         // uint32_t * pPropertyCount,               // input - provide number of layer properties
             mInstanceLayerProperties.data()         // VkLayerProperties * pProperties);        // array of structures to be filled with info about registered layers
         );
@@ -134,7 +443,7 @@ VkResult App::queryInstanceExtensionProperties()
 
     uint32_t propertyCount{ 0u };
 
-    result = vkEnumerateInstanceExtensionProperties(// discover available extensions to instance on system
+    result = mGlobalDispatch.vkEnumerateInstanceExtensionProperties(// discover available extensions to instance on system
         nullptr,                                    // const char* pLayerName,                  // nullptr or layer that might provide extensions
         &propertyCount,                             // uint32_t * pPropertyCount,               // output - get number of layer properties
         nullptr                                     // VkExtensionProperties * pProperties);    // nullptr
@@ -144,7 +453,7 @@ VkResult App::queryInstanceExtensionProperties()
     {
         mInstanceExtensionProperties.resize(propertyCount);
 
-        result = vkEnumerateInstanceExtensionProperties(// discover available extensions to instance on system
+        result = mGlobalDispatch.vkEnumerateInstanceExtensionProperties(// discover available extensions to instance on system
             nullptr,                                    // const char* pLayerName,                  // nullptr or layer that might provide extensions
             &propertyCount,                             // uint32_t * pPropertyCount,               // input - provide number of layer properties
             mInstanceExtensionProperties.data()         // VkExtensionProperties * pProperties);    // array of structures to be filled on supported extensions
@@ -166,7 +475,7 @@ VkResult App::queryPhysicalDevices()
     {
         uint32_t physicalDeviceCount{ 0u };
 
-        result = vkEnumeratePhysicalDevices(        // discover all supported devices in the system
+        result = mInstanceDispatch.vkEnumeratePhysicalDevices( // discover all supported devices in the system
             mInstance,                              // VkInstance instance,                         // Vulkan instance created in vkCreateInstance
             &physicalDeviceCount,                   // uint32_t * pPhysicalDeviceCount,             // output - get number of physical devices
             nullptr                                 // VkPhysicalDevice * pPhysicalDevices);        // nullptr
@@ -176,7 +485,7 @@ VkResult App::queryPhysicalDevices()
         {
             mPhysicalDevices.resize(physicalDeviceCount);
 
-            result = vkEnumeratePhysicalDevices(    // get handles to all physical devices in the system
+            result = mInstanceDispatch.vkEnumeratePhysicalDevices( // get handles to all physical devices in the system
                 mInstance,                          // VkInstance instance,                         // Vulkan instance created in vkCreateInstance
                 &physicalDeviceCount,               // uint32_t * pPhysicalDeviceCount,             // input - provide number of discovered physical devices in the system
                 &mPhysicalDevices[0]                // VkPhysicalDevice * pPhysicalDevices);        // array of handles to physical devices
@@ -187,209 +496,116 @@ VkResult App::queryPhysicalDevices()
     return result;
 }
 
-VkResult App::queryPhysicalDeviceLayerProperties()
+bool App::loadCapabilityCache()
 {
-    // Query device layer properties
+    // Use cached capability blocks in place when every physical device has an
+    // entry with the same driver identity (vendorID, deviceID, driverVersion, pipelineCacheUUID).
+    // Only vkGetPhysicalDeviceProperties is needed to check the identity.
 
-    VkResult result = VK_SUCCESS;
+    mPhysicalDeviceRecords.clear();
+
+    if (mConfig.capabilityCachePath.empty() || !mCapabilityCache.open(mConfig.capabilityCachePath))
+        return false;
 
     const size_t len{ mPhysicalDevices.size() };
-    mPhysicalDeviceLayerProperties.resize(len);
+    bool hit{ mCapabilityCache.getDeviceCount() == len };
 
-    for (size_t i{ 0u }; i < len; ++i)
+    std::vector<const PhysicalDeviceCapabilities*> capabilities(len, nullptr);
+    for (size_t i{ 0u }; hit && i < len; ++i)
     {
-        uint32_t propertyCount{ 0u };
-
-        result = vkEnumerateDeviceLayerProperties(  // discover available layers to device on system
-            mPhysicalDevices[i],                    // physical device to query
-            &propertyCount,                         // uint32_t * pPropertyCount,                   // output - get number of layer properties
-            nullptr                                 // VkLayerProperties * pProperties);            // nullptr
+        VkPhysicalDeviceProperties properties;
+        mInstanceDispatch.vkGetPhysicalDeviceProperties( // fill structures describing all properties of physical device
+            mPhysicalDevices[i],                    // VkPhysicalDevice physicalDevice,             // handle to physical device
+            &properties                             // VkPhysicalDeviceProperties * pProperties);   // structure to be filled with details on physical device properties
         );
 
-        if (result == VK_SUCCESS)
-        {
-            mPhysicalDeviceLayerProperties[i].resize(propertyCount);
-
-            result = vkEnumerateDeviceLayerProperties( // discover available layers to device on system
-                mPhysicalDevices[i],                // physical device to query
-                &propertyCount,                     // uint32_t * pPropertyCount,                   // output - get number of layer properties
-                mPhysicalDeviceLayerProperties[i].data() // VkLayerProperties * pProperties);       // array of structures to be filled with info about registered layers
-            );
-
-            if (result != VK_SUCCESS)
-                break;
-        }
-        else
-            break;
+        capabilities[i] = mCapabilityCache.find(i, properties);
+        hit = capabilities[i] != nullptr;
     }
 
-    return result;
-}
-
-VkResult App::queryPhysicalDeviceExtensionProperties()
-{
-    // Query device extension properties
-
-    VkResult result = VK_SUCCESS;
-
-    const size_t len{ mPhysicalDevices.size() };
-    mPhysicalDeviceExtensionProperties.resize(len);
-
-    for (size_t i{ 0u }; i < len; ++i)
+    if (!hit)
     {
-        uint32_t propertyCount{ 0u };
-
-        result = vkEnumerateDeviceExtensionProperties( // discover available extensions to instance on system
-            mPhysicalDevices[i],                    // VkPhysicalDevice physicalDevice,             // physical device to query
-            nullptr,                                // const char* pLayerName,                      // nullptr or layer that might provide extensions
-            &propertyCount,                         // uint32_t * pPropertyCount,                   // output - get number of layer properties
-            nullptr                                 // VkExtensionProperties * pProperties);        // nullptr
-        );
-
-        if (result == VK_SUCCESS)
-        {
-            mPhysicalDeviceExtensionProperties[i].resize(propertyCount);
-
-            result = vkEnumerateDeviceExtensionProperties( // discover available extensions to instance on system
-                mPhysicalDevices[i],                // VkPhysicalDevice physicalDevice,             // physical device to query
-                nullptr,                            // const char* pLayerName,                      // nullptr or layer that might provide extensions
-                &propertyCount,                     // uint32_t * pPropertyCount,                   // input - provide number of layer properties
-                mPhysicalDeviceExtensionProperties[i].data() // VkExtensionProperties * pProperties); // array of structures to be filled with info about registered layers
-            );
-
-            if (result != VK_SUCCESS)
-                break;
-        }
-        else
-            break;
+        // stale cache - full query and rewrite
+        mCapabilityCache.close();
+        return false;
     }
 
-    return result;
-}
-
-VkResult App::queryPhysicalDeviceProperties()
-{
-    // Query properties of physical devices
-
-    // typedef struct VkPhysicalDeviceProperties {              // details on physical device
-    //    uint32_t apiVersion;                                  // highest version of Vulkan supported by device
-    //    uint32_t driverVersion;                               // driver version used to control device (vendor specific)
-    //    uint32_t vendorID;                                    // identify vendor
-    //    uint32_t deviceID;                                    // identify device
-    //    VkPhysicalDeviceType deviceType;                      // supported physical device types
-    //    char deviceName[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE];    // human readable name of device
-    //    uint8_t pipelineCacheUUID[VK_UUID_SIZE];              // used for pipeline caching
-    //    VkPhysicalDeviceLimits limits;                        // min and max limits for physical device
-    //    VkPhysicalDeviceSparseProperties sparseProperties;    // properties related to sparse textures
-    //} VkPhysicalDeviceProperties;
-
-    VkResult result = VK_SUCCESS;
-
-    const size_t len{ mPhysicalDevices.size() };
-    mPhysicalDeviceProperties.resize(len);
-
+    mPhysicalDeviceRecords.resize(len);
     for (size_t i{ 0u }; i < len; ++i)
-    {
-        vkGetPhysicalDeviceProperties(              // fill structures describing all properties of physical device
-            mPhysicalDevices[i],                    // VkPhysicalDevice physicalDevice,             // handle to physical device
-            &mPhysicalDeviceProperties[i]           // VkPhysicalDeviceProperties * pProperties);   // structure to be filled with details on physical device properties
-        );
-    }
+        mPhysicalDeviceRecords[i].attach(mPhysicalDevices[i], capabilities[i]);
 
-    return result;
+    return true;
 }
 
-VkResult App::queryPhysicalDeviceFeatures()
+void App::storeCapabilityCache()
 {
-    // Query features of physical devices
-
-    // typedef struct VkPhysicalDeviceFeatures {                // details on features of physical device
-    //    VkBool32    robustBufferAccess;                       // bool field marked if the feature is supported
-    //    ..
-    //} VkPhysicalDeviceFeatures;
-
-    VkResult result = VK_SUCCESS;
-
-    const size_t len{ mPhysicalDevices.size() };
-    mPhysicalDeviceFeatures.resize(len);
-
-    for (size_t i{ 0u }; i < len; ++i)
-    {
-        vkGetPhysicalDeviceFeatures(                // fill structures describing all features of physical device
-            mPhysicalDevices[i],                    // VkPhysicalDevice physicalDevice,             // handle to physical device
-            &mPhysicalDeviceFeatures[i]             // VkPhysicalDeviceFeatures* pFeatures);        // structure to be filled with details on physical device features
-        );
-    }
-
-    return result;
+    // failing to write the cache only costs the next start a full query
+    if (!mConfig.capabilityCachePath.empty())
+        CapabilityCache::write(mConfig.capabilityCachePath, mPhysicalDeviceRecords);
 }
 
-VkResult App::queryPhysicalDeviceMemoryProperties()
+VkResult App::queryPhysicalDeviceRecords()
 {
-    // Query memory properties of physical devices
-
-    // typedef struct VkPhysicalDeviceMemoryProperties {        // properties of device heaps and supported memory types
-    //    uint32_t memoryTypeCount;                             // number of memory types
-    //    VkMemoryType memoryTypes[VK_MAX_MEMORY_TYPES];        // memoryTypeCount number of structures
-    //    uint32_t memoryHeapCount;                             // number of heaps
-    //    VkMemoryHeap memoryHeaps[VK_MAX_MEMORY_HEAPS];        // memoryHeapCount number of structures
-    //} VkPhysicalDeviceMemoryProperties;
-
-    VkResult result = VK_SUCCESS;
+    // Query capabilities of physical devices, one pass per device.
+    // Devices are independent, with more than one they are queried in parallel.
 
     const size_t len{ mPhysicalDevices.size() };
-    mPhysicalDeviceMemoryProperties.resize(len);
+    mPhysicalDeviceRecords.clear();
+    mPhysicalDeviceRecords.resize(len);
 
-    for (size_t i{ 0u }; i < len; ++i)
+    std::vector<VkResult> results(len, VK_SUCCESS);
+    const auto queryRecord = [this, &results](size_t i) { results[i] = mPhysicalDeviceRecords[i].query(mInstanceDispatch, mPhysicalDevices[i]); };
+
+    // the calling thread queries too, so one device needs no worker
+    const size_t threadCount{ len > 1u ? std::min<size_t>(len - 1u, mConfig.maxQueryThreads) : 0u };
+    if (threadCount > 0u)
     {
-        vkGetPhysicalDeviceMemoryProperties(        // fill structures describing all memory properties of physical device
-            mPhysicalDevices[i],                    // VkPhysicalDevice physicalDevice,             // handle to physical device
-            &mPhysicalDeviceMemoryProperties[i]     // VkPhysicalDeviceMemoryProperties* pMemoryProperties); // structure to be filled with details on physical device memory properties
-        );
+        ThreadPool threadPool(threadCount);
+        threadPool.parallelFor(len, queryRecord);
     }
+    else
+        for (size_t i{ 0u }; i < len; ++i)
+            queryRecord(i);
 
-    return result;
+    for (VkResult result : results)
+        if (result != VK_SUCCESS)
+            return result;
+
+    return VK_SUCCESS;
 }
 
-void App::queryPhysicalDeviceQueueFamilyProperties()
+VkQueue App::getQueue(QueueType type, uint32_t index) const
 {
-    // Query queue familty properties of physical devices
-
-    // typedef struct VkQueueFamilyProperties {                 // identical queues with same caps and able to run in parallel
-    //    VkQueueFlags queueFlags;                              // overall caps of queue
-    //    uint32_t queueCount;                                  // number of queues in family (1 or more)
-    //    uint32_t timestampValidBits;                          // number of valid bits when timestamps taken from queue
-    //    VkExtent3D minImageTransferGranularity;               // units to support image transfers (may not support)
-    //} VkQueueFamilyProperties;
+    const std::vector<VkQueue>& queues = mQueues[static_cast<size_t>(type)];
+    return queues.empty() ? VK_NULL_HANDLE : queues[index % queues.size()];
+}
 
-    const size_t len{ mPhysicalDevices.size() };
-    mQueueFamilyProperties.resize(len);
-    uint32_t queueFamilyPropertyCount{ 0u };
+std::mutex* App::getQueueMutex(QueueType type, uint32_t index)
+{
+    const VkQueue queue{ getQueue(type, index) };
+    const auto it = std::find_if(mQueueMutexes.begin(), mQueueMutexes.end(), [queue](const QueueMutex& queueMutex) { return queueMutex.queue == queue; });
+    return it != mQueueMutexes.end() ? it->mutex.get() : nullptr;
+}
 
-    for (size_t i{ 0u }; i < len; ++i)
-    {
-        vkGetPhysicalDeviceQueueFamilyProperties(   // discover number of queue families supported by physical device
-            mPhysicalDevices[i],                    // VkPhysicalDevice physicalDevice,             // handle to physical device
-            &queueFamilyPropertyCount,              // uint32_t * pQueueFamilyPropertyCount,        // output - get number of queue families
-            nullptr                                 // VkQueueFamilyProperties * pQueueFamilyProperties // nullptr
-        );
-        mQueueFamilyProperties[i].resize(queueFamilyPropertyCount);
+uint32_t App::getQueueCount(QueueType type) const
+{
+    return static_cast<uint32_t>(mQueues[static_cast<size_t>(type)].size());
+}
 
-        vkGetPhysicalDeviceQueueFamilyProperties(   // get properties of device queue families
-            mPhysicalDevices[i],                    // VkPhysicalDevice physicalDevice,             // handle to physical device
-            &queueFamilyPropertyCount,              // uint32_t * pQueueFamilyPropertyCount,        // input - provide number of queue families
-            mQueueFamilyProperties[i].data()        // VkQueueFamilyProperties * pQueueFamilyProperties // array of structures to fill
-        );
-    }
+uint32_t App::getQueueFamilyIndex(QueueType type) const
+{
+    return mQueueFamilyIndices[static_cast<size_t>(type)];
 }
 
-bool App::getQueueFamilyIndex(size_t physicalDeviceIndex, VkQueueFlags queueFlags, uint32_t& queueFamilyIndex)
+bool App::getQueueFamilyIndex(size_t physicalDeviceIndex, VkQueueFlags queueFlags, uint32_t& queueFamilyIndex, VkQueueFlags excludedQueueFlags)
 {
-    const auto& queueFamilyProperties = mQueueFamilyProperties[physicalDeviceIndex];
+    // First family supporting all queueFlags and none of excludedQueueFlags
+
+    const auto queueFamilyProperties = mPhysicalDeviceRecords[physicalDeviceIndex].getQueueFamilyProperties();
     queueFamilyIndex = std::numeric_limits< uint32_t>::max();
 
     for (uint32_t i{ 0u }; i < queueFamilyProperties.size(); ++i)
-        if (queueFamilyProperties[i].queueFlags & queueFlags)
+        if ((queueFamilyProperties[i].queueFlags & queueFlags) == queueFlags && !(queueFamilyProperties[i].queueFlags & excludedQueueFlags))
         {
             queueFamilyIndex = i;
             break;
@@ -398,44 +614,210 @@ bool App::getQueueFamilyIndex(size_t physicalDeviceIndex, VkQueueFlags queueFlag
     return queueFamilyIndex == std::numeric_limits< uint32_t>::max() ? false : true;
 }
 
-VkResult App::createLogicalDevice(size_t physicalDeviceIndex, uint32_t queueFamilyIndex)
+bool App::selectQueueFamilies(size_t physicalDeviceIndex)
+{
+    // queueFlags - combination of VkQueueFlagBits, where each flag means that queues in this family that supports or not the following :
+    // VK_QUEUE_GRAPHICS_BIT                    // graphics operations : drawing points, lines, triangles
+    // VK_QUEUE_COMPUTE_BIT                     // computer operations : e.g.dispatching compute shaders
+    // VK_QUEUE_TRANSFER_BIT                    // transfer operations : e.g.copying bufferand image contents
+    // VK_QUEUE_SPARSE_BINDING_BIT              // memory binding operations used to update sparse resources
+    //
+    // Graphics and compute families support transfer even when they do not report VK_QUEUE_TRANSFER_BIT.
+
+    uint32_t& graphics = mQueueFamilyIndices[static_cast<size_t>(QueueType::Graphics)];
+    uint32_t& compute = mQueueFamilyIndices[static_cast<size_t>(QueueType::AsyncCompute)];
+    uint32_t& transfer = mQueueFamilyIndices[static_cast<size_t>(QueueType::Transfer)];
+
+    // Graphics - prefer family with compute too (required to exist by the spec if any graphics family exists)
+    if (!getQueueFamilyIndex(physicalDeviceIndex, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT, graphics)
+        && !getQueueFamilyIndex(physicalDeviceIndex, VK_QUEUE_GRAPHICS_BIT, graphics))
+        return false;
+
+    // Async compute - compute without graphics, else any compute family, else share graphics family
+    if (!getQueueFamilyIndex(physicalDeviceIndex, VK_QUEUE_COMPUTE_BIT, compute, VK_QUEUE_GRAPHICS_BIT)
+        && !getQueueFamilyIndex(physicalDeviceIndex, VK_QUEUE_COMPUTE_BIT, compute))
+        compute = graphics;
+
+    // Transfer - copy engine (no graphics and compute), else transfer without graphics, else share compute family
+    if (!getQueueFamilyIndex(physicalDeviceIndex, VK_QUEUE_TRANSFER_BIT, transfer, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)
+        && !getQueueFamilyIndex(physicalDeviceIndex, VK_QUEUE_TRANSFER_BIT, transfer, VK_QUEUE_GRAPHICS_BIT))
+        transfer = compute;
+
+    return true;
+}
+
+VkResult App::createLogicalDevice(size_t physicalDeviceIndex)
 {
     // Initialize logical device
-    // 2) create device queue create info - VkDeviceQueueCreateInfo (queueFamilyIndex)
-    // 3) create device create info - VkDeviceCreateInfo (&VkDeviceQueueCreateInfo)
-    // 4) create device instance vkCreateDevice (&VkDeviceCreateInfo, &mDevice)
-    // 5) destroy VkDeviceQueueCreateInfo and VkDeviceCreateInfo
+    // 1) assign queue indices of each family to queue roles (QueueType), each role gets
+    //    up to its requested number of distinct queues, a role left without a free queue shares queue 0
+    // 2) resolve enabled features - requested by AppConfig::features and supported by the device,
+    //    optional extensions supported by the device
+    // 3) create device queue create info per used family - VkDeviceQueueCreateInfo (queueFamilyIndex, priorities)
+    // 4) create device create info - VkDeviceCreateInfo (&VkDeviceQueueCreateInfo[], features)
+    // 5) create device instance vkCreateDevice (&VkDeviceCreateInfo, &mDevice)
+    // 6) get queue handles - vkGetDeviceQueue
+    // 7) destroy VkDeviceQueueCreateInfo and VkDeviceCreateInfo
 
     VkResult result = VK_SUCCESS;
 
-    const VkDeviceQueueCreateInfo deviceQueueCreateInfo = {
-        VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, // VkStructureType sType;                   // type of create device info structure
-        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
-        0,                                      // VkDeviceCreateFlags flags;                   // 0 (no bits defined in current version of Vulkan)
-        queueFamilyIndex,                       // uint32_t queueFamilyIndex;                   // index to queues matching queueFlags
-        1,                                      // uint32_t queueCount;                         // input - number of queues to create in the family queueFamilyIndex
-        nullptr                                 // const float* pQueuePriorities;               // nullptr or ptr to array of floats representing priorities of queues
+    const auto queueFamilyProperties = mPhysicalDeviceRecords[physicalDeviceIndex].getQueueFamilyProperties();
+    std::vector<std::vector<float>> queuePriorities(queueFamilyProperties.size());     // per family, one entry per created queue
+    std::array<std::vector<uint32_t>, QueueTypeCount> queueIndices;                    // per role, index of queue in its family
+
+    for (size_t type{ 0u }; type < QueueTypeCount; ++type)
+    {
+        const uint32_t queueFamilyIndex{ mQueueFamilyIndices[type] };
+        const QueueRequest& queueRequest = mConfig.queues[type];
+        std::vector<float>& priorities = queuePriorities[queueFamilyIndex];
+
+        // residency moves get a Transfer queue of their own next to the StagingUploader's
+        const uint32_t minCount{ type == static_cast<size_t>(QueueType::Transfer) && mConfig.residency.framesInFlight > 0u ? 2u : 1u };
+
+        for (uint32_t i{ 0u }; i < std::max(queueRequest.count, minCount); ++i)
+        {
+            if (priorities.size() < queueFamilyProperties[queueFamilyIndex].queueCount)
+            {
+                queueIndices[type].push_back(static_cast<uint32_t>(priorities.size()));
+                priorities.push_back(std::min(std::max(queueRequest.priority, 0.0f), 1.0f));
+            }
+            else
+            {
+                // family exhausted, role shares the first queue of the family
+                if (queueIndices[type].empty())
+                    queueIndices[type].push_back(0u);
+                break;
+            }
+        }
+    }
+
+    // Enable only requested features the device supports
+    std::string missingFeature;
+    result = resolveDeviceFeatures(mPhysicalDeviceRecords[physicalDeviceIndex], mConfig.features, mEnabledFeatures, &missingFeature);
+    if (result != VK_SUCCESS)
+    {
+        std::printf("Required device feature %s is not supported\n", missingFeature.c_str());
+        return result;
+    }
+
+    // Enable optional extensions the device supports, one hash probe each
+    const PhysicalDeviceRecord& record = mPhysicalDeviceRecords[physicalDeviceIndex];
+    std::vector<const char*> enabledExtensionNames;
+    mEnabledDeviceExtensions.clear();
+    const auto enableOptionalExtension = [this, &record, &enabledExtensionNames](const NameHash& name)
+    {
+        if (record.hasExtension(name) && !mEnabledDeviceExtensions.contains(name))
+        {
+            enabledExtensionNames.push_back(name.name);
+            mEnabledDeviceExtensions.insert(name.name);
+        }
     };
 
+    if (mConfig.pipelineCreationFeedback)
+        enableOptionalExtension(KnownExtensions::PipelineCreationFeedback);
+    if (mConfig.memoryBudget && mConfig.residency.framesInFlight > 0u)
+        enableOptionalExtension(KnownExtensions::MemoryBudget);
+    for (const std::string& extensionName : mConfig.optionalDeviceExtensions)
+        enableOptionalExtension(extensionName.c_str());
+
+    std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfos;
+    for (uint32_t queueFamilyIndex{ 0u }; queueFamilyIndex < queuePriorities.size(); ++queueFamilyIndex)
+    {
+        if (queuePriorities[queueFamilyIndex].empty())
+            continue;
+
+        deviceQueueCreateInfos.push_back({
+            VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, // VkStructureType sType;               // type of create device info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0,                                  // VkDeviceCreateFlags flags;                   // 0 (no bits defined in current version of Vulkan)
+            queueFamilyIndex,                   // uint32_t queueFamilyIndex;                   // index to queues matching queueFlags
+            static_cast<uint32_t>(queuePriorities[queueFamilyIndex].size()), // uint32_t queueCount; // input - number of queues to create in the family queueFamilyIndex
+            queuePriorities[queueFamilyIndex].data() // const float* pQueuePriorities;          // nullptr or ptr to array of floats representing priorities of queues
+        });
+    }
+
     const VkDeviceCreateInfo deviceCreateInfo = {
         VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,   // VkStructureType sType;                       // type of create device info structure
-        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        mEnabledFeatures.getDeviceCreateInfoNext(), // const void* pNext;                       // VkPhysicalDeviceFeatures2 -> 1.1 -> 1.2 features chain (Vulkan 1.2 devices) or nullptr
         0,                                      // VkDeviceCreateFlags flags;                   // 0 (no bits defined in current version of Vulkan)
-        1,                                      // uint32_t queueCreateInfoCount;               // number of structures in pQueueCreateInfos array
-        &deviceQueueCreateInfo,                 // const VkDeviceQueueCreateInfo* pQueueCreateInfos; // ptr to array of structures with queues specs
+        static_cast<uint32_t>(deviceQueueCreateInfos.size()), // uint32_t queueCreateInfoCount; // number of structures in pQueueCreateInfos array
+        deviceQueueCreateInfos.data(),          // const VkDeviceQueueCreateInfo* pQueueCreateInfos; // ptr to array of structures with queues specs
         0,                                      // uint32_t enabledLayerCount;                  // let enable layers and extensions (can be 0)
         nullptr,                                // const char* const* ppEnabledLayerNames;		// let enable layers and extensions (can be nullptr)
-        0,                                      // uint32_t enabledExtensionCount;              // let enable layers and extensions (can be 0)
-        nullptr,                                // const char* const* ppEnabledExtensionNames;  // let enable layers and extensions (can be nullptr)
-        &mPhysicalDeviceFeatures[physicalDeviceIndex] // const VkPhysicalDeviceFeatures* pEnabledFeatures; // ptr to structure with optional features (can be nullptr)
+        static_cast<uint32_t>(enabledExtensionNames.size()), // uint32_t enabledExtensionCount; // number of optional extensions supported by the device (can be 0)
+        enabledExtensionNames.data(),           // const char* const* ppEnabledExtensionNames;  // names of optional extensions supported by the device
+        mEnabledFeatures.getEnabledFeatures()   // const VkPhysicalDeviceFeatures* pEnabledFeatures; // ptr to structure with optional features (nullptr when chained in pNext)
     };
 
-    result = vkCreateDevice(                    // create logical device
+    result = mInstanceDispatch.vkCreateDevice(  // create logical device
         mPhysicalDevices[physicalDeviceIndex],  // VkPhysicalDevice physicalDevice,             // handle to physical device
         &deviceCreateInfo,                      // const VkDeviceCreateInfo * pCreateInfo,      // parameters describing logical device
-        nullptr,                                // const VkAllocationCallbacks * pAllocator,    // custom memory allocator
+        mAllocationCallbacks,                   // const VkAllocationCallbacks * pAllocator,    // custom memory allocator
         &mDevice                                // VkDevice * pDevice);                         // handle to logical device
     );
 
+    // device functions straight from the driver, no loader trampoline per call
+    if (result == VK_SUCCESS)
+        mDeviceDispatch.load(mInstanceDispatch, mDevice);
+
+    for (size_t type{ 0u }; type < QueueTypeCount; ++type)
+    {
+        mQueues[type].clear();
+
+        for (uint32_t queueIndex : queueIndices[type])
+        {
+            VkQueue queue{ VK_NULL_HANDLE };
+            if (result == VK_SUCCESS)
+                mDeviceDispatch.vkGetDeviceQueue( // get handle of queue created with the device
+                    mDevice,                    // VkDevice device,                             // logical device owning the queue
+                    mQueueFamilyIndices[type],  // uint32_t queueFamilyIndex,                   // family of the queue
+                    queueIndex,                 // uint32_t queueIndex,                         // index within the family (< queueCount of its create info)
+                    &queue                      // VkQueue* pQueue);                            // output - queue handle
+                );
+            mQueues[type].push_back(queue);
+        }
+    }
+
+    // one lock per distinct queue, roles sharing a queue share its lock
+    mQueueMutexes.clear();
+    for (const std::vector<VkQueue>& queues : mQueues)
+        for (VkQueue queue : queues)
+            if (queue != VK_NULL_HANDLE
+                && std::none_of(mQueueMutexes.begin(), mQueueMutexes.end(), [queue](const QueueMutex& queueMutex) { return queueMutex.queue == queue; }))
+                mQueueMutexes.push_back(QueueMutex{ queue, std::make_unique<std::mutex>() });
+
+    return result;
+}
+
+VkResult App::createDeviceContexts(const std::vector<uint32_t>& physicalDeviceIndices)
+{
+    // Device contexts share the feature request and memory/compute configuration of the main device,
+    // contexts on the same physical device are ordered round-robin so shares spread over the GPUs
+    VkResult result = VK_SUCCESS;
+
+    DeviceContextConfig deviceContextConfig;
+    deviceContextConfig.features = mConfig.features;
+    deviceContextConfig.deviceMemory = mConfig.deviceMemory;
+    deviceContextConfig.compute = mConfig.compute;
+
+    const uint32_t devicesPerPhysicalDevice{ std::max(mConfig.multiDevice.devicesPerPhysicalDevice, 1u) };
+    for (uint32_t i{ 0u }; result == VK_SUCCESS && i < devicesPerPhysicalDevice; ++i)
+        for (uint32_t physicalDeviceIndex : physicalDeviceIndices)
+        {
+            mDeviceContexts.emplace_back(new DeviceContext);
+            result = mDeviceContexts.back()->init(mInstanceDispatch, mPhysicalDevices[physicalDeviceIndex], mPhysicalDeviceRecords[physicalDeviceIndex],
+                mAllocationCallbacks, deviceContextConfig);
+            if (result != VK_SUCCESS)
+                break;
+        }
+
+    if (result == VK_SUCCESS)
+    {
+        std::vector<DeviceContext*> deviceContexts;
+        for (std::unique_ptr<DeviceContext>& deviceContext : mDeviceContexts)
+            deviceContexts.push_back(deviceContext.get());
+        result = mMultiDeviceScheduler.init(deviceContexts, mConfig.multiDevice);
+    }
+
     return result;
 }
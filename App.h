@@ -1,44 +1,278 @@
 #pragma once
 
+#include "CapabilityCache.h"
+#include "CommandRecorder.h"
+#include "ComputeEngine.h"
+#include "DeviceContext.h"
+#include "DeviceFeatures.h"
+#include "DeviceMemoryAllocator.h"
+#include "DeviceSelector.h"
+#include "HeadlessRenderer.h"
+#include "HostAllocator.h"
+#include "MultiDeviceScheduler.h"
+#include "NameSet.h"
+#include "PhysicalDeviceRecord.h"
+#include "PipelineCache.h"
+#include "Profiler.h"
+#include "ResidencyManager.h"
+#include "StagingUploader.h"
+#include "SubmissionScheduler.h"
+#include "VulkanDispatch.h"
 #include <vulkan/vulkan.h>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
+/// Steps of App::init() and App::deinit() timed for startup benchmarking
+enum class InitPhase : uint32_t
+{
+	LoadVulkanLibrary,
+	CreateInstance,
+	QueryPhysicalDevices,
+	LoadCapabilityCache,
+	QueryPhysicalDeviceRecords,
+	StoreCapabilityCache,
+	SelectPhysicalDevice,
+	CreateLogicalDevice,
+	CreateProfiler,
+	CreateMemoryAllocator,
+	CreateStagingUploader,
+	CreatePipelineCache,
+	CreateComputeEngine,
+	CreateCommandRecorder,
+	CreateSubmissionScheduler,
+	CreateHeadlessRenderer,
+	CreateResidencyManager,
+	CreateMultiDeviceScheduler,
+	Deinit,
+	Count
+};
+
+/// Roles App creates queues for, each role gets a dedicated family when the device has one
+enum class QueueType : uint32_t
+{
+	Graphics,		// graphics (+ compute + transfer) family
+	AsyncCompute,	// compute family without graphics, falls back to the graphics family
+	Transfer,		// transfer family without graphics and compute (copy engine), falls back to compute/graphics
+	Count
+};
+
+constexpr size_t QueueTypeCount{ static_cast<size_t>(QueueType::Count) };
+
+/// Number and priority of queues created for one QueueType
+struct QueueRequest
+{
+	uint32_t count;		// queues to create (clamped to what the family offers)
+	float priority;		// 0.0 - 1.0, relative to other queues of the device
+};
+
+/// Options of App, defaults match the demo
+struct AppConfig
+{
+	bool useHostAllocator{ true };				// pass HostAllocator callbacks as pAllocator (false - driver internal allocator)
+	bool printHostAllocatorSummary{ true };		// print host allocation statistics in deinit()
+	bool printDeviceMemoryStatistics{ true };	// print device memory statistics in deinit()
+	bool printPipelineCacheStatistics{ true };	// print pipeline cache statistics in deinit()
+	uint32_t maxQueryThreads{ 4u };				// threads querying physical devices in parallel (0 - serial)
+	std::string capabilityCachePath{ "mkVulkanDemo.capcache" };	// capability cache file (empty - always query)
+	std::string pipelineCachePath{ "mkVulkanDemo.pipelinecache" };	// pipeline cache file, loaded in init(), saved in deinit() (empty - not persisted)
+	std::vector<std::string> pipelineCacheMergePaths;	// pipeline caches of other (worker) processes merged in init()
+	bool pipelineCreationFeedback{ true };		// enable VK_EXT_pipeline_creation_feedback when supported (pipeline cache hit/miss counters)
+	bool memoryBudget{ true };					// enable VK_EXT_memory_budget when supported (heap budgets of the residency manager)
+	std::vector<std::string> optionalInstanceExtensions;	// enabled when supported, see App::isInstanceExtensionEnabled()
+	std::vector<std::string> optionalDeviceExtensions;		// enabled when supported, see App::isDeviceExtensionEnabled()
+	DeviceSelectionCriteria deviceSelection;	// weights/override for choosing the physical device
+	std::array<QueueRequest, QueueTypeCount> queues{ {	// queues per QueueType
+		{ 1u, 1.0f },							// Graphics
+		{ 1u, 0.75f },							// AsyncCompute
+		{ 1u, 0.5f }							// Transfer
+	} };
+	DeviceFeatureRequest features{ getFeatureProfile(FeatureProfile::Performance) };	// features enabled on the logical device
+	HostAllocatorConfig hostAllocator;
+	DeviceMemoryAllocatorConfig deviceMemory;
+	StagingUploaderConfig staging;				// uploads on the Transfer queue (ringSize 0 - no uploader)
+	ComputeEngineConfig compute;				// kernels on the AsyncCompute queue (maxDescriptorSets 0 - no engine)
+	CommandRecorderConfig commandRecorder;		// multi-threaded recording for the Graphics queue (framesInFlight 0 - no recorder)
+	SubmissionSchedulerConfig submission;		// timeline per QueueType, needs timelineSemaphore (maxBatchesInFlight 0 - no scheduler)
+	HeadlessRendererConfig headless;			// offscreen rendering + readback on the Graphics queue (framesInFlight 0 - no renderer)
+	ResidencyManagerConfig residency;			// eviction of idle buffers over budget, moves on the Transfer queue (framesInFlight 0 - no manager)
+	MultiDeviceSchedulerConfig multiDevice;		// compute batches split over logical devices on all eligible physical devices (maxPhysicalDevices 0 - no scheduler)
+	ProfilerConfig profiler;					// CPU/GPU zones of the subsystems, trace written in deinit() (enabled false - no profiler)
+};
+
 class App
 {
 public:
+	explicit App(const AppConfig& config = AppConfig{});
+
 	/// Initialize Vulkan Instance. Query physical devices and their
 	/// properties, features, memory properties, queue familty properties.
 	/// Query instance layers/extensions and device layers/extensions.
+	/// Devices are queried in parallel when there is more than one. Device
+	/// capabilities are taken from the capability cache when the drivers did
+	/// not change since it was written. The logical device is created on the
+	/// best scoring physical device (see DeviceSelector). The pipeline cache
+	/// of the previous run is loaded when it was written for the same device
+	/// and driver (AppConfig::pipelineCachePath) and saved again in deinit().
 	/// return initialization result
 	VkResult init();
 
 	/// Destroy Vulkan Instance, logical device
 	VkResult deinit();
+
+	using InitPhaseDurations = std::array<std::chrono::nanoseconds, static_cast<size_t>(InitPhase::Count)>;
+
+	/// Wall time of each phase of the last init()/deinit()
+	const InitPhaseDurations& getInitPhaseDurations() const { return mInitPhaseDurations; }
+
+	/// Human readable name of init phase
+	static const char* getInitPhaseName(InitPhase phase);
+
+	VkInstance getInstance() const { return mInstance; }
+	VkDevice getDevice() const { return mDevice; }
+
+	/// Instance layers and extensions, enumerated on the first call (empty before the loader is loaded)
+	const std::vector<VkLayerProperties>& getInstanceLayerProperties();
+	const std::vector<VkExtensionProperties>& getInstanceExtensionProperties();
+
+	/// Capability checks with a single hash probe. Pass KnownExtensions/KnownLayers
+	/// (hashed at compile time) or any name. Instance tables are enumerated and
+	/// device tables indexed on first use only.
+	bool hasInstanceLayer(const NameHash& name);
+	bool hasInstanceExtension(const NameHash& name);
+	/// Supported by the physical device the logical device is created on
+	bool hasDeviceLayer(const NameHash& name) const;
+	bool hasDeviceExtension(const NameHash& name) const;
+	/// Optional extensions init() enabled (AppConfig::optional*Extensions and those of App's subsystems)
+	bool isInstanceExtensionEnabled(const NameHash& name) const { return mEnabledInstanceExtensions.contains(name); }
+	bool isDeviceExtensionEnabled(const NameHash& name) const { return mEnabledDeviceExtensions.contains(name); }
+
+	/// Function tables of the loader, the instance and the logical device (see VulkanDispatch.h),
+	/// code outside App calls Vulkan through them
+	const GlobalDispatch& getGlobalDispatch() const { return mGlobalDispatch; }
+	const InstanceDispatch& getInstanceDispatch() const { return mInstanceDispatch; }
+	const DeviceDispatch& getDeviceDispatch() const { return mDeviceDispatch; }
+
+	/// Sub-allocator of device memory of the logical device
+	DeviceMemoryAllocator& getMemoryAllocator() { return mMemoryAllocator; }
+
+	/// Streaming uploads to device buffers on the Transfer queue
+	StagingUploader& getStagingUploader() { return mStagingUploader; }
+
+	/// Pipeline cache persisted across runs, create pipelines through it
+	PipelineCache& getPipelineCache() { return mPipelineCache; }
+
+	/// Compute kernels on the AsyncCompute queue, kernels must be destroyed before deinit()
+	ComputeEngine& getComputeEngine() { return mComputeEngine; }
+
+	/// Frames of secondary command buffers recorded on all cores, submitted to the Graphics queue
+	CommandRecorder& getCommandRecorder() { return mCommandRecorder; }
+
+	/// Timeline semaphore submissions to the first queue of every QueueType, queue
+	/// index of tickets is the QueueType. Not initialized (getQueueCount() 0) when
+	/// the timelineSemaphore feature is not enabled on the device.
+	SubmissionScheduler& getSubmissionScheduler() { return mSubmissionScheduler; }
+
+	/// Offscreen color target rendered on the Graphics queue and read back to the host
+	HeadlessRenderer& getHeadlessRenderer() { return mHeadlessRenderer; }
+
+	/// Buffers demoted to host memory when device local heaps run over budget and restored on use.
+	/// Moves use the second Transfer queue, which is requested with it. When the family has a single
+	/// queue it is the StagingUploader's one, and both submit to it under its getQueueMutex() lock.
+	ResidencyManager& getResidencyManager() { return mResidencyManager; }
+
+	/// Batches of compute work split across DeviceContexts - logical devices of their own with a
+	/// compute queue, allocator and compute engine - on the selected physical device and the next
+	/// best eligible ones (AppConfig::multiDevice). Independent of getDevice() and its subsystems,
+	/// kernels and buffers are created per context. Not initialized (getDeviceCount() 0) by default.
+	MultiDeviceScheduler& getMultiDeviceScheduler() { return mMultiDeviceScheduler; }
+
+	/// Zones of all subsystems, GPU time calibrated on every queue family. Not initialized
+	/// when AppConfig::profiler is disabled. Call beginFrame() once per frame, without it
+	/// GPU zones over maxGpuZonesPerFrame are dropped (reported once) until deinit().
+	Profiler& getProfiler() { return mProfiler; }
+
+	/// Features enabled on the logical device (subset of AppConfig::features supported by the device)
+	const DeviceFeatureChain& getEnabledFeatures() const { return mEnabledFeatures; }
+
+	/// Queue index of role type (index wraps around getQueueCount()). When the
+	/// device has fewer queues than requested, roles in the same family share
+	/// queues, e.g. all of them use queue 0 of a device with a single queue.
+	VkQueue getQueue(QueueType type, uint32_t index = 0u) const;
+	uint32_t getQueueCount(QueueType type) const;
+	uint32_t getQueueFamilyIndex(QueueType type) const;
+
+	/// Lock of the VkQueue getQueue(type, index) returns, one per distinct queue. App's
+	/// subsystems submit under the lock of their queue, so they may submit from different
+	/// threads. Code submitting to getQueue() concurrently with them must hold it too.
+	std::mutex* getQueueMutex(QueueType type, uint32_t index = 0u);
 private:
+	using Clock = std::chrono::steady_clock;
+
+	/// Lock held around every submission to queue
+	struct QueueMutex
+	{
+		VkQueue queue;
+		std::unique_ptr<std::mutex> mutex;		// stable address, handed to the subsystems
+	};
+
+	void beginInitPhase();
+	void endInitPhase(InitPhase phase);
+
 	VkResult queryInstanceLayerProperties();
 	VkResult queryInstanceExtensionProperties();
 	VkResult queryPhysicalDevices();
-	VkResult queryPhysicalDeviceLayerProperties();
-	VkResult queryPhysicalDeviceExtensionProperties();
-	VkResult queryPhysicalDeviceProperties();
-	VkResult queryPhysicalDeviceFeatures();
-	VkResult queryPhysicalDeviceMemoryProperties();
-	void queryPhysicalDeviceQueueFamilyProperties();
+	bool loadCapabilityCache();
+	VkResult queryPhysicalDeviceRecords();
+	void storeCapabilityCache();
+
+	bool getQueueFamilyIndex(size_t physicalDeviceIndex, VkQueueFlags queueFlags, uint32_t& queueFamilyIndex, VkQueueFlags excludedQueueFlags = 0u);
+	bool selectQueueFamilies(size_t physicalDeviceIndex);
+	VkResult createLogicalDevice(size_t physicalDeviceIndex);
+	VkResult createDeviceContexts(const std::vector<uint32_t>& physicalDeviceIndices);
 
-	bool getQueueFamilyIndex(size_t physicalDeviceIndex, VkQueueFlags queueFlags, uint32_t& queueFamilyIndex);
-	VkResult createLogicalDevice(size_t physicalDeviceIndex, uint32_t queueFamilyIndex);
+	AppConfig mConfig;
+	HostAllocator mHostAllocator;
+	const VkAllocationCallbacks* mAllocationCallbacks;
+
+	VulkanLibrary mVulkanLibrary;
+	GlobalDispatch mGlobalDispatch;
+	InstanceDispatch mInstanceDispatch;
+	DeviceDispatch mDeviceDispatch;
 
 	VkInstance mInstance;
 	std::vector<VkLayerProperties> mInstanceLayerProperties;
 	std::vector<VkExtensionProperties> mInstanceExtensionProperties;
+	NameSet mInstanceLayerSet;									// built when the layers are enumerated
+	NameSet mInstanceExtensionSet;								// built when the extensions are enumerated
+	NameSet mEnabledInstanceExtensions;
 	std::vector<VkPhysicalDevice> mPhysicalDevices;
-	std::vector<std::vector<VkLayerProperties>> mPhysicalDeviceLayerProperties;
-	std::vector<std::vector<VkExtensionProperties>> mPhysicalDeviceExtensionProperties;
-	std::vector<VkPhysicalDeviceProperties> mPhysicalDeviceProperties;
-	std::vector<VkPhysicalDeviceFeatures> mPhysicalDeviceFeatures;
-	std::vector<VkPhysicalDeviceMemoryProperties> mPhysicalDeviceMemoryProperties;
-	std::vector<std::vector<VkQueueFamilyProperties>> mQueueFamilyProperties;
+	std::vector<PhysicalDeviceRecord> mPhysicalDeviceRecords;	// capabilities, same order as mPhysicalDevices
+	CapabilityCache mCapabilityCache;							// mapping the records may point into
+	size_t mPhysicalDeviceIndex;								// device the logical device is created on
 
 	VkDevice mDevice;
+	DeviceFeatureChain mEnabledFeatures;
+	NameSet mEnabledDeviceExtensions;
+	std::array<uint32_t, QueueTypeCount> mQueueFamilyIndices;	// family of each QueueType
+	std::array<std::vector<VkQueue>, QueueTypeCount> mQueues;	// queues of each QueueType
+	std::vector<QueueMutex> mQueueMutexes;						// one per distinct queue of mQueues
+	DeviceMemoryAllocator mMemoryAllocator;
+	StagingUploader mStagingUploader;
+	PipelineCache mPipelineCache;
+	ComputeEngine mComputeEngine;
+	CommandRecorder mCommandRecorder;
+	SubmissionScheduler mSubmissionScheduler;
+	HeadlessRenderer mHeadlessRenderer;
+	ResidencyManager mResidencyManager;
+	Profiler mProfiler;
+	std::vector<std::unique_ptr<DeviceContext>> mDeviceContexts;	// logical devices of the multi-device scheduler
+	MultiDeviceScheduler mMultiDeviceScheduler;
+
+	Clock::time_point mInitPhaseStart;
+	InitPhaseDurations mInitPhaseDurations{};
 };
 
@@ -0,0 +1,154 @@
+#include "CapabilityCache.h"
+#include <cstring>
+
+namespace
+{
+    constexpr uint32_t cMagic{ 0x43434b4du };             // "MKCC"
+    constexpr uint32_t cFormatVersion{ 2u };             // 2 - Vulkan 1.1/1.2 properties and features
+
+    struct CapabilityCacheHeader
+    {
+        uint32_t magic;
+        uint32_t formatVersion;                         // bumped when the file layout changes
+        uint32_t headerVersion;                         // VK_HEADER_VERSION of the writer
+        uint32_t capabilitiesSize;                      // sizeof(PhysicalDeviceCapabilities) of the writer
+        uint32_t limitsSize;                            // sizeof(VkPhysicalDeviceLimits) of the writer (catches packing differences)
+        uint32_t deviceCount;
+        uint64_t fileSize;
+    };
+
+    struct CapabilityCacheEntry
+    {
+        uint32_t vendorID;                              // driver identity the block was queried with
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint32_t blockOffset;                           // from start of file
+        uint32_t blockSize;
+    };
+
+    uint32_t alignBlockOffset(size_t offset)
+    {
+        return static_cast<uint32_t>((offset + 7u) & ~size_t{ 7u });
+    }
+
+    bool isArrayInBlock(uint32_t offset, uint32_t count, size_t elementSize, uint32_t blockSize)
+    {
+        return offset >= sizeof(PhysicalDeviceCapabilities) && offset <= blockSize && count <= (blockSize - offset) / elementSize;
+    }
+
+    // a corrupted file must not make App read outside of the mapping
+    bool isBlockValid(const uint8_t* fileData, size_t fileSize, const CapabilityCacheEntry& entry)
+    {
+        if (entry.blockOffset % 8u != 0u || entry.blockSize < sizeof(PhysicalDeviceCapabilities)
+            || entry.blockOffset > fileSize || entry.blockSize > fileSize - entry.blockOffset)
+            return false;
+
+        const PhysicalDeviceCapabilities* capabilities{ reinterpret_cast<const PhysicalDeviceCapabilities*>(fileData + entry.blockOffset) };
+
+        return capabilities->blockSize == entry.blockSize
+            && isArrayInBlock(capabilities->layerPropertyOffset, capabilities->layerPropertyCount, sizeof(VkLayerProperties), entry.blockSize)
+            && isArrayInBlock(capabilities->extensionPropertyOffset, capabilities->extensionPropertyCount, sizeof(VkExtensionProperties), entry.blockSize)
+            && isArrayInBlock(capabilities->queueFamilyPropertyOffset, capabilities->queueFamilyPropertyCount, sizeof(VkQueueFamilyProperties), entry.blockSize);
+    }
+
+    const CapabilityCacheEntry* getEntries(const uint8_t* fileData)
+    {
+        return reinterpret_cast<const CapabilityCacheEntry*>(fileData + alignBlockOffset(sizeof(CapabilityCacheHeader)));
+    }
+}
+
+bool CapabilityCache::open(const std::string& path)
+{
+    if (!mFile.open(path))
+        return false;
+
+    const uint8_t* fileData{ mFile.data() };
+    const size_t fileSize{ mFile.size() };
+    const CapabilityCacheHeader* header{ reinterpret_cast<const CapabilityCacheHeader*>(fileData) };
+
+    bool valid{ fileSize >= sizeof(CapabilityCacheHeader)
+        && header->magic == cMagic
+        && header->formatVersion == cFormatVersion
+        && header->headerVersion == VK_HEADER_VERSION
+        && header->capabilitiesSize == sizeof(PhysicalDeviceCapabilities)
+        && header->limitsSize == sizeof(VkPhysicalDeviceLimits)
+        && header->fileSize == fileSize
+        && alignBlockOffset(sizeof(CapabilityCacheHeader)) + header->deviceCount * sizeof(CapabilityCacheEntry) <= fileSize };
+
+    for (uint32_t i{ 0u }; valid && i < header->deviceCount; ++i)
+        valid = isBlockValid(fileData, fileSize, getEntries(fileData)[i]);
+
+    if (!valid)
+        close();
+
+    return valid;
+}
+
+void CapabilityCache::close()
+{
+    mFile.close();
+}
+
+const PhysicalDeviceCapabilities* CapabilityCache::find(size_t index, const VkPhysicalDeviceProperties& properties) const
+{
+    if (index >= getDeviceCount())
+        return nullptr;
+
+    const CapabilityCacheEntry& entry = getEntries(mFile.data())[index];
+    const bool match{ entry.vendorID == properties.vendorID
+        && entry.deviceID == properties.deviceID
+        && entry.driverVersion == properties.driverVersion
+        && std::memcmp(entry.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0 };
+
+    return match ? reinterpret_cast<const PhysicalDeviceCapabilities*>(mFile.data() + entry.blockOffset) : nullptr;
+}
+
+size_t CapabilityCache::getDeviceCount() const
+{
+    return mFile.isOpen() ? reinterpret_cast<const CapabilityCacheHeader*>(mFile.data())->deviceCount : 0u;
+}
+
+bool CapabilityCache::write(const std::string& path, const std::vector<PhysicalDeviceRecord>& records)
+{
+    // Layout: header | entries | blocks, blocks are copied as they are
+    const uint32_t entryOffset{ alignBlockOffset(sizeof(CapabilityCacheHeader)) };
+    uint32_t fileSize{ alignBlockOffset(entryOffset + records.size() * sizeof(CapabilityCacheEntry)) };
+
+    std::vector<CapabilityCacheEntry> entries(records.size());
+    for (size_t i{ 0u }; i < records.size(); ++i)
+    {
+        const VkPhysicalDeviceProperties& properties = records[i].getProperties();
+
+        entries[i].vendorID = properties.vendorID;
+        entries[i].deviceID = properties.deviceID;
+        entries[i].driverVersion = properties.driverVersion;
+        std::memcpy(entries[i].pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+        entries[i].blockOffset = fileSize;
+        entries[i].blockSize = records[i].getCapabilities()->blockSize;
+
+        fileSize = alignBlockOffset(fileSize + entries[i].blockSize);
+    }
+
+    std::vector<uint64_t> storage(fileSize / sizeof(uint64_t), 0u);
+    uint8_t* fileData{ reinterpret_cast<uint8_t*>(storage.data()) };
+
+    const CapabilityCacheHeader header{
+        cMagic,
+        cFormatVersion,
+        VK_HEADER_VERSION,
+        static_cast<uint32_t>(sizeof(PhysicalDeviceCapabilities)),
+        static_cast<uint32_t>(sizeof(VkPhysicalDeviceLimits)),
+        static_cast<uint32_t>(records.size()),
+        fileSize
+    };
+    std::memcpy(fileData, &header, sizeof(header));
+
+    if (!entries.empty())
+        std::memcpy(fileData + entryOffset, entries.data(), entries.size() * sizeof(CapabilityCacheEntry));
+
+    for (size_t i{ 0u }; i < records.size(); ++i)
+        std::memcpy(fileData + entries[i].blockOffset, records[i].getCapabilities(), entries[i].blockSize);
+
+    return writeFileAtomic(path, fileData, fileSize);
+}
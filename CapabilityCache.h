@@ -0,0 +1,34 @@
+#pragma once
+
+#include "FileUtils.h"
+#include "PhysicalDeviceRecord.h"
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+
+/// On-disk copy of the capability blocks of all physical devices.
+///
+/// File layout (little endian, blocks 8 byte aligned):
+///   CapabilityCacheHeader
+///   CapabilityCacheEntry[deviceCount]
+///   PhysicalDeviceCapabilities blocks (as produced by PhysicalDeviceRecord)
+///
+/// An entry is valid while vendorID, deviceID, driverVersion and pipelineCacheUUID
+/// of the device match, blocks are used in place from the mapping (zero copy).
+class CapabilityCache
+{
+public:
+	/// Map path and validate header and entries, false when missing or incompatible
+	bool open(const std::string& path);
+	void close();
+
+	/// Cached block of device index when its driver identity matches properties, nullptr otherwise
+	const PhysicalDeviceCapabilities* find(size_t index, const VkPhysicalDeviceProperties& properties) const;
+
+	size_t getDeviceCount() const;
+
+	/// Serialize blocks of records into path (atomically replaces the file)
+	static bool write(const std::string& path, const std::vector<PhysicalDeviceRecord>& records);
+private:
+	MappedFile mFile;
+};
@@ -0,0 +1,369 @@
+#include "CommandRecorder.h"
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+    // Secondaries allocated per vkAllocateCommandBuffers call when a pool runs out
+    constexpr uint32_t cSecondaryAllocationCount{ 8u };
+}
+
+CommandRecorder::CommandRecorder()
+    : mDevice(VK_NULL_HANDLE)
+    , mDispatch(nullptr)
+    , mAllocationCallbacks(nullptr)
+    , mQueue(VK_NULL_HANDLE)
+    , mQueueFamilyIndex(0u)
+    , mProfiler(nullptr)
+    , mQueueMutex(nullptr)
+    , mFrameIndex(0u)
+    , mRecording(false)
+{
+}
+
+VkResult CommandRecorder::init(VkDevice device, const DeviceDispatch& dispatch, uint32_t queueFamilyIndex, VkQueue queue,
+    const VkAllocationCallbacks* allocationCallbacks, const CommandRecorderConfig& config)
+{
+    // 1) start the recording threads
+    // 2) per frame in flight: command pool per thread slot, primary command buffer, fence
+
+    VkResult result = VK_SUCCESS;
+
+    if (config.framesInFlight == 0u)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    mDevice = device;
+    mDispatch = &dispatch;
+    mAllocationCallbacks = allocationCallbacks;
+    mQueue = queue;
+    mQueueFamilyIndex = queueFamilyIndex;
+    mFrameIndex = 0u;
+    mRecording = false;
+    mStatistics = CommandRecorderStatistics{};
+
+    const uint32_t threadCount{ config.threadCount > 0u ? config.threadCount : std::max(std::thread::hardware_concurrency(), 1u) - 1u };
+    mThreadPool.reset(new ThreadPool(threadCount));
+    const size_t slotCount{ mThreadPool->getSlotCount() };
+
+    mFrames.resize(config.framesInFlight);
+    for (Frame& frame : mFrames)
+    {
+        frame.pools.resize(slotCount);
+        for (ThreadCommandPool& pool : frame.pools)
+        {
+            if (result != VK_SUCCESS)
+                break;
+
+            const VkCommandPoolCreateInfo commandPoolCreateInfo = {
+                VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, // VkStructureType sType;           // type of command pool create info structure
+                nullptr,                        // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+                VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, // VkCommandPoolCreateFlags flags;        // buffers live one frame, only the whole pool is reset
+                queueFamilyIndex                // uint32_t queueFamilyIndex;                   // family of the queue frames are submitted to
+            };
+
+            result = mDispatch->vkCreateCommandPool(mDevice, &commandPoolCreateInfo, mAllocationCallbacks, &pool.commandPool);
+        }
+
+        if (result == VK_SUCCESS)
+        {
+            const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, // VkStructureType sType;       // type of command buffer allocate info structure
+                nullptr,                        // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+                frame.pools.back().commandPool, // VkCommandPool commandPool;                   // pool of the calling thread's slot
+                VK_COMMAND_BUFFER_LEVEL_PRIMARY,// VkCommandBufferLevel level;                  // submitted directly
+                1u                              // uint32_t commandBufferCount;                 // one per frame
+            };
+
+            result = mDispatch->vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &frame.primary);
+        }
+
+        if (result == VK_SUCCESS)
+        {
+            const VkFenceCreateInfo fenceCreateInfo = {
+                VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,    // VkStructureType sType;               // type of fence create info structure
+                nullptr,                        // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+                0u                              // VkFenceCreateFlags flags;                    // unsignaled, signaled by the frame submission
+            };
+
+            result = mDispatch->vkCreateFence(mDevice, &fenceCreateInfo, mAllocationCallbacks, &frame.fence);
+        }
+    }
+
+    return result;
+}
+
+void CommandRecorder::deinit()
+{
+    if (mDevice == VK_NULL_HANDLE)
+        return;
+
+    waitIdle();
+
+    for (Frame& frame : mFrames)
+    {
+        if (frame.fence != VK_NULL_HANDLE)
+            mDispatch->vkDestroyFence(mDevice, frame.fence, mAllocationCallbacks);
+        for (ThreadCommandPool& pool : frame.pools)
+            if (pool.commandPool != VK_NULL_HANDLE)
+                mDispatch->vkDestroyCommandPool(mDevice, pool.commandPool, mAllocationCallbacks); // frees its command buffers too
+    }
+    mFrames.clear();
+
+    mThreadPool.reset();
+    mRecording = false;
+
+    mDevice = VK_NULL_HANDLE;
+}
+
+VkResult CommandRecorder::beginFrame()
+{
+    VkResult result = VK_SUCCESS;
+
+    if (mRecording)
+        return VK_ERROR_UNKNOWN;
+
+    MK_PROFILE_CPU_ZONE(mProfiler, "CommandRecorder::beginFrame");
+
+    Frame& frame = mFrames[mFrameIndex];
+
+    // command buffers of the slot may still be executing
+    result = waitFrame(frame);
+
+    // recycle whole pools, pools no thread recorded into last time are already reset
+    for (size_t slot{ 0u }; result == VK_SUCCESS && slot < frame.pools.size(); ++slot)
+    {
+        ThreadCommandPool& pool = frame.pools[slot];
+        if (pool.usedCount == 0u && slot + 1u < frame.pools.size())
+            continue;
+
+        result = mDispatch->vkResetCommandPool(mDevice, pool.commandPool, 0u);
+        pool.usedCount = 0u;
+        pool.recordTime = std::chrono::nanoseconds::zero();
+        ++mStatistics.poolResetCount;
+    }
+
+    frame.secondaries.clear();
+
+    mStatistics.lastFrame = CommandRecorderFrameStatistics{};
+    mRecording = result == VK_SUCCESS;
+
+    return result;
+}
+
+VkResult CommandRecorder::record(size_t count, const RecordFunction& function, const VkCommandBufferInheritanceInfo* inheritanceInfo)
+{
+    if (!mRecording)
+        return VK_ERROR_UNKNOWN;
+
+    MK_PROFILE_CPU_ZONE(mProfiler, "CommandRecorder::record");
+
+    const Clock::time_point start{ Clock::now() };
+
+    Frame& frame = mFrames[mFrameIndex];
+    const size_t first{ frame.secondaries.size() };
+    frame.secondaries.resize(first + count, VK_NULL_HANDLE);
+
+    const VkCommandBufferInheritanceInfo noRenderPass = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO, // VkStructureType sType;            // type of inheritance info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        VK_NULL_HANDLE,                         // VkRenderPass renderPass;                     // executed outside a render pass
+        0u,                                     // uint32_t subpass;
+        VK_NULL_HANDLE,                         // VkFramebuffer framebuffer;
+        VK_FALSE,                               // VkBool32 occlusionQueryEnable;               // no queries active in the primary
+        0u,                                     // VkQueryControlFlags queryFlags;
+        0u                                      // VkQueryPipelineStatisticFlags pipelineStatistics;
+    };
+
+    // secondaries inside a render pass continue it
+    VkCommandBufferUsageFlags usageFlags{ VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT };
+    if (inheritanceInfo && inheritanceInfo->renderPass != VK_NULL_HANDLE)
+        usageFlags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+
+    const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, // VkStructureType sType;                  // type of command buffer begin info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        usageFlags,                             // VkCommandBufferUsageFlags flags;             // recorded again next frame
+        inheritanceInfo ? inheritanceInfo : &noRenderPass // const VkCommandBufferInheritanceInfo* pInheritanceInfo; // state inherited from the primary
+    };
+
+    std::vector<VkResult> results(count, VK_SUCCESS);
+
+    // each thread records into the pool of its slot only
+    mThreadPool->parallelFor(count, [&](size_t index, size_t threadIndex)
+    {
+        MK_PROFILE_CPU_ZONE(mProfiler, "CommandRecorder record job");
+
+        const Clock::time_point jobStart{ Clock::now() };
+        ThreadCommandPool& pool = frame.pools[threadIndex];
+
+        VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+        VkResult result = acquireSecondary(pool, commandBuffer);
+
+        if (result == VK_SUCCESS)
+            result = mDispatch->vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+
+        if (result == VK_SUCCESS)
+        {
+            function(commandBuffer, index);
+            result = mDispatch->vkEndCommandBuffer(commandBuffer);
+        }
+
+        // a secondary that failed to begin or end is invalid, endFrame() leaves it out
+        frame.secondaries[first + index] = result == VK_SUCCESS ? commandBuffer : VK_NULL_HANDLE;
+        results[index] = result;
+        pool.recordTime += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - jobStart);
+    });
+
+    mStatistics.lastFrame.recordTime += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+
+    for (VkResult result : results)
+        if (result != VK_SUCCESS)
+            return result;
+
+    return VK_SUCCESS;
+}
+
+VkResult CommandRecorder::endFrame()
+{
+    // 1) record primary executing the secondaries of all record() calls in order
+    // 2) one vkQueueSubmit for the frame, signals the fence of the frame slot
+
+    VkResult result = VK_SUCCESS;
+
+    if (!mRecording)
+        return VK_ERROR_UNKNOWN;
+    mRecording = false;
+
+    MK_PROFILE_CPU_ZONE(mProfiler, "CommandRecorder::endFrame");
+
+    const Clock::time_point start{ Clock::now() };
+
+    Frame& frame = mFrames[mFrameIndex];
+
+    const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, // VkStructureType sType;                  // type of command buffer begin info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // VkCommandBufferUsageFlags flags;        // recorded again next time the slot is used
+        nullptr                                 // const VkCommandBufferInheritanceInfo* pInheritanceInfo; // primary command buffer
+    };
+
+    // secondaries of failed jobs are left out
+    frame.secondaries.erase(std::remove(frame.secondaries.begin(), frame.secondaries.end(), VK_NULL_HANDLE), frame.secondaries.end());
+
+    result = mDispatch->vkBeginCommandBuffer(frame.primary, &commandBufferBeginInfo);
+
+    if (result == VK_SUCCESS)
+    {
+        {
+            MK_PROFILE_GPU_ZONE(mProfiler, frame.primary, mQueueFamilyIndex, "CommandRecorder frame");
+            if (!frame.secondaries.empty())
+                mDispatch->vkCmdExecuteCommands(frame.primary, static_cast<uint32_t>(frame.secondaries.size()), frame.secondaries.data());
+        }
+
+        result = mDispatch->vkEndCommandBuffer(frame.primary);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,      // VkStructureType sType;                       // type of submit info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // uint32_t waitSemaphoreCount;
+            nullptr,                            // const VkSemaphore* pWaitSemaphores;
+            nullptr,                            // const VkPipelineStageFlags* pWaitDstStageMask;
+            1u,                                 // uint32_t commandBufferCount;                 // primary executing all secondaries of the frame
+            &frame.primary,                     // const VkCommandBuffer* pCommandBuffers;
+            0u,                                 // uint32_t signalSemaphoreCount;               // completion is tracked by the fence
+            nullptr                             // const VkSemaphore* pSignalSemaphores;
+        };
+
+        std::unique_lock<std::mutex> queueLock;
+        if (mQueueMutex)
+            queueLock = std::unique_lock<std::mutex>(*mQueueMutex);
+
+        result = mDispatch->vkQueueSubmit(mQueue, 1u, &submitInfo, frame.fence);
+    }
+
+    frame.submitted = result == VK_SUCCESS;
+
+    // counters of the frame
+    CommandRecorderFrameStatistics& frameStatistics = mStatistics.lastFrame;
+    frameStatistics.bufferCount = static_cast<uint32_t>(frame.secondaries.size()) + 1u;
+    frameStatistics.threadBufferCounts.resize(frame.pools.size());
+    frameStatistics.threadRecordTimes.resize(frame.pools.size());
+    for (size_t slot{ 0u }; slot < frame.pools.size(); ++slot)
+    {
+        frameStatistics.threadBufferCounts[slot] = static_cast<uint32_t>(frame.pools[slot].usedCount);
+        frameStatistics.threadRecordTimes[slot] = frame.pools[slot].recordTime;
+    }
+    frameStatistics.submitTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+
+    ++mStatistics.frameCount;
+    mStatistics.bufferCount += frameStatistics.bufferCount;
+    mStatistics.stealCount = mThreadPool->getStealCount();
+
+    mFrameIndex = (mFrameIndex + 1u) % static_cast<uint32_t>(mFrames.size());
+
+    return result;
+}
+
+VkResult CommandRecorder::waitIdle()
+{
+    VkResult result = VK_SUCCESS;
+
+    for (Frame& frame : mFrames)
+    {
+        const VkResult frameResult{ waitFrame(frame) };
+        if (result == VK_SUCCESS)
+            result = frameResult;
+    }
+
+    return result;
+}
+
+VkResult CommandRecorder::acquireSecondary(ThreadCommandPool& pool, VkCommandBuffer& commandBuffer)
+{
+    // Buffers stay allocated across pool resets, only a frame with more jobs than before allocates
+
+    VkResult result = VK_SUCCESS;
+
+    if (pool.usedCount == pool.secondaries.size())
+    {
+        const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, // VkStructureType sType;           // type of command buffer allocate info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            pool.commandPool,                   // VkCommandPool commandPool;                   // pool of the recording thread's slot
+            VK_COMMAND_BUFFER_LEVEL_SECONDARY,  // VkCommandBufferLevel level;                  // executed by the frame's primary
+            cSecondaryAllocationCount           // uint32_t commandBufferCount;                 // a few at once
+        };
+
+        pool.secondaries.resize(pool.usedCount + cSecondaryAllocationCount, VK_NULL_HANDLE);
+        result = mDispatch->vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, pool.secondaries.data() + pool.usedCount);
+        if (result != VK_SUCCESS)
+        {
+            pool.secondaries.resize(pool.usedCount);
+            return result;
+        }
+    }
+
+    commandBuffer = pool.secondaries[pool.usedCount++];
+
+    return result;
+}
+
+VkResult CommandRecorder::waitFrame(Frame& frame)
+{
+    VkResult result = VK_SUCCESS;
+
+    if (!frame.submitted)
+        return VK_SUCCESS;
+
+    result = mDispatch->vkWaitForFences(mDevice, 1u, &frame.fence, VK_TRUE, UINT64_MAX);
+    if (result == VK_SUCCESS)
+    {
+        result = mDispatch->vkResetFences(mDevice, 1u, &frame.fence);
+        frame.submitted = false;
+    }
+
+    return result;
+}
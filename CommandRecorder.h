@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include "VulkanDispatch.h"
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct CommandRecorderConfig
+{
+	uint32_t framesInFlight{ 2u };				// frames recorded while earlier ones execute (0 - no recorder)
+	uint32_t threadCount{ 0u };					// recording workers besides the calling thread (0 - hardware threads - 1)
+};
+
+/// Counters of one frame
+struct CommandRecorderFrameStatistics
+{
+	uint32_t bufferCount{ 0u };					// secondary + primary command buffers recorded
+	std::vector<uint32_t> threadBufferCounts;	// secondaries recorded per thread slot
+	std::vector<std::chrono::nanoseconds> threadRecordTimes;	// begin + record function + end per thread slot
+	std::chrono::nanoseconds recordTime{ 0 };	// wall time of record() calls
+	std::chrono::nanoseconds submitTime{ 0 };	// primary recording + vkQueueSubmit in endFrame()
+};
+
+/// Counters since init()
+struct CommandRecorderStatistics
+{
+	uint64_t frameCount{ 0u };
+	uint64_t bufferCount{ 0u };					// secondary + primary command buffers recorded
+	uint64_t poolResetCount{ 0u };				// vkResetCommandPool calls
+	uint64_t stealCount{ 0u };					// job ranges taken over by an idle thread
+	CommandRecorderFrameStatistics lastFrame;	// last frame passed to endFrame()
+};
+
+/// Records secondary command buffers on all cores. Every thread slot of the
+/// ThreadPool owns one VkCommandPool per frame in flight, so threads never
+/// share a pool and need no locking. Pools of a frame are recycled as a whole
+/// with vkResetCommandPool once its fence is signaled, command buffers stay
+/// allocated and are reused. endFrame() executes the secondaries of all
+/// record() calls in order from one primary command buffer and submits it
+/// with a single vkQueueSubmit.
+/// Typical use: beginFrame(), record() ..., endFrame().
+/// Not thread safe - the record functions run in parallel, the calls do not.
+/// Other objects submitting to the queue from other threads must do so under
+/// the lock of setQueueMutex().
+class CommandRecorder
+{
+public:
+	/// Record commands of job index into commandBuffer (begun, ended by the recorder)
+	using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, size_t index)>;
+
+	CommandRecorder();
+
+	CommandRecorder(const CommandRecorder&) = delete;
+	CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+	/// Start the recording threads, create command pools, primaries and fences for queue of queueFamilyIndex
+	VkResult init(VkDevice device, const DeviceDispatch& dispatch, uint32_t queueFamilyIndex, VkQueue queue,
+		const VkAllocationCallbacks* allocationCallbacks, const CommandRecorderConfig& config = CommandRecorderConfig{});
+
+	/// Wait for submitted frames, destroy all objects and stop the threads
+	void deinit();
+
+	/// Wait until the frame slot is free and reset its command pools
+	VkResult beginFrame();
+
+	/// Record count secondary command buffers in parallel, function(commandBuffer, i) for i in [0, count)
+	/// inheritanceInfo - render pass state of the secondaries (nullptr - used outside a render pass)
+	VkResult record(size_t count, const RecordFunction& function, const VkCommandBufferInheritanceInfo* inheritanceInfo = nullptr);
+
+	/// Execute all secondaries of the frame from one primary command buffer and submit it
+	VkResult endFrame();
+
+	/// Wait until all submitted frames were executed by the device
+	VkResult waitIdle();
+
+	/// Record CPU zones of the calls and record jobs and a GPU zone of each frame's primary into profiler (nullptr - none)
+	void setProfiler(Profiler* profiler) { mProfiler = profiler; }
+
+	/// Lock held around submissions when other objects submit to the same queue (nullptr - queue not shared)
+	void setQueueMutex(std::mutex* queueMutex) { mQueueMutex = queueMutex; }
+
+	/// Thread slots recording in parallel (workers + calling thread)
+	size_t getThreadSlotCount() const { return mThreadPool ? mThreadPool->getSlotCount() : 0u; }
+
+	const CommandRecorderStatistics& getStatistics() const { return mStatistics; }
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Command pool of one thread slot in one frame, padded so slots written by different threads do not share cache lines
+	struct alignas(64) ThreadCommandPool
+	{
+		VkCommandPool commandPool{ VK_NULL_HANDLE };
+		std::vector<VkCommandBuffer> secondaries;	// allocated, reused after every pool reset
+		size_t usedCount{ 0u };						// secondaries recorded since the last reset
+		std::chrono::nanoseconds recordTime{ 0 };
+	};
+
+	struct Frame
+	{
+		std::vector<ThreadCommandPool> pools;		// one per thread slot
+		VkCommandBuffer primary{ VK_NULL_HANDLE };	// allocated from the pool of the calling thread's slot
+		VkFence fence{ VK_NULL_HANDLE };
+		bool submitted{ false };					// fence is signaled by a submission not waited for yet
+		std::vector<VkCommandBuffer> secondaries;	// execution order
+	};
+
+	VkResult acquireSecondary(ThreadCommandPool& pool, VkCommandBuffer& commandBuffer);
+	VkResult waitFrame(Frame& frame);
+
+	VkDevice mDevice;
+	const DeviceDispatch* mDispatch;
+	const VkAllocationCallbacks* mAllocationCallbacks;
+	VkQueue mQueue;
+	uint32_t mQueueFamilyIndex;
+	Profiler* mProfiler;
+	std::mutex* mQueueMutex;
+	std::unique_ptr<ThreadPool> mThreadPool;
+	std::vector<Frame> mFrames;
+	uint32_t mFrameIndex;							// frame slot of the frame being recorded
+	bool mRecording;								// between beginFrame() and endFrame()
+
+	CommandRecorderStatistics mStatistics;
+};
@@ -0,0 +1,562 @@
+#include "ComputeEngine.h"
+#include "FileUtils.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr uint32_t cSpirvMagic{ 0x07230203u };
+
+    void memoryBarrier(const DeviceDispatch& dispatch, VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask,
+        VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+    {
+        const VkMemoryBarrier memoryBarrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,   // VkStructureType sType;                       // type of memory barrier structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            srcAccessMask,                      // VkAccessFlags srcAccessMask;                 // writes to make available
+            dstAccessMask                       // VkAccessFlags dstAccessMask;                 // accesses the writes are made visible to
+        };
+
+        dispatch.vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0u, 1u, &memoryBarrier, 0u, nullptr, 0u, nullptr);
+    }
+}
+
+ComputeEngine::ComputeEngine()
+    : mDevice(VK_NULL_HANDLE)
+    , mDispatch(nullptr)
+    , mAllocator(nullptr)
+    , mPipelineCache(nullptr)
+    , mAllocationCallbacks(nullptr)
+    , mQueue(VK_NULL_HANDLE)
+    , mQueueFamilyIndex(0u)
+    , mProfiler(nullptr)
+    , mQueueMutex(nullptr)
+    , mMaxGroupCountX(0u)
+    , mCommandPool(VK_NULL_HANDLE)
+    , mCommandBuffer(VK_NULL_HANDLE)
+    , mFence(VK_NULL_HANDLE)
+    , mRecording(false)
+    , mSubmitted(false)
+    , mDescriptorPool(VK_NULL_HANDLE)
+    , mUploadBuffer(VK_NULL_HANDLE)
+    , mReadbackBuffer(VK_NULL_HANDLE)
+{
+}
+
+VkResult ComputeEngine::init(VkDevice device, const DeviceDispatch& dispatch, const PhysicalDeviceRecord& record, DeviceMemoryAllocator& allocator,
+    PipelineCache& pipelineCache, uint32_t queueFamilyIndex, VkQueue queue, const VkAllocationCallbacks* allocationCallbacks,
+    const ComputeEngineConfig& config)
+{
+    // 1) create command pool, command buffer and fence
+    // 2) create descriptor pool of storage buffer descriptors
+    // 3) create upload and readback staging buffers, mapped by the allocator for their lifetime
+
+    VkResult result = VK_SUCCESS;
+
+    if (config.maxDescriptorSets == 0u || config.maxStorageBuffersPerSet == 0u || config.stagingSize == 0u)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    mDevice = device;
+    mDispatch = &dispatch;
+    mAllocator = &allocator;
+    mPipelineCache = &pipelineCache;
+    mAllocationCallbacks = allocationCallbacks;
+    mQueue = queue;
+    mQueueFamilyIndex = queueFamilyIndex;
+    mConfig = config;
+    mMaxGroupCountX = record.getProperties().limits.maxComputeWorkGroupCount[0];
+    mRecording = false;
+    mSubmitted = false;
+    mStatistics = ComputeEngineStatistics{};
+
+    const VkCommandPoolCreateInfo commandPoolCreateInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, // VkStructureType sType;                   // type of command pool create info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,   // VkCommandPoolCreateFlags flags;              // command buffer is re-recorded after every begin()
+        queueFamilyIndex                        // uint32_t queueFamilyIndex;                   // family of the compute queue
+    };
+
+    result = mDispatch->vkCreateCommandPool(mDevice, &commandPoolCreateInfo, mAllocationCallbacks, &mCommandPool);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, // VkStructureType sType;           // type of command buffer allocate info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            mCommandPool,                       // VkCommandPool commandPool;                   // pool to allocate from
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,    // VkCommandBufferLevel level;                  // submitted directly
+            1u                                  // uint32_t commandBufferCount;                 // one recording at a time
+        };
+
+        result = mDispatch->vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &mCommandBuffer);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkFenceCreateInfo fenceCreateInfo = {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,    // VkStructureType sType;                   // type of fence create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u                                  // VkFenceCreateFlags flags;                    // unsignaled, signaled by submit()
+        };
+
+        result = mDispatch->vkCreateFence(mDevice, &fenceCreateInfo, mAllocationCallbacks, &mFence);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkDescriptorPoolSize descriptorPoolSize = {
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // VkDescriptorType type;                       // kernels bind storage buffers only
+            mConfig.maxDescriptorSets * mConfig.maxStorageBuffersPerSet // uint32_t descriptorCount; // of all sets
+        };
+
+        const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, // VkStructureType sType;            // type of descriptor pool create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, // VkDescriptorPoolCreateFlags flags; // sets are freed individually by destroyBindings()
+            mConfig.maxDescriptorSets,          // uint32_t maxSets;                            // sets alive at the same time
+            1u,                                 // uint32_t poolSizeCount;                      // number of entries in pPoolSizes
+            &descriptorPoolSize                 // const VkDescriptorPoolSize* pPoolSizes;      // descriptors per type
+        };
+
+        result = mDispatch->vkCreateDescriptorPool(mDevice, &descriptorPoolCreateInfo, mAllocationCallbacks, &mDescriptorPool);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        VkBufferCreateInfo bufferCreateInfo = {
+            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,   // VkStructureType sType;                   // type of buffer create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // VkBufferCreateFlags flags;                   // no sparse binding
+            mConfig.stagingSize,                // VkDeviceSize size;                           // size in bytes
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,   // VkBufferUsageFlags usage;                    // source of upload() copies
+            VK_SHARING_MODE_EXCLUSIVE,          // VkSharingMode sharingMode;                   // used by the compute queue only
+            0u,                                 // uint32_t queueFamilyIndexCount;              // (concurrent sharing only)
+            nullptr                             // const uint32_t* pQueueFamilyIndices;         // (concurrent sharing only)
+        };
+
+        result = mAllocator->createBuffer(bufferCreateInfo, MemoryUsage::CpuToGpu, mUploadBuffer, mUploadAllocation);
+
+        if (result == VK_SUCCESS)
+        {
+            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;  // destination of readback() copies
+            result = mAllocator->createBuffer(bufferCreateInfo, MemoryUsage::GpuToCpu, mReadbackBuffer, mReadbackAllocation);
+        }
+
+        if (result == VK_SUCCESS && (!mUploadAllocation.mappedData || !mReadbackAllocation.mappedData))
+            result = VK_ERROR_MEMORY_MAP_FAILED;
+    }
+
+    return result;
+}
+
+void ComputeEngine::deinit()
+{
+    if (mDevice == VK_NULL_HANDLE)
+        return;
+
+    wait();
+
+    if (mReadbackBuffer != VK_NULL_HANDLE)
+        mAllocator->destroyBuffer(mReadbackBuffer, mReadbackAllocation);
+    if (mUploadBuffer != VK_NULL_HANDLE)
+        mAllocator->destroyBuffer(mUploadBuffer, mUploadAllocation);
+    if (mDescriptorPool != VK_NULL_HANDLE)
+        mDispatch->vkDestroyDescriptorPool(mDevice, mDescriptorPool, mAllocationCallbacks); // frees all sets too
+    if (mFence != VK_NULL_HANDLE)
+        mDispatch->vkDestroyFence(mDevice, mFence, mAllocationCallbacks);
+    if (mCommandPool != VK_NULL_HANDLE)
+        mDispatch->vkDestroyCommandPool(mDevice, mCommandPool, mAllocationCallbacks); // frees the command buffer too
+
+    mDescriptorPool = VK_NULL_HANDLE;
+    mFence = VK_NULL_HANDLE;
+    mCommandPool = VK_NULL_HANDLE;
+    mCommandBuffer = VK_NULL_HANDLE;
+    mRecording = false;
+
+    mDevice = VK_NULL_HANDLE;
+}
+
+bool ComputeEngine::loadSpirv(const std::string& path, std::vector<uint32_t>& code)
+{
+    MappedFile file;
+    // an empty file has no magic number to check
+    if (!file.open(path) || file.size() < sizeof(uint32_t) || file.size() % sizeof(uint32_t) != 0u)
+        return false;
+
+    code.resize(file.size() / sizeof(uint32_t));
+    std::memcpy(code.data(), file.data(), file.size());
+
+    return code[0] == cSpirvMagic;
+}
+
+VkResult ComputeEngine::createKernel(const std::string& spirvPath, uint32_t storageBufferCount, uint32_t pushConstantSize, ComputeKernel& kernel)
+{
+    std::vector<uint32_t> code;
+    if (!loadSpirv(spirvPath, code))
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    return createKernel(code.data(), code.size() * sizeof(uint32_t), storageBufferCount, pushConstantSize, kernel);
+}
+
+VkResult ComputeEngine::createKernel(const uint32_t* code, size_t codeSize, uint32_t storageBufferCount, uint32_t pushConstantSize, ComputeKernel& kernel)
+{
+    // 1) create shader module of the SPIR-V code
+    // 2) create descriptor set layout - storage buffers at bindings 0..storageBufferCount-1
+    // 3) create pipeline layout - the set layout and the push constant range
+    // 4) create compute pipeline through the pipeline cache
+
+    VkResult result = VK_SUCCESS;
+
+    if (storageBufferCount > mConfig.maxStorageBuffersPerSet)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    kernel = ComputeKernel{};
+    kernel.storageBufferCount = storageBufferCount;
+    kernel.pushConstantSize = pushConstantSize;
+
+    const VkShaderModuleCreateInfo shaderModuleCreateInfo = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, // VkStructureType sType;                  // type of shader module create info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        0u,                                     // VkShaderModuleCreateFlags flags;             // reserved
+        codeSize,                               // size_t codeSize;                             // size in bytes, multiple of 4
+        code                                    // const uint32_t* pCode;                       // SPIR-V words
+    };
+
+    result = mDispatch->vkCreateShaderModule(mDevice, &shaderModuleCreateInfo, mAllocationCallbacks, &kernel.shaderModule);
+
+    if (result == VK_SUCCESS)
+    {
+        std::vector<VkDescriptorSetLayoutBinding> bindings(storageBufferCount);
+        for (uint32_t i{ 0u }; i < storageBufferCount; ++i)
+            bindings[i] = {
+                i,                              // uint32_t binding;                            // layout(binding = i)
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // VkDescriptorType descriptorType;          // buffer block
+                1u,                             // uint32_t descriptorCount;                    // no arrays
+                VK_SHADER_STAGE_COMPUTE_BIT,    // VkShaderStageFlags stageFlags;               // compute only
+                nullptr                         // const VkSampler* pImmutableSamplers;         // (samplers only)
+            };
+
+        const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, // VkStructureType sType;      // type of descriptor set layout create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // VkDescriptorSetLayoutCreateFlags flags;      // sets are allocated from the pool
+            storageBufferCount,                 // uint32_t bindingCount;                       // number of entries in pBindings
+            bindings.data()                     // const VkDescriptorSetLayoutBinding* pBindings; // bindings of set 0
+        };
+
+        result = mDispatch->vkCreateDescriptorSetLayout(mDevice, &descriptorSetLayoutCreateInfo, mAllocationCallbacks, &kernel.descriptorSetLayout);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkPushConstantRange pushConstantRange = {
+            VK_SHADER_STAGE_COMPUTE_BIT,        // VkShaderStageFlags stageFlags;               // compute only
+            0u,                                 // uint32_t offset;                             // whole block
+            pushConstantSize                    // uint32_t size;                               // multiple of 4
+        };
+
+        const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, // VkStructureType sType;            // type of pipeline layout create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // VkPipelineLayoutCreateFlags flags;           // reserved
+            1u,                                 // uint32_t setLayoutCount;                     // set 0
+            &kernel.descriptorSetLayout,        // const VkDescriptorSetLayout* pSetLayouts;
+            pushConstantSize > 0u ? 1u : 0u,    // uint32_t pushConstantRangeCount;             // 0 - no push constants
+            &pushConstantRange                  // const VkPushConstantRange* pPushConstantRanges;
+        };
+
+        result = mDispatch->vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, mAllocationCallbacks, &kernel.pipelineLayout);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkComputePipelineCreateInfo computePipelineCreateInfo = {
+            VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO, // VkStructureType sType;           // type of compute pipeline create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // VkPipelineCreateFlags flags;                 // no derivatives
+            {
+                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, // VkStructureType sType;  // type of shader stage create info structure
+                nullptr,                        // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+                0u,                             // VkPipelineShaderStageCreateFlags flags;      // no subgroup size control
+                VK_SHADER_STAGE_COMPUTE_BIT,    // VkShaderStageFlagBits stage;                 // compute
+                kernel.shaderModule,            // VkShaderModule module;                       // SPIR-V of the kernel
+                "main",                         // const char* pName;                           // entry point
+                nullptr                         // const VkSpecializationInfo* pSpecializationInfo; // no specialization constants
+            },                                  // VkPipelineShaderStageCreateInfo stage;
+            kernel.pipelineLayout,              // VkPipelineLayout layout;                     // set 0 + push constants
+            VK_NULL_HANDLE,                     // VkPipeline basePipelineHandle;               // no derivatives
+            -1                                  // int32_t basePipelineIndex;                   // no derivatives
+        };
+
+        result = mPipelineCache->createComputePipelines(1u, &computePipelineCreateInfo, &kernel.pipeline);
+    }
+
+    if (result == VK_SUCCESS)
+        ++mStatistics.kernelCount;
+    else
+        destroyKernel(kernel);
+
+    return result;
+}
+
+void ComputeEngine::destroyKernel(ComputeKernel& kernel)
+{
+    if (kernel.pipeline != VK_NULL_HANDLE)
+        mDispatch->vkDestroyPipeline(mDevice, kernel.pipeline, mAllocationCallbacks);
+    if (kernel.pipelineLayout != VK_NULL_HANDLE)
+        mDispatch->vkDestroyPipelineLayout(mDevice, kernel.pipelineLayout, mAllocationCallbacks);
+    if (kernel.descriptorSetLayout != VK_NULL_HANDLE)
+        mDispatch->vkDestroyDescriptorSetLayout(mDevice, kernel.descriptorSetLayout, mAllocationCallbacks);
+    if (kernel.shaderModule != VK_NULL_HANDLE)
+        mDispatch->vkDestroyShaderModule(mDevice, kernel.shaderModule, mAllocationCallbacks);
+
+    kernel = ComputeKernel{};
+}
+
+VkResult ComputeEngine::createBindings(const ComputeKernel& kernel, const VkDescriptorBufferInfo* buffers, VkDescriptorSet& descriptorSet)
+{
+    VkResult result = VK_SUCCESS;
+
+    const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, // VkStructureType sType;               // type of descriptor set allocate info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        mDescriptorPool,                        // VkDescriptorPool descriptorPool;             // pool to allocate from
+        1u,                                     // uint32_t descriptorSetCount;                 // number of entries in pSetLayouts
+        &kernel.descriptorSetLayout             // const VkDescriptorSetLayout* pSetLayouts;    // layout of the kernel
+    };
+
+    result = mDispatch->vkAllocateDescriptorSets(mDevice, &descriptorSetAllocateInfo, &descriptorSet);
+
+    if (result == VK_SUCCESS && kernel.storageBufferCount > 0u)
+    {
+        const VkWriteDescriptorSet writeDescriptorSet = {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, // VkStructureType sType;                   // type of descriptor write structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            descriptorSet,                      // VkDescriptorSet dstSet;                      // set to update
+            0u,                                 // uint32_t dstBinding;                         // first binding
+            0u,                                 // uint32_t dstArrayElement;                    // no arrays
+            kernel.storageBufferCount,          // uint32_t descriptorCount;                    // consecutive bindings 0..count-1
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // VkDescriptorType descriptorType;             // buffer blocks
+            nullptr,                            // const VkDescriptorImageInfo* pImageInfo;     // (images only)
+            buffers,                            // const VkDescriptorBufferInfo* pBufferInfo;   // buffer ranges
+            nullptr                             // const VkBufferView* pTexelBufferView;        // (texel buffers only)
+        };
+
+        mDispatch->vkUpdateDescriptorSets(mDevice, 1u, &writeDescriptorSet, 0u, nullptr);
+    }
+
+    return result;
+}
+
+void ComputeEngine::destroyBindings(VkDescriptorSet& descriptorSet)
+{
+    if (descriptorSet != VK_NULL_HANDLE)
+        mDispatch->vkFreeDescriptorSets(mDevice, mDescriptorPool, 1u, &descriptorSet);
+    descriptorSet = VK_NULL_HANDLE;
+}
+
+VkResult ComputeEngine::begin()
+{
+    VkResult result = VK_SUCCESS;
+
+    if (mRecording)
+        return VK_ERROR_UNKNOWN;
+
+    // command buffer may still be executing
+    result = wait();
+
+    if (result == VK_SUCCESS)
+        result = mDispatch->vkResetCommandPool(mDevice, mCommandPool, 0u);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, // VkStructureType sType;              // type of command buffer begin info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // VkCommandBufferUsageFlags flags;    // recorded again before the next submission
+            nullptr                             // const VkCommandBufferInheritanceInfo* pInheritanceInfo; // primary command buffer
+        };
+
+        result = mDispatch->vkBeginCommandBuffer(mCommandBuffer, &commandBufferBeginInfo);
+    }
+
+    mRecording = result == VK_SUCCESS;
+
+    return result;
+}
+
+void ComputeEngine::dispatch(const ComputeKernel& kernel, VkDescriptorSet descriptorSet, const void* pushConstants,
+    uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+    MK_PROFILE_GPU_ZONE(mProfiler, mCommandBuffer, mQueueFamilyIndex, "ComputeEngine dispatch");
+
+    mDispatch->vkCmdBindPipeline(mCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel.pipeline);
+    if (descriptorSet != VK_NULL_HANDLE)
+        mDispatch->vkCmdBindDescriptorSets(mCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel.pipelineLayout, 0u, 1u, &descriptorSet, 0u, nullptr);
+    if (kernel.pushConstantSize > 0u)
+        mDispatch->vkCmdPushConstants(mCommandBuffer, kernel.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0u, kernel.pushConstantSize, pushConstants);
+
+    mDispatch->vkCmdDispatch(mCommandBuffer, groupCountX, groupCountY, groupCountZ);
+
+    ++mStatistics.dispatchCount;
+}
+
+void ComputeEngine::barrier()
+{
+    memoryBarrier(*mDispatch, mCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    ++mStatistics.barrierCount;
+}
+
+VkResult ComputeEngine::submit()
+{
+    VkResult result = VK_SUCCESS;
+
+    if (!mRecording)
+        return VK_ERROR_UNKNOWN;
+    mRecording = false;
+
+    MK_PROFILE_CPU_ZONE(mProfiler, "ComputeEngine::submit");
+
+    result = mDispatch->vkEndCommandBuffer(mCommandBuffer);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,      // VkStructureType sType;                       // type of submit info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // uint32_t waitSemaphoreCount;                 // inputs are written by upload() before
+            nullptr,                            // const VkSemaphore* pWaitSemaphores;
+            nullptr,                            // const VkPipelineStageFlags* pWaitDstStageMask;
+            1u,                                 // uint32_t commandBufferCount;                 // whole recording is one command buffer
+            &mCommandBuffer,                    // const VkCommandBuffer* pCommandBuffers;
+            0u,                                 // uint32_t signalSemaphoreCount;               // completion is tracked by the fence
+            nullptr                             // const VkSemaphore* pSignalSemaphores;
+        };
+
+        std::unique_lock<std::mutex> queueLock;
+        if (mQueueMutex)
+            queueLock = std::unique_lock<std::mutex>(*mQueueMutex);
+
+        result = mDispatch->vkQueueSubmit(mQueue, 1u, &submitInfo, mFence);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        mSubmitted = true;
+        ++mStatistics.submitCount;
+    }
+
+    return result;
+}
+
+VkResult ComputeEngine::wait()
+{
+    VkResult result = VK_SUCCESS;
+
+    if (!mSubmitted)
+        return VK_SUCCESS;
+
+    MK_PROFILE_CPU_ZONE(mProfiler, "ComputeEngine::wait");
+
+    result = mDispatch->vkWaitForFences(mDevice, 1u, &mFence, VK_TRUE, UINT64_MAX);
+    if (result == VK_SUCCESS)
+    {
+        result = mDispatch->vkResetFences(mDevice, 1u, &mFence);
+        mSubmitted = false;
+    }
+
+    return result;
+}
+
+VkResult ComputeEngine::upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    VkResult result = VK_SUCCESS;
+
+    for (VkDeviceSize done{ 0u }; result == VK_SUCCESS && done < size; )
+    {
+        const VkDeviceSize chunk{ std::min(size - done, mConfig.stagingSize) };
+
+        std::memcpy(mUploadAllocation.mappedData, static_cast<const uint8_t*>(data) + done, static_cast<size_t>(chunk));
+        result = mAllocator->flush(mUploadAllocation, 0u, chunk);
+
+        if (result == VK_SUCCESS)
+            result = copy(mUploadBuffer, 0u, dst, dstOffset + done, chunk, false);
+
+        done += chunk;
+    }
+
+    if (result == VK_SUCCESS)
+        mStatistics.bytesUploaded += size;
+
+    return result;
+}
+
+VkResult ComputeEngine::readback(VkBuffer src, VkDeviceSize srcOffset, void* data, VkDeviceSize size)
+{
+    VkResult result = VK_SUCCESS;
+
+    for (VkDeviceSize done{ 0u }; result == VK_SUCCESS && done < size; )
+    {
+        const VkDeviceSize chunk{ std::min(size - done, mConfig.stagingSize) };
+
+        result = copy(src, srcOffset + done, mReadbackBuffer, 0u, chunk, true);
+
+        if (result == VK_SUCCESS)
+            result = mAllocator->invalidate(mReadbackAllocation, 0u, chunk);
+
+        if (result == VK_SUCCESS)
+            std::memcpy(static_cast<uint8_t*>(data) + done, mReadbackAllocation.mappedData, static_cast<size_t>(chunk));
+
+        done += chunk;
+    }
+
+    if (result == VK_SUCCESS)
+        mStatistics.bytesReadBack += size;
+
+    return result;
+}
+
+VkResult ComputeEngine::copy(VkBuffer src, VkDeviceSize srcOffset, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size, bool toHost)
+{
+    // One command buffer per chunk, submitted and waited for, staging memory is reused by the next chunk
+
+    VkResult result = VK_SUCCESS;
+
+    result = begin();
+
+    if (result == VK_SUCCESS)
+    {
+        // shader and copy writes of earlier submissions before the copy reads src or overwrites dst
+        memoryBarrier(*mDispatch, mCommandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+
+        const VkBufferCopy region = {
+            srcOffset,                          // VkDeviceSize srcOffset;
+            dstOffset,                          // VkDeviceSize dstOffset;
+            size                                // VkDeviceSize size;
+        };
+
+        mDispatch->vkCmdCopyBuffer(mCommandBuffer, src, dst, 1u, &region);
+
+        // copy result visible to the host (readback) or to later dispatches (upload)
+        if (toHost)
+            memoryBarrier(*mDispatch, mCommandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+        else
+            memoryBarrier(*mDispatch, mCommandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+        result = submit();
+    }
+
+    if (result == VK_SUCCESS)
+        result = wait();
+
+    return result;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "DeviceMemoryAllocator.h"
+#include "PipelineCache.h"
+#include "Profiler.h"
+#include "VulkanDispatch.h"
+#include <vulkan/vulkan.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ComputeEngineConfig
+{
+	uint32_t maxDescriptorSets{ 256u };				// descriptor sets alive at the same time (createBindings())
+	uint32_t maxStorageBuffersPerSet{ 4u };			// storage buffer bindings per kernel
+	VkDeviceSize stagingSize{ 4u * 1024u * 1024u };	// host visible buffer of upload()/readback(), larger transfers are split
+};
+
+/// Counters since init()
+struct ComputeEngineStatistics
+{
+	uint64_t kernelCount{ 0u };						// created by createKernel()
+	uint64_t dispatchCount{ 0u };
+	uint64_t barrierCount{ 0u };
+	uint64_t submitCount{ 0u };
+	uint64_t bytesUploaded{ 0u };
+	uint64_t bytesReadBack{ 0u };
+};
+
+/// Compute pipeline of one SPIR-V entry point "main" with storage buffer
+/// bindings 0..storageBufferCount-1 of set 0 and an optional push constant block
+struct ComputeKernel
+{
+	VkShaderModule shaderModule{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline pipeline{ VK_NULL_HANDLE };
+	uint32_t storageBufferCount{ 0u };
+	uint32_t pushConstantSize{ 0u };
+};
+
+/// Records compute dispatches into one command buffer and executes them on a
+/// compute queue. Pipelines are created through the PipelineCache. Buffers
+/// are filled and read back through host visible staging buffers on the same
+/// queue, so kernels see the data without a queue family ownership transfer.
+/// Typical use: begin(), dispatch()/barrier() ..., submit(), wait().
+/// Not thread safe. Other objects submitting to the queue from other threads
+/// must do so under the lock of setQueueMutex().
+class ComputeEngine
+{
+public:
+	ComputeEngine();
+
+	ComputeEngine(const ComputeEngine&) = delete;
+	ComputeEngine& operator=(const ComputeEngine&) = delete;
+
+	/// Create command pool, descriptor pool and staging buffers for queue of queueFamilyIndex
+	VkResult init(VkDevice device, const DeviceDispatch& dispatch, const PhysicalDeviceRecord& record, DeviceMemoryAllocator& allocator,
+		PipelineCache& pipelineCache, uint32_t queueFamilyIndex, VkQueue queue, const VkAllocationCallbacks* allocationCallbacks,
+		const ComputeEngineConfig& config = ComputeEngineConfig{});
+
+	/// Wait for the last submission and destroy all objects (kernels must be destroyed before)
+	void deinit();
+
+	/// Read a SPIR-V binary, false when the file is missing or is not SPIR-V
+	static bool loadSpirv(const std::string& path, std::vector<uint32_t>& code);
+
+	/// Create kernel of SPIR-V file or code (codeSize in bytes)
+	VkResult createKernel(const std::string& spirvPath, uint32_t storageBufferCount, uint32_t pushConstantSize, ComputeKernel& kernel);
+	VkResult createKernel(const uint32_t* code, size_t codeSize, uint32_t storageBufferCount, uint32_t pushConstantSize, ComputeKernel& kernel);
+	void destroyKernel(ComputeKernel& kernel);
+
+	/// Descriptor set binding buffers (kernel.storageBufferCount entries) to the bindings of kernel
+	VkResult createBindings(const ComputeKernel& kernel, const VkDescriptorBufferInfo* buffers, VkDescriptorSet& descriptorSet);
+	void destroyBindings(VkDescriptorSet& descriptorSet);
+
+	/// Start recording, waits for the previous submission
+	VkResult begin();
+
+	/// Record dispatch of kernel, pushConstants - kernel.pushConstantSize bytes (nullptr when 0)
+	void dispatch(const ComputeKernel& kernel, VkDescriptorSet descriptorSet, const void* pushConstants,
+		uint32_t groupCountX, uint32_t groupCountY = 1u, uint32_t groupCountZ = 1u);
+
+	/// Make shader writes of previous dispatches visible to following dispatches
+	void barrier();
+
+	/// End recording and submit to the queue
+	VkResult submit();
+
+	/// Wait until the last submission was executed by the device
+	VkResult wait();
+
+	/// Record CPU zones of submit()/wait() and a GPU zone of every dispatch into profiler (nullptr - none)
+	void setProfiler(Profiler* profiler) { mProfiler = profiler; }
+
+	/// Lock held around submissions when other objects submit to the same queue (nullptr - queue not shared)
+	void setQueueMutex(std::mutex* queueMutex) { mQueueMutex = queueMutex; }
+
+	/// Copy size bytes of data to dst at dstOffset, returns when the copy is done.
+	/// Must not be called between begin() and submit().
+	VkResult upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+	/// Copy size bytes of src at srcOffset to data after all submitted work finished.
+	/// Must not be called between begin() and submit().
+	VkResult readback(VkBuffer src, VkDeviceSize srcOffset, void* data, VkDeviceSize size);
+
+	/// Limit of groupCountX of a dispatch (maxComputeWorkGroupCount[0])
+	uint32_t getMaxGroupCountX() const { return mMaxGroupCountX; }
+
+	const ComputeEngineStatistics& getStatistics() const { return mStatistics; }
+private:
+	VkResult copy(VkBuffer src, VkDeviceSize srcOffset, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size, bool toHost);
+
+	VkDevice mDevice;
+	const DeviceDispatch* mDispatch;
+	DeviceMemoryAllocator* mAllocator;
+	PipelineCache* mPipelineCache;
+	const VkAllocationCallbacks* mAllocationCallbacks;
+	VkQueue mQueue;
+	uint32_t mQueueFamilyIndex;
+	Profiler* mProfiler;
+	std::mutex* mQueueMutex;
+	ComputeEngineConfig mConfig;
+	uint32_t mMaxGroupCountX;
+
+	VkCommandPool mCommandPool;
+	VkCommandBuffer mCommandBuffer;
+	VkFence mFence;
+	bool mRecording;
+	bool mSubmitted;							// mFence is signaled by a submission not waited for yet
+	VkDescriptorPool mDescriptorPool;
+
+	VkBuffer mUploadBuffer;						// CpuToGpu, source of upload() copies
+	MemoryAllocation mUploadAllocation;
+	VkBuffer mReadbackBuffer;					// GpuToCpu, destination of readback() copies
+	MemoryAllocation mReadbackAllocation;
+
+	ComputeEngineStatistics mStatistics;
+};
@@ -0,0 +1,128 @@
+#include "DeviceContext.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+DeviceContext::DeviceContext()
+    : mPhysicalDevice(VK_NULL_HANDLE)
+    , mRecord(nullptr)
+    , mAllocationCallbacks(nullptr)
+    , mDevice(VK_NULL_HANDLE)
+    , mQueueFamilyIndex(0u)
+    , mQueue(VK_NULL_HANDLE)
+{
+}
+
+VkResult DeviceContext::init(const InstanceDispatch& instanceDispatch, VkPhysicalDevice physicalDevice, const PhysicalDeviceRecord& record,
+    const VkAllocationCallbacks* allocationCallbacks, const DeviceContextConfig& config)
+{
+    // 1) create the logical device with one compute queue and load its dispatch table
+    // 2) create memory allocator and pipeline cache of the device
+    // 3) create compute engine on the queue
+
+    VkResult result = VK_SUCCESS;
+
+    mPhysicalDevice = physicalDevice;
+    mRecord = &record;
+    mAllocationCallbacks = allocationCallbacks;
+
+    result = createLogicalDevice(instanceDispatch, config.features, config.queuePriority);
+
+    if (result == VK_SUCCESS)
+        result = mMemoryAllocator.init(mDevice, mDispatch, record, mAllocationCallbacks, config.deviceMemory);
+
+    // kernels are compiled once per context, the cache only lives as long as the device
+    if (result == VK_SUCCESS)
+        result = mPipelineCache.init(mDevice, mDispatch, record, mAllocationCallbacks, std::string{}, false);
+
+    if (result == VK_SUCCESS)
+        result = mComputeEngine.init(mDevice, mDispatch, record, mMemoryAllocator, mPipelineCache,
+            mQueueFamilyIndex, mQueue, mAllocationCallbacks, config.compute);
+
+    return result;
+}
+
+void DeviceContext::deinit()
+{
+    if (mDevice == VK_NULL_HANDLE)
+        return;
+
+    mDispatch.vkDeviceWaitIdle(mDevice);
+
+    mComputeEngine.deinit();
+    mPipelineCache.deinit();
+    mMemoryAllocator.deinit();
+
+    mDispatch.vkDestroyDevice(mDevice, mAllocationCallbacks);
+
+    mDevice = VK_NULL_HANDLE;
+    mQueue = VK_NULL_HANDLE;
+}
+
+VkResult DeviceContext::createLogicalDevice(const InstanceDispatch& instanceDispatch, const DeviceFeatureRequest& features, float queuePriority)
+{
+    // Compute family - without graphics (async compute engine), else any compute family
+    const auto queueFamilyProperties = mRecord->getQueueFamilyProperties();
+    uint32_t computeFamilyIndex{ UINT32_MAX };
+    uint32_t dedicatedFamilyIndex{ UINT32_MAX };
+
+    for (uint32_t i{ 0u }; i < queueFamilyProperties.size(); ++i)
+    {
+        const VkQueueFlags queueFlags{ queueFamilyProperties[i].queueFlags };
+        if (!(queueFlags & VK_QUEUE_COMPUTE_BIT) || queueFamilyProperties[i].queueCount == 0u)
+            continue;
+
+        if (computeFamilyIndex == UINT32_MAX)
+            computeFamilyIndex = i;
+        if (dedicatedFamilyIndex == UINT32_MAX && !(queueFlags & VK_QUEUE_GRAPHICS_BIT))
+            dedicatedFamilyIndex = i;
+    }
+
+    mQueueFamilyIndex = dedicatedFamilyIndex != UINT32_MAX ? dedicatedFamilyIndex : computeFamilyIndex;
+    if (mQueueFamilyIndex == UINT32_MAX)
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+
+    // Enable only requested features the device supports
+    std::string missingFeature;
+    VkResult result = resolveDeviceFeatures(*mRecord, features, mEnabledFeatures, &missingFeature);
+    if (result != VK_SUCCESS)
+    {
+        std::printf("Required device feature %s is not supported by %s\n", missingFeature.c_str(), mRecord->getProperties().deviceName);
+        return result;
+    }
+
+    const float priority{ std::min(std::max(queuePriority, 0.0f), 1.0f) };
+
+    const VkDeviceQueueCreateInfo deviceQueueCreateInfo = {
+        VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, // VkStructureType sType;                   // type of create device info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        0,                                      // VkDeviceCreateFlags flags;                   // 0 (no bits defined in current version of Vulkan)
+        mQueueFamilyIndex,                      // uint32_t queueFamilyIndex;                   // compute family
+        1u,                                     // uint32_t queueCount;                         // one queue, driven by one thread
+        &priority                               // const float* pQueuePriorities;               // relative to other queues of the device
+    };
+
+    const VkDeviceCreateInfo deviceCreateInfo = {
+        VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,   // VkStructureType sType;                       // type of create device info structure
+        mEnabledFeatures.getDeviceCreateInfoNext(), // const void* pNext;                       // VkPhysicalDeviceFeatures2 -> 1.1 -> 1.2 features chain (Vulkan 1.2 devices) or nullptr
+        0,                                      // VkDeviceCreateFlags flags;                   // 0 (no bits defined in current version of Vulkan)
+        1u,                                     // uint32_t queueCreateInfoCount;               // number of structures in pQueueCreateInfos array
+        &deviceQueueCreateInfo,                 // const VkDeviceQueueCreateInfo* pQueueCreateInfos; // the compute queue
+        0,                                      // uint32_t enabledLayerCount;                  // no layers
+        nullptr,                                // const char* const* ppEnabledLayerNames;      // no layers
+        0,                                      // uint32_t enabledExtensionCount;              // core compute only
+        nullptr,                                // const char* const* ppEnabledExtensionNames;  // core compute only
+        mEnabledFeatures.getEnabledFeatures()   // const VkPhysicalDeviceFeatures* pEnabledFeatures; // ptr to structure with optional features (nullptr when chained in pNext)
+    };
+
+    result = instanceDispatch.vkCreateDevice(mPhysicalDevice, &deviceCreateInfo, mAllocationCallbacks, &mDevice);
+
+    // device functions straight from the driver, one table per logical device
+    if (result == VK_SUCCESS)
+    {
+        mDispatch.load(instanceDispatch, mDevice);
+        mDispatch.vkGetDeviceQueue(mDevice, mQueueFamilyIndex, 0u, &mQueue);
+    }
+
+    return result;
+}
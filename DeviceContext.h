@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ComputeEngine.h"
+#include "DeviceFeatures.h"
+#include "DeviceMemoryAllocator.h"
+#include "PhysicalDeviceRecord.h"
+#include "PipelineCache.h"
+#include "VulkanDispatch.h"
+#include <vulkan/vulkan.h>
+
+/// Options of the logical devices of DeviceContext
+struct DeviceContextConfig
+{
+	DeviceFeatureRequest features{ getFeatureProfile(FeatureProfile::Performance) };	// features enabled on the logical device
+	DeviceMemoryAllocatorConfig deviceMemory;
+	ComputeEngineConfig compute;
+	float queuePriority{ 1.0f };					// of the compute queue
+};
+
+/// Logical device with one compute queue, its own dispatch table, memory
+/// allocator, pipeline cache (not persisted) and compute engine. Several
+/// contexts may be created on the same physical device, each one is an
+/// independent VkDevice.
+/// Not thread safe, one thread drives a context at a time.
+class DeviceContext
+{
+public:
+	DeviceContext();
+
+	DeviceContext(const DeviceContext&) = delete;
+	DeviceContext& operator=(const DeviceContext&) = delete;
+
+	/// Create the logical device on physicalDevice (capabilities in record, which must outlive the context)
+	/// with a queue of the first compute family without graphics, else of any compute family
+	VkResult init(const InstanceDispatch& instanceDispatch, VkPhysicalDevice physicalDevice, const PhysicalDeviceRecord& record,
+		const VkAllocationCallbacks* allocationCallbacks, const DeviceContextConfig& config = DeviceContextConfig{});
+
+	/// Wait for the device and destroy it with all subsystems (kernels and buffers must be destroyed before)
+	void deinit();
+
+	VkDevice getDevice() const { return mDevice; }
+	VkPhysicalDevice getPhysicalDevice() const { return mPhysicalDevice; }
+	const PhysicalDeviceRecord& getRecord() const { return *mRecord; }
+	const DeviceDispatch& getDispatch() const { return mDispatch; }
+	const DeviceFeatureChain& getEnabledFeatures() const { return mEnabledFeatures; }
+
+	VkQueue getQueue() const { return mQueue; }
+	uint32_t getQueueFamilyIndex() const { return mQueueFamilyIndex; }
+
+	DeviceMemoryAllocator& getMemoryAllocator() { return mMemoryAllocator; }
+	PipelineCache& getPipelineCache() { return mPipelineCache; }
+	ComputeEngine& getComputeEngine() { return mComputeEngine; }
+private:
+	VkResult createLogicalDevice(const InstanceDispatch& instanceDispatch, const DeviceFeatureRequest& features, float queuePriority);
+
+	VkPhysicalDevice mPhysicalDevice;
+	const PhysicalDeviceRecord* mRecord;
+	const VkAllocationCallbacks* mAllocationCallbacks;
+
+	VkDevice mDevice;
+	DeviceDispatch mDispatch;
+	DeviceFeatureChain mEnabledFeatures;
+	uint32_t mQueueFamilyIndex;
+	VkQueue mQueue;
+	DeviceMemoryAllocator mMemoryAllocator;
+	PipelineCache mPipelineCache;
+	ComputeEngine mComputeEngine;
+};
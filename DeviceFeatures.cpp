@@ -0,0 +1,286 @@
+#include "DeviceFeatures.h"
+#include <cstddef>
+#include <iterator>
+
+namespace
+{
+    // Feature structs are plain runs of VkBool32 (after sType/pNext for the 1.1/1.2 ones),
+    // so they can be combined field by field. The 1.1/1.2 runs end at their last member,
+    // sizeof would count the tail padding after an odd number of flags.
+
+    constexpr size_t cFeatureCount{ sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32) };
+    constexpr size_t cFeature11Count{ (offsetof(VkPhysicalDeviceVulkan11Features, shaderDrawParameters) + sizeof(VkBool32)
+        - offsetof(VkPhysicalDeviceVulkan11Features, storageBuffer16BitAccess)) / sizeof(VkBool32) };
+    constexpr size_t cFeature12Count{ (offsetof(VkPhysicalDeviceVulkan12Features, subgroupBroadcastDynamicId) + sizeof(VkBool32)
+        - offsetof(VkPhysicalDeviceVulkan12Features, samplerMirrorClampToEdge)) / sizeof(VkBool32) };
+
+    // Member names for messages, keyed by offset so an entry in the wrong place cannot give a wrong name
+    struct FeatureName
+    {
+        size_t offset;
+        const char* name;
+    };
+
+#define MK_FEATURE_NAME(type, member) { offsetof(type, member), #member }
+    const FeatureName cFeatureNames[]{
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, robustBufferAccess),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, fullDrawIndexUint32),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, imageCubeArray),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, independentBlend),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, geometryShader),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, tessellationShader),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, sampleRateShading),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, dualSrcBlend),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, logicOp),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, multiDrawIndirect),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, drawIndirectFirstInstance),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, depthClamp),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, depthBiasClamp),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, fillModeNonSolid),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, depthBounds),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, wideLines),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, largePoints),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, alphaToOne),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, multiViewport),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, samplerAnisotropy),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, textureCompressionETC2),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, textureCompressionASTC_LDR),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, textureCompressionBC),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, occlusionQueryPrecise),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, pipelineStatisticsQuery),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, vertexPipelineStoresAndAtomics),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, fragmentStoresAndAtomics),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderTessellationAndGeometryPointSize),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderImageGatherExtended),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderStorageImageExtendedFormats),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderStorageImageMultisample),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderStorageImageReadWithoutFormat),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderStorageImageWriteWithoutFormat),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderUniformBufferArrayDynamicIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderSampledImageArrayDynamicIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderStorageBufferArrayDynamicIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderStorageImageArrayDynamicIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderClipDistance),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderCullDistance),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderFloat64),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderInt64),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderInt16),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderResourceResidency),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, shaderResourceMinLod),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, sparseBinding),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, sparseResidencyBuffer),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, sparseResidencyImage2D),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, sparseResidencyImage3D),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, sparseResidency2Samples),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, sparseResidency4Samples),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, sparseResidency8Samples),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, sparseResidency16Samples),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, sparseResidencyAliased),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, variableMultisampleRate),
+        MK_FEATURE_NAME(VkPhysicalDeviceFeatures, inheritedQueries)
+    };
+
+    const FeatureName cFeature11Names[]{
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, storageBuffer16BitAccess),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, uniformAndStorageBuffer16BitAccess),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, storagePushConstant16),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, storageInputOutput16),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, multiview),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, multiviewGeometryShader),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, multiviewTessellationShader),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, variablePointersStorageBuffer),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, variablePointers),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, protectedMemory),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, samplerYcbcrConversion),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan11Features, shaderDrawParameters)
+    };
+
+    const FeatureName cFeature12Names[]{
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, samplerMirrorClampToEdge),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, drawIndirectCount),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, storageBuffer8BitAccess),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, uniformAndStorageBuffer8BitAccess),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, storagePushConstant8),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderBufferInt64Atomics),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderSharedInt64Atomics),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderFloat16),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderInt8),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, descriptorIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderInputAttachmentArrayDynamicIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderUniformTexelBufferArrayDynamicIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderStorageTexelBufferArrayDynamicIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderUniformBufferArrayNonUniformIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderSampledImageArrayNonUniformIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderStorageBufferArrayNonUniformIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderStorageImageArrayNonUniformIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderInputAttachmentArrayNonUniformIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderUniformTexelBufferArrayNonUniformIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderStorageTexelBufferArrayNonUniformIndexing),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, descriptorBindingUniformBufferUpdateAfterBind),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, descriptorBindingSampledImageUpdateAfterBind),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, descriptorBindingStorageImageUpdateAfterBind),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, descriptorBindingStorageBufferUpdateAfterBind),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, descriptorBindingUniformTexelBufferUpdateAfterBind),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, descriptorBindingStorageTexelBufferUpdateAfterBind),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, descriptorBindingUpdateUnusedWhilePending),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, descriptorBindingPartiallyBound),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, descriptorBindingVariableDescriptorCount),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, runtimeDescriptorArray),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, samplerFilterMinmax),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, scalarBlockLayout),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, imagelessFramebuffer),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, uniformBufferStandardLayout),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderSubgroupExtendedTypes),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, separateDepthStencilLayouts),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, hostQueryReset),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, timelineSemaphore),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, bufferDeviceAddress),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, bufferDeviceAddressCaptureReplay),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, bufferDeviceAddressMultiDevice),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, vulkanMemoryModel),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, vulkanMemoryModelDeviceScope),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, vulkanMemoryModelAvailabilityVisibilityChains),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderOutputViewportIndex),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, shaderOutputLayer),
+        MK_FEATURE_NAME(VkPhysicalDeviceVulkan12Features, subgroupBroadcastDynamicId)
+    };
+#undef MK_FEATURE_NAME
+
+    static_assert(std::size(cFeatureNames) == cFeatureCount, "VkPhysicalDeviceFeatures member missing in cFeatureNames");
+    static_assert(std::size(cFeature11Names) == cFeature11Count, "VkPhysicalDeviceVulkan11Features member missing in cFeature11Names");
+    static_assert(std::size(cFeature12Names) == cFeature12Count, "VkPhysicalDeviceVulkan12Features member missing in cFeature12Names");
+
+    // "Struct::member" of flag index of a struct whose flags start at firstOffset
+    template<size_t N>
+    std::string getFeatureName(const char* structName, const FeatureName (&names)[N], size_t firstOffset, size_t index)
+    {
+        const size_t offset{ firstOffset + index * sizeof(VkBool32) };
+        for (const FeatureName& name : names)
+            if (name.offset == offset)
+                return std::string(structName) + "::" + name.name;
+
+        return std::string(structName) + "[" + std::to_string(index) + "]";
+    }
+
+    VkBool32* getFlags(VkPhysicalDeviceFeatures& features) { return &features.robustBufferAccess; }
+    VkBool32* getFlags(VkPhysicalDeviceVulkan11Features& features) { return &features.storageBuffer16BitAccess; }
+    VkBool32* getFlags(VkPhysicalDeviceVulkan12Features& features) { return &features.samplerMirrorClampToEdge; }
+    const VkBool32* getFlags(const VkPhysicalDeviceFeatures& features) { return &features.robustBufferAccess; }
+    const VkBool32* getFlags(const VkPhysicalDeviceVulkan11Features& features) { return &features.storageBuffer16BitAccess; }
+    const VkBool32* getFlags(const VkPhysicalDeviceVulkan12Features& features) { return &features.samplerMirrorClampToEdge; }
+
+    // enabled = supported & (required | optional), false when a required flag is not supported
+    template<typename T>
+    bool resolve(const T& supported, const T& required, const T& optional, T& enabled, size_t count, size_t& firstMissing)
+    {
+        const VkBool32* supportedFlags{ getFlags(supported) };
+        const VkBool32* requiredFlags{ getFlags(required) };
+        const VkBool32* optionalFlags{ getFlags(optional) };
+        VkBool32* enabledFlags{ getFlags(enabled) };
+
+        firstMissing = count;
+        for (size_t i{ 0u }; i < count; ++i)
+        {
+            enabledFlags[i] = supportedFlags[i] && (requiredFlags[i] || optionalFlags[i]) ? VK_TRUE : VK_FALSE;
+            if (requiredFlags[i] && !supportedFlags[i] && firstMissing == count)
+                firstMissing = i;
+        }
+
+        return firstMissing == count;
+    }
+}
+
+DeviceFeatureRequest getFeatureProfile(FeatureProfile profile)
+{
+    DeviceFeatureRequest request;
+
+    switch (profile)
+    {
+    case FeatureProfile::Minimal:
+        break;
+
+    case FeatureProfile::Debug:
+        // bounds checks on every shader buffer access - catches out of range reads/writes
+        request.optional.robustBufferAccess = VK_TRUE;
+        [[fallthrough]];                        // debug is performance plus robustness
+    case FeatureProfile::Performance:
+        request.optional12.timelineSemaphore = VK_TRUE;
+        request.optional12.hostQueryReset = VK_TRUE;
+        request.optional12.bufferDeviceAddress = VK_TRUE;
+        request.optional12.scalarBlockLayout = VK_TRUE;
+        request.optional12.uniformBufferStandardLayout = VK_TRUE;
+        request.optional12.descriptorIndexing = VK_TRUE;
+        request.optional12.runtimeDescriptorArray = VK_TRUE;
+        request.optional12.descriptorBindingPartiallyBound = VK_TRUE;
+        request.optional12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+        request.optional12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+        request.optional12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        break;
+
+    case FeatureProfile::All:
+    {
+        VkBool32* flags{ getFlags(request.optional) };
+        for (size_t i{ 0u }; i < cFeatureCount; ++i)
+            flags[i] = VK_TRUE;
+
+        VkBool32* flags11{ getFlags(request.optional11) };
+        for (size_t i{ 0u }; i < cFeature11Count; ++i)
+            flags11[i] = VK_TRUE;
+
+        VkBool32* flags12{ getFlags(request.optional12) };
+        for (size_t i{ 0u }; i < cFeature12Count; ++i)
+            flags12[i] = VK_TRUE;
+        break;
+    }
+    }
+
+    return request;
+}
+
+const void* DeviceFeatureChain::getDeviceCreateInfoNext()
+{
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &features11;
+    features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    features11.pNext = &features12;
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.pNext = nullptr;
+
+    return chained ? &features2 : nullptr;
+}
+
+VkResult resolveDeviceFeatures(const PhysicalDeviceRecord& record, const DeviceFeatureRequest& request, DeviceFeatureChain& enabled, std::string* missingFeature)
+{
+    // Vulkan 1.1/1.2 feature structs may only be chained for Vulkan 1.2 devices,
+    // below that they are reported as unsupported
+    enabled = DeviceFeatureChain{};
+    enabled.chained = record.getProperties().apiVersion >= VK_API_VERSION_1_2;
+
+    size_t firstMissing{ 0u };
+    bool supported{ true };
+
+    if (!resolve(record.getFeatures(), request.required, request.optional, enabled.features2.features, cFeatureCount, firstMissing))
+    {
+        supported = false;
+        if (missingFeature)
+            *missingFeature = getFeatureName("VkPhysicalDeviceFeatures", cFeatureNames, offsetof(VkPhysicalDeviceFeatures, robustBufferAccess), firstMissing);
+    }
+
+    if (!resolve(record.getFeatures11(), request.required11, request.optional11, enabled.features11, cFeature11Count, firstMissing) && supported)
+    {
+        supported = false;
+        if (missingFeature)
+            *missingFeature = getFeatureName("VkPhysicalDeviceVulkan11Features", cFeature11Names,
+                offsetof(VkPhysicalDeviceVulkan11Features, storageBuffer16BitAccess), firstMissing);
+    }
+
+    if (!resolve(record.getFeatures12(), request.required12, request.optional12, enabled.features12, cFeature12Count, firstMissing) && supported)
+    {
+        supported = false;
+        if (missingFeature)
+            *missingFeature = getFeatureName("VkPhysicalDeviceVulkan12Features", cFeature12Names,
+                offsetof(VkPhysicalDeviceVulkan12Features, samplerMirrorClampToEdge), firstMissing);
+    }
+
+    return supported ? VK_SUCCESS : VK_ERROR_FEATURE_NOT_PRESENT;
+}
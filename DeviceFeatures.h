@@ -0,0 +1,48 @@
+#pragma once
+
+#include "PhysicalDeviceRecord.h"
+#include <vulkan/vulkan.h>
+#include <string>
+
+/// Predefined feature sets for the logical device
+enum class FeatureProfile : uint32_t
+{
+	Minimal,		// nothing beyond Vulkan 1.0 core
+	Performance,	// modern fast paths (timeline semaphores, buffer device address, descriptor indexing), robustness off
+	Debug,			// Performance + robustBufferAccess (bounds checked shader buffer access)
+	All				// every supported feature (old behaviour, costs GPU time)
+};
+
+/// Features to enable on the logical device. Missing required features fail
+/// device creation, optional ones are enabled only when supported.
+struct DeviceFeatureRequest
+{
+	VkPhysicalDeviceFeatures required{};
+	VkPhysicalDeviceFeatures optional{};
+	VkPhysicalDeviceVulkan11Features required11{};		// sType/pNext are ignored
+	VkPhysicalDeviceVulkan11Features optional11{};
+	VkPhysicalDeviceVulkan12Features required12{};
+	VkPhysicalDeviceVulkan12Features optional12{};
+};
+
+/// Request of profile
+DeviceFeatureRequest getFeatureProfile(FeatureProfile profile);
+
+/// Features enabled on a logical device, ready to be chained into VkDeviceCreateInfo
+struct DeviceFeatureChain
+{
+	VkPhysicalDeviceFeatures2 features2{};
+	VkPhysicalDeviceVulkan11Features features11{};
+	VkPhysicalDeviceVulkan12Features features12{};
+	bool chained{ false };						// true - pass features2 as pNext, false - pass features2.features as pEnabledFeatures
+
+	/// Value for VkDeviceCreateInfo::pNext (sets up the chain, call after any copy)
+	const void* getDeviceCreateInfoNext();
+	/// Value for VkDeviceCreateInfo::pEnabledFeatures
+	const VkPhysicalDeviceFeatures* getEnabledFeatures() const { return chained ? nullptr : &features2.features; }
+};
+
+/// Intersect request with features of record. Returns VK_ERROR_FEATURE_NOT_PRESENT
+/// (and the name of the first missing feature in missingFeature) when a required
+/// feature is not supported.
+VkResult resolveDeviceFeatures(const PhysicalDeviceRecord& record, const DeviceFeatureRequest& request, DeviceFeatureChain& enabled, std::string* missingFeature = nullptr);
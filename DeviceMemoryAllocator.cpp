@@ -0,0 +1,738 @@
+#include "DeviceMemoryAllocator.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    // Property flags of a memory type for one MemoryUsage
+    struct MemoryUsageFlags
+    {
+        VkMemoryPropertyFlags required;         // all must be set
+        VkMemoryPropertyFlags fallbackRequired; // required when no type has all of required
+        VkMemoryPropertyFlags preferred;        // each one missing costs 1
+        VkMemoryPropertyFlags avoided;          // each one set costs 1
+    };
+
+    const MemoryUsageFlags cMemoryUsageFlags[MemoryUsageCount]{
+        // GpuOnly - device local, host visible memory is a scarce resource (BAR) or slower to access
+        { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0u, 0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT },
+        // CpuToGpu - write combined system memory, no flushes needed
+        { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+          0u, VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT },
+        // GpuToCpu - cached for fast CPU reads, non-coherent is fine (invalidate())
+        { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+          VK_MEMORY_PROPERTY_HOST_CACHED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT }
+    };
+
+    // Types with these flags need explicit opt-in and are never chosen
+    constexpr VkMemoryPropertyFlags cExcludedMemoryPropertyFlags{ VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_PROTECTED_BIT };
+
+    constexpr uint32_t cTransientBlockIndex{ UINT32_MAX - 1u };
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1u) & ~(alignment - 1u);
+    }
+
+    VkDeviceSize alignDown(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return value & ~(alignment - 1u);
+    }
+
+    bool isPowerOfTwo(VkDeviceSize value)
+    {
+        return value != 0u && (value & (value - 1u)) == 0u;
+    }
+
+    VkDeviceSize nextPowerOfTwo(VkDeviceSize value)
+    {
+        VkDeviceSize result{ 1u };
+        while (result < value)
+            result <<= 1u;
+        return result;
+    }
+
+    uint32_t countBits(VkMemoryPropertyFlags flags)
+    {
+        uint32_t count{ 0u };
+        for (; flags; flags &= flags - 1u)
+            ++count;
+        return count;
+    }
+
+    bool isOutOfMemory(VkResult result)
+    {
+        return result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator()
+    : mDevice(VK_NULL_HANDLE)
+    , mDispatch(nullptr)
+    , mAllocationCallbacks(nullptr)
+    , mMemoryProperties{}
+    , mNonCoherentAtomSize(1u)
+    , mSeparateTilingPools(true)
+    , mMaxMemoryAllocationCount(0u)
+    , mDeviceMemoryCount(0u)
+{
+}
+
+VkResult DeviceMemoryAllocator::init(VkDevice device, const DeviceDispatch& dispatch, const PhysicalDeviceRecord& record,
+    const VkAllocationCallbacks* allocationCallbacks, const DeviceMemoryAllocatorConfig& config)
+{
+    if (!isPowerOfTwo(config.blockSize) || !isPowerOfTwo(config.minAllocationSize) || config.blockSize < config.minAllocationSize
+        || (config.transientSize && !isPowerOfTwo(config.transientSize)))
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    const VkPhysicalDeviceLimits& limits = record.getProperties().limits;
+
+    mDevice = device;
+    mDispatch = &dispatch;
+    mAllocationCallbacks = allocationCallbacks;
+    mConfig = config;
+    mMemoryProperties = record.getMemoryProperties();
+    mNonCoherentAtomSize = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1u);
+    mMaxMemoryAllocationCount = limits.maxMemoryAllocationCount;
+    mDeviceMemoryCount = 0u;
+    mDedicatedStatistics.fill(MemoryTypeStatistics{});
+
+    // Buddy nodes are aligned to their size and at least minAllocationSize, so
+    // a linear and an optimal resource never share a bufferImageGranularity
+    // page when the granularity is not larger than the smallest node.
+    mSeparateTilingPools = limits.bufferImageGranularity > config.minAllocationSize;
+
+    // Blocks of small heaps (e.g. 256 MiB BAR) are reduced to an eighth of the heap
+    mPools.clear();
+    mPools.resize(mMemoryProperties.memoryTypeCount * static_cast<size_t>(MemoryTiling::Count));
+    for (uint32_t i{ 0u }; i < mMemoryProperties.memoryTypeCount; ++i)
+    {
+        const VkDeviceSize heapSize{ mMemoryProperties.memoryHeaps[mMemoryProperties.memoryTypes[i].heapIndex].size };
+        VkDeviceSize blockSize{ config.blockSize };
+        while (blockSize > config.minAllocationSize && blockSize * 8u > heapSize)
+            blockSize >>= 1u;
+
+        for (uint32_t tiling{ 0u }; tiling < static_cast<uint32_t>(MemoryTiling::Count); ++tiling)
+            mPools[getPoolIndex(i, static_cast<MemoryTiling>(tiling))].blockSize = blockSize;
+    }
+
+    return VK_SUCCESS;
+}
+
+void DeviceMemoryAllocator::deinit()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mDevice == VK_NULL_HANDLE)
+        return;
+
+    for (TransientRing& transientRing : mTransientRings)
+    {
+        if (transientRing.buffer != VK_NULL_HANDLE)
+            mDispatch->vkDestroyBuffer(mDevice, transientRing.buffer, mAllocationCallbacks);
+        if (transientRing.allocation.memory != VK_NULL_HANDLE)
+            freeDeviceMemory(transientRing.allocation.memory, transientRing.allocation.mappedData);
+        transientRing = TransientRing{};
+    }
+
+    size_t leakedCount{ 0u };
+    for (Pool& pool : mPools)
+        for (std::unique_ptr<Block>& block : pool.blocks)
+            if (block)
+            {
+                leakedCount += block->nodes.getAllocationCount();
+                freeDeviceMemory(block->memory, block->mappedData);
+            }
+    mPools.clear();
+
+    for (const MemoryTypeStatistics& statistics : mDedicatedStatistics)
+        leakedCount += statistics.dedicatedCount;
+
+    if (leakedCount)
+        std::printf("DeviceMemoryAllocator: %zu allocations not freed before deinit\n", leakedCount);
+
+    mDevice = VK_NULL_HANDLE;
+}
+
+uint32_t DeviceMemoryAllocator::findMemoryType(uint32_t memoryTypeBits, MemoryUsage usage) const
+{
+    // Cheapest type with all required flags, types are ordered by the driver
+    // so the first one wins ties. Fall back to fewer required flags.
+
+    const MemoryUsageFlags& usageFlags = cMemoryUsageFlags[static_cast<size_t>(usage)];
+
+    for (const VkMemoryPropertyFlags required : { usageFlags.required, usageFlags.fallbackRequired })
+    {
+        uint32_t bestIndex{ UINT32_MAX };
+        uint32_t bestCost{ UINT32_MAX };
+
+        for (uint32_t i{ 0u }; i < mMemoryProperties.memoryTypeCount; ++i)
+        {
+            const VkMemoryPropertyFlags flags{ mMemoryProperties.memoryTypes[i].propertyFlags };
+            if (!(memoryTypeBits & (1u << i)) || (flags & required) != required || (flags & cExcludedMemoryPropertyFlags))
+                continue;
+
+            const uint32_t cost{ countBits(usageFlags.preferred & ~flags) + countBits(usageFlags.avoided & flags) };
+            if (cost < bestCost)
+            {
+                bestIndex = i;
+                bestCost = cost;
+            }
+        }
+
+        if (bestIndex != UINT32_MAX)
+            return bestIndex;
+    }
+
+    return UINT32_MAX;
+}
+
+VkMemoryPropertyFlags DeviceMemoryAllocator::getMemoryTypeFlags(uint32_t memoryTypeIndex) const
+{
+    return memoryTypeIndex < mMemoryProperties.memoryTypeCount ? mMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags : 0u;
+}
+
+VkResult DeviceMemoryAllocator::allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, MemoryTiling tiling, MemoryAllocation& allocation)
+{
+    // Try the best memory type first, on out of memory the next best one of memoryTypeBits
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    allocation = MemoryAllocation{};
+
+    VkResult result = VK_ERROR_FEATURE_NOT_PRESENT;    // no memory type fits
+    uint32_t memoryTypeBits{ requirements.memoryTypeBits };
+
+    for (;;)
+    {
+        const uint32_t memoryTypeIndex{ findMemoryType(memoryTypeBits, usage) };
+        if (memoryTypeIndex == UINT32_MAX)
+            break;
+
+        result = allocateFromType(requirements, memoryTypeIndex, tiling, allocation);
+        if (!isOutOfMemory(result))
+            break;
+
+        memoryTypeBits &= ~(1u << memoryTypeIndex);
+    }
+
+    return result;
+}
+
+void DeviceMemoryAllocator::free(MemoryAllocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE || allocation.blockIndex == cTransientBlockIndex)
+    {
+        allocation = MemoryAllocation{};
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (allocation.poolIndex == UINT32_MAX)
+    {
+        // dedicated
+        MemoryTypeStatistics& statistics = mDedicatedStatistics[allocation.memoryTypeIndex];
+        --statistics.dedicatedCount;
+        statistics.dedicatedBytes -= allocation.size;
+        freeDeviceMemory(allocation.memory, allocation.mappedData);
+    }
+    else
+    {
+        Pool& pool = mPools[allocation.poolIndex];
+        std::unique_ptr<Block>& block = pool.blocks[allocation.blockIndex];
+
+        block->nodes.free(allocation.offset);
+        block->requestedBytes -= allocation.size;
+
+        // Keep one empty block per pool, so an allocation pattern around a
+        // block boundary does not allocate and free device memory every time.
+        // The block is freed when another one is empty already.
+        if (block->nodes.isEmpty()
+            && std::any_of(pool.blocks.begin(), pool.blocks.end(),
+                [&block](const std::unique_ptr<Block>& b) { return b && b != block && b->nodes.isEmpty(); }))
+        {
+            freeDeviceMemory(block->memory, block->mappedData);
+            block.reset();
+        }
+    }
+
+    allocation = MemoryAllocation{};
+}
+
+VkResult DeviceMemoryAllocator::createBuffer(const VkBufferCreateInfo& createInfo, MemoryUsage usage, VkBuffer& buffer, MemoryAllocation& allocation)
+{
+    // 1) create buffer - vkCreateBuffer
+    // 2) get its size, alignment and allowed memory types - vkGetBufferMemoryRequirements
+    // 3) sub-allocate memory and bind it - vkBindBufferMemory
+
+    VkResult result = VK_SUCCESS;
+
+    buffer = VK_NULL_HANDLE;
+    allocation = MemoryAllocation{};
+
+    result = mDispatch->vkCreateBuffer(mDevice, &createInfo, mAllocationCallbacks, &buffer);
+
+    if (result == VK_SUCCESS)
+    {
+        VkMemoryRequirements requirements;
+        mDispatch->vkGetBufferMemoryRequirements(mDevice, buffer, &requirements);
+        result = allocate(requirements, usage, MemoryTiling::Linear, allocation);
+    }
+
+    if (result == VK_SUCCESS)
+        result = mDispatch->vkBindBufferMemory(mDevice, buffer, allocation.memory, allocation.offset);
+
+    if (result != VK_SUCCESS)
+        destroyBuffer(buffer, allocation);
+
+    return result;
+}
+
+void DeviceMemoryAllocator::destroyBuffer(VkBuffer& buffer, MemoryAllocation& allocation)
+{
+    if (buffer != VK_NULL_HANDLE)
+        mDispatch->vkDestroyBuffer(mDevice, buffer, mAllocationCallbacks);
+    buffer = VK_NULL_HANDLE;
+
+    free(allocation);
+}
+
+VkResult DeviceMemoryAllocator::createImage(const VkImageCreateInfo& createInfo, MemoryUsage usage, VkImage& image, MemoryAllocation& allocation)
+{
+    VkResult result = VK_SUCCESS;
+
+    image = VK_NULL_HANDLE;
+    allocation = MemoryAllocation{};
+
+    result = mDispatch->vkCreateImage(mDevice, &createInfo, mAllocationCallbacks, &image);
+
+    if (result == VK_SUCCESS)
+    {
+        VkMemoryRequirements requirements;
+        mDispatch->vkGetImageMemoryRequirements(mDevice, image, &requirements);
+        result = allocate(requirements, usage, createInfo.tiling == VK_IMAGE_TILING_LINEAR ? MemoryTiling::Linear : MemoryTiling::Optimal, allocation);
+    }
+
+    if (result == VK_SUCCESS)
+        result = mDispatch->vkBindImageMemory(mDevice, image, allocation.memory, allocation.offset);
+
+    if (result != VK_SUCCESS)
+        destroyImage(image, allocation);
+
+    return result;
+}
+
+void DeviceMemoryAllocator::destroyImage(VkImage& image, MemoryAllocation& allocation)
+{
+    if (image != VK_NULL_HANDLE)
+        mDispatch->vkDestroyImage(mDevice, image, mAllocationCallbacks);
+    image = VK_NULL_HANDLE;
+
+    free(allocation);
+}
+
+VkResult DeviceMemoryAllocator::allocateTransient(VkDeviceSize size, VkDeviceSize alignment, MemoryUsage usage, TransientAllocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    allocation = TransientAllocation{};
+
+    // ring buffer is created on first use
+    TransientRing& transientRing = mTransientRings[static_cast<size_t>(usage)];
+    if (transientRing.status == VK_NOT_READY)
+        transientRing.status = createTransientRing(usage, transientRing);
+    if (transientRing.status != VK_SUCCESS)
+        return transientRing.status;
+
+    const uint32_t memoryTypeIndex{ transientRing.allocation.memoryTypeIndex };
+    if (!isCoherent(memoryTypeIndex))
+        size = alignUp(size, mNonCoherentAtomSize);
+
+    VkDeviceSize offset;
+    if (!transientRing.ring->allocate(size, getAllocationAlignment(memoryTypeIndex, std::max<VkDeviceSize>(alignment, 1u)), offset))
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+
+    allocation.buffer = transientRing.buffer;
+    allocation.allocation.memory = transientRing.allocation.memory;
+    allocation.allocation.offset = offset;
+    allocation.allocation.size = size;
+    allocation.allocation.mappedData = transientRing.allocation.mappedData ? static_cast<uint8_t*>(transientRing.allocation.mappedData) + offset : nullptr;
+    allocation.allocation.memoryTypeIndex = memoryTypeIndex;
+    allocation.allocation.blockIndex = cTransientBlockIndex;
+
+    return VK_SUCCESS;
+}
+
+void DeviceMemoryAllocator::advanceFrame()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // with framesInFlight frames in flight, the oldest closed frame is done when the
+    // caller waited for it - keep the others
+    const size_t keptFrameCount{ std::max(mConfig.framesInFlight, 1u) - 1u };
+
+    for (TransientRing& transientRing : mTransientRings)
+    {
+        if (!transientRing.ring)
+            continue;
+
+        transientRing.ring->endFrame();
+        while (transientRing.ring->getPendingFrameCount() > keptFrameCount)
+            transientRing.ring->releaseFrame();
+    }
+}
+
+VkResult DeviceMemoryAllocator::flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    return flushOrInvalidate(false, allocation, offset, size);
+}
+
+VkResult DeviceMemoryAllocator::invalidate(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    return flushOrInvalidate(true, allocation, offset, size);
+}
+
+MemoryTypeStatistics DeviceMemoryAllocator::getStatistics(uint32_t memoryTypeIndex) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    MemoryTypeStatistics statistics{};
+    if (memoryTypeIndex >= mMemoryProperties.memoryTypeCount || mPools.empty())
+        return statistics;
+
+    // pools of both tilings (one pool when tilings share blocks)
+    for (uint32_t tiling{ 0u }; tiling < static_cast<uint32_t>(MemoryTiling::Count); ++tiling)
+    {
+        const uint32_t poolIndex{ getPoolIndex(memoryTypeIndex, static_cast<MemoryTiling>(tiling)) };
+        if (tiling > 0u && poolIndex == getPoolIndex(memoryTypeIndex, MemoryTiling::Linear))
+            break;
+
+        for (const std::unique_ptr<Block>& block : mPools[poolIndex].blocks)
+        {
+            if (!block)
+                continue;
+
+            ++statistics.blockCount;
+            statistics.allocationCount += block->nodes.getAllocationCount();
+            statistics.blockBytes += block->nodes.getSize();
+            statistics.usedBytes += block->nodes.getUsedSize();
+            statistics.requestedBytes += block->requestedBytes;
+            statistics.largestFreeBytes = std::max(statistics.largestFreeBytes, block->nodes.getLargestFreeNodeSize());
+            statistics.blockLargestFreeBytes += block->nodes.getLargestFreeNodeSize();
+        }
+    }
+
+    statistics.dedicatedCount = mDedicatedStatistics[memoryTypeIndex].dedicatedCount;
+    statistics.dedicatedBytes = mDedicatedStatistics[memoryTypeIndex].dedicatedBytes;
+
+    for (const TransientRing& transientRing : mTransientRings)
+        if (transientRing.ring && transientRing.allocation.memoryTypeIndex == memoryTypeIndex)
+        {
+            statistics.transientBytes += transientRing.ring->getSize();
+            statistics.transientUsedBytes += transientRing.ring->getUsedSize();
+        }
+
+    return statistics;
+}
+
+uint32_t DeviceMemoryAllocator::getDeviceMemoryCount() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mDeviceMemoryCount;
+}
+
+void DeviceMemoryAllocator::printStatistics() const
+{
+    std::printf("DeviceMemoryAllocator statistics\n");
+    std::printf("%-4s %-4s %-11s %7s %12s %12s %12s %8s %6s %6s %9s %12s %12s\n",
+        "type", "heap", "flags", "blocks", "block B", "used B", "requested B", "allocs", "util", "frag", "dedicated", "dedicated B", "transient B");
+
+    for (uint32_t i{ 0u }; i < mMemoryProperties.memoryTypeCount; ++i)
+    {
+        const MemoryTypeStatistics statistics{ getStatistics(i) };
+        if (!statistics.blockCount && !statistics.dedicatedCount && !statistics.transientBytes)
+            continue;
+
+        // D - device local, V - host visible, C - host coherent, H - host cached
+        const VkMemoryPropertyFlags flags{ mMemoryProperties.memoryTypes[i].propertyFlags };
+        char flagString[5]{
+            flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT ? 'D' : '-',
+            flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ? 'V' : '-',
+            flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ? 'C' : '-',
+            flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT ? 'H' : '-',
+            '\0' };
+
+        std::printf("%-4u %-4u %-11s %7u %12llu %12llu %12llu %8llu %5.1f%% %5.1f%% %9u %12llu %12llu\n",
+            i, mMemoryProperties.memoryTypes[i].heapIndex, flagString,
+            statistics.blockCount,
+            static_cast<unsigned long long>(statistics.blockBytes),
+            static_cast<unsigned long long>(statistics.usedBytes),
+            static_cast<unsigned long long>(statistics.requestedBytes),
+            static_cast<unsigned long long>(statistics.allocationCount),
+            100.0f * statistics.getUtilization(),
+            100.0f * statistics.getFragmentation(),
+            statistics.dedicatedCount,
+            static_cast<unsigned long long>(statistics.dedicatedBytes),
+            static_cast<unsigned long long>(statistics.transientBytes));
+    }
+
+    std::printf("device memory allocations: %u of max %u\n", getDeviceMemoryCount(), mMaxMemoryAllocationCount);
+}
+
+uint32_t DeviceMemoryAllocator::getPoolIndex(uint32_t memoryTypeIndex, MemoryTiling tiling) const
+{
+    const uint32_t tilingIndex{ mSeparateTilingPools ? static_cast<uint32_t>(tiling) : 0u };
+    return memoryTypeIndex * static_cast<uint32_t>(MemoryTiling::Count) + tilingIndex;
+}
+
+bool DeviceMemoryAllocator::isCoherent(uint32_t memoryTypeIndex) const
+{
+    return (mMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0u;
+}
+
+VkDeviceSize DeviceMemoryAllocator::getAllocationAlignment(uint32_t memoryTypeIndex, VkDeviceSize alignment) const
+{
+    // Flushed/invalidated ranges are widened to nonCoherentAtomSize, aligning
+    // the allocation keeps the widened range inside of it
+    const VkMemoryPropertyFlags flags{ mMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags };
+    if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+        return std::max(alignment, mNonCoherentAtomSize);
+
+    return alignment;
+}
+
+VkResult DeviceMemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkDeviceMemory& memory, void*& mappedData)
+{
+    // Allocate memory and map host visible memory for its whole lifetime
+    // (mapping is not free and a persistent mapping is allowed by the spec)
+
+    VkResult result = VK_SUCCESS;
+
+    memory = VK_NULL_HANDLE;
+    mappedData = nullptr;
+
+    // vkAllocateMemory may fail or misbehave past the limit, fail here so callers can sub-allocate instead
+    if (mMaxMemoryAllocationCount != 0u && mDeviceMemoryCount >= mMaxMemoryAllocationCount)
+        return VK_ERROR_TOO_MANY_OBJECTS;
+
+    const VkMemoryAllocateInfo memoryAllocateInfo = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, // VkStructureType sType;                       // type of memory allocate info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        size,                                   // VkDeviceSize allocationSize;                 // size in bytes
+        memoryTypeIndex                         // uint32_t memoryTypeIndex;                    // index into VkPhysicalDeviceMemoryProperties::memoryTypes
+    };
+
+    result = mDispatch->vkAllocateMemory(mDevice, &memoryAllocateInfo, mAllocationCallbacks, &memory);
+
+    if (result == VK_SUCCESS && (mMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+    {
+        result = mDispatch->vkMapMemory(mDevice, memory, 0u, VK_WHOLE_SIZE, 0u, &mappedData);
+        if (result != VK_SUCCESS)
+        {
+            mDispatch->vkFreeMemory(mDevice, memory, mAllocationCallbacks);
+            memory = VK_NULL_HANDLE;
+            mappedData = nullptr;
+        }
+    }
+
+    if (result == VK_SUCCESS)
+        ++mDeviceMemoryCount;
+
+    return result;
+}
+
+void DeviceMemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, void* mappedData)
+{
+    if (mappedData)
+        mDispatch->vkUnmapMemory(mDevice, memory);
+    mDispatch->vkFreeMemory(mDevice, memory, mAllocationCallbacks);
+    --mDeviceMemoryCount;
+}
+
+VkResult DeviceMemoryAllocator::allocateFromType(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, MemoryTiling tiling, MemoryAllocation& allocation)
+{
+    VkResult result = VK_SUCCESS;
+
+    const uint32_t poolIndex{ getPoolIndex(memoryTypeIndex, tiling) };
+    Pool& pool = mPools[poolIndex];
+
+    const VkDeviceSize size{ requirements.size };
+    const VkDeviceSize alignment{ getAllocationAlignment(memoryTypeIndex, std::max<VkDeviceSize>(requirements.alignment, 1u)) };
+    const VkDeviceSize dedicatedThreshold{ mConfig.dedicatedThreshold ? mConfig.dedicatedThreshold : pool.blockSize / 2u };
+
+    // At maxMemoryAllocationCount a request that fits a block is sub-allocated from the existing blocks
+    if (size > dedicatedThreshold)
+    {
+        result = allocateDedicated(size, memoryTypeIndex, allocation);
+        if (result != VK_ERROR_TOO_MANY_OBJECTS || size > pool.blockSize)
+            return result;
+    }
+
+    VkDeviceSize offset{ 0u };
+    uint32_t blockIndex{ UINT32_MAX };
+
+    // First block with a free node large enough
+    for (uint32_t i{ 0u }; i < pool.blocks.size(); ++i)
+        if (pool.blocks[i] && pool.blocks[i]->nodes.allocate(size, alignment, offset))
+        {
+            blockIndex = i;
+            break;
+        }
+
+    // New block, smaller ones when the heap is running out of memory
+    if (blockIndex == UINT32_MAX)
+    {
+        const VkDeviceSize minBlockSize{ nextPowerOfTwo(std::max({ size, alignment, mConfig.minAllocationSize })) };
+        VkDeviceSize blockSize{ pool.blockSize };
+        VkDeviceMemory memory;
+        void* mappedData;
+
+        for (;;)
+        {
+            result = allocateDeviceMemory(blockSize, memoryTypeIndex, memory, mappedData);
+            if (result == VK_SUCCESS || !isOutOfMemory(result) || blockSize / 2u < minBlockSize)
+                break;
+            blockSize /= 2u;
+        }
+
+        if (result != VK_SUCCESS)
+            return result;
+
+        std::unique_ptr<Block> block{ new Block(blockSize, mConfig.minAllocationSize) };
+        block->memory = memory;
+        block->mappedData = mappedData;
+        block->nodes.allocate(size, alignment, offset);
+
+        // reuse slot of a freed block
+        const auto freeSlot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+        blockIndex = static_cast<uint32_t>(freeSlot - pool.blocks.begin());
+        if (freeSlot == pool.blocks.end())
+            pool.blocks.push_back(std::move(block));
+        else
+            *freeSlot = std::move(block);
+    }
+
+    Block& block = *pool.blocks[blockIndex];
+    block.requestedBytes += size;
+
+    allocation.memory = block.memory;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.mappedData = block.mappedData ? static_cast<uint8_t*>(block.mappedData) + offset : nullptr;
+    allocation.memoryTypeIndex = memoryTypeIndex;
+    allocation.poolIndex = poolIndex;
+    allocation.blockIndex = blockIndex;
+
+    return VK_SUCCESS;
+}
+
+VkResult DeviceMemoryAllocator::allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, MemoryAllocation& allocation)
+{
+    // whole atoms, so flushing the widened range stays inside the memory
+    if (!isCoherent(memoryTypeIndex))
+        size = alignUp(size, mNonCoherentAtomSize);
+
+    VkResult result = allocateDeviceMemory(size, memoryTypeIndex, allocation.memory, allocation.mappedData);
+
+    if (result == VK_SUCCESS)
+    {
+        allocation.offset = 0u;
+        allocation.size = size;
+        allocation.memoryTypeIndex = memoryTypeIndex;
+        allocation.poolIndex = UINT32_MAX;
+        allocation.blockIndex = UINT32_MAX;
+
+        MemoryTypeStatistics& statistics = mDedicatedStatistics[memoryTypeIndex];
+        ++statistics.dedicatedCount;
+        statistics.dedicatedBytes += size;
+    }
+
+    return result;
+}
+
+VkResult DeviceMemoryAllocator::createTransientRing(MemoryUsage usage, TransientRing& transientRing)
+{
+    // One buffer over dedicated memory, allocations are ranges of the buffer
+
+    VkResult result = VK_SUCCESS;
+
+    if (mConfig.transientSize == 0u)
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+
+    const VkBufferCreateInfo bufferCreateInfo = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,   // VkStructureType sType;                       // type of buffer create info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        0u,                                     // VkBufferCreateFlags flags;                   // no sparse binding
+        mConfig.transientSize,                  // VkDeviceSize size;                           // size in bytes
+        mConfig.transientBufferUsage,           // VkBufferUsageFlags usage;                    // allowed usages of ranges
+        VK_SHARING_MODE_EXCLUSIVE,              // VkSharingMode sharingMode;                   // one queue family at a time
+        0u,                                     // uint32_t queueFamilyIndexCount;              // (concurrent sharing only)
+        nullptr                                 // const uint32_t* pQueueFamilyIndices;         // (concurrent sharing only)
+    };
+
+    result = mDispatch->vkCreateBuffer(mDevice, &bufferCreateInfo, mAllocationCallbacks, &transientRing.buffer);
+
+    if (result == VK_SUCCESS)
+    {
+        VkMemoryRequirements requirements;
+        mDispatch->vkGetBufferMemoryRequirements(mDevice, transientRing.buffer, &requirements);
+
+        const uint32_t memoryTypeIndex{ findMemoryType(requirements.memoryTypeBits, usage) };
+        result = memoryTypeIndex == UINT32_MAX ? VK_ERROR_FEATURE_NOT_PRESENT : allocateDedicated(requirements.size, memoryTypeIndex, transientRing.allocation);
+    }
+
+    if (result == VK_SUCCESS)
+        result = mDispatch->vkBindBufferMemory(mDevice, transientRing.buffer, transientRing.allocation.memory, 0u);
+
+    if (result == VK_SUCCESS)
+    {
+        // ring memory is not a user visible dedicated allocation
+        MemoryTypeStatistics& statistics = mDedicatedStatistics[transientRing.allocation.memoryTypeIndex];
+        --statistics.dedicatedCount;
+        statistics.dedicatedBytes -= transientRing.allocation.size;
+
+        transientRing.ring.reset(new RingAllocator(mConfig.transientSize));
+    }
+    else
+    {
+        if (transientRing.buffer != VK_NULL_HANDLE)
+            mDispatch->vkDestroyBuffer(mDevice, transientRing.buffer, mAllocationCallbacks);
+        if (transientRing.allocation.memory != VK_NULL_HANDLE)
+        {
+            MemoryTypeStatistics& statistics = mDedicatedStatistics[transientRing.allocation.memoryTypeIndex];
+            --statistics.dedicatedCount;
+            statistics.dedicatedBytes -= transientRing.allocation.size;
+            freeDeviceMemory(transientRing.allocation.memory, transientRing.allocation.mappedData);
+        }
+        transientRing.buffer = VK_NULL_HANDLE;
+        transientRing.allocation = MemoryAllocation{};
+    }
+
+    return result;
+}
+
+VkResult DeviceMemoryAllocator::flushOrInvalidate(bool invalidate, const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (allocation.memory == VK_NULL_HANDLE || isCoherent(allocation.memoryTypeIndex))
+        return VK_SUCCESS;
+
+    if (size == VK_WHOLE_SIZE)
+        size = allocation.size - offset;
+
+    // widen to whole atoms, allocations of non-coherent memory are atom aligned and sized
+    const VkDeviceSize begin{ alignDown(allocation.offset + offset, mNonCoherentAtomSize) };
+    const VkDeviceSize end{ alignUp(allocation.offset + offset + size, mNonCoherentAtomSize) };
+
+    const VkMappedMemoryRange mappedMemoryRange = {
+        VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,  // VkStructureType sType;                       // type of mapped memory range structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        allocation.memory,                      // VkDeviceMemory memory;                       // mapped memory
+        begin,                                  // VkDeviceSize offset;                         // multiple of nonCoherentAtomSize
+        end - begin                             // VkDeviceSize size;                           // multiple of nonCoherentAtomSize
+    };
+
+    return invalidate ? mDispatch->vkInvalidateMappedMemoryRanges(mDevice, 1u, &mappedMemoryRange) : mDispatch->vkFlushMappedMemoryRanges(mDevice, 1u, &mappedMemoryRange);
+}
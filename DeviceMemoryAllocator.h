@@ -0,0 +1,203 @@
+#pragma once
+
+#include "PhysicalDeviceRecord.h"
+#include "SubAllocator.h"
+#include "VulkanDispatch.h"
+#include <vulkan/vulkan.h>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// Intended use of memory, selects the memory type
+enum class MemoryUsage : uint32_t
+{
+	GpuOnly,	// device local, preferably not host visible (render targets, static buffers)
+	CpuToGpu,	// host visible + coherent, preferably uncached (staging uploads, per-frame constants)
+	GpuToCpu,	// host visible, preferably cached (readback)
+	Count
+};
+
+constexpr size_t MemoryUsageCount{ static_cast<size_t>(MemoryUsage::Count) };
+
+/// Resource kind bound to memory. Linear (buffers, linear images) and optimal
+/// resources are sub-allocated from different blocks when bufferImageGranularity
+/// could make neighbours alias.
+enum class MemoryTiling : uint32_t
+{
+	Linear,
+	Optimal,
+	Count
+};
+
+struct DeviceMemoryAllocatorConfig
+{
+	VkDeviceSize blockSize{ 64u * 1024u * 1024u };	// power of two, heaps smaller than 8 blocks use heapSize / 8
+	VkDeviceSize minAllocationSize{ 256u };			// power of two, smallest sub-allocation node
+	VkDeviceSize dedicatedThreshold{ 0u };			// larger requests get their own VkDeviceMemory (0 - blockSize / 2)
+	VkDeviceSize transientSize{ 8u * 1024u * 1024u };	// ring buffer per MemoryUsage for per-frame data (0 - disabled)
+	VkBufferUsageFlags transientBufferUsage{
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT };
+	uint32_t framesInFlight{ 2u };					// transient memory of a frame is reused this many frames later
+};
+
+/// Memory bound to one resource
+struct MemoryAllocation
+{
+	VkDeviceMemory memory{ VK_NULL_HANDLE };
+	VkDeviceSize offset{ 0u };					// offset of the resource in memory
+	VkDeviceSize size{ 0u };					// requested size
+	void* mappedData{ nullptr };				// host address of offset, host visible memory stays mapped
+	uint32_t memoryTypeIndex{ UINT32_MAX };
+	uint32_t poolIndex{ UINT32_MAX };			// internal - pool of the block, UINT32_MAX for dedicated and transient memory
+	uint32_t blockIndex{ UINT32_MAX };			// internal - block in the pool, UINT32_MAX - 1 for transient memory
+};
+
+/// Range of a transient ring buffer, valid until the frame is recycled
+struct TransientAllocation
+{
+	VkBuffer buffer{ VK_NULL_HANDLE };			// ring buffer, allocation.offset is the offset in the buffer too
+	MemoryAllocation allocation;
+};
+
+/// Counters of one memory type
+struct MemoryTypeStatistics
+{
+	uint32_t blockCount{ 0u };
+	uint32_t dedicatedCount{ 0u };
+	uint64_t allocationCount{ 0u };				// live sub-allocations
+	VkDeviceSize blockBytes{ 0u };				// reserved in blocks
+	VkDeviceSize usedBytes{ 0u };				// in allocated nodes (requested size rounded to a power of two)
+	VkDeviceSize requestedBytes{ 0u };			// requested by live sub-allocations
+	VkDeviceSize largestFreeBytes{ 0u };		// largest free node of all blocks
+	VkDeviceSize blockLargestFreeBytes{ 0u };	// sum of the largest free node of each block
+	VkDeviceSize dedicatedBytes{ 0u };
+	VkDeviceSize transientBytes{ 0u };			// transient ring buffer size
+	VkDeviceSize transientUsedBytes{ 0u };
+
+	/// used / reserved bytes of the blocks
+	float getUtilization() const { return blockBytes ? static_cast<float>(usedBytes) / static_cast<float>(blockBytes) : 0.0f; }
+
+	/// Share of free bytes not in the largest free node of their block, 0 when
+	/// the free memory of every block is one node
+	float getFragmentation() const
+	{
+		const VkDeviceSize freeBytes{ blockBytes - usedBytes };
+		return freeBytes ? 1.0f - static_cast<float>(blockLargestFreeBytes) / static_cast<float>(freeBytes) : 0.0f;
+	}
+};
+
+/// Device memory sub-allocator. Memory is allocated in large blocks per memory
+/// type and sub-allocated with a buddy allocator, per-frame data comes from a
+/// ring buffer. Host visible memory is mapped once for its whole lifetime.
+/// All methods are thread safe.
+class DeviceMemoryAllocator
+{
+public:
+	DeviceMemoryAllocator();
+
+	DeviceMemoryAllocator(const DeviceMemoryAllocator&) = delete;
+	DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+
+	/// Initialize for device created on the physical device of record
+	VkResult init(VkDevice device, const DeviceDispatch& dispatch, const PhysicalDeviceRecord& record,
+		const VkAllocationCallbacks* allocationCallbacks, const DeviceMemoryAllocatorConfig& config = DeviceMemoryAllocatorConfig{});
+
+	/// Free all memory, every allocation must be freed and the device idle before
+	void deinit();
+
+	/// Best memory type of memoryTypeBits for usage
+	/// return memory type index or UINT32_MAX when no type in memoryTypeBits fits
+	uint32_t findMemoryType(uint32_t memoryTypeBits, MemoryUsage usage) const;
+
+	VkMemoryPropertyFlags getMemoryTypeFlags(uint32_t memoryTypeIndex) const;
+
+	/// Allocate memory for requirements of a resource
+	/// return VK_ERROR_TOO_MANY_OBJECTS when a new VkDeviceMemory would exceed maxMemoryAllocationCount
+	VkResult allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, MemoryTiling tiling, MemoryAllocation& allocation);
+	void free(MemoryAllocation& allocation);
+
+	/// Create buffer/image and bind it to newly allocated memory
+	VkResult createBuffer(const VkBufferCreateInfo& createInfo, MemoryUsage usage, VkBuffer& buffer, MemoryAllocation& allocation);
+	void destroyBuffer(VkBuffer& buffer, MemoryAllocation& allocation);
+	VkResult createImage(const VkImageCreateInfo& createInfo, MemoryUsage usage, VkImage& image, MemoryAllocation& allocation);
+	void destroyImage(VkImage& image, MemoryAllocation& allocation);
+
+	/// Allocate size bytes at alignment from the ring buffer of usage. The
+	/// range is valid for the current frame only (see advanceFrame()).
+	/// return VK_ERROR_OUT_OF_POOL_MEMORY when the ring is full
+	VkResult allocateTransient(VkDeviceSize size, VkDeviceSize alignment, MemoryUsage usage, TransientAllocation& allocation);
+
+	/// Close the current frame of the ring buffers. Call once per frame after
+	/// waiting for the GPU to finish the frame submitted framesInFlight frames
+	/// ago, its transient memory is reused.
+	void advanceFrame();
+
+	/// Make host writes to non-coherent memory visible to the device / device
+	/// writes visible to the host. Ranges are widened to nonCoherentAtomSize.
+	/// No-op for coherent memory. offset is relative to the allocation.
+	VkResult flush(const MemoryAllocation& allocation, VkDeviceSize offset = 0u, VkDeviceSize size = VK_WHOLE_SIZE) const;
+	VkResult invalidate(const MemoryAllocation& allocation, VkDeviceSize offset = 0u, VkDeviceSize size = VK_WHOLE_SIZE) const;
+
+	MemoryTypeStatistics getStatistics(uint32_t memoryTypeIndex) const;
+
+	/// Live vkAllocateMemory allocations (limited by maxMemoryAllocationCount)
+	uint32_t getDeviceMemoryCount() const;
+
+	/// Print statistics of used memory types to stdout
+	void printStatistics() const;
+private:
+	struct Block
+	{
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		void* mappedData{ nullptr };
+		BuddyAllocator nodes;
+		VkDeviceSize requestedBytes{ 0u };
+
+		Block(VkDeviceSize size, VkDeviceSize minNodeSize) : nodes(size, minNodeSize) {}
+	};
+
+	/// Blocks of one memory type and tiling
+	struct Pool
+	{
+		std::vector<std::unique_ptr<Block>> blocks;	// freed blocks leave nullptr, indices stay valid
+		VkDeviceSize blockSize{ 0u };
+	};
+
+	struct TransientRing
+	{
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		MemoryAllocation allocation;				// dedicated memory of the buffer
+		std::unique_ptr<RingAllocator> ring;
+		VkResult status{ VK_NOT_READY };			// VK_NOT_READY until first used, then result of creation (not retried)
+	};
+
+	uint32_t getPoolIndex(uint32_t memoryTypeIndex, MemoryTiling tiling) const;
+	bool isCoherent(uint32_t memoryTypeIndex) const;
+	VkDeviceSize getAllocationAlignment(uint32_t memoryTypeIndex, VkDeviceSize alignment) const;
+
+	VkResult allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkDeviceMemory& memory, void*& mappedData);
+	void freeDeviceMemory(VkDeviceMemory memory, void* mappedData);
+
+	VkResult allocateFromType(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, MemoryTiling tiling, MemoryAllocation& allocation);
+	VkResult allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, MemoryAllocation& allocation);
+	VkResult createTransientRing(MemoryUsage usage, TransientRing& transientRing);
+	VkResult flushOrInvalidate(bool invalidate, const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+	VkDevice mDevice;
+	const DeviceDispatch* mDispatch;
+	const VkAllocationCallbacks* mAllocationCallbacks;
+	DeviceMemoryAllocatorConfig mConfig;
+	VkPhysicalDeviceMemoryProperties mMemoryProperties;
+	VkDeviceSize mNonCoherentAtomSize;
+	bool mSeparateTilingPools;						// bufferImageGranularity exceeds minAllocationSize
+	uint32_t mMaxMemoryAllocationCount;
+
+	mutable std::mutex mMutex;
+	std::vector<Pool> mPools;						// per memory type and tiling, see getPoolIndex()
+	std::array<TransientRing, MemoryUsageCount> mTransientRings;
+	std::array<MemoryTypeStatistics, VK_MAX_MEMORY_TYPES> mDedicatedStatistics{};	// dedicatedCount/Bytes only
+	uint32_t mDeviceMemoryCount;
+};
@@ -0,0 +1,202 @@
+#include "DeviceSelector.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    constexpr float cGiB{ 1024.0f * 1024.0f * 1024.0f };
+
+    const char* getDeviceTypeName(VkPhysicalDeviceType deviceType)
+    {
+        switch (deviceType)
+        {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:      return "discrete GPU";
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:    return "integrated GPU";
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:       return "virtual GPU";
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:               return "CPU";
+        default:                                        return "other";
+        }
+    }
+
+    // Device type first, the other terms are unbounded (memory of a CPU device is all of the RAM)
+    // and only rank devices of the same type weight
+    bool isBetter(const DeviceScore& a, const DeviceScore& b)
+    {
+        return a.type != b.type ? a.type > b.type : a.total > b.total;
+    }
+}
+
+DeviceSelector::DeviceSelector(const DeviceSelectionCriteria& criteria)
+    : mCriteria(criteria)
+{
+}
+
+int32_t DeviceSelector::select(const std::vector<PhysicalDeviceRecord>& records)
+{
+    mScores.clear();
+    for (const PhysicalDeviceRecord& record : records)
+        mScores.push_back(score(record));
+
+    if (mCriteria.log)
+        logScores(records);
+
+    // forced device wins even if it does not qualify - the user knows better
+    if (mCriteria.forcedDeviceIndex >= 0 || !mCriteria.forcedDeviceName.empty())
+    {
+        const int32_t forcedIndex{ findForcedDevice(records) };
+
+        if (mCriteria.log)
+        {
+            if (forcedIndex < 0)
+                std::printf("Forced physical device (index %d, name \"%s\") not found\n", mCriteria.forcedDeviceIndex, mCriteria.forcedDeviceName.c_str());
+            else
+                std::printf("Selected [%d] %s: forced by DeviceSelectionCriteria\n", forcedIndex, records[forcedIndex].getProperties().deviceName);
+        }
+
+        return forcedIndex;
+    }
+
+    int32_t bestIndex{ -1 };
+    int32_t runnerUpIndex{ -1 };
+    for (int32_t i{ 0 }; i < static_cast<int32_t>(mScores.size()); ++i)
+    {
+        if (!mScores[i].eligible)
+            continue;
+
+        if (bestIndex < 0 || isBetter(mScores[i], mScores[bestIndex]))
+        {
+            runnerUpIndex = bestIndex;
+            bestIndex = i;
+        }
+        else if (runnerUpIndex < 0 || isBetter(mScores[i], mScores[runnerUpIndex]))
+            runnerUpIndex = i;
+    }
+
+    if (mCriteria.log)
+    {
+        if (bestIndex < 0)
+            std::printf("No physical device meets the selection criteria\n");
+        else if (runnerUpIndex < 0)
+            std::printf("Selected [%d] %s: only eligible device\n", bestIndex, records[bestIndex].getProperties().deviceName);
+        else
+        {
+            const DeviceScore& best = mScores[bestIndex];
+            const DeviceScore& runnerUp = mScores[runnerUpIndex];
+            std::printf("Selected [%d] %s: score %.1f vs %.1f of [%d] %s (type %+.1f, memory %+.1f, limits %+.1f, queues %+.1f)\n",
+                bestIndex, records[bestIndex].getProperties().deviceName, best.total,
+                runnerUp.total, runnerUpIndex, records[runnerUpIndex].getProperties().deviceName,
+                best.type - runnerUp.type, best.memory - runnerUp.memory, best.limits - runnerUp.limits, best.queues - runnerUp.queues);
+        }
+    }
+
+    return bestIndex;
+}
+
+std::vector<uint32_t> DeviceSelector::getRanking() const
+{
+    std::vector<uint32_t> ranking;
+    for (uint32_t i{ 0u }; i < mScores.size(); ++i)
+        if (mScores[i].eligible)
+            ranking.push_back(i);
+
+    // equal scores keep enumeration order
+    std::stable_sort(ranking.begin(), ranking.end(), [this](uint32_t a, uint32_t b) { return isBetter(mScores[a], mScores[b]); });
+
+    return ranking;
+}
+
+DeviceScore DeviceSelector::score(const PhysicalDeviceRecord& record) const
+{
+    const DeviceSelectionWeights& weights = mCriteria.weights;
+    const VkPhysicalDeviceProperties& properties = record.getProperties();
+    const VkPhysicalDeviceLimits& limits = properties.limits;
+    const VkPhysicalDeviceMemoryProperties& memoryProperties = record.getMemoryProperties();
+
+    DeviceScore score;
+
+    // hard requirements
+    bool hasRequiredQueueFamily{ false };
+    for (const VkQueueFamilyProperties& queueFamilyProperties : record.getQueueFamilyProperties())
+        hasRequiredQueueFamily |= (queueFamilyProperties.queueFlags & mCriteria.requiredQueueFlags) == mCriteria.requiredQueueFlags;
+
+    if (!hasRequiredQueueFamily)
+        score.rejectReason = "no queue family with required queue flags";
+
+    for (const std::string& extensionName : mCriteria.requiredExtensions)
+        if (score.rejectReason.empty() && !record.hasExtension(extensionName.c_str()))
+            score.rejectReason = "missing extension " + extensionName;
+
+    score.eligible = score.rejectReason.empty();
+
+    // device type
+    switch (properties.deviceType)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:      score.type = weights.discreteGpu; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:    score.type = weights.integratedGpu; break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:       score.type = weights.virtualGpu; break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:               score.type = weights.cpu; break;
+    default:                                        score.type = weights.otherType; break;
+    }
+
+    // largest device local heap
+    VkDeviceSize deviceLocalHeapSize{ 0u };
+    for (uint32_t i{ 0u }; i < memoryProperties.memoryHeapCount; ++i)
+        if ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && memoryProperties.memoryHeaps[i].size > deviceLocalHeapSize)
+            deviceLocalHeapSize = memoryProperties.memoryHeaps[i].size;
+    score.memory = weights.deviceLocalMemoryPerGiB * static_cast<float>(deviceLocalHeapSize) / cGiB;
+
+    // limits that matter for compute and offscreen rendering
+    score.limits = weights.maxComputeSharedMemoryPerKiB * static_cast<float>(limits.maxComputeSharedMemorySize) / 1024.0f
+        + weights.maxComputeWorkGroupInvocationsPer1K * static_cast<float>(limits.maxComputeWorkGroupInvocations) / 1024.0f
+        + weights.maxImageDimension2DPer1K * static_cast<float>(limits.maxImageDimension2D) / 1024.0f
+        + weights.maxStorageBufferRangePerGiB * static_cast<float>(limits.maxStorageBufferRange) / cGiB;
+
+    // queue families that allow overlapping work
+    for (const VkQueueFamilyProperties& queueFamilyProperties : record.getQueueFamilyProperties())
+    {
+        const VkQueueFlags queueFlags{ queueFamilyProperties.queueFlags };
+        const bool graphics{ (queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0u };
+        const bool compute{ (queueFlags & VK_QUEUE_COMPUTE_BIT) != 0u };
+
+        if (compute && !graphics)
+            score.queues += weights.dedicatedComputeFamily;
+        else if ((queueFlags & VK_QUEUE_TRANSFER_BIT) && !graphics && !compute)
+            score.queues += weights.dedicatedTransferFamily;
+
+        score.queues += weights.perQueue * static_cast<float>(queueFamilyProperties.queueCount);
+    }
+
+    score.total = score.type + score.memory + score.limits + score.queues;
+
+    return score;
+}
+
+int32_t DeviceSelector::findForcedDevice(const std::vector<PhysicalDeviceRecord>& records) const
+{
+    if (mCriteria.forcedDeviceIndex >= 0)
+        return mCriteria.forcedDeviceIndex < static_cast<int32_t>(records.size()) ? mCriteria.forcedDeviceIndex : -1;
+
+    for (int32_t i{ 0 }; i < static_cast<int32_t>(records.size()); ++i)
+        if (std::strstr(records[i].getProperties().deviceName, mCriteria.forcedDeviceName.c_str()))
+            return i;
+
+    return -1;
+}
+
+void DeviceSelector::logScores(const std::vector<PhysicalDeviceRecord>& records) const
+{
+    std::printf("Physical device selection:\n");
+
+    for (size_t i{ 0u }; i < records.size(); ++i)
+    {
+        const VkPhysicalDeviceProperties& properties = records[i].getProperties();
+        const DeviceScore& score = mScores[i];
+
+        std::printf("  [%zu] %s (%s): ", i, properties.deviceName, getDeviceTypeName(properties.deviceType));
+        if (score.eligible)
+            std::printf("score %.1f = type %.1f + memory %.1f + limits %.1f + queues %.1f\n", score.total, score.type, score.memory, score.limits, score.queues);
+        else
+            std::printf("rejected, %s\n", score.rejectReason.c_str());
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "PhysicalDeviceRecord.h"
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+
+/// Weights of the physical device score, each term is weight * input.
+/// The device type weight ranks first, the total only decides between devices of equal type weight.
+struct DeviceSelectionWeights
+{
+	// VkPhysicalDeviceType
+	float discreteGpu{ 1000.0f };
+	float integratedGpu{ 300.0f };
+	float virtualGpu{ 200.0f };
+	float cpu{ 10.0f };
+	float otherType{ 0.0f };
+
+	// memory - size of the largest DEVICE_LOCAL heap
+	float deviceLocalMemoryPerGiB{ 40.0f };
+
+	// VkPhysicalDeviceLimits
+	float maxComputeSharedMemoryPerKiB{ 1.0f };
+	float maxComputeWorkGroupInvocationsPer1K{ 20.0f };
+	float maxImageDimension2DPer1K{ 2.0f };
+	float maxStorageBufferRangePerGiB{ 10.0f };
+
+	// queue families
+	float dedicatedComputeFamily{ 50.0f };		// compute without graphics (async compute)
+	float dedicatedTransferFamily{ 50.0f };		// transfer without graphics and compute (copy engine)
+	float perQueue{ 2.0f };						// total number of queues over all families
+};
+
+/// What the selected device must support and how candidates are ranked
+struct DeviceSelectionCriteria
+{
+	DeviceSelectionWeights weights;
+	int32_t forcedDeviceIndex{ -1 };			// >= 0 - take this device, skip scoring
+	std::string forcedDeviceName;				// not empty - take the first device whose name contains it
+	VkQueueFlags requiredQueueFlags{ VK_QUEUE_GRAPHICS_BIT };	// some family must support all of them
+	std::vector<std::string> requiredExtensions;
+	bool log{ true };							// print scores and the reason of the choice
+};
+
+/// Score of one candidate, broken down for logging
+struct DeviceScore
+{
+	bool eligible{ false };
+	std::string rejectReason;
+	float type{ 0.0f };
+	float memory{ 0.0f };
+	float limits{ 0.0f };
+	float queues{ 0.0f };
+	float total{ 0.0f };
+};
+
+/// Pick the physical device App creates its logical device on
+class DeviceSelector
+{
+public:
+	explicit DeviceSelector(const DeviceSelectionCriteria& criteria);
+
+	/// Score all records and return index of the selected one, -1 when no device qualifies
+	int32_t select(const std::vector<PhysicalDeviceRecord>& records);
+
+	/// Scores of the last select(), same order as records
+	const std::vector<DeviceScore>& getScores() const { return mScores; }
+
+	/// Indices of the eligible devices of the last select(), best score first
+	std::vector<uint32_t> getRanking() const;
+private:
+	DeviceScore score(const PhysicalDeviceRecord& record) const;
+	int32_t findForcedDevice(const std::vector<PhysicalDeviceRecord>& records) const;
+	void logScores(const std::vector<PhysicalDeviceRecord>& records) const;
+
+	DeviceSelectionCriteria mCriteria;
+	std::vector<DeviceScore> mScores;
+};
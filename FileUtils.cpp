@@ -0,0 +1,122 @@
+#include "FileUtils.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping{ CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+    const void* view{ mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr };
+    if (!view)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mFileHandle = file;
+    mMappingHandle = mapping;
+    mData = static_cast<const uint8_t*>(view);
+    mSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+    const int file{ ::open(path.c_str(), O_RDONLY | O_CLOEXEC) };
+    if (file < 0)
+        return false;
+
+    struct stat fileStat{};
+    void* view{ MAP_FAILED };
+    if (fstat(file, &fileStat) == 0 && fileStat.st_size > 0)
+        view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+    // the mapping keeps the file alive
+    ::close(file);
+
+    if (view == MAP_FAILED)
+        return false;
+
+    mData = static_cast<const uint8_t*>(view);
+    mSize = static_cast<size_t>(fileStat.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (!mData)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mData);
+    CloseHandle(mMappingHandle);
+    CloseHandle(mFileHandle);
+    mMappingHandle = nullptr;
+    mFileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(mData), mSize);
+#endif
+
+    mData = nullptr;
+    mSize = 0u;
+}
+
+bool writeFileAtomic(const std::string& path, const void* data, size_t size)
+{
+    // temporary name is unique per process, concurrent writers do not clobber each other
+#ifdef _WIN32
+    const std::string temporaryPath{ path + ".tmp." + std::to_string(_getpid()) };
+#else
+    const std::string temporaryPath{ path + ".tmp." + std::to_string(getpid()) };
+#endif
+
+    std::FILE* file{ std::fopen(temporaryPath.c_str(), "wb") };
+    if (!file)
+        return false;
+
+    bool written{ std::fwrite(data, 1u, size, file) == size && std::fflush(file) == 0 };
+#ifndef _WIN32
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    written = std::fclose(file) == 0 && written;
+
+#ifdef _WIN32
+    written = written && MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    written = written && std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+#endif
+
+    if (!written)
+        std::remove(temporaryPath.c_str());
+
+    return written;
+}
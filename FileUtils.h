@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/// Map path, false when the file does not exist, is empty or cannot be mapped
+	bool open(const std::string& path);
+	void close();
+
+	const uint8_t* data() const { return mData; }
+	size_t size() const { return mSize; }
+	bool isOpen() const { return mData != nullptr; }
+private:
+	const uint8_t* mData{ nullptr };
+	size_t mSize{ 0u };
+#ifdef _WIN32
+	void* mFileHandle{ nullptr };
+	void* mMappingHandle{ nullptr };
+#endif
+};
+
+/// Write size bytes to a temporary file next to path and rename it over path,
+/// readers (and other processes) see either the old or the new file, never a partial one
+bool writeFileAtomic(const std::string& path, const void* data, size_t size);
@@ -0,0 +1,547 @@
+#include "HeadlessRenderer.h"
+#include "FileUtils.h"
+#include <algorithm>
+#include <cstdio>
+
+HeadlessRenderer::HeadlessRenderer()
+    : mDevice(VK_NULL_HANDLE)
+    , mDispatch(nullptr)
+    , mAllocator(nullptr)
+    , mAllocationCallbacks(nullptr)
+    , mQueue(VK_NULL_HANDLE)
+    , mQueueFamilyIndex(0u)
+    , mProfiler(nullptr)
+    , mQueueMutex(nullptr)
+    , mRowPitch(0u)
+    , mRenderPass(VK_NULL_HANDLE)
+    , mCommandPool(VK_NULL_HANDLE)
+    , mFrameIndex(0u)
+{
+}
+
+VkResult HeadlessRenderer::init(VkDevice device, const DeviceDispatch& dispatch, DeviceMemoryAllocator& allocator, uint32_t queueFamilyIndex,
+    VkQueue queue, const VkAllocationCallbacks* allocationCallbacks, const HeadlessRendererConfig& config)
+{
+    // 1) create render pass - clear, render, leave the image ready to be copied
+    // 2) create command pool
+    // 3) per frame in flight: color image, view, framebuffer, mapped readback buffer, command buffer, fence
+
+    VkResult result = VK_SUCCESS;
+
+    const uint32_t texelSize{ getTexelSize(config.format) };
+    if (config.framesInFlight == 0u || config.width == 0u || config.height == 0u)
+        return VK_ERROR_INITIALIZATION_FAILED;
+    if (texelSize == 0u)
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+
+    mDevice = device;
+    mDispatch = &dispatch;
+    mAllocator = &allocator;
+    mAllocationCallbacks = allocationCallbacks;
+    mQueue = queue;
+    mQueueFamilyIndex = queueFamilyIndex;
+    mConfig = config;
+    mRowPitch = static_cast<VkDeviceSize>(config.width) * texelSize;
+    mFrameIndex = 0u;
+    mStatistics = HeadlessRendererStatistics{};
+
+    const VkAttachmentDescription attachmentDescription = {
+        0u,                                     // VkAttachmentDescriptionFlags flags;          // no aliasing
+        mConfig.format,                         // VkFormat format;                             // format of the color images
+        VK_SAMPLE_COUNT_1_BIT,                  // VkSampleCountFlagBits samples;               // no multisampling, copied as is
+        VK_ATTACHMENT_LOAD_OP_CLEAR,            // VkAttachmentLoadOp loadOp;                   // every frame starts from clearColor
+        VK_ATTACHMENT_STORE_OP_STORE,           // VkAttachmentStoreOp storeOp;                 // read back after the render pass
+        VK_ATTACHMENT_LOAD_OP_DONT_CARE,        // VkAttachmentLoadOp stencilLoadOp;            // no stencil
+        VK_ATTACHMENT_STORE_OP_DONT_CARE,       // VkAttachmentStoreOp stencilStoreOp;
+        VK_IMAGE_LAYOUT_UNDEFINED,              // VkImageLayout initialLayout;                 // previous contents are cleared anyway
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL    // VkImageLayout finalLayout;                   // source of the readback copy
+    };
+
+    const VkAttachmentReference colorAttachment = {
+        0u,                                     // uint32_t attachment;                         // the color image
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL // VkImageLayout layout;                       // while rendering
+    };
+
+    const VkSubpassDescription subpassDescription = {
+        0u,                                     // VkSubpassDescriptionFlags flags;
+        VK_PIPELINE_BIND_POINT_GRAPHICS,        // VkPipelineBindPoint pipelineBindPoint;       // graphics pipelines
+        0u,                                     // uint32_t inputAttachmentCount;
+        nullptr,                                // const VkAttachmentReference* pInputAttachments;
+        1u,                                     // uint32_t colorAttachmentCount;               // layout(location = 0) out
+        &colorAttachment,                       // const VkAttachmentReference* pColorAttachments;
+        nullptr,                                // const VkAttachmentReference* pResolveAttachments; // no multisampling
+        nullptr,                                // const VkAttachmentReference* pDepthStencilAttachment; // no depth
+        0u,                                     // uint32_t preserveAttachmentCount;
+        nullptr                                 // const uint32_t* pPreserveAttachments;
+    };
+
+    const VkSubpassDependency subpassDependencies[] = {
+        {
+            VK_SUBPASS_EXTERNAL,                // uint32_t srcSubpass;                         // readback copy of the previous frame in the slot
+            0u,                                 // uint32_t dstSubpass;
+            VK_PIPELINE_STAGE_TRANSFER_BIT,     // VkPipelineStageFlags srcStageMask;           // copy has to finish reading...
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // VkPipelineStageFlags dstStageMask; // ...before the clear overwrites the image
+            0u,                                 // VkAccessFlags srcAccessMask;                 // write after read - execution dependency only
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, // VkAccessFlags dstAccessMask;
+            0u                                  // VkDependencyFlags dependencyFlags;
+        },
+        {
+            0u,                                 // uint32_t srcSubpass;
+            VK_SUBPASS_EXTERNAL,                // uint32_t dstSubpass;                         // readback copy of this frame
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // VkPipelineStageFlags srcStageMask; // rendering has to finish...
+            VK_PIPELINE_STAGE_TRANSFER_BIT,     // VkPipelineStageFlags dstStageMask;           // ...before the copy
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, // VkAccessFlags srcAccessMask;
+            VK_ACCESS_TRANSFER_READ_BIT,        // VkAccessFlags dstAccessMask;
+            0u                                  // VkDependencyFlags dependencyFlags;
+        }
+    };
+
+    const VkRenderPassCreateInfo renderPassCreateInfo = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO, // VkStructureType sType;                    // type of render pass create info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        0u,                                     // VkRenderPassCreateFlags flags;               // reserved
+        1u,                                     // uint32_t attachmentCount;                    // color only
+        &attachmentDescription,                 // const VkAttachmentDescription* pAttachments;
+        1u,                                     // uint32_t subpassCount;
+        &subpassDescription,                    // const VkSubpassDescription* pSubpasses;
+        2u,                                     // uint32_t dependencyCount;                    // previous copy -> render -> copy
+        subpassDependencies                     // const VkSubpassDependency* pDependencies;
+    };
+
+    result = mDispatch->vkCreateRenderPass(mDevice, &renderPassCreateInfo, mAllocationCallbacks, &mRenderPass);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkCommandPoolCreateInfo commandPoolCreateInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, // VkStructureType sType;               // type of command pool create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, // VkCommandPoolCreateFlags flags; // re-recorded every frame, reset one by one
+            queueFamilyIndex                    // uint32_t queueFamilyIndex;                   // family of the graphics queue
+        };
+
+        result = mDispatch->vkCreateCommandPool(mDevice, &commandPoolCreateInfo, mAllocationCallbacks, &mCommandPool);
+    }
+
+    mFrames.resize(mConfig.framesInFlight);
+    for (Frame& frame : mFrames)
+        if (result == VK_SUCCESS)
+            result = createFrame(frame);
+
+    return result;
+}
+
+void HeadlessRenderer::deinit()
+{
+    if (mDevice == VK_NULL_HANDLE)
+        return;
+
+    for (Frame& frame : mFrames)
+    {
+        if (frame.submitted)
+            mDispatch->vkWaitForFences(mDevice, 1u, &frame.fence, VK_TRUE, UINT64_MAX);
+
+        if (frame.fence != VK_NULL_HANDLE)
+            mDispatch->vkDestroyFence(mDevice, frame.fence, mAllocationCallbacks);
+        if (frame.readbackBuffer != VK_NULL_HANDLE)
+            mAllocator->destroyBuffer(frame.readbackBuffer, frame.readbackAllocation);
+        if (frame.framebuffer != VK_NULL_HANDLE)
+            mDispatch->vkDestroyFramebuffer(mDevice, frame.framebuffer, mAllocationCallbacks);
+        if (frame.imageView != VK_NULL_HANDLE)
+            mDispatch->vkDestroyImageView(mDevice, frame.imageView, mAllocationCallbacks);
+        if (frame.image != VK_NULL_HANDLE)
+            mAllocator->destroyImage(frame.image, frame.imageAllocation);
+    }
+    mFrames.clear();
+
+    if (mCommandPool != VK_NULL_HANDLE)
+        mDispatch->vkDestroyCommandPool(mDevice, mCommandPool, mAllocationCallbacks); // frees the command buffers too
+    if (mRenderPass != VK_NULL_HANDLE)
+        mDispatch->vkDestroyRenderPass(mDevice, mRenderPass, mAllocationCallbacks);
+
+    mCommandPool = VK_NULL_HANDLE;
+    mRenderPass = VK_NULL_HANDLE;
+
+    mDevice = VK_NULL_HANDLE;
+}
+
+VkResult HeadlessRenderer::renderFrame(const RecordFunction& record, OutputFunction output)
+{
+    VkResult result = VK_SUCCESS;
+
+    MK_PROFILE_CPU_ZONE(mProfiler, "HeadlessRenderer::renderFrame");
+
+    const Clock::time_point start{ Clock::now() };
+    Frame& frame = mFrames[mFrameIndex % mFrames.size()];
+
+    // oldest frame, the newer ones keep the device busy meanwhile
+    result = readbackFrame(frame);
+
+    if (result == VK_SUCCESS)
+        result = recordFrame(frame, record);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,      // VkStructureType sType;                       // type of submit info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // uint32_t waitSemaphoreCount;
+            nullptr,                            // const VkSemaphore* pWaitSemaphores;
+            nullptr,                            // const VkPipelineStageFlags* pWaitDstStageMask;
+            1u,                                 // uint32_t commandBufferCount;                 // render pass + readback copy
+            &frame.commandBuffer,               // const VkCommandBuffer* pCommandBuffers;
+            0u,                                 // uint32_t signalSemaphoreCount;               // completion is tracked by the fence
+            nullptr                             // const VkSemaphore* pSignalSemaphores;
+        };
+
+        std::unique_lock<std::mutex> queueLock;
+        if (mQueueMutex)
+            queueLock = std::unique_lock<std::mutex>(*mQueueMutex);
+
+        result = mDispatch->vkQueueSubmit(mQueue, 1u, &submitInfo, frame.fence);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        frame.submitted = true;
+        frame.index = mFrameIndex++;
+        frame.start = start;
+        frame.output = std::move(output);
+        ++mStatistics.frameCount;
+    }
+
+    return result;
+}
+
+VkResult HeadlessRenderer::flush()
+{
+    VkResult result = VK_SUCCESS;
+
+    // oldest first, the slot of the next frame holds the oldest one
+    for (size_t i{ 0u }; result == VK_SUCCESS && i < mFrames.size(); ++i)
+        result = readbackFrame(mFrames[(mFrameIndex + i) % mFrames.size()]);
+
+    return result;
+}
+
+uint32_t HeadlessRenderer::getTexelSize(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        return 4u;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return 8u;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16u;
+    default:
+        return 0u;
+    }
+}
+
+bool HeadlessRenderer::writePpm(const std::string& path, const HeadlessFrame& frame)
+{
+    // PPM has no alpha and fixed RGB order, the texels are converted - use writeRaw() for the unmodified frame
+    bool bgra{ false };
+    switch (frame.format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        break;
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        bgra = true;
+        break;
+    default:
+        return false;
+    }
+
+    char header[64];
+    const int headerSize{ std::snprintf(header, sizeof(header), "P6\n%u %u\n255\n", frame.width, frame.height) };
+
+    std::vector<uint8_t> data(static_cast<size_t>(headerSize) + static_cast<size_t>(frame.width) * frame.height * 3u);
+    std::copy(header, header + headerSize, data.begin());
+
+    uint8_t* dst{ data.data() + headerSize };
+    for (uint32_t y{ 0u }; y < frame.height; ++y)
+    {
+        const uint8_t* src{ frame.data + y * frame.rowPitch };
+        for (uint32_t x{ 0u }; x < frame.width; ++x, src += 4u, dst += 3u)
+        {
+            dst[0] = src[bgra ? 2u : 0u];
+            dst[1] = src[1];
+            dst[2] = src[bgra ? 0u : 2u];
+        }
+    }
+
+    return writeFileAtomic(path, data.data(), data.size());
+}
+
+bool HeadlessRenderer::writeRaw(const std::string& path, const HeadlessFrame& frame)
+{
+    // straight from the mapped readback buffer
+    return writeFileAtomic(path, frame.data, static_cast<size_t>(frame.size));
+}
+
+VkResult HeadlessRenderer::createFrame(Frame& frame)
+{
+    VkResult result = VK_SUCCESS;
+
+    const VkImageCreateInfo imageCreateInfo = {
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,    // VkStructureType sType;                       // type of image create info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        0u,                                     // VkImageCreateFlags flags;                    // no sparse binding, no aliasing
+        VK_IMAGE_TYPE_2D,                       // VkImageType imageType;
+        mConfig.format,                         // VkFormat format;                             // color target format
+        { mConfig.width, mConfig.height, 1u },  // VkExtent3D extent;
+        1u,                                     // uint32_t mipLevels;
+        1u,                                     // uint32_t arrayLayers;
+        VK_SAMPLE_COUNT_1_BIT,                  // VkSampleCountFlagBits samples;
+        VK_IMAGE_TILING_OPTIMAL,                // VkImageTiling tiling;                        // fastest to render, the copy untiles it
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, // VkImageUsageFlags usage; // rendered, then copied to the readback buffer
+        VK_SHARING_MODE_EXCLUSIVE,              // VkSharingMode sharingMode;                   // used by the graphics queue only
+        0u,                                     // uint32_t queueFamilyIndexCount;              // (concurrent sharing only)
+        nullptr,                                // const uint32_t* pQueueFamilyIndices;         // (concurrent sharing only)
+        VK_IMAGE_LAYOUT_UNDEFINED               // VkImageLayout initialLayout;                 // the render pass clears it
+    };
+
+    result = mAllocator->createImage(imageCreateInfo, MemoryUsage::GpuOnly, frame.image, frame.imageAllocation);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkImageViewCreateInfo imageViewCreateInfo = {
+            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, // VkStructureType sType;                 // type of image view create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // VkImageViewCreateFlags flags;
+            frame.image,                        // VkImage image;
+            VK_IMAGE_VIEW_TYPE_2D,              // VkImageViewType viewType;
+            mConfig.format,                     // VkFormat format;                             // same as the image
+            {
+                VK_COMPONENT_SWIZZLE_IDENTITY,  // VkComponentSwizzle r;
+                VK_COMPONENT_SWIZZLE_IDENTITY,  // VkComponentSwizzle g;
+                VK_COMPONENT_SWIZZLE_IDENTITY,  // VkComponentSwizzle b;
+                VK_COMPONENT_SWIZZLE_IDENTITY   // VkComponentSwizzle a;
+            },                                  // VkComponentMapping components;
+            {
+                VK_IMAGE_ASPECT_COLOR_BIT,      // VkImageAspectFlags aspectMask;
+                0u,                             // uint32_t baseMipLevel;
+                1u,                             // uint32_t levelCount;
+                0u,                             // uint32_t baseArrayLayer;
+                1u                              // uint32_t layerCount;
+            }                                   // VkImageSubresourceRange subresourceRange;
+        };
+
+        result = mDispatch->vkCreateImageView(mDevice, &imageViewCreateInfo, mAllocationCallbacks, &frame.imageView);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkFramebufferCreateInfo framebufferCreateInfo = {
+            VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO, // VkStructureType sType;                // type of framebuffer create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // VkFramebufferCreateFlags flags;              // not imageless
+            mRenderPass,                        // VkRenderPass renderPass;
+            1u,                                 // uint32_t attachmentCount;
+            &frame.imageView,                   // const VkImageView* pAttachments;
+            mConfig.width,                      // uint32_t width;
+            mConfig.height,                     // uint32_t height;
+            1u                                  // uint32_t layers;
+        };
+
+        result = mDispatch->vkCreateFramebuffer(mDevice, &framebufferCreateInfo, mAllocationCallbacks, &frame.framebuffer);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkBufferCreateInfo bufferCreateInfo = {
+            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,   // VkStructureType sType;                   // type of buffer create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // VkBufferCreateFlags flags;                   // no sparse binding
+            mRowPitch * mConfig.height,         // VkDeviceSize size;                           // tightly packed rows
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,   // VkBufferUsageFlags usage;                    // destination of the readback copy
+            VK_SHARING_MODE_EXCLUSIVE,          // VkSharingMode sharingMode;                   // used by the graphics queue only
+            0u,                                 // uint32_t queueFamilyIndexCount;              // (concurrent sharing only)
+            nullptr                             // const uint32_t* pQueueFamilyIndices;         // (concurrent sharing only)
+        };
+
+        // host cached when available - the host reads every texel, uncached reads are slow
+        result = mAllocator->createBuffer(bufferCreateInfo, MemoryUsage::GpuToCpu, frame.readbackBuffer, frame.readbackAllocation);
+
+        if (result == VK_SUCCESS && !frame.readbackAllocation.mappedData)
+            result = VK_ERROR_MEMORY_MAP_FAILED;
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, // VkStructureType sType;           // type of command buffer allocate info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            mCommandPool,                       // VkCommandPool commandPool;                   // pool to allocate from
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,    // VkCommandBufferLevel level;                  // submitted directly
+            1u                                  // uint32_t commandBufferCount;                 // one per frame in flight
+        };
+
+        result = mDispatch->vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &frame.commandBuffer);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkFenceCreateInfo fenceCreateInfo = {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,    // VkStructureType sType;                   // type of fence create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u                                  // VkFenceCreateFlags flags;                    // unsignaled, signaled by the frame submission
+        };
+
+        result = mDispatch->vkCreateFence(mDevice, &fenceCreateInfo, mAllocationCallbacks, &frame.fence);
+    }
+
+    return result;
+}
+
+VkResult HeadlessRenderer::recordFrame(Frame& frame, const RecordFunction& record)
+{
+    VkResult result = VK_SUCCESS;
+
+    result = mDispatch->vkResetCommandBuffer(frame.commandBuffer, 0u);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, // VkStructureType sType;              // type of command buffer begin info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // VkCommandBufferUsageFlags flags;    // re-recorded for every frame
+            nullptr                             // const VkCommandBufferInheritanceInfo* pInheritanceInfo; // (secondaries only)
+        };
+
+        result = mDispatch->vkBeginCommandBuffer(frame.commandBuffer, &commandBufferBeginInfo);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        MK_PROFILE_GPU_ZONE(mProfiler, frame.commandBuffer, mQueueFamilyIndex, "HeadlessRenderer render pass");
+
+        VkClearValue clearValue;
+        clearValue.color = mConfig.clearColor;
+
+        const VkRenderPassBeginInfo renderPassBeginInfo = {
+            VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO, // VkStructureType sType;                 // type of render pass begin info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            mRenderPass,                        // VkRenderPass renderPass;
+            frame.framebuffer,                  // VkFramebuffer framebuffer;                   // color image of the slot
+            { { 0, 0 }, { mConfig.width, mConfig.height } }, // VkRect2D renderArea;            // whole image
+            1u,                                 // uint32_t clearValueCount;
+            &clearValue                         // const VkClearValue* pClearValues;
+        };
+
+        mDispatch->vkCmdBeginRenderPass(frame.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        const VkViewport viewport = {
+            0.0f,                               // float x;
+            0.0f,                               // float y;
+            static_cast<float>(mConfig.width),  // float width;
+            static_cast<float>(mConfig.height), // float height;
+            0.0f,                               // float minDepth;
+            1.0f                                // float maxDepth;
+        };
+        const VkRect2D scissor{ { 0, 0 }, { mConfig.width, mConfig.height } };
+
+        // ignored by pipelines with static viewport/scissor
+        mDispatch->vkCmdSetViewport(frame.commandBuffer, 0u, 1u, &viewport);
+        mDispatch->vkCmdSetScissor(frame.commandBuffer, 0u, 1u, &scissor);
+
+        if (record)
+            record(frame.commandBuffer, mFrameIndex);
+
+        mDispatch->vkCmdEndRenderPass(frame.commandBuffer);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        MK_PROFILE_GPU_ZONE(mProfiler, frame.commandBuffer, mQueueFamilyIndex, "HeadlessRenderer readback copy");
+
+        const VkBufferImageCopy bufferImageCopy = {
+            0u,                                 // VkDeviceSize bufferOffset;
+            0u,                                 // uint32_t bufferRowLength;                    // 0 - tightly packed
+            0u,                                 // uint32_t bufferImageHeight;                  // 0 - tightly packed
+            {
+                VK_IMAGE_ASPECT_COLOR_BIT,      // VkImageAspectFlags aspectMask;
+                0u,                             // uint32_t mipLevel;
+                0u,                             // uint32_t baseArrayLayer;
+                1u                              // uint32_t layerCount;
+            },                                  // VkImageSubresourceLayers imageSubresource;
+            { 0, 0, 0 },                        // VkOffset3D imageOffset;
+            { mConfig.width, mConfig.height, 1u } // VkExtent3D imageExtent;                    // whole image
+        };
+
+        mDispatch->vkCmdCopyImageToBuffer(frame.commandBuffer, frame.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.readbackBuffer, 1u, &bufferImageCopy);
+
+        const VkBufferMemoryBarrier bufferMemoryBarrier = {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, // VkStructureType sType;                  // type of buffer memory barrier structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_ACCESS_TRANSFER_WRITE_BIT,       // VkAccessFlags srcAccessMask;                 // the copy...
+            VK_ACCESS_HOST_READ_BIT,            // VkAccessFlags dstAccessMask;                 // ...is visible to the host once the fence is signaled
+            VK_QUEUE_FAMILY_IGNORED,            // uint32_t srcQueueFamilyIndex;                // no ownership transfer
+            VK_QUEUE_FAMILY_IGNORED,            // uint32_t dstQueueFamilyIndex;
+            frame.readbackBuffer,               // VkBuffer buffer;
+            0u,                                 // VkDeviceSize offset;
+            VK_WHOLE_SIZE                       // VkDeviceSize size;
+        };
+
+        mDispatch->vkCmdPipelineBarrier(frame.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0u,
+            0u, nullptr, 1u, &bufferMemoryBarrier, 0u, nullptr);
+    }
+
+    if (result == VK_SUCCESS)
+        result = mDispatch->vkEndCommandBuffer(frame.commandBuffer);
+
+    return result;
+}
+
+VkResult HeadlessRenderer::readbackFrame(Frame& frame)
+{
+    VkResult result = VK_SUCCESS;
+
+    if (!frame.submitted)
+        return VK_SUCCESS;
+
+    MK_PROFILE_CPU_ZONE(mProfiler, "HeadlessRenderer::readbackFrame");
+
+    const Clock::time_point waitStart{ Clock::now() };
+    result = mDispatch->vkWaitForFences(mDevice, 1u, &frame.fence, VK_TRUE, UINT64_MAX);
+    mStatistics.waitTime += Clock::now() - waitStart;
+
+    if (result == VK_SUCCESS)
+        result = mDispatch->vkResetFences(mDevice, 1u, &frame.fence);
+
+    // no-op for host coherent memory
+    if (result == VK_SUCCESS)
+        result = mAllocator->invalidate(frame.readbackAllocation);
+
+    if (result == VK_SUCCESS)
+    {
+        frame.submitted = false;
+
+        HeadlessFrame output;
+        output.index = frame.index;
+        output.width = mConfig.width;
+        output.height = mConfig.height;
+        output.format = mConfig.format;
+        output.data = static_cast<const uint8_t*>(frame.readbackAllocation.mappedData);
+        output.rowPitch = mRowPitch;
+        output.size = mRowPitch * mConfig.height;
+        output.latency = Clock::now() - frame.start;
+
+        if (frame.output)
+            frame.output(output);
+        frame.output = nullptr;
+
+        ++mStatistics.readbackCount;
+        mStatistics.bytesReadBack += output.size;
+        mStatistics.totalLatency += output.latency;
+        mStatistics.maxLatency = std::max(mStatistics.maxLatency, output.latency);
+    }
+
+    return result;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "DeviceMemoryAllocator.h"
+#include "Profiler.h"
+#include "VulkanDispatch.h"
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct HeadlessRendererConfig
+{
+	uint32_t width{ 1280u };
+	uint32_t height{ 720u };
+	uint32_t framesInFlight{ 2u };				// frames rendered while older ones are read back (0 - no renderer, 1 - synchronous)
+	VkFormat format{ VK_FORMAT_R8G8B8A8_UNORM };	// color target, read back as is (8 bit RGBA/BGRA, 16/32 bit float RGBA)
+	VkClearColorValue clearColor{ { 0.0f, 0.0f, 0.0f, 1.0f } };
+};
+
+/// Frame read back to the host. data points into the persistently mapped
+/// readback buffer and is valid during the output function only.
+struct HeadlessFrame
+{
+	uint64_t index{ 0u };						// renderFrame() call counter
+	uint32_t width{ 0u };
+	uint32_t height{ 0u };
+	VkFormat format{ VK_FORMAT_UNDEFINED };
+	const uint8_t* data{ nullptr };				// first row, rows are tightly packed
+	VkDeviceSize rowPitch{ 0u };
+	VkDeviceSize size{ 0u };					// rowPitch * height
+	std::chrono::nanoseconds latency{ 0 };		// renderFrame() call to output
+};
+
+/// Counters since init()
+struct HeadlessRendererStatistics
+{
+	uint64_t frameCount{ 0u };					// submitted by renderFrame()
+	uint64_t readbackCount{ 0u };				// waited for and passed to their output functions
+	uint64_t bytesReadBack{ 0u };
+	std::chrono::nanoseconds totalLatency{ 0 };	// sum of HeadlessFrame::latency
+	std::chrono::nanoseconds maxLatency{ 0 };
+	std::chrono::nanoseconds waitTime{ 0 };		// host blocked on frames still executing
+};
+
+/// Renders frames without a window into an offscreen color image. Each frame
+/// in flight has its own image, command buffer, fence and readback buffer in
+/// host visible (preferably cached) memory that stays mapped. The image is
+/// copied to the buffer in the frame's command buffer, the host reads it in
+/// place - no extra CPU copy. A frame slot is read back when it is reused, so
+/// with framesInFlight 2 the readback of frame N overlaps rendering of frame N+1.
+/// Typical use: renderFrame() ..., flush().
+/// Not thread safe. Other objects submitting to the queue from other threads
+/// must do so under the lock of setQueueMutex().
+class HeadlessRenderer
+{
+public:
+	/// Record draw commands of frameIndex, called inside the render pass with viewport and scissor covering the image
+	using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, uint64_t frameIndex)>;
+
+	/// Consume a frame read back, called from renderFrame() or flush() in frame order
+	using OutputFunction = std::function<void(const HeadlessFrame& frame)>;
+
+	HeadlessRenderer();
+
+	HeadlessRenderer(const HeadlessRenderer&) = delete;
+	HeadlessRenderer& operator=(const HeadlessRenderer&) = delete;
+
+	/// Create render pass, color images, framebuffers, readback buffers, command buffers and fences for queue of queueFamilyIndex
+	VkResult init(VkDevice device, const DeviceDispatch& dispatch, DeviceMemoryAllocator& allocator, uint32_t queueFamilyIndex,
+		VkQueue queue, const VkAllocationCallbacks* allocationCallbacks, const HeadlessRendererConfig& config = HeadlessRendererConfig{});
+
+	/// Wait for submitted frames (their output functions are not called) and destroy all objects
+	void deinit();
+
+	/// Render a frame with record and submit it. When its frame slot is still
+	/// in use the oldest frame is waited for and passed to its output function
+	/// first. output may be empty - the frame is rendered but not consumed.
+	VkResult renderFrame(const RecordFunction& record, OutputFunction output);
+
+	/// Wait for all submitted frames and pass them to their output functions
+	VkResult flush();
+
+	/// Record CPU zones of renderFrame() and GPU zones of the render pass and readback copy into profiler (nullptr - none)
+	void setProfiler(Profiler* profiler) { mProfiler = profiler; }
+
+	/// Lock held around submissions when other objects submit to the same queue (nullptr - queue not shared)
+	void setQueueMutex(std::mutex* queueMutex) { mQueueMutex = queueMutex; }
+
+	/// Render pass of the color target, pipelines used in record functions must be compatible
+	VkRenderPass getRenderPass() const { return mRenderPass; }
+
+	uint32_t getWidth() const { return mConfig.width; }
+	uint32_t getHeight() const { return mConfig.height; }
+	VkFormat getFormat() const { return mConfig.format; }
+
+	const HeadlessRendererStatistics& getStatistics() const { return mStatistics; }
+
+	/// Bytes per texel of the formats supported as color target, 0 for other formats
+	static uint32_t getTexelSize(VkFormat format);
+
+	/// Write frame as binary PPM (8 bit RGBA/BGRA formats only, alpha is dropped)
+	static bool writePpm(const std::string& path, const HeadlessFrame& frame);
+
+	/// Write the texels of frame as they are, rows tightly packed
+	static bool writeRaw(const std::string& path, const HeadlessFrame& frame);
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Frame
+	{
+		VkImage image{ VK_NULL_HANDLE };
+		MemoryAllocation imageAllocation;
+		VkImageView imageView{ VK_NULL_HANDLE };
+		VkFramebuffer framebuffer{ VK_NULL_HANDLE };
+		VkBuffer readbackBuffer{ VK_NULL_HANDLE };
+		MemoryAllocation readbackAllocation;	// mapped for its lifetime
+		VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+		VkFence fence{ VK_NULL_HANDLE };
+		bool submitted{ false };				// fence is signaled by a submission not read back yet
+		uint64_t index{ 0u };
+		Clock::time_point start;				// renderFrame() call
+		OutputFunction output;
+	};
+
+	VkResult createFrame(Frame& frame);
+	VkResult recordFrame(Frame& frame, const RecordFunction& record);
+	VkResult readbackFrame(Frame& frame);
+
+	VkDevice mDevice;
+	const DeviceDispatch* mDispatch;
+	DeviceMemoryAllocator* mAllocator;
+	const VkAllocationCallbacks* mAllocationCallbacks;
+	VkQueue mQueue;
+	uint32_t mQueueFamilyIndex;
+	Profiler* mProfiler;
+	std::mutex* mQueueMutex;
+	HeadlessRendererConfig mConfig;
+	VkDeviceSize mRowPitch;
+
+	VkRenderPass mRenderPass;
+	VkCommandPool mCommandPool;
+	std::vector<Frame> mFrames;
+	uint64_t mFrameIndex;						// index of the next frame, its slot is mFrameIndex % framesInFlight
+
+	HeadlessRendererStatistics mStatistics;
+};
@@ -0,0 +1,475 @@
+#include "HostAllocator.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    // Placed right before every pointer returned to the driver
+    struct AllocationHeader
+    {
+        uint64_t size;                          // requested size
+        uint32_t offset;                        // distance from start of the underlying block to the returned pointer
+        HostAllocationMode mode;                // strategy that owns the block
+        uint8_t sizeClass;                      // pool size class (Pool mode only)
+        uint8_t scope;                          // VkSystemAllocationScope of the allocation
+        uint8_t reserved;
+    };
+    static_assert(sizeof(AllocationHeader) == 16u, "AllocationHeader must keep 16 byte alignment of returned pointers");
+
+    constexpr size_t cBlockAlignment{ 16u };    // every block start (chunk, slab slot, system block) is aligned to this
+    constexpr size_t cMinPoolBlockSize{ 32u };
+
+    const char* const cScopeNames[HostAllocationScopeCount]{ "COMMAND", "OBJECT", "CACHE", "DEVICE", "INSTANCE" };
+    const char* const cModeNames[]{ "arena", "pool", "system" };
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1u) & ~(alignment - 1u);
+    }
+
+    AllocationHeader* getHeader(void* memory)
+    {
+        return reinterpret_cast<AllocationHeader*>(static_cast<uint8_t*>(memory) - sizeof(AllocationHeader));
+    }
+
+    // Bytes needed from a cBlockAlignment aligned block to hold header, padding and payload
+    size_t getFootprint(size_t size, size_t alignment)
+    {
+        return sizeof(AllocationHeader) + (alignment > cBlockAlignment ? alignment - cBlockAlignment : 0u) + size;
+    }
+
+    uint8_t* systemAllocate(size_t size)
+    {
+#ifdef _WIN32
+        return static_cast<uint8_t*>(_aligned_malloc(size, cBlockAlignment));
+#else
+        return static_cast<uint8_t*>(std::aligned_alloc(cBlockAlignment, alignUp(size, cBlockAlignment)));
+#endif
+    }
+
+    void systemFree(void* memory)
+    {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+
+    // counters of in use bytes do not wrap when the driver reports more frees than allocations
+    void subtractClamped(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        uint64_t current{ counter.load(std::memory_order_relaxed) };
+        while (!counter.compare_exchange_weak(current, current - std::min(current, value), std::memory_order_relaxed))
+            ;
+    }
+}
+
+HostAllocator::HostAllocator(const HostAllocatorConfig& config)
+    : mConfig(config)
+{
+    mAllocationCallbacks = {
+        this,                                   // void* pUserData;                             // passed as first parameter to all callbacks
+        &allocationFunction,                    // PFN_vkAllocationFunction pfnAllocation;      // allocate aligned host memory
+        &reallocationFunction,                  // PFN_vkReallocationFunction pfnReallocation;  // resize allocation (may move it)
+        &freeFunction,                          // PFN_vkFreeFunction pfnFree;                  // release allocation
+        &internalAllocationNotification,        // PFN_vkInternalAllocationNotification pfnInternalAllocation; // driver allocated memory on its own (informational)
+        &internalFreeNotification               // PFN_vkInternalFreeNotification pfnInternalFree; // driver released memory on its own (informational)
+    };
+
+    mConfig.arenaChunkSize = alignUp(std::max<size_t>(mConfig.arenaChunkSize, cBlockAlignment), cBlockAlignment);
+}
+
+HostAllocator::~HostAllocator()
+{
+    reset();
+}
+
+HostAllocationStatistics HostAllocator::getStatistics(VkSystemAllocationScope scope) const
+{
+    const ScopeCounters& counters = mCounters[static_cast<size_t>(scope)];
+
+    HostAllocationStatistics statistics;
+    statistics.allocationCount = counters.allocationCount.load(std::memory_order_relaxed);
+    statistics.reallocationCount = counters.reallocationCount.load(std::memory_order_relaxed);
+    statistics.freeCount = counters.freeCount.load(std::memory_order_relaxed);
+    statistics.bytesRequested = counters.bytesRequested.load(std::memory_order_relaxed);
+    statistics.bytesInUse = counters.bytesInUse.load(std::memory_order_relaxed);
+    statistics.peakBytesInUse = counters.peakBytesInUse.load(std::memory_order_relaxed);
+    statistics.internalAllocationCount = counters.internalAllocationCount.load(std::memory_order_relaxed);
+    statistics.internalBytesInUse = counters.internalBytesInUse.load(std::memory_order_relaxed);
+
+    return statistics;
+}
+
+void HostAllocator::printSummary() const
+{
+    std::printf("HostAllocator summary\n");
+    std::printf("%-9s %-7s %10s %10s %10s %14s %12s %12s %10s %12s\n",
+        "scope", "mode", "allocs", "reallocs", "frees", "requested B", "in use B", "peak B", "internal", "internal B");
+
+    for (size_t i{ 0u }; i < HostAllocationScopeCount; ++i)
+    {
+        const HostAllocationStatistics statistics{ getStatistics(static_cast<VkSystemAllocationScope>(i)) };
+        std::printf("%-9s %-7s %10llu %10llu %10llu %14llu %12llu %12llu %10llu %12llu\n",
+            cScopeNames[i],
+            cModeNames[static_cast<size_t>(mConfig.scopeModes[i])],
+            static_cast<unsigned long long>(statistics.allocationCount),
+            static_cast<unsigned long long>(statistics.reallocationCount),
+            static_cast<unsigned long long>(statistics.freeCount),
+            static_cast<unsigned long long>(statistics.bytesRequested),
+            static_cast<unsigned long long>(statistics.bytesInUse),
+            static_cast<unsigned long long>(statistics.peakBytesInUse),
+            static_cast<unsigned long long>(statistics.internalAllocationCount),
+            static_cast<unsigned long long>(statistics.internalBytesInUse));
+    }
+
+    size_t poolSlabCount{ 0u };
+    uint64_t poolBlockCount{ 0u };
+    for (Pool& pool : mPools)
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        poolSlabCount += pool.slabs.size();
+        poolBlockCount += pool.blockCount;
+    }
+
+    std::lock_guard<std::mutex> lock(mArenaMutex);
+    std::printf("arena: %zu chunks x %zu B + %zu dedicated (%llu B), pool: %zu slabs / %llu blocks, system: %llu B\n",
+        mArena.chunks.size(), mConfig.arenaChunkSize, mArena.dedicatedChunks.size(),
+        static_cast<unsigned long long>(mArena.dedicatedBytes),
+        poolSlabCount, static_cast<unsigned long long>(poolBlockCount),
+        static_cast<unsigned long long>(mSystemBytes.load(std::memory_order_relaxed)));
+}
+
+void HostAllocator::reset()
+{
+    {
+        std::lock_guard<std::mutex> lock(mArenaMutex);
+
+        for (uint8_t* chunk : mArena.chunks)
+            systemFree(chunk);
+        for (uint8_t* chunk : mArena.dedicatedChunks)
+            systemFree(chunk);
+
+        mArena = Arena{};
+    }
+
+    for (Pool& pool : mPools)
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+
+        for (uint8_t* slab : pool.slabs)
+            systemFree(slab);
+
+        pool.slabs.clear();
+        pool.freeList = nullptr;
+        pool.blockCount = 0u;
+    }
+}
+
+void* VKAPI_PTR HostAllocator::allocationFunction(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+{
+    return static_cast<HostAllocator*>(pUserData)->allocate(size, alignment, allocationScope);
+}
+
+void* VKAPI_PTR HostAllocator::reallocationFunction(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+{
+    return static_cast<HostAllocator*>(pUserData)->reallocate(pOriginal, size, alignment, allocationScope);
+}
+
+void VKAPI_PTR HostAllocator::freeFunction(void* pUserData, void* pMemory)
+{
+    static_cast<HostAllocator*>(pUserData)->free(pMemory);
+}
+
+void VKAPI_PTR HostAllocator::internalAllocationNotification(void* pUserData, size_t size, VkInternalAllocationType, VkSystemAllocationScope allocationScope)
+{
+    ScopeCounters& counters = static_cast<HostAllocator*>(pUserData)->mCounters[static_cast<size_t>(allocationScope)];
+    counters.internalAllocationCount.fetch_add(1u, std::memory_order_relaxed);
+    counters.internalBytesInUse.fetch_add(size, std::memory_order_relaxed);
+}
+
+void VKAPI_PTR HostAllocator::internalFreeNotification(void* pUserData, size_t size, VkInternalAllocationType, VkSystemAllocationScope allocationScope)
+{
+    subtractClamped(static_cast<HostAllocator*>(pUserData)->mCounters[static_cast<size_t>(allocationScope)].internalBytesInUse, size);
+}
+
+void* HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    // size 0 must return nullptr (no allocation)
+    if (size == 0u)
+        return nullptr;
+
+    void* memory{ allocateBlock(size, alignment, scope) };
+    if (memory)
+    {
+        mCounters[static_cast<size_t>(scope)].allocationCount.fetch_add(1u, std::memory_order_relaxed);
+        trackAllocation(static_cast<uint32_t>(scope), size);
+    }
+
+    return memory;
+}
+
+void* HostAllocator::reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (!original)
+        return allocate(size, alignment, scope);
+
+    if (size == 0u)
+    {
+        free(original);
+        return nullptr;
+    }
+
+    AllocationHeader* header{ getHeader(original) };
+    const uint32_t originalScope{ header->scope };
+    const size_t originalSize{ static_cast<size_t>(header->size) };
+
+    void* memory{ original };
+    if (!resizeBlock(original, size, alignment))
+    {
+        // on failure the original allocation must stay untouched
+        memory = allocateBlock(size, alignment, scope);
+        if (!memory)
+            return nullptr;
+
+        std::memcpy(memory, original, std::min(size, originalSize));
+        releaseBlock(original);
+    }
+    else
+        header->scope = static_cast<uint8_t>(scope);
+
+    mCounters[static_cast<size_t>(scope)].reallocationCount.fetch_add(1u, std::memory_order_relaxed);
+    trackFree(originalScope, originalSize);
+    trackAllocation(static_cast<uint32_t>(scope), size);
+
+    return memory;
+}
+
+void HostAllocator::free(void* memory)
+{
+    // nullptr free is allowed and ignored
+    if (!memory)
+        return;
+
+    const AllocationHeader* header{ getHeader(memory) };
+    mCounters[header->scope].freeCount.fetch_add(1u, std::memory_order_relaxed);
+    trackFree(header->scope, static_cast<size_t>(header->size));
+
+    releaseBlock(memory);
+}
+
+void* HostAllocator::allocateBlock(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    const size_t footprint{ getFootprint(size, alignment) };
+    HostAllocationMode mode{ mConfig.scopeModes[static_cast<size_t>(scope)] };
+    uint32_t sizeClass{ 0u };
+
+    // blocks larger than the biggest size class fall back to the system heap
+    if (mode == HostAllocationMode::Pool)
+    {
+        while (sizeClass < cPoolSizeClassCount && (cMinPoolBlockSize << sizeClass) < footprint)
+            ++sizeClass;
+        if (sizeClass == cPoolSizeClassCount)
+            mode = HostAllocationMode::System;
+    }
+
+    uint8_t* block{ nullptr };
+    switch (mode)
+    {
+    case HostAllocationMode::Arena:
+        block = allocateArenaBlock(footprint);
+        break;
+    case HostAllocationMode::Pool:
+        block = allocatePoolBlock(mPools[sizeClass], sizeClass);
+        break;
+    case HostAllocationMode::System:
+        block = systemAllocate(footprint);
+        break;
+    }
+
+    if (!block)
+        return nullptr;
+
+    // returned pointer is aligned to max(alignment, 16), header sits right before it
+    const uintptr_t address{ reinterpret_cast<uintptr_t>(block) + sizeof(AllocationHeader) };
+    uint8_t* memory{ block + (alignUp(address, std::max(alignment, cBlockAlignment)) - reinterpret_cast<uintptr_t>(block)) };
+
+    AllocationHeader* header{ getHeader(memory) };
+    header->size = size;
+    header->offset = static_cast<uint32_t>(memory - block);
+    header->mode = mode;
+    header->sizeClass = static_cast<uint8_t>(sizeClass);
+    header->scope = static_cast<uint8_t>(scope);
+    header->reserved = 0u;
+
+    // same quantity as subtracted by resizeBlock() and releaseBlock()
+    if (mode == HostAllocationMode::System)
+        mSystemBytes.fetch_add(header->offset + size, std::memory_order_relaxed);
+
+    return memory;
+}
+
+bool HostAllocator::resizeBlock(void* memory, size_t size, size_t alignment)
+{
+    // Try to keep the allocation where it is, alignment of a reallocation must match the original one
+    AllocationHeader* header{ getHeader(memory) };
+    if (reinterpret_cast<uintptr_t>(memory) % std::max(alignment, cBlockAlignment) != 0u)
+        return false;
+
+    uint8_t* block{ static_cast<uint8_t*>(memory) - header->offset };
+    const size_t footprint{ header->offset + size };
+
+    bool resized{ false };
+    switch (header->mode)
+    {
+    case HostAllocationMode::Arena:
+        if (size <= header->size)
+            resized = true;
+        else
+        {
+            std::lock_guard<std::mutex> lock(mArenaMutex);
+            if (block == mArena.lastBlock && !mArena.chunks.empty())
+            {
+                const size_t blockOffset{ static_cast<size_t>(block - mArena.chunks.back()) };
+                if (blockOffset + alignUp(footprint, cBlockAlignment) <= mConfig.arenaChunkSize)
+                {
+                    mArena.used = blockOffset + alignUp(footprint, cBlockAlignment);
+                    resized = true;
+                }
+            }
+        }
+        break;
+    case HostAllocationMode::Pool:
+        resized = footprint <= (cMinPoolBlockSize << header->sizeClass);
+        break;
+    case HostAllocationMode::System:
+        resized = size <= header->size;
+        break;
+    }
+
+    if (resized)
+    {
+        if (header->mode == HostAllocationMode::System)
+            mSystemBytes.fetch_sub(header->size - size, std::memory_order_relaxed);
+        header->size = size;
+    }
+
+    return resized;
+}
+
+void HostAllocator::releaseBlock(void* memory)
+{
+    const AllocationHeader* header{ getHeader(memory) };
+    uint8_t* block{ static_cast<uint8_t*>(memory) - header->offset };
+
+    switch (header->mode)
+    {
+    case HostAllocationMode::Arena:
+    {
+        // arena memory is reclaimed by reset(), only the most recent block can be rolled back
+        std::lock_guard<std::mutex> lock(mArenaMutex);
+        if (block == mArena.lastBlock && !mArena.chunks.empty())
+        {
+            mArena.used = static_cast<size_t>(block - mArena.chunks.back());
+            mArena.lastBlock = nullptr;
+        }
+        break;
+    }
+    case HostAllocationMode::Pool:
+    {
+        Pool& pool = mPools[header->sizeClass];
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        *reinterpret_cast<void**>(block) = pool.freeList;
+        pool.freeList = block;
+        break;
+    }
+    case HostAllocationMode::System:
+        mSystemBytes.fetch_sub(header->offset + header->size, std::memory_order_relaxed);
+        systemFree(block);
+        break;
+    }
+}
+
+uint8_t* HostAllocator::allocateArenaBlock(size_t footprint)
+{
+    footprint = alignUp(footprint, cBlockAlignment);
+
+    std::lock_guard<std::mutex> lock(mArenaMutex);
+
+    // oversized blocks get a chunk of their own so the current chunk keeps bumping
+    if (footprint > mConfig.arenaChunkSize)
+    {
+        uint8_t* chunk{ systemAllocate(footprint) };
+        if (chunk)
+        {
+            mArena.dedicatedChunks.push_back(chunk);
+            mArena.dedicatedBytes += footprint;
+        }
+        return chunk;
+    }
+
+    if (mArena.chunks.empty() || mArena.used + footprint > mConfig.arenaChunkSize)
+    {
+        uint8_t* chunk{ systemAllocate(mConfig.arenaChunkSize) };
+        if (!chunk)
+            return nullptr;
+
+        mArena.chunks.push_back(chunk);
+        mArena.used = 0u;
+    }
+
+    uint8_t* block{ mArena.chunks.back() + mArena.used };
+    mArena.used += footprint;
+    mArena.lastBlock = block;
+
+    return block;
+}
+
+uint8_t* HostAllocator::allocatePoolBlock(Pool& pool, uint32_t sizeClass)
+{
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    // carve a new slab into blocks of the size class when the free list is empty
+    if (!pool.freeList)
+    {
+        const size_t blockSize{ cMinPoolBlockSize << sizeClass };
+        const size_t blockCount{ std::max<size_t>(mConfig.poolSlabSize / blockSize, 1u) };
+
+        uint8_t* slab{ systemAllocate(blockCount * blockSize) };
+        if (!slab)
+            return nullptr;
+        pool.slabs.push_back(slab);
+
+        for (size_t i{ blockCount }; i > 0u; --i)
+        {
+            uint8_t* block{ slab + (i - 1u) * blockSize };
+            *reinterpret_cast<void**>(block) = pool.freeList;
+            pool.freeList = block;
+        }
+        pool.blockCount += blockCount;
+    }
+
+    uint8_t* block{ static_cast<uint8_t*>(pool.freeList) };
+    pool.freeList = *reinterpret_cast<void**>(block);
+
+    return block;
+}
+
+void HostAllocator::trackAllocation(uint32_t scope, size_t size)
+{
+    ScopeCounters& counters = mCounters[scope];
+    counters.bytesRequested.fetch_add(size, std::memory_order_relaxed);
+
+    const uint64_t bytesInUse{ counters.bytesInUse.fetch_add(size, std::memory_order_relaxed) + size };
+    uint64_t peakBytesInUse{ counters.peakBytesInUse.load(std::memory_order_relaxed) };
+    while (peakBytesInUse < bytesInUse && !counters.peakBytesInUse.compare_exchange_weak(peakBytesInUse, bytesInUse, std::memory_order_relaxed))
+        ;
+}
+
+void HostAllocator::trackFree(uint32_t scope, size_t size)
+{
+    subtractClamped(mCounters[scope].bytesInUse, size);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/// Strategy used for host allocations of one VkSystemAllocationScope
+enum class HostAllocationMode : uint8_t
+{
+	Arena,	// bump allocation from large chunks, frees are deferred until reset()
+	Pool,	// size-classed free lists, freed blocks are reused by the next allocation of the class
+	System	// aligned allocation from the general-purpose heap
+};
+
+/// Number of VkSystemAllocationScope values (COMMAND, OBJECT, CACHE, DEVICE, INSTANCE)
+constexpr size_t HostAllocationScopeCount{ 5u };
+
+struct HostAllocatorConfig
+{
+	/// Mode per VkSystemAllocationScope. Instance and device scoped memory lives
+	/// until vkDestroyInstance/vkDestroyDevice and goes to the arena, everything
+	/// that churns goes to the pools.
+	std::array<HostAllocationMode, HostAllocationScopeCount> scopeModes{
+		HostAllocationMode::Pool,	// VK_SYSTEM_ALLOCATION_SCOPE_COMMAND
+		HostAllocationMode::Pool,	// VK_SYSTEM_ALLOCATION_SCOPE_OBJECT
+		HostAllocationMode::Pool,	// VK_SYSTEM_ALLOCATION_SCOPE_CACHE
+		HostAllocationMode::Arena,	// VK_SYSTEM_ALLOCATION_SCOPE_DEVICE
+		HostAllocationMode::Arena	// VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE
+	};
+
+	size_t arenaChunkSize{ 256u * 1024u };	// allocations larger than a chunk get their own chunk
+	size_t poolSlabSize{ 64u * 1024u };		// slab carved into blocks of one size class
+};
+
+/// Counters of one VkSystemAllocationScope
+struct HostAllocationStatistics
+{
+	uint64_t allocationCount{ 0u };
+	uint64_t reallocationCount{ 0u };
+	uint64_t freeCount{ 0u };
+	uint64_t bytesRequested{ 0u };			// sum of all requested sizes
+	uint64_t bytesInUse{ 0u };				// requested size of live allocations
+	uint64_t peakBytesInUse{ 0u };
+	uint64_t internalAllocationCount{ 0u };	// driver allocations reported via pfnInternalAllocation
+	uint64_t internalBytesInUse{ 0u };
+};
+
+/// VkAllocationCallbacks implementation with arena and pool strategies and
+/// per scope statistics. All callbacks are thread safe. The arena and every
+/// pool size class have a lock of their own and counters are atomic, so
+/// threads only contend when they allocate from the same arena or size class.
+class HostAllocator
+{
+public:
+	explicit HostAllocator(const HostAllocatorConfig& config = HostAllocatorConfig{});
+	~HostAllocator();
+
+	HostAllocator(const HostAllocator&) = delete;
+	HostAllocator& operator=(const HostAllocator&) = delete;
+
+	/// Callbacks to pass as pAllocator to vkCreate*/vkDestroy*/vkAllocate*/vkFree*
+	const VkAllocationCallbacks* getAllocationCallbacks() const { return &mAllocationCallbacks; }
+
+	/// Statistics of scope (VkSystemAllocationScope value)
+	HostAllocationStatistics getStatistics(VkSystemAllocationScope scope) const;
+
+	/// Print statistics of all scopes and arena/pool footprint to stdout
+	void printSummary() const;
+
+	/// Release all arena chunks and pool slabs. Every object created with the
+	/// callbacks must be destroyed before.
+	void reset();
+private:
+	struct Arena
+	{
+		std::vector<uint8_t*> chunks;			// chunks.back() is the one being bumped
+		std::vector<uint8_t*> dedicatedChunks;	// allocations larger than arenaChunkSize
+		size_t used{ 0u };						// bytes used in chunks.back()
+		uint8_t* lastBlock{ nullptr };			// most recent block, may grow/shrink in place
+		uint64_t dedicatedBytes{ 0u };
+	};
+
+	struct alignas(64) Pool
+	{
+		std::mutex mutex;
+		void* freeList{ nullptr };			// blocks linked through their first bytes
+		uint64_t blockCount{ 0u };
+		std::vector<uint8_t*> slabs;
+	};
+
+	/// HostAllocationStatistics updated without a lock
+	struct ScopeCounters
+	{
+		std::atomic<uint64_t> allocationCount{ 0u };
+		std::atomic<uint64_t> reallocationCount{ 0u };
+		std::atomic<uint64_t> freeCount{ 0u };
+		std::atomic<uint64_t> bytesRequested{ 0u };
+		std::atomic<uint64_t> bytesInUse{ 0u };
+		std::atomic<uint64_t> peakBytesInUse{ 0u };
+		std::atomic<uint64_t> internalAllocationCount{ 0u };
+		std::atomic<uint64_t> internalBytesInUse{ 0u };
+	};
+
+	static void* VKAPI_PTR allocationFunction(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope);
+	static void* VKAPI_PTR reallocationFunction(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope);
+	static void VKAPI_PTR freeFunction(void* pUserData, void* pMemory);
+	static void VKAPI_PTR internalAllocationNotification(void* pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope);
+	static void VKAPI_PTR internalFreeNotification(void* pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope);
+
+	void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void free(void* memory);
+
+	// the functions below lock the arena or pool they touch
+	void* allocateBlock(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	bool resizeBlock(void* memory, size_t size, size_t alignment);
+	void releaseBlock(void* memory);
+	uint8_t* allocateArenaBlock(size_t footprint);
+	uint8_t* allocatePoolBlock(Pool& pool, uint32_t sizeClass);
+
+	void trackAllocation(uint32_t scope, size_t size);
+	void trackFree(uint32_t scope, size_t size);
+
+	static constexpr uint32_t cPoolSizeClassCount{ 8u };	// 32 B .. 4 KiB in powers of two
+
+	HostAllocatorConfig mConfig;
+	VkAllocationCallbacks mAllocationCallbacks;
+
+	mutable std::mutex mArenaMutex;
+	Arena mArena;
+	mutable std::array<Pool, cPoolSizeClassCount> mPools;	// mutable for the locks of printSummary()
+	std::array<ScopeCounters, HostAllocationScopeCount> mCounters;
+	std::atomic<uint64_t> mSystemBytes{ 0u };		// offset + size of live System blocks
+};
@@ -0,0 +1,279 @@
+#include "MultiDeviceScheduler.h"
+#include <algorithm>
+#include <cstdio>
+
+MultiDeviceScheduler::MultiDeviceScheduler()
+    : mProfiler(nullptr)
+    , mFailed(false)
+    , mChunkSize(1u)
+{
+}
+
+VkResult MultiDeviceScheduler::init(const std::vector<DeviceContext*>& devices, const MultiDeviceSchedulerConfig& config)
+{
+    if (devices.empty() || config.chunksPerDevice == 0u)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    const size_t deviceCount{ devices.size() };
+
+    mDevices = devices;
+    mConfig = config;
+    mConfig.throughputSmoothing = std::min(std::max(config.throughputSmoothing, 0.0f), 1.0f);
+
+    mRanges.clear();
+    for (size_t i{ 0u }; i < deviceCount; ++i)
+        mRanges.emplace_back(new Range);
+    mStatistics.assign(deviceCount, DeviceWorkStatistics{});
+    mBatchBusyTimes.assign(deviceCount, std::chrono::nanoseconds::zero());
+    mBatchResults.assign(deviceCount, VK_SUCCESS);
+    mFailed.store(false, std::memory_order_relaxed);
+
+    // slot of the calling thread drives the last device
+    mThreadPool.reset(new ThreadPool(deviceCount - 1u));
+
+    return VK_SUCCESS;
+}
+
+void MultiDeviceScheduler::deinit()
+{
+    mThreadPool.reset();
+    mRanges.clear();
+    mDevices.clear();
+}
+
+double MultiDeviceScheduler::getWeight(uint32_t deviceIndex) const
+{
+    if (mStatistics[deviceIndex].throughput > 0.0)
+        return mStatistics[deviceIndex].throughput;
+
+    // devices not measured yet are assumed as fast as the average measured one, all equal before the first batch
+    double throughputSum{ 0.0 };
+    uint32_t measuredCount{ 0u };
+    for (const DeviceWorkStatistics& statistics : mStatistics)
+        if (statistics.throughput > 0.0)
+        {
+            throughputSum += statistics.throughput;
+            ++measuredCount;
+        }
+
+    return measuredCount > 0u ? throughputSum / measuredCount : 1.0;
+}
+
+double MultiDeviceScheduler::getShare(uint32_t deviceIndex) const
+{
+    double weightSum{ 0.0 };
+    for (uint32_t i{ 0u }; i < getDeviceCount(); ++i)
+        weightSum += getWeight(i);
+
+    return weightSum > 0.0 ? getWeight(deviceIndex) / weightSum : 0.0;
+}
+
+uint64_t MultiDeviceScheduler::getChunkSize(uint64_t itemCount) const
+{
+    return std::max<uint64_t>(itemCount / (static_cast<uint64_t>(std::max(getDeviceCount(), 1u)) * mConfig.chunksPerDevice), 1u);
+}
+
+VkResult MultiDeviceScheduler::run(uint64_t itemCount, const ChunkFunction& function)
+{
+    // 1) split items into contiguous ranges proportional to the measured throughput
+    // 2) every device processes its range chunk by chunk on its own thread, stealing when it runs dry
+    // 3) fold busy time of the batch into the throughput of each device
+
+    if (mDevices.empty())
+        return VK_ERROR_INITIALIZATION_FAILED;
+    if (itemCount == 0u)
+        return VK_SUCCESS;
+
+    MK_PROFILE_CPU_ZONE(mProfiler, "MultiDeviceScheduler::run");
+
+    const uint32_t deviceCount{ getDeviceCount() };
+
+    std::vector<double> weights(deviceCount);
+    double weightSum{ 0.0 };
+    for (uint32_t i{ 0u }; i < deviceCount; ++i)
+    {
+        weights[i] = getWeight(i);
+        weightSum += weights[i];
+    }
+
+    mChunkSize = getChunkSize(itemCount);
+
+    double cumulativeWeight{ 0.0 };
+    uint64_t begin{ 0u };
+    for (uint32_t i{ 0u }; i < deviceCount; ++i)
+    {
+        cumulativeWeight += weights[i];
+        const uint64_t end{ i + 1u == deviceCount ? itemCount
+            : std::max(begin, std::min(static_cast<uint64_t>(static_cast<double>(itemCount) * cumulativeWeight / weightSum), itemCount)) };
+
+        {
+            std::lock_guard<std::mutex> lock(mRanges[i]->mutex);
+            mRanges[i]->begin = begin;
+            mRanges[i]->end = end;
+        }
+        begin = end;
+
+        mBatchBusyTimes[i] = std::chrono::nanoseconds::zero();
+        mBatchResults[i] = VK_SUCCESS;
+        mStatistics[i].lastBatchItemCount = 0u;
+    }
+    mFailed.store(false, std::memory_order_relaxed);
+
+    mThreadPool->parallelFor(deviceCount, [this, &function](size_t deviceIndex)
+    {
+        runDevice(static_cast<uint32_t>(deviceIndex), function);
+    });
+
+    updateThroughput();
+
+    for (VkResult result : mBatchResults)
+        if (result != VK_SUCCESS)
+            return result;
+
+    return VK_SUCCESS;
+}
+
+void MultiDeviceScheduler::runDevice(uint32_t deviceIndex, const ChunkFunction& function)
+{
+    DeviceWorkStatistics& statistics = mStatistics[deviceIndex];
+    uint64_t first{ 0u };
+    uint64_t count{ 0u };
+
+    while (!mFailed.load(std::memory_order_relaxed) && takeChunk(deviceIndex, first, count))
+    {
+        MK_PROFILE_CPU_ZONE(mProfiler, "MultiDeviceScheduler chunk");
+
+        const auto start = std::chrono::steady_clock::now();
+        const VkResult result = function(deviceIndex, first, count);
+        mBatchBusyTimes[deviceIndex] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+        if (result != VK_SUCCESS)
+        {
+            mBatchResults[deviceIndex] = result;
+            mFailed.store(true, std::memory_order_relaxed);
+            break;
+        }
+
+        statistics.itemCount += count;
+        statistics.lastBatchItemCount += count;
+        ++statistics.chunkCount;
+    }
+}
+
+bool MultiDeviceScheduler::takeChunk(uint32_t deviceIndex, uint64_t& first, uint64_t& count)
+{
+    Range& range = *mRanges[deviceIndex];
+
+    // a stolen range may be stolen again before the first chunk is taken from it
+    do
+    {
+        std::lock_guard<std::mutex> lock(range.mutex);
+        if (range.begin < range.end)
+        {
+            first = range.begin;
+            count = std::min(mChunkSize, range.end - range.begin);
+            range.begin += count;
+            return true;
+        }
+    } while (steal(deviceIndex));
+
+    return false;
+}
+
+bool MultiDeviceScheduler::steal(uint32_t deviceIndex)
+{
+    const double weight{ getWeight(deviceIndex) };
+
+    for (;;)
+    {
+        // victim - the device with the most estimated time left
+        uint32_t victimIndex{ UINT32_MAX };
+        double maxTimeLeft{ 0.0 };
+        for (uint32_t i{ 0u }; i < getDeviceCount(); ++i)
+        {
+            if (i == deviceIndex)
+                continue;
+
+            uint64_t remaining{ 0u };
+            {
+                std::lock_guard<std::mutex> lock(mRanges[i]->mutex);
+                remaining = mRanges[i]->end - mRanges[i]->begin;
+            }
+
+            const double timeLeft{ static_cast<double>(remaining) / getWeight(i) };
+            if (remaining > 0u && timeLeft > maxTimeLeft)
+            {
+                victimIndex = i;
+                maxTimeLeft = timeLeft;
+            }
+        }
+
+        if (victimIndex == UINT32_MAX)
+            return false;
+
+        // share of the thief by throughput, so both are expected to finish together
+        const double victimWeight{ getWeight(victimIndex) };
+        uint64_t first{ 0u };
+        uint64_t count{ 0u };
+        {
+            Range& victim = *mRanges[victimIndex];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+
+            const uint64_t remaining{ victim.end - victim.begin };
+            if (remaining == 0u)
+                continue;	// emptied since the search, look again
+
+            // whole chunks, the tail of a batch is not split into ever smaller submissions
+            count = static_cast<uint64_t>(static_cast<double>(remaining) * weight / (weight + victimWeight));
+            count = std::min((count / mChunkSize + 1u) * mChunkSize, remaining);
+            victim.end -= count;
+            first = victim.end;
+        }
+
+        {
+            Range& range = *mRanges[deviceIndex];
+            std::lock_guard<std::mutex> lock(range.mutex);
+            range.begin = first;
+            range.end = first + count;
+        }
+
+        ++mStatistics[deviceIndex].stealCount;
+        mStatistics[deviceIndex].stolenItemCount += count;
+
+        return true;
+    }
+}
+
+void MultiDeviceScheduler::updateThroughput()
+{
+    const double smoothing{ mConfig.throughputSmoothing };
+
+    for (uint32_t i{ 0u }; i < getDeviceCount(); ++i)
+    {
+        DeviceWorkStatistics& statistics = mStatistics[i];
+        const std::chrono::nanoseconds busyTime{ mBatchBusyTimes[i] };
+        statistics.busyTime += busyTime;
+
+        // a device all of whose items were stolen keeps its previous throughput
+        if (statistics.lastBatchItemCount == 0u || busyTime.count() <= 0)
+            continue;
+
+        const double throughput{ static_cast<double>(statistics.lastBatchItemCount) / std::chrono::duration<double>(busyTime).count() };
+        statistics.throughput = statistics.throughput > 0.0 ? smoothing * throughput + (1.0 - smoothing) * statistics.throughput : throughput;
+    }
+}
+
+void MultiDeviceScheduler::printStatistics() const
+{
+    std::printf("MultiDeviceScheduler statistics (%u devices)\n", getDeviceCount());
+    std::printf("%-3s %-32s %12s %8s %8s %12s %14s %7s\n", "dev", "name", "items", "chunks", "steals", "stolen", "items/s", "share");
+
+    for (uint32_t i{ 0u }; i < getDeviceCount(); ++i)
+    {
+        const DeviceWorkStatistics& statistics = mStatistics[i];
+        std::printf("%-3u %-32.32s %12llu %8llu %8llu %12llu %14.1f %6.1f%%\n", i, mDevices[i]->getRecord().getProperties().deviceName,
+            static_cast<unsigned long long>(statistics.itemCount), static_cast<unsigned long long>(statistics.chunkCount),
+            static_cast<unsigned long long>(statistics.stealCount), static_cast<unsigned long long>(statistics.stolenItemCount),
+            statistics.throughput, 100.0 * getShare(i));
+    }
+}
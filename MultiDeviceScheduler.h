@@ -0,0 +1,109 @@
+#pragma once
+
+#include "DeviceContext.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct MultiDeviceSchedulerConfig
+{
+	uint32_t maxPhysicalDevices{ 0u };			// eligible physical devices App creates device contexts on, selected device first (0 - no scheduler)
+	uint32_t devicesPerPhysicalDevice{ 1u };	// logical devices per physical device, > 1 e.g. to test scheduling on one software ICD
+	uint32_t chunksPerDevice{ 8u };				// a batch is split into chunks of itemCount / (devices * chunksPerDevice) items
+	float throughputSmoothing{ 0.5f };			// weight of the last batch in the measured throughput (1 - last batch only)
+};
+
+/// Counters of one device since init()
+struct DeviceWorkStatistics
+{
+	uint64_t itemCount{ 0u };					// work items processed
+	uint64_t chunkCount{ 0u };					// calls of the chunk function
+	uint64_t stealCount{ 0u };					// ranges taken from devices that fell behind
+	uint64_t stolenItemCount{ 0u };				// items in them
+	uint64_t lastBatchItemCount{ 0u };			// items processed in the last run()
+	std::chrono::nanoseconds busyTime{ 0 };		// spent in the chunk function
+	double throughput{ 0.0 };					// items per second of busy time, smoothed over batches (0 - not measured yet)
+};
+
+/// Splits batches of independent work items across the compute engines of
+/// several DeviceContexts. Each device gets a contiguous range sized by its
+/// measured throughput (equal shares until measured), and processes it chunk by
+/// chunk on a thread of its own. A device that runs out of items steals from
+/// the back of the range of the device with the most estimated time left, a
+/// share weighted by the throughput of both, so a device falling behind - slower
+/// than measured, or shared with other work - is rebalanced within the batch.
+/// Throughput is measured per batch as items per second inside the chunk
+/// function and smoothed over batches.
+/// Typical use: create kernels and buffers on every getDevice(), run() ...
+/// Not thread safe - chunk functions run in parallel, the calls do not.
+class MultiDeviceScheduler
+{
+public:
+	/// Process work items [first, first + count) on the device of deviceIndex and return when they are done.
+	/// Called on the thread driving that device, calls for different devices run in parallel.
+	using ChunkFunction = std::function<VkResult(uint32_t deviceIndex, uint64_t first, uint64_t count)>;
+
+	MultiDeviceScheduler();
+
+	MultiDeviceScheduler(const MultiDeviceScheduler&) = delete;
+	MultiDeviceScheduler& operator=(const MultiDeviceScheduler&) = delete;
+
+	/// Start one thread per device but one, which the caller of run() drives
+	VkResult init(const std::vector<DeviceContext*>& devices, const MultiDeviceSchedulerConfig& config = MultiDeviceSchedulerConfig{});
+
+	/// Stop the threads (devices are not destroyed)
+	void deinit();
+
+	uint32_t getDeviceCount() const { return static_cast<uint32_t>(mDevices.size()); }
+	DeviceContext& getDevice(uint32_t deviceIndex) { return *mDevices[deviceIndex]; }
+
+	/// Most items passed to one chunk function call of run(itemCount), e.g. to size per device buffers
+	uint64_t getChunkSize(uint64_t itemCount) const;
+
+	/// Process itemCount items across all devices and return when all are done.
+	/// return first error of a chunk function, the remaining chunks are skipped after it
+	VkResult run(uint64_t itemCount, const ChunkFunction& function);
+
+	/// Share of the next batch deviceIndex starts with (0.0 - 1.0)
+	double getShare(uint32_t deviceIndex) const;
+
+	/// Record a CPU zone of run() and of every chunk into profiler (nullptr - none)
+	void setProfiler(Profiler* profiler) { mProfiler = profiler; }
+
+	/// Counters per device, same order as the devices of init()
+	const std::vector<DeviceWorkStatistics>& getStatistics() const { return mStatistics; }
+
+	/// Print share, throughput and steals of every device to stdout
+	void printStatistics() const;
+private:
+	// Items [begin, end) left to a device, the owner takes chunks from the front, thieves from the back
+	struct alignas(64) Range
+	{
+		std::mutex mutex;
+		uint64_t begin{ 0u };
+		uint64_t end{ 0u };
+	};
+
+	double getWeight(uint32_t deviceIndex) const;
+	void runDevice(uint32_t deviceIndex, const ChunkFunction& function);
+	bool takeChunk(uint32_t deviceIndex, uint64_t& first, uint64_t& count);
+	bool steal(uint32_t deviceIndex);
+	void updateThroughput();
+
+	std::vector<DeviceContext*> mDevices;
+	MultiDeviceSchedulerConfig mConfig;
+	Profiler* mProfiler;
+	std::unique_ptr<ThreadPool> mThreadPool;
+	std::vector<std::unique_ptr<Range>> mRanges;			// one per device
+	std::vector<DeviceWorkStatistics> mStatistics;			// one per device, written by its thread during run()
+	std::vector<std::chrono::nanoseconds> mBatchBusyTimes;	// busy time in the current run()
+	std::vector<VkResult> mBatchResults;					// first error of each device in the current run()
+	std::atomic<bool> mFailed;								// a chunk failed, remaining chunks are skipped
+	uint64_t mChunkSize;									// items per chunk of the current run()
+};
@@ -0,0 +1,63 @@
+#include "NameSet.h"
+#include <cstring>
+
+void NameSet::clear()
+{
+    mEntries.clear();
+    mSize = 0u;
+    mBuilt = false;
+}
+
+void NameSet::reset(size_t count)
+{
+    // at most half full, probes of missing names stop at the first empty slot
+    size_t capacity{ 8u };
+    while (capacity < count * 2u)
+        capacity *= 2u;
+
+    mEntries.assign(capacity, Entry{});
+    mSize = 0u;
+}
+
+void NameSet::insert(const char* name)
+{
+    if ((mSize + 1u) * 2u > mEntries.size())
+    {
+        // grow and rehash, only when insert() is used without build()
+        std::vector<Entry> entries;
+        entries.swap(mEntries);
+        reset(mSize + 1u);
+        for (const Entry& entry : entries)
+            if (entry.name)
+                insert(entry.name);
+    }
+
+    const NameHash nameHash{ name };
+    const size_t mask{ mEntries.size() - 1u };
+    for (size_t i{ static_cast<size_t>(nameHash.hash) & mask }; ; i = (i + 1u) & mask)
+    {
+        Entry& entry = mEntries[i];
+        if (!entry.name)
+        {
+            entry = { nameHash.hash, name };
+            ++mSize;
+            return;
+        }
+        if (entry.hash == nameHash.hash && std::strcmp(entry.name, name) == 0)
+            return;
+    }
+}
+
+bool NameSet::contains(const NameHash& name) const
+{
+    if (mEntries.empty())
+        return false;
+
+    // the name comparison only confirms a hash match
+    const size_t mask{ mEntries.size() - 1u };
+    for (size_t i{ static_cast<size_t>(name.hash) & mask }; mEntries[i].name; i = (i + 1u) & mask)
+        if (mEntries[i].hash == name.hash && std::strcmp(mEntries[i].name, name.name) == 0)
+            return true;
+
+    return false;
+}
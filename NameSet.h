@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// 64-bit FNV-1a of a null-terminated name, evaluated at compile time for literals
+constexpr uint64_t hashName(const char* name)
+{
+	uint64_t hash{ 14695981039346656037ull };
+	for (; *name; ++name)
+	{
+		hash ^= static_cast<uint8_t>(*name);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/// Layer or extension name with its hash. Constructed from a literal in a
+/// constexpr context (see KnownExtensions) the hash costs nothing at runtime,
+/// any other name is hashed where it is converted.
+struct NameHash
+{
+	const char* name;
+	uint64_t hash;
+
+	constexpr NameHash(const char* name_)
+		: name(name_)
+		, hash(hashName(name_))
+	{
+	}
+};
+
+/// Extensions App checks for, hashed at compile time
+namespace KnownExtensions
+{
+	constexpr NameHash DebugUtils{ VK_EXT_DEBUG_UTILS_EXTENSION_NAME };
+	constexpr NameHash MemoryBudget{ VK_EXT_MEMORY_BUDGET_EXTENSION_NAME };
+	constexpr NameHash PipelineCreationFeedback{ VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME };
+}
+
+/// Layers App checks for, hashed at compile time
+namespace KnownLayers
+{
+	constexpr NameHash KhronosValidation{ "VK_LAYER_KHRONOS_validation" };
+}
+
+/// Hash set of layer/extension names for lookups with a single probe
+/// (open addressing, at most half full). Names are not copied, they must
+/// stay valid while the set is used - typically they point into the
+/// property arrays the set was built from.
+/// Not thread safe.
+class NameSet
+{
+public:
+	/// Index count names, getName(i) returns the i-th (const char*)
+	template<typename GetName>
+	void build(size_t count, GetName getName)
+	{
+		reset(count);
+		for (size_t i{ 0u }; i < count; ++i)
+			insert(getName(i));
+		mBuilt = true;
+	}
+
+	/// Empty and not built
+	void clear();
+
+	/// Add name, duplicates are ignored
+	void insert(const char* name);
+
+	bool contains(const NameHash& name) const;
+
+	/// build() was called since the last clear()
+	bool isBuilt() const { return mBuilt; }
+	size_t size() const { return mSize; }
+private:
+	struct Entry
+	{
+		uint64_t hash{ 0u };
+		const char* name{ nullptr };		// nullptr - empty slot
+	};
+
+	void reset(size_t count);
+
+	std::vector<Entry> mEntries;			// power of two size
+	size_t mSize{ 0u };
+	bool mBuilt{ false };
+};
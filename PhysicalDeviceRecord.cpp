@@ -0,0 +1,241 @@
+#include "PhysicalDeviceRecord.h"
+
+namespace
+{
+    uint32_t alignBlockOffset(size_t offset)
+    {
+        return static_cast<uint32_t>((offset + 7u) & ~size_t{ 7u });
+    }
+}
+
+VkResult PhysicalDeviceRecord::query(const InstanceDispatch& dispatch, VkPhysicalDevice physicalDevice)
+{
+    // Query capabilities of physical device
+    // 1) discover number of layers, extensions and queue families
+    // 2) allocate one block for the fixed part and all arrays
+    // 3) fill the block (retry if number of layers/extensions changed in between)
+
+    VkResult result = VK_SUCCESS;
+
+    mPhysicalDevice = physicalDevice;
+    mCapabilities = nullptr;
+    mLayerSet.clear();
+    mExtensionSet.clear();
+
+    do
+    {
+        uint32_t layerPropertyCount{ 0u };
+        uint32_t extensionPropertyCount{ 0u };
+        uint32_t queueFamilyPropertyCount{ 0u };
+
+        result = dispatch.vkEnumerateDeviceLayerProperties( // discover available layers to device on system
+            physicalDevice,                         // physical device to query
+            &layerPropertyCount,                    // uint32_t * pPropertyCount,                   // output - get number of layer properties
+            nullptr                                 // VkLayerProperties * pProperties);            // nullptr
+        );
+
+        if (result == VK_SUCCESS)
+            result = dispatch.vkEnumerateDeviceExtensionProperties( // discover available extensions to device on system
+                physicalDevice,                     // VkPhysicalDevice physicalDevice,             // physical device to query
+                nullptr,                            // const char* pLayerName,                      // nullptr or layer that might provide extensions
+                &extensionPropertyCount,            // uint32_t * pPropertyCount,                   // output - get number of extension properties
+                nullptr                             // VkExtensionProperties * pProperties);        // nullptr
+            );
+
+        if (result != VK_SUCCESS)
+            break;
+
+        dispatch.vkGetPhysicalDeviceQueueFamilyProperties( // discover number of queue families supported by physical device
+            physicalDevice,                         // VkPhysicalDevice physicalDevice,             // handle to physical device
+            &queueFamilyPropertyCount,              // uint32_t * pQueueFamilyPropertyCount,        // output - get number of queue families
+            nullptr                                 // VkQueueFamilyProperties * pQueueFamilyProperties // nullptr
+        );
+
+        // Layout of the block: PhysicalDeviceCapabilities | layers | extensions | queue families
+        const uint32_t layerPropertyOffset{ alignBlockOffset(sizeof(PhysicalDeviceCapabilities)) };
+        const uint32_t extensionPropertyOffset{ alignBlockOffset(layerPropertyOffset + layerPropertyCount * sizeof(VkLayerProperties)) };
+        const uint32_t queueFamilyPropertyOffset{ alignBlockOffset(extensionPropertyOffset + extensionPropertyCount * sizeof(VkExtensionProperties)) };
+        const uint32_t blockSize{ alignBlockOffset(queueFamilyPropertyOffset + queueFamilyPropertyCount * sizeof(VkQueueFamilyProperties)) };
+
+        mStorage.assign(blockSize / sizeof(uint64_t), 0u);
+        uint8_t* block{ reinterpret_cast<uint8_t*>(mStorage.data()) };
+        PhysicalDeviceCapabilities* capabilities{ reinterpret_cast<PhysicalDeviceCapabilities*>(block) };
+
+        capabilities->layerPropertyCount = layerPropertyCount;
+        capabilities->layerPropertyOffset = layerPropertyOffset;
+        capabilities->extensionPropertyCount = extensionPropertyCount;
+        capabilities->extensionPropertyOffset = extensionPropertyOffset;
+        capabilities->queueFamilyPropertyCount = queueFamilyPropertyCount;
+        capabilities->queueFamilyPropertyOffset = queueFamilyPropertyOffset;
+        capabilities->blockSize = blockSize;
+
+        result = dispatch.vkEnumerateDeviceLayerProperties( // discover available layers to device on system
+            physicalDevice,                         // physical device to query
+            &capabilities->layerPropertyCount,      // uint32_t * pPropertyCount,                   // input - provide number of layer properties
+            reinterpret_cast<VkLayerProperties*>(block + layerPropertyOffset) // VkLayerProperties * pProperties); // array of structures to be filled with info about registered layers
+        );
+
+        if (result == VK_SUCCESS)
+            result = dispatch.vkEnumerateDeviceExtensionProperties( // discover available extensions to device on system
+                physicalDevice,                     // VkPhysicalDevice physicalDevice,             // physical device to query
+                nullptr,                            // const char* pLayerName,                      // nullptr or layer that might provide extensions
+                &capabilities->extensionPropertyCount, // uint32_t * pPropertyCount,                // input - provide number of extension properties
+                reinterpret_cast<VkExtensionProperties*>(block + extensionPropertyOffset) // VkExtensionProperties * pProperties); // array of structures to be filled on supported extensions
+            );
+
+        if (result != VK_SUCCESS)
+            continue;
+
+        // typedef struct VkPhysicalDeviceProperties {              // details on physical device
+        //    uint32_t apiVersion;                                  // highest version of Vulkan supported by device
+        //    uint32_t driverVersion;                               // driver version used to control device (vendor specific)
+        //    uint32_t vendorID;                                    // identify vendor
+        //    uint32_t deviceID;                                    // identify device
+        //    VkPhysicalDeviceType deviceType;                      // supported physical device types
+        //    char deviceName[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE];    // human readable name of device
+        //    uint8_t pipelineCacheUUID[VK_UUID_SIZE];              // used for pipeline caching
+        //    VkPhysicalDeviceLimits limits;                        // min and max limits for physical device
+        //    VkPhysicalDeviceSparseProperties sparseProperties;    // properties related to sparse textures
+        //} VkPhysicalDeviceProperties;
+
+        dispatch.vkGetPhysicalDeviceProperties(     // fill structures describing all properties of physical device
+            physicalDevice,                         // VkPhysicalDevice physicalDevice,             // handle to physical device
+            &capabilities->properties               // VkPhysicalDeviceProperties * pProperties);   // structure to be filled with details on physical device properties
+        );
+
+        // typedef struct VkPhysicalDeviceFeatures {                // details on features of physical device
+        //    VkBool32    robustBufferAccess;                       // bool field marked if the feature is supported
+        //    ..
+        //} VkPhysicalDeviceFeatures;
+        //
+        // Vulkan 1.1/1.2 features (timelineSemaphore, bufferDeviceAddress, descriptorIndexing, ..)
+        // and properties (driverID, subgroupSize, ..) are in VkPhysicalDeviceVulkan11/12Features/Properties
+
+        capabilities->properties11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_PROPERTIES;
+        capabilities->properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+        capabilities->features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+        capabilities->features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+        if (capabilities->properties.apiVersion >= VK_API_VERSION_1_2)
+        {
+            // Vulkan 1.2 device - query 1.1/1.2 properties and features through the pNext chain
+            capabilities->properties11.pNext = &capabilities->properties12;
+            capabilities->features11.pNext = &capabilities->features12;
+
+            VkPhysicalDeviceProperties2 properties2 = {
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, // VkStructureType sType;           // type of structure
+                &capabilities->properties11,        // void* pNext;                                 // chain of extending structures to fill (1.1 -> 1.2)
+                {}                                  // VkPhysicalDeviceProperties properties;       // same as vkGetPhysicalDeviceProperties
+            };
+
+            VkPhysicalDeviceFeatures2 features2 = {
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, // VkStructureType sType;             // type of structure
+                &capabilities->features11,          // void* pNext;                                 // chain of extending structures to fill (1.1 -> 1.2)
+                {}                                  // VkPhysicalDeviceFeatures features;           // same as vkGetPhysicalDeviceFeatures
+            };
+
+            dispatch.vkGetPhysicalDeviceProperties2( // fill properties and all structures chained to them
+                physicalDevice,                     // VkPhysicalDevice physicalDevice,             // handle to physical device
+                &properties2                        // VkPhysicalDeviceProperties2* pProperties);   // structure with pNext chain to be filled
+            );
+
+            dispatch.vkGetPhysicalDeviceFeatures2(  // fill features and all structures chained to them
+                physicalDevice,                     // VkPhysicalDevice physicalDevice,             // handle to physical device
+                &features2                          // VkPhysicalDeviceFeatures2* pFeatures);       // structure with pNext chain to be filled
+            );
+
+            capabilities->properties = properties2.properties;
+            capabilities->features = features2.features;
+
+            // the block is copied and memory mapped, it must not contain pointers
+            capabilities->properties11.pNext = nullptr;
+            capabilities->features11.pNext = nullptr;
+        }
+        else
+            dispatch.vkGetPhysicalDeviceFeatures(   // fill structures describing all features of physical device
+                physicalDevice,                     // VkPhysicalDevice physicalDevice,             // handle to physical device
+                &capabilities->features             // VkPhysicalDeviceFeatures* pFeatures);        // structure to be filled with details on physical device features
+            );
+
+        // typedef struct VkPhysicalDeviceMemoryProperties {        // properties of device heaps and supported memory types
+        //    uint32_t memoryTypeCount;                             // number of memory types
+        //    VkMemoryType memoryTypes[VK_MAX_MEMORY_TYPES];        // memoryTypeCount number of structures
+        //    uint32_t memoryHeapCount;                             // number of heaps
+        //    VkMemoryHeap memoryHeaps[VK_MAX_MEMORY_HEAPS];        // memoryHeapCount number of structures
+        //} VkPhysicalDeviceMemoryProperties;
+
+        dispatch.vkGetPhysicalDeviceMemoryProperties( // fill structures describing all memory properties of physical device
+            physicalDevice,                         // VkPhysicalDevice physicalDevice,             // handle to physical device
+            &capabilities->memoryProperties         // VkPhysicalDeviceMemoryProperties* pMemoryProperties); // structure to be filled with details on physical device memory properties
+        );
+
+        // typedef struct VkQueueFamilyProperties {                 // identical queues with same caps and able to run in parallel
+        //    VkQueueFlags queueFlags;                              // overall caps of queue
+        //    uint32_t queueCount;                                  // number of queues in family (1 or more)
+        //    uint32_t timestampValidBits;                          // number of valid bits when timestamps taken from queue
+        //    VkExtent3D minImageTransferGranularity;               // units to support image transfers (may not support)
+        //} VkQueueFamilyProperties;
+
+        dispatch.vkGetPhysicalDeviceQueueFamilyProperties( // get properties of device queue families
+            physicalDevice,                         // VkPhysicalDevice physicalDevice,             // handle to physical device
+            &capabilities->queueFamilyPropertyCount, // uint32_t * pQueueFamilyPropertyCount,       // input - provide number of queue families
+            reinterpret_cast<VkQueueFamilyProperties*>(block + queueFamilyPropertyOffset) // VkQueueFamilyProperties * pQueueFamilyProperties // array of structures to fill
+        );
+
+        mCapabilities = capabilities;
+    } while (result == VK_INCOMPLETE);
+
+    return result;
+}
+
+void PhysicalDeviceRecord::attach(VkPhysicalDevice physicalDevice, const PhysicalDeviceCapabilities* capabilities)
+{
+    mPhysicalDevice = physicalDevice;
+    mStorage.clear();
+    mCapabilities = capabilities;
+    mLayerSet.clear();
+    mExtensionSet.clear();
+}
+
+ArrayView<VkLayerProperties> PhysicalDeviceRecord::getLayerProperties() const
+{
+    return getArray<VkLayerProperties>(mCapabilities->layerPropertyOffset, mCapabilities->layerPropertyCount);
+}
+
+ArrayView<VkExtensionProperties> PhysicalDeviceRecord::getExtensionProperties() const
+{
+    return getArray<VkExtensionProperties>(mCapabilities->extensionPropertyOffset, mCapabilities->extensionPropertyCount);
+}
+
+ArrayView<VkQueueFamilyProperties> PhysicalDeviceRecord::getQueueFamilyProperties() const
+{
+    return getArray<VkQueueFamilyProperties>(mCapabilities->queueFamilyPropertyOffset, mCapabilities->queueFamilyPropertyCount);
+}
+
+bool PhysicalDeviceRecord::hasLayer(const NameHash& name) const
+{
+    if (!mLayerSet.isBuilt())
+    {
+        const ArrayView<VkLayerProperties> layerProperties{ getLayerProperties() };
+        mLayerSet.build(layerProperties.size(), [&layerProperties](size_t i) { return layerProperties[i].layerName; });
+    }
+
+    return mLayerSet.contains(name);
+}
+
+bool PhysicalDeviceRecord::hasExtension(const NameHash& name) const
+{
+    if (!mExtensionSet.isBuilt())
+    {
+        const ArrayView<VkExtensionProperties> extensionProperties{ getExtensionProperties() };
+        mExtensionSet.build(extensionProperties.size(), [&extensionProperties](size_t i) { return extensionProperties[i].extensionName; });
+    }
+
+    return mExtensionSet.contains(name);
+}
+
+template<typename T>
+ArrayView<T> PhysicalDeviceRecord::getArray(uint32_t offset, uint32_t count) const
+{
+    return { reinterpret_cast<const T*>(reinterpret_cast<const uint8_t*>(mCapabilities) + offset), count };
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "NameSet.h"
+#include "VulkanDispatch.h"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+/// Read-only view of count elements stored in a capability block
+template<typename T>
+struct ArrayView
+{
+	const T* data{ nullptr };
+	uint32_t count{ 0u };
+
+	const T* begin() const { return data; }
+	const T* end() const { return data + count; }
+	uint32_t size() const { return count; }
+	bool empty() const { return count == 0u; }
+	const T& operator[](size_t index) const { return data[index]; }
+};
+
+/// Fixed part of the capabilities of one physical device. The layer, extension
+/// and queue family arrays follow it in the same block, offsets are relative to
+/// the start of the block so it can be copied or memory mapped as is.
+struct PhysicalDeviceCapabilities
+{
+	VkPhysicalDeviceProperties properties;
+	VkPhysicalDeviceFeatures features;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	VkPhysicalDeviceVulkan11Properties properties11;	// Vulkan 1.1/1.2 structs are zero (apart of sType)
+	VkPhysicalDeviceVulkan12Properties properties12;	// for devices below Vulkan 1.2, pNext is always nullptr
+	VkPhysicalDeviceVulkan11Features features11;
+	VkPhysicalDeviceVulkan12Features features12;
+	uint32_t layerPropertyCount;
+	uint32_t layerPropertyOffset;
+	uint32_t extensionPropertyCount;
+	uint32_t extensionPropertyOffset;
+	uint32_t queueFamilyPropertyCount;
+	uint32_t queueFamilyPropertyOffset;
+	uint32_t blockSize;						// size of the whole block including the arrays
+	uint32_t reserved;
+};
+
+/// Everything App knows about one physical device, gathered in a single pass
+/// into one contiguous block
+class PhysicalDeviceRecord
+{
+public:
+	PhysicalDeviceRecord() = default;
+	PhysicalDeviceRecord(const PhysicalDeviceRecord&) = delete;
+	PhysicalDeviceRecord& operator=(const PhysicalDeviceRecord&) = delete;
+	PhysicalDeviceRecord(PhysicalDeviceRecord&&) = default;				// block is owned by mStorage and moves with it
+	PhysicalDeviceRecord& operator=(PhysicalDeviceRecord&&) = default;
+
+	/// Query layers, extensions, properties, features, memory properties and
+	/// queue family properties of physicalDevice
+	VkResult query(const InstanceDispatch& dispatch, VkPhysicalDevice physicalDevice);
+
+	/// Use a block owned by someone else (e.g. a memory mapped capability cache),
+	/// the block must outlive the record
+	void attach(VkPhysicalDevice physicalDevice, const PhysicalDeviceCapabilities* capabilities);
+
+	/// Block with all capabilities, PhysicalDeviceCapabilities::blockSize bytes
+	const PhysicalDeviceCapabilities* getCapabilities() const { return mCapabilities; }
+
+	VkPhysicalDevice getPhysicalDevice() const { return mPhysicalDevice; }
+	const VkPhysicalDeviceProperties& getProperties() const { return mCapabilities->properties; }
+	const VkPhysicalDeviceFeatures& getFeatures() const { return mCapabilities->features; }
+	const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const { return mCapabilities->memoryProperties; }
+	const VkPhysicalDeviceVulkan11Properties& getProperties11() const { return mCapabilities->properties11; }
+	const VkPhysicalDeviceVulkan12Properties& getProperties12() const { return mCapabilities->properties12; }
+	const VkPhysicalDeviceVulkan11Features& getFeatures11() const { return mCapabilities->features11; }
+	const VkPhysicalDeviceVulkan12Features& getFeatures12() const { return mCapabilities->features12; }
+	ArrayView<VkLayerProperties> getLayerProperties() const;
+	ArrayView<VkExtensionProperties> getExtensionProperties() const;
+	ArrayView<VkQueueFamilyProperties> getQueueFamilyProperties() const;
+
+	/// Whether the device supports the layer/extension, one hash probe. The name
+	/// index is built on the first call (not thread safe), not at all for
+	/// records nobody asks.
+	bool hasLayer(const NameHash& name) const;
+	bool hasExtension(const NameHash& name) const;
+private:
+	template<typename T>
+	ArrayView<T> getArray(uint32_t offset, uint32_t count) const;
+
+	VkPhysicalDevice mPhysicalDevice{ VK_NULL_HANDLE };
+	std::vector<uint64_t> mStorage;			// owned block, 8 byte aligned (empty when attached)
+	const PhysicalDeviceCapabilities* mCapabilities{ nullptr };
+	mutable NameSet mLayerSet;				// names point into the block
+	mutable NameSet mExtensionSet;
+};
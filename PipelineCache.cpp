@@ -0,0 +1,311 @@
+#include "PipelineCache.h"
+#include "FileUtils.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // Feedback structures chained into a copy of the create infos, must outlive the create call
+    struct CreationFeedbackStorage
+    {
+        std::vector<VkPipelineCreationFeedbackEXT> pipelineFeedbacks;
+        std::vector<VkPipelineCreationFeedbackEXT> stageFeedbacks;
+        std::vector<VkPipelineCreationFeedbackCreateInfoEXT> createInfos;
+    };
+
+    uint32_t getStageCount(const VkComputePipelineCreateInfo&)
+    {
+        return 1u;
+    }
+
+    uint32_t getStageCount(const VkGraphicsPipelineCreateInfo& createInfo)
+    {
+        return createInfo.stageCount;
+    }
+
+    template <typename CreateInfo>
+    void chainCreationFeedback(std::vector<CreateInfo>& createInfos, CreationFeedbackStorage& storage)
+    {
+        size_t stageCount{ 0u };
+        for (const CreateInfo& createInfo : createInfos)
+            stageCount += getStageCount(createInfo);
+
+        // sized up front, the chain points into the vectors
+        storage.pipelineFeedbacks.assign(createInfos.size(), VkPipelineCreationFeedbackEXT{});
+        storage.stageFeedbacks.assign(stageCount, VkPipelineCreationFeedbackEXT{});
+        storage.createInfos.resize(createInfos.size());
+
+        size_t stage{ 0u };
+        for (size_t i{ 0u }; i < createInfos.size(); ++i)
+        {
+            storage.createInfos[i] = {
+                VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT, // VkStructureType sType; // type of creation feedback structure
+                createInfos[i].pNext,           // const void* pNext;                           // rest of the caller's chain
+                &storage.pipelineFeedbacks[i],  // VkPipelineCreationFeedbackEXT* pPipelineCreationFeedback; // output - whole pipeline
+                getStageCount(createInfos[i]),  // uint32_t pipelineStageCreationFeedbackCount; // one per shader stage
+                storage.stageFeedbacks.data() + stage // VkPipelineCreationFeedbackEXT* pPipelineStageCreationFeedbacks; // output - per stage
+            };
+            createInfos[i].pNext = &storage.createInfos[i];
+            stage += getStageCount(createInfos[i]);
+        }
+    }
+}
+
+PipelineCache::PipelineCache()
+    : mDevice(VK_NULL_HANDLE)
+    , mDispatch(nullptr)
+    , mAllocationCallbacks(nullptr)
+    , mProperties{}
+    , mCreationFeedback(false)
+    , mPipelineCache(VK_NULL_HANDLE)
+    , mDirty(false)
+{
+}
+
+VkResult PipelineCache::init(VkDevice device, const DeviceDispatch& dispatch, const PhysicalDeviceRecord& record,
+    const VkAllocationCallbacks* allocationCallbacks, const std::string& path, bool creationFeedback)
+{
+    // 1) map cache file of the previous run
+    // 2) check its header against the device, drivers are not required to survive foreign data
+    // 3) create pipeline cache with the mapped data as initial data - vkCreatePipelineCache
+
+    VkResult result = VK_SUCCESS;
+
+    const Clock::time_point start{ Clock::now() };
+
+    mDevice = device;
+    mDispatch = &dispatch;
+    mAllocationCallbacks = allocationCallbacks;
+    mProperties = record.getProperties();
+    mPath = path;
+    mCreationFeedback = creationFeedback;
+    mStatistics = PipelineCacheStatistics{};
+
+    MappedFile file;
+    const bool compatible{ !mPath.empty() && file.open(mPath) && isCompatible(file.data(), file.size(), mProperties) };
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO, // VkStructureType sType;                 // type of pipeline cache create info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        0u,                                     // VkPipelineCacheCreateFlags flags;            // internally synchronized
+        compatible ? file.size() : 0u,          // size_t initialDataSize;                      // 0 - empty cache
+        compatible ? file.data() : nullptr      // const void* pInitialData;                    // data of vkGetPipelineCacheData of a previous run
+    };
+
+    result = mDispatch->vkCreatePipelineCache(mDevice, &pipelineCacheCreateInfo, mAllocationCallbacks, &mPipelineCache);
+
+    // the header matched but the driver rejected the data - start empty
+    if (result != VK_SUCCESS && compatible)
+    {
+        pipelineCacheCreateInfo.initialDataSize = 0u;
+        pipelineCacheCreateInfo.pInitialData = nullptr;
+        result = mDispatch->vkCreatePipelineCache(mDevice, &pipelineCacheCreateInfo, mAllocationCallbacks, &mPipelineCache);
+        mStatistics.loaded = false;
+    }
+    else
+        mStatistics.loaded = compatible && result == VK_SUCCESS;
+
+    mStatistics.loadedBytes = mStatistics.loaded ? file.size() : 0u;
+    mStatistics.loadTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+
+    // a stale file is replaced at the next save
+    mDirty = !mStatistics.loaded && file.isOpen();
+
+    return result;
+}
+
+void PipelineCache::deinit()
+{
+    if (mPipelineCache != VK_NULL_HANDLE)
+        mDispatch->vkDestroyPipelineCache(mDevice, mPipelineCache, mAllocationCallbacks);
+    mPipelineCache = VK_NULL_HANDLE;
+}
+
+VkResult PipelineCache::merge(const std::vector<std::string>& paths)
+{
+    // Create a temporary cache per compatible file and merge them all at once
+
+    VkResult result = VK_SUCCESS;
+
+    std::vector<VkPipelineCache> srcCaches;
+
+    for (const std::string& path : paths)
+    {
+        MappedFile file;
+        if (!file.open(path) || !isCompatible(file.data(), file.size(), mProperties))
+            continue;
+
+        const VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO, // VkStructureType sType;             // type of pipeline cache create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // VkPipelineCacheCreateFlags flags;            // internally synchronized
+            file.size(),                        // size_t initialDataSize;                      // size of cache data of the other process
+            file.data()                         // const void* pInitialData;                    // cache data of the other process
+        };
+
+        VkPipelineCache srcCache{ VK_NULL_HANDLE };
+        if (mDispatch->vkCreatePipelineCache(mDevice, &pipelineCacheCreateInfo, mAllocationCallbacks, &srcCache) == VK_SUCCESS)
+            srcCaches.push_back(srcCache);
+    }
+
+    if (!srcCaches.empty())
+    {
+        result = mDispatch->vkMergePipelineCaches( // merge pipelines of srcCaches into the cache
+            mDevice,                            // VkDevice device,                             // logical device owning the caches
+            mPipelineCache,                     // VkPipelineCache dstCache,                    // cache to merge into
+            static_cast<uint32_t>(srcCaches.size()), // uint32_t srcCacheCount,                 // number of caches in pSrcCaches
+            srcCaches.data()                    // const VkPipelineCache* pSrcCaches);          // caches to merge from
+        );
+
+        for (VkPipelineCache srcCache : srcCaches)
+            mDispatch->vkDestroyPipelineCache(mDevice, srcCache, mAllocationCallbacks);
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (result == VK_SUCCESS && !srcCaches.empty())
+    {
+        mStatistics.mergedFileCount += static_cast<uint32_t>(srcCaches.size());
+        mDirty = true;
+    }
+
+    return result;
+}
+
+VkResult PipelineCache::save()
+{
+    VkResult result = VK_SUCCESS;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mPath.empty() || mPipelineCache == VK_NULL_HANDLE || !mDirty)
+            return VK_SUCCESS;
+    }
+
+    const Clock::time_point start{ Clock::now() };
+
+    // the cache may grow between the two calls (other threads creating pipelines)
+    std::vector<uint8_t> data;
+    size_t dataSize{ 0u };
+    do
+    {
+        result = mDispatch->vkGetPipelineCacheData(mDevice, mPipelineCache, &dataSize, nullptr);
+        if (result == VK_SUCCESS)
+        {
+            data.resize(dataSize);
+            result = mDispatch->vkGetPipelineCacheData(mDevice, mPipelineCache, &dataSize, data.data());
+        }
+    } while (result == VK_INCOMPLETE);
+
+    if (result == VK_SUCCESS && !writeFileAtomic(mPath, data.data(), dataSize))
+        result = VK_ERROR_UNKNOWN;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (result == VK_SUCCESS)
+    {
+        mStatistics.savedBytes = dataSize;
+        mStatistics.saveTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+        mDirty = false;
+    }
+
+    return result;
+}
+
+VkResult PipelineCache::createComputePipelines(uint32_t createInfoCount, const VkComputePipelineCreateInfo* createInfos, VkPipeline* pipelines)
+{
+    std::vector<VkComputePipelineCreateInfo> chainedCreateInfos(createInfos, createInfos + createInfoCount);
+    CreationFeedbackStorage feedback;
+    if (mCreationFeedback)
+        chainCreationFeedback(chainedCreateInfos, feedback);
+
+    const Clock::time_point start{ Clock::now() };
+    const VkResult result = mDispatch->vkCreateComputePipelines(mDevice, mPipelineCache, createInfoCount, chainedCreateInfos.data(), mAllocationCallbacks, pipelines);
+    const std::chrono::nanoseconds wallTime{ std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start) };
+
+    if (result == VK_SUCCESS)
+        for (uint32_t i{ 0u }; i < createInfoCount; ++i)
+            recordFeedback(mCreationFeedback ? feedback.pipelineFeedbacks[i] : VkPipelineCreationFeedbackEXT{}, wallTime, createInfoCount);
+
+    return result;
+}
+
+VkResult PipelineCache::createGraphicsPipelines(uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo* createInfos, VkPipeline* pipelines)
+{
+    std::vector<VkGraphicsPipelineCreateInfo> chainedCreateInfos(createInfos, createInfos + createInfoCount);
+    CreationFeedbackStorage feedback;
+    if (mCreationFeedback)
+        chainCreationFeedback(chainedCreateInfos, feedback);
+
+    const Clock::time_point start{ Clock::now() };
+    const VkResult result = mDispatch->vkCreateGraphicsPipelines(mDevice, mPipelineCache, createInfoCount, chainedCreateInfos.data(), mAllocationCallbacks, pipelines);
+    const std::chrono::nanoseconds wallTime{ std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start) };
+
+    if (result == VK_SUCCESS)
+        for (uint32_t i{ 0u }; i < createInfoCount; ++i)
+            recordFeedback(mCreationFeedback ? feedback.pipelineFeedbacks[i] : VkPipelineCreationFeedbackEXT{}, wallTime, createInfoCount);
+
+    return result;
+}
+
+PipelineCacheStatistics PipelineCache::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStatistics;
+}
+
+void PipelineCache::printStatistics() const
+{
+    const PipelineCacheStatistics statistics{ getStatistics() };
+
+    std::printf("PipelineCache: %s %zu B in %.3f ms, merged %u files, %llu pipelines (%llu hits, %llu misses) in %.3f ms, saved %zu B in %.3f ms\n",
+        statistics.loaded ? "loaded" : "not loaded", statistics.loadedBytes,
+        std::chrono::duration<double, std::milli>(statistics.loadTime).count(),
+        statistics.mergedFileCount,
+        static_cast<unsigned long long>(statistics.pipelineCount),
+        static_cast<unsigned long long>(statistics.hitCount),
+        static_cast<unsigned long long>(statistics.missCount),
+        std::chrono::duration<double, std::milli>(statistics.creationTime).count(),
+        statistics.savedBytes,
+        std::chrono::duration<double, std::milli>(statistics.saveTime).count());
+}
+
+bool PipelineCache::isCompatible(const void* data, size_t size, const VkPhysicalDeviceProperties& properties)
+{
+    // Header written by the driver at the start of vkGetPipelineCacheData
+    VkPipelineCacheHeaderVersionOne header;
+    if (!data || size < sizeof(header))
+        return false;
+
+    std::memcpy(&header, data, sizeof(header));
+
+    return header.headerSize >= sizeof(header) && header.headerSize <= size
+        && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendorID == properties.vendorID
+        && header.deviceID == properties.deviceID
+        && std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::recordFeedback(const VkPipelineCreationFeedbackEXT& feedback, std::chrono::nanoseconds wallTime, uint32_t pipelineCount)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    ++mStatistics.pipelineCount;
+
+    if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)
+    {
+        mStatistics.creationTime += std::chrono::nanoseconds(feedback.duration);
+
+        if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)
+            ++mStatistics.hitCount;
+        else
+        {
+            ++mStatistics.missCount;
+            mDirty = true;
+        }
+    }
+    else
+    {
+        // no feedback - share of the wall time of the create call, cache content unknown
+        mStatistics.creationTime += wallTime / pipelineCount;
+        mDirty = true;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "PhysicalDeviceRecord.h"
+#include "VulkanDispatch.h"
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Counters of PipelineCache
+struct PipelineCacheStatistics
+{
+	bool loaded{ false };						// initial data was accepted
+	size_t loadedBytes{ 0u };
+	std::chrono::nanoseconds loadTime{ 0 };		// read, validate and vkCreatePipelineCache
+	uint32_t mergedFileCount{ 0u };				// caches of other processes merged
+	uint64_t pipelineCount{ 0u };				// created through createComputePipelines()/createGraphicsPipelines()
+	uint64_t hitCount{ 0u };					// creation feedback reported an application cache hit
+	uint64_t missCount{ 0u };					// creation feedback reported no hit
+	std::chrono::nanoseconds creationTime{ 0 };	// pipeline creation time (feedback duration when available)
+	size_t savedBytes{ 0u };
+	std::chrono::nanoseconds saveTime{ 0 };
+};
+
+/// VkPipelineCache persisted in a file. Data is only handed to the driver
+/// when the header (VkPipelineCacheHeaderVersionOne) matches vendorID,
+/// deviceID and pipelineCacheUUID of the device, so a cache of another GPU or
+/// driver version is discarded instead of relying on the driver to reject it.
+/// Pipelines created through it are counted as hits/misses via
+/// VK_EXT_pipeline_creation_feedback when the extension is enabled.
+/// Thread safe.
+class PipelineCache
+{
+public:
+	PipelineCache();
+
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+
+	/// Create the cache with initial data of path (empty - no file)
+	/// creationFeedback - VK_EXT_pipeline_creation_feedback is enabled on device
+	VkResult init(VkDevice device, const DeviceDispatch& dispatch, const PhysicalDeviceRecord& record,
+		const VkAllocationCallbacks* allocationCallbacks, const std::string& path, bool creationFeedback);
+
+	/// Destroy the cache (does not save)
+	void deinit();
+
+	/// Merge valid caches of paths, e.g. written by worker processes
+	VkResult merge(const std::vector<std::string>& paths);
+
+	/// Write the cache to the path of init() atomically (temporary file + rename).
+	/// Skipped when nothing was added since it was loaded.
+	VkResult save();
+
+	VkPipelineCache getHandle() const { return mPipelineCache; }
+
+	/// vkCreateComputePipelines/vkCreateGraphicsPipelines through the cache with creation feedback chained
+	VkResult createComputePipelines(uint32_t createInfoCount, const VkComputePipelineCreateInfo* createInfos, VkPipeline* pipelines);
+	VkResult createGraphicsPipelines(uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo* createInfos, VkPipeline* pipelines);
+
+	PipelineCacheStatistics getStatistics() const;
+
+	/// Print statistics to stdout
+	void printStatistics() const;
+
+	/// Whether data starts with a pipeline cache header of the device of properties
+	static bool isCompatible(const void* data, size_t size, const VkPhysicalDeviceProperties& properties);
+private:
+	using Clock = std::chrono::steady_clock;
+
+	void recordFeedback(const VkPipelineCreationFeedbackEXT& feedback, std::chrono::nanoseconds wallTime, uint32_t pipelineCount);
+
+	VkDevice mDevice;
+	const DeviceDispatch* mDispatch;
+	const VkAllocationCallbacks* mAllocationCallbacks;
+	VkPhysicalDeviceProperties mProperties;
+	std::string mPath;
+	bool mCreationFeedback;
+	VkPipelineCache mPipelineCache;
+	bool mDirty;								// content changed since load
+
+	mutable std::mutex mMutex;					// statistics only, VkPipelineCache is internally synchronized
+	PipelineCacheStatistics mStatistics;
+};
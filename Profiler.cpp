@@ -0,0 +1,572 @@
+#include "Profiler.h"
+#include "FileUtils.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+namespace
+{
+    // bumped by every init(), a thread's cached buffer of an older init() is looked up again
+    std::atomic<uint64_t> sGeneration{ 0u };
+
+    struct ThreadBufferCache
+    {
+        const void* profiler{ nullptr };
+        uint64_t generation{ 0u };
+        void* buffer{ nullptr };
+    };
+
+    thread_local ThreadBufferCache tThreadBufferCache;
+
+    void appendJsonString(std::string& json, const char* text)
+    {
+        json += '"';
+        for (const char* c{ text ? text : "" }; *c; ++c)
+        {
+            switch (*c)
+            {
+            case '"':   json += "\\\""; break;
+            case '\\':  json += "\\\\"; break;
+            case '\n':  json += "\\n"; break;
+            case '\t':  json += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(*c) < 0x20u)
+                {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(*c));
+                    json += escaped;
+                }
+                else
+                    json += *c;
+            }
+        }
+        json += '"';
+    }
+
+    void appendCompleteEvent(std::string& json, const char* name, uint32_t pid, uint32_t tid, int64_t start, int64_t duration, const char* args)
+    {
+        // "X" complete event, ts and dur in microseconds
+        char buffer[192];
+        json += "{\"ph\":\"X\",\"name\":";
+        appendJsonString(json, name);
+        std::snprintf(buffer, sizeof(buffer), ",\"pid\":%" PRIu32 ",\"tid\":%" PRIu32 ",\"ts\":%.3f,\"dur\":%.3f%s},\n",
+            pid, tid, static_cast<double>(start) * 1e-3, static_cast<double>(duration) * 1e-3, args);
+        json += buffer;
+    }
+
+    void appendNameEvent(std::string& json, const char* type, uint32_t pid, uint32_t tid, const char* name)
+    {
+        char buffer[96];
+        std::snprintf(buffer, sizeof(buffer), "{\"ph\":\"M\",\"name\":\"%s\",\"pid\":%" PRIu32 ",\"tid\":%" PRIu32 ",\"args\":{\"name\":", type, pid, tid);
+        json += buffer;
+        appendJsonString(json, name);
+        json += "}},\n";
+    }
+
+    constexpr uint32_t cCpuProcess{ 1u };
+    constexpr uint32_t cGpuProcess{ 2u };
+}
+
+Profiler::Profiler()
+    : mDevice(VK_NULL_HANDLE)
+    , mDispatch(nullptr)
+    , mAllocationCallbacks(nullptr)
+    , mEnabled(false)
+    , mDebugLabels(false)
+    , mGeneration(0u)
+    , mEpoch(Clock::now())
+    , mQueryPool(VK_NULL_HANDLE)
+    , mTimestampPeriod(1.0)
+    , mGpuSlot(0u)
+    , mFrameIndex(0u)
+    , mGpuZonesDropped(0u)
+    , mGpuOverflowReported(false)
+    , mGpuZonesLost(0u)
+    , mGpuFramesDeferred(0u)
+{
+}
+
+VkResult Profiler::init(VkDevice device, const DeviceDispatch& dispatch, const PhysicalDeviceRecord& record,
+    const std::vector<uint32_t>& queueFamilyIndices, const std::vector<VkQueue>& queues,
+    const VkAllocationCallbacks* allocationCallbacks, bool hostQueryReset, bool debugLabels, const ProfilerConfig& config)
+{
+    // 1) valid timestamp bits of every queue family as a mask, timestampPeriod
+    // 2) create query pool - 2 queries per zone of every frame slot + 1 for calibration, reset from the host
+    // 3) calibrate every family - timestamp on its queue placed at the middle of the CPU time around its submission
+
+    VkResult result = VK_SUCCESS;
+
+    mDevice = device;
+    mDispatch = &dispatch;
+    mAllocationCallbacks = allocationCallbacks;
+    mConfig = config;
+    mDebugLabels = debugLabels && config.debugLabels && dispatch.vkCmdBeginDebugUtilsLabelEXT && dispatch.vkCmdEndDebugUtilsLabelEXT;
+    mGeneration = sGeneration.fetch_add(1u, std::memory_order_relaxed) + 1u;
+    mEpoch = Clock::now();
+    mGpuSlot = 0u;
+    mFrameIndex = 0u;
+    mGpuOverflowReported.store(false, std::memory_order_relaxed);
+    clear();
+
+    // masks are set by calibrate(), zones of other families are dropped
+    const ArrayView<VkQueueFamilyProperties> queueFamilyProperties{ record.getQueueFamilyProperties() };
+    mQueueFamilyClocks.assign(queueFamilyProperties.size(), QueueFamilyClock{});
+    mTimestampPeriod = static_cast<double>(record.getProperties().limits.timestampPeriod);
+
+    std::vector<uint64_t> masks(queueFamilyIndices.size(), 0u);
+    bool timestamps{ false };
+    for (size_t i{ 0u }; i < queueFamilyIndices.size() && i < queues.size(); ++i)
+        if (queueFamilyIndices[i] < queueFamilyProperties.size())
+        {
+            const uint32_t validBits{ queueFamilyProperties[queueFamilyIndices[i]].timestampValidBits };
+            masks[i] = validBits >= 64u ? UINT64_MAX : (uint64_t(1u) << validBits) - 1u;
+            timestamps = timestamps || masks[i] != 0u;
+        }
+
+    // GPU zones need a queue family with timestamps and slots reset from the host
+    const bool gpuZones{ config.framesInFlight > 0u && config.maxGpuZonesPerFrame > 0u && hostQueryReset && timestamps };
+
+    if (gpuZones)
+    {
+        const uint32_t queryCount{ config.framesInFlight * config.maxGpuZonesPerFrame * 2u + 1u };
+
+        const VkQueryPoolCreateInfo queryPoolCreateInfo = {
+            VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, // VkStructureType sType;                 // type of query pool create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // VkQueryPoolCreateFlags flags;                // reserved
+            VK_QUERY_TYPE_TIMESTAMP,            // VkQueryType queryType;                       // vkCmdWriteTimestamp
+            queryCount,                         // uint32_t queryCount;                         // begin + end of every zone slot, calibration query last
+            0u                                  // VkQueryPipelineStatisticFlags pipelineStatistics; // pipeline statistics queries only
+        };
+
+        result = mDispatch->vkCreateQueryPool(mDevice, &queryPoolCreateInfo, mAllocationCallbacks, &mQueryPool);
+
+        // queries start in undefined state
+        if (result == VK_SUCCESS)
+            mDispatch->vkResetQueryPool(mDevice, mQueryPool, 0u, queryCount);
+
+        // a family listed twice is calibrated once
+        for (size_t i{ 0u }; i < masks.size() && result == VK_SUCCESS; ++i)
+            if (masks[i] != 0u && mQueueFamilyClocks[queueFamilyIndices[i]].mask == 0u)
+                result = calibrate(queueFamilyIndices[i], queues[i], masks[i]);
+
+        mGpuFrames.reset(new GpuFrame[config.framesInFlight]);
+        for (uint32_t slot{ 0u }; slot < config.framesInFlight; ++slot)
+            mGpuFrames[slot].zones.reset(new GpuZone[config.maxGpuZonesPerFrame]);
+    }
+
+    if (result == VK_SUCCESS)
+        setEnabled(config.enabled);
+
+    return result;
+}
+
+void Profiler::deinit()
+{
+    setEnabled(false);
+
+    if (mDevice == VK_NULL_HANDLE)
+        return;
+
+    if (mQueryPool != VK_NULL_HANDLE)
+        mDispatch->vkDestroyQueryPool(mDevice, mQueryPool, mAllocationCallbacks);
+
+    mQueryPool = VK_NULL_HANDLE;
+    mGpuFrames.reset();
+    mDevice = VK_NULL_HANDLE;
+}
+
+VkResult Profiler::calibrate(uint32_t queueFamilyIndex, VkQueue queue, uint64_t mask)
+{
+    // One timestamp submitted alone, the GPU wrote it between submission and fence wait.
+    // Drift between the clocks is not corrected, fine for traces of minutes.
+
+    VkResult result = VK_SUCCESS;
+
+    const uint32_t calibrationQuery{ mConfig.framesInFlight * mConfig.maxGpuZonesPerFrame * 2u };
+
+    // the query of the previous family's calibration is available, reset it for this one
+    mDispatch->vkResetQueryPool(mDevice, mQueryPool, calibrationQuery, 1u);
+
+    VkCommandPool commandPool{ VK_NULL_HANDLE };
+    VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+    VkFence fence{ VK_NULL_HANDLE };
+
+    const VkCommandPoolCreateInfo commandPoolCreateInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, // VkStructureType sType;                   // type of command pool create info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,   // VkCommandPoolCreateFlags flags;              // one submission
+        queueFamilyIndex                        // uint32_t queueFamilyIndex;                   // family of the calibrated queue
+    };
+
+    result = mDispatch->vkCreateCommandPool(mDevice, &commandPoolCreateInfo, mAllocationCallbacks, &commandPool);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, // VkStructureType sType;           // type of command buffer allocate info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            commandPool,                        // VkCommandPool commandPool;                   // pool created above
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,    // VkCommandBufferLevel level;                  // submitted directly
+            1u                                  // uint32_t commandBufferCount;
+        };
+
+        result = mDispatch->vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &commandBuffer);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkFenceCreateInfo fenceCreateInfo = {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, // VkStructureType sType;                      // type of fence create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u                                  // VkFenceCreateFlags flags;                    // unsignaled
+        };
+
+        result = mDispatch->vkCreateFence(mDevice, &fenceCreateInfo, mAllocationCallbacks, &fence);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, // VkStructureType sType;              // type of command buffer begin info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // VkCommandBufferUsageFlags flags;    // submitted once
+            nullptr                             // const VkCommandBufferInheritanceInfo* pInheritanceInfo; // primary command buffer
+        };
+
+        result = mDispatch->vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        mDispatch->vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, calibrationQuery);
+        result = mDispatch->vkEndCommandBuffer(commandBuffer);
+    }
+
+    Clock::time_point submitTime;
+    Clock::time_point completeTime;
+    if (result == VK_SUCCESS)
+    {
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,      // VkStructureType sType;                       // type of submit info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // uint32_t waitSemaphoreCount;                 // nothing to wait for
+            nullptr,                            // const VkSemaphore* pWaitSemaphores;
+            nullptr,                            // const VkPipelineStageFlags* pWaitDstStageMask;
+            1u,                                 // uint32_t commandBufferCount;
+            &commandBuffer,                     // const VkCommandBuffer* pCommandBuffers;      // the timestamp
+            0u,                                 // uint32_t signalSemaphoreCount;
+            nullptr                             // const VkSemaphore* pSignalSemaphores;
+        };
+
+        submitTime = Clock::now();
+        result = mDispatch->vkQueueSubmit(queue, 1u, &submitInfo, fence);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        result = mDispatch->vkWaitForFences(mDevice, 1u, &fence, VK_TRUE, UINT64_MAX);
+        completeTime = Clock::now();
+    }
+
+    uint64_t timestamp{ 0u };
+    if (result == VK_SUCCESS)
+        result = mDispatch->vkGetQueryPoolResults(mDevice, mQueryPool, calibrationQuery, 1u, sizeof(timestamp), &timestamp,
+            sizeof(timestamp), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+    if (result == VK_SUCCESS)
+    {
+        QueueFamilyClock& clock = mQueueFamilyClocks[queueFamilyIndex];
+        clock.mask = mask;
+        clock.anchorTimestamp = timestamp & mask;
+        clock.anchorTime = std::chrono::duration_cast<std::chrono::nanoseconds>(submitTime - mEpoch).count()
+            + std::chrono::duration_cast<std::chrono::nanoseconds>(completeTime - submitTime).count() / 2;
+    }
+
+    if (fence != VK_NULL_HANDLE)
+        mDispatch->vkDestroyFence(mDevice, fence, mAllocationCallbacks);
+    if (commandPool != VK_NULL_HANDLE)
+        mDispatch->vkDestroyCommandPool(mDevice, commandPool, mAllocationCallbacks);
+
+    return result;
+}
+
+Profiler::ThreadBuffer* Profiler::getThreadBuffer()
+{
+    // Cached per thread, the lookup under the lock happens once per thread and init()
+
+    ThreadBufferCache& cache = tThreadBufferCache;
+    if (cache.profiler == this && cache.generation == mGeneration)
+        return static_cast<ThreadBuffer*>(cache.buffer);
+
+    const std::thread::id threadId{ std::this_thread::get_id() };
+
+    std::lock_guard<std::mutex> lock(mThreadBufferMutex);
+
+    ThreadBuffer* buffer{ nullptr };
+    for (const std::unique_ptr<ThreadBuffer>& threadBuffer : mThreadBuffers)
+        if (threadBuffer->threadId == threadId)
+        {
+            buffer = threadBuffer.get();
+            break;
+        }
+
+    if (!buffer)
+    {
+        mThreadBuffers.emplace_back(new ThreadBuffer);
+        buffer = mThreadBuffers.back().get();
+        buffer->threadId = threadId;
+        buffer->index = static_cast<uint32_t>(mThreadBuffers.size());
+    }
+
+    cache.profiler = this;
+    cache.generation = mGeneration;
+    cache.buffer = buffer;
+
+    return buffer;
+}
+
+void Profiler::recordCpuZone(const char* name, Clock::time_point start, Clock::time_point end)
+{
+    ThreadBuffer* buffer{ getThreadBuffer() };
+    if (buffer->events.size() >= mConfig.maxCpuZonesPerThread)
+    {
+        ++buffer->droppedCount;
+        return;
+    }
+
+    buffer->events.push_back({
+        name,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(start - mEpoch).count(),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()
+    });
+}
+
+uint32_t Profiler::beginGpuZone(VkCommandBuffer commandBuffer, uint32_t queueFamilyIndex, const char* name)
+{
+    // Label first, the timestamps then cover only the commands of the zone
+
+    if (mDebugLabels)
+    {
+        const VkDebugUtilsLabelEXT label = {
+            VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, // VkStructureType sType;                  // type of debug label structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            name,                               // const char* pLabelName;                      // shown by capture tools
+            { 0.0f, 0.0f, 0.0f, 0.0f }          // float color[4];                              // all zero - tool's default color
+        };
+
+        mDispatch->vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
+    }
+
+    if (mQueryPool == VK_NULL_HANDLE || queueFamilyIndex >= mQueueFamilyClocks.size() || mQueueFamilyClocks[queueFamilyIndex].mask == 0u)
+    {
+        mGpuZonesDropped.fetch_add(1u, std::memory_order_relaxed);
+        return cInvalidZone;
+    }
+
+    GpuFrame& frame = mGpuFrames[mGpuSlot];
+    const uint32_t index{ frame.zoneCount.fetch_add(1u, std::memory_order_relaxed) };
+    if (index >= mConfig.maxGpuZonesPerFrame)
+    {
+        // the slot only fills up this far when beginFrame() is not called, could not move on or the frame is too large
+        if (!mGpuOverflowReported.exchange(true, std::memory_order_relaxed))
+            std::printf("Profiler: more than %" PRIu32 " GPU zones in frame %" PRIu64 ", further zones are dropped (%s)\n",
+                mConfig.maxGpuZonesPerFrame, mFrameIndex, mFrameIndex == 0u ? "beginFrame() was never called"
+                : mGpuFramesDeferred > 0u ? "beginFrame() waits for a slot still executing" : "raise maxGpuZonesPerFrame");
+
+        mGpuZonesDropped.fetch_add(1u, std::memory_order_relaxed);
+        return cInvalidZone;
+    }
+
+    frame.zones[index] = { name, queueFamilyIndex };
+
+    const uint32_t zone{ mGpuSlot * mConfig.maxGpuZonesPerFrame + index };
+    mDispatch->vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, zone * 2u);
+
+    return zone;
+}
+
+void Profiler::endGpuZone(VkCommandBuffer commandBuffer, uint32_t zone)
+{
+    if (zone != cInvalidZone)
+        mDispatch->vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, zone * 2u + 1u);
+
+    if (mDebugLabels)
+        mDispatch->vkCmdEndDebugUtilsLabelEXT(commandBuffer);
+}
+
+void Profiler::beginFrame()
+{
+    if (mQueryPool == VK_NULL_HANDLE)
+        return;
+
+    // the slot's previous frame was submitted framesInFlight frames ago, while it
+    // still executes this frame's zones go on in the current slot
+    const uint32_t slot{ (mGpuSlot + 1u) % mConfig.framesInFlight };
+    if (!collectGpuFrame(slot, false))
+    {
+        ++mGpuFramesDeferred;
+        return;
+    }
+
+    mGpuSlot = slot;
+    mGpuFrames[mGpuSlot].frameIndex = ++mFrameIndex;
+}
+
+void Profiler::flush()
+{
+    if (mQueryPool == VK_NULL_HANDLE)
+        return;
+
+    // oldest slot first, keeps the anchors moving forward
+    for (uint32_t i{ 1u }; i <= mConfig.framesInFlight; ++i)
+        collectGpuFrame((mGpuSlot + i) % mConfig.framesInFlight, true);
+}
+
+bool Profiler::collectGpuFrame(uint32_t slot, bool idle)
+{
+    // Read back the timestamps without waiting and reset the slot for its next frame.
+    // A timestamp that is not available yet may belong to a submission still executing,
+    // its query must not be reset - the slot is left as is and false returned. With the
+    // device idle (idle) such timestamps were never submitted and are counted as lost.
+
+    GpuFrame& frame = mGpuFrames[slot];
+    const uint32_t zoneCount{ std::min(frame.zoneCount.load(std::memory_order_relaxed), mConfig.maxGpuZonesPerFrame) };
+    if (zoneCount == 0u)
+        return true;
+
+    const uint32_t firstQuery{ slot * mConfig.maxGpuZonesPerFrame * 2u };
+    const uint32_t queryCount{ zoneCount * 2u };
+
+    // value + availability per query, VK_NOT_READY only means some are not available
+    mQueryResults.resize(static_cast<size_t>(queryCount) * 2u);
+    const VkResult result = mDispatch->vkGetQueryPoolResults(mDevice, mQueryPool, firstQuery, queryCount,
+        mQueryResults.size() * sizeof(uint64_t), mQueryResults.data(), 2u * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    if (result == VK_NOT_READY && !idle)
+        for (uint32_t query{ 0u }; query < queryCount; ++query)
+            if (mQueryResults[query * 2u + 1u] == 0u)
+                return false;
+
+    for (uint32_t i{ 0u }; i < zoneCount; ++i)
+    {
+        const uint64_t* begin{ &mQueryResults[i * 4u] };
+        const uint64_t* end{ &mQueryResults[i * 4u + 2u] };
+        if ((result != VK_SUCCESS && result != VK_NOT_READY) || begin[1] == 0u || end[1] == 0u)
+        {
+            ++mGpuZonesLost;
+            continue;
+        }
+
+        const GpuZone& zone = frame.zones[i];
+        QueueFamilyClock& clock = mQueueFamilyClocks[zone.queueFamilyIndex];
+        const int64_t start{ getGpuTime(begin[0], clock) };
+        const uint64_t ticks{ (end[0] - begin[0]) & clock.mask };
+
+        mGpuEvents.push_back({ zone.name, zone.queueFamilyIndex, frame.frameIndex, start,
+            static_cast<int64_t>(static_cast<double>(ticks) * mTimestampPeriod) });
+    }
+
+    mDispatch->vkResetQueryPool(mDevice, mQueryPool, firstQuery, queryCount);
+    frame.zoneCount.store(0u, std::memory_order_relaxed);
+
+    return true;
+}
+
+int64_t Profiler::getGpuTime(uint64_t timestamp, QueueFamilyClock& clock)
+{
+    // Ticks from the anchor, masked to the family's valid bits so a wrapped
+    // counter still gives the short distance. Timestamps up to half the
+    // counter range behind the anchor are negative. The anchor moves along
+    // so slow wrapping counters are unwrapped over any run time.
+
+    const uint64_t mask{ clock.mask };
+    uint64_t delta{ (timestamp - clock.anchorTimestamp) & mask };
+    int64_t ticks{ static_cast<int64_t>(delta) };
+    if (delta > (mask >> 1))
+        ticks = -static_cast<int64_t>((~delta & mask) + 1u);
+
+    const int64_t time{ clock.anchorTime + static_cast<int64_t>(static_cast<double>(ticks) * mTimestampPeriod) };
+    if (ticks > 0)
+    {
+        clock.anchorTimestamp += static_cast<uint64_t>(ticks);
+        clock.anchorTime = time;
+    }
+
+    return time;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const
+{
+    // {"displayTimeUnit":"ns","traceEvents":[...]}, CPU threads are tracks of
+    // process 1, GPU queue families tracks of process 2
+
+    std::string json;
+    json.reserve(256u + 128u * getStatistics().cpuZoneCount + 160u * mGpuEvents.size());
+    json += "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+    appendNameEvent(json, "process_name", cCpuProcess, 0u, "CPU");
+    for (const std::unique_ptr<ThreadBuffer>& threadBuffer : mThreadBuffers)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "Thread %" PRIu32, threadBuffer->index);
+        appendNameEvent(json, "thread_name", cCpuProcess, threadBuffer->index, name);
+
+        for (const CpuEvent& event : threadBuffer->events)
+            appendCompleteEvent(json, event.name, cCpuProcess, threadBuffer->index, event.start, event.duration, "");
+    }
+
+    appendNameEvent(json, "process_name", cGpuProcess, 0u, "GPU");
+    for (uint32_t queueFamilyIndex{ 0u }; queueFamilyIndex < mQueueFamilyClocks.size(); ++queueFamilyIndex)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "Queue family %" PRIu32, queueFamilyIndex);
+        appendNameEvent(json, "thread_name", cGpuProcess, queueFamilyIndex, name);
+    }
+
+    for (const GpuEvent& event : mGpuEvents)
+    {
+        char args[48];
+        std::snprintf(args, sizeof(args), ",\"args\":{\"frame\":%" PRIu64 "}", event.frameIndex);
+        appendCompleteEvent(json, event.name, cGpuProcess, event.queueFamilyIndex, event.start, event.duration, args);
+    }
+
+    // drop the separator of the last event (a metadata event always precedes it)
+    json.resize(json.size() - 2u);
+    json += "\n]}\n";
+
+    return writeFileAtomic(path, json.data(), json.size());
+}
+
+void Profiler::clear()
+{
+    std::lock_guard<std::mutex> lock(mThreadBufferMutex);
+    for (const std::unique_ptr<ThreadBuffer>& threadBuffer : mThreadBuffers)
+    {
+        threadBuffer->events.clear();
+        threadBuffer->droppedCount = 0u;
+    }
+
+    mGpuEvents.clear();
+    mGpuZonesDropped.store(0u, std::memory_order_relaxed);
+    mGpuZonesLost = 0u;
+    mGpuFramesDeferred = 0u;
+}
+
+ProfilerStatistics Profiler::getStatistics() const
+{
+    ProfilerStatistics statistics;
+    for (const std::unique_ptr<ThreadBuffer>& threadBuffer : mThreadBuffers)
+    {
+        statistics.cpuZoneCount += threadBuffer->events.size();
+        statistics.cpuZonesDropped += threadBuffer->droppedCount;
+    }
+
+    statistics.gpuZoneCount = mGpuEvents.size();
+    statistics.gpuZonesDropped = mGpuZonesDropped.load(std::memory_order_relaxed);
+    statistics.gpuZonesLost = mGpuZonesLost;
+    statistics.gpuFramesDeferred = mGpuFramesDeferred;
+
+    return statistics;
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include "PhysicalDeviceRecord.h"
+#include "VulkanDispatch.h"
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ProfilerConfig
+{
+	bool enabled{ false };						// record zones from init() on, setEnabled() switches at runtime
+	uint32_t framesInFlight{ 3u };				// GPU timestamp slots, a slot is read back when beginFrame() reuses it (0 - CPU zones only)
+	uint32_t maxGpuZonesPerFrame{ 256u };		// further GPU zones of a frame are dropped
+	uint32_t maxCpuZonesPerThread{ 1u << 20 };	// further CPU zones of a thread are dropped
+	bool debugLabels{ true };					// VK_EXT_debug_utils labels around GPU zones when the instance supports the extension
+	std::string tracePath;						// Chrome trace written by App::deinit() (empty - not written)
+};
+
+/// Counters since init()
+struct ProfilerStatistics
+{
+	uint64_t cpuZoneCount{ 0u };				// recorded CPU zones
+	uint64_t cpuZonesDropped{ 0u };				// over maxCpuZonesPerThread
+	uint64_t gpuZoneCount{ 0u };				// GPU zones read back
+	uint64_t gpuZonesDropped{ 0u };				// over maxGpuZonesPerFrame or on families without timestamps or calibration
+	uint64_t gpuZonesLost{ 0u };				// timestamps not available when read back with the device idle (never submitted)
+	uint64_t gpuFramesDeferred{ 0u };			// beginFrame() calls that stayed in the current slot, the next one was still executing
+};
+
+/// Scoped CPU zones and GPU zones backed by timestamp queries, exported as a
+/// Chrome trace (chrome://tracing, Perfetto). CPU zones are appended to a
+/// buffer of the recording thread, threads never share one. GPU zones write
+/// a timestamp pair into the query slot of the current frame, slots are
+/// reset from the host (hostQueryReset) and read back without waiting when
+/// beginFrame() reuses them. A slot with timestamps still pending is not
+/// reset, beginFrame() then keeps recording into the current slot. Without
+/// beginFrame() calls every zone goes to the first slot, zones over
+/// maxGpuZonesPerFrame are dropped and reported once. Timestamps are masked
+/// to timestampValidBits of the zone's queue family, converted with
+/// timestampPeriod and placed on the CPU timeline with one calibration
+/// submission per queue family in init(). With
+/// VK_EXT_debug_utils every GPU zone is also a command buffer label for
+/// capture tools. Disabled, a zone costs one relaxed atomic load.
+/// Zones may be recorded from any thread, the other calls not concurrently with them.
+/// Use the MK_PROFILE_* macros, they compile to nothing with MK_PROFILER_DISABLED.
+class Profiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr uint32_t cInvalidZone{ UINT32_MAX };
+
+	Profiler();
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	/// Create the timestamp query pool (when hostQueryReset is enabled and framesInFlight > 0) and
+	/// calibrate GPU time against CPU time with a submission to queues[i] of queueFamilyIndices[i].
+	/// GPU zones are recorded on these families only, pass every family the subsystems submit to.
+	/// debugLabels - VK_EXT_debug_utils is enabled on the instance
+	VkResult init(VkDevice device, const DeviceDispatch& dispatch, const PhysicalDeviceRecord& record,
+		const std::vector<uint32_t>& queueFamilyIndices, const std::vector<VkQueue>& queues,
+		const VkAllocationCallbacks* allocationCallbacks, bool hostQueryReset, bool debugLabels,
+		const ProfilerConfig& config = ProfilerConfig{});
+
+	/// Destroy the query pool, recorded zones are kept for writeChromeTrace()
+	void deinit();
+
+	bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+	void setEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+
+	/// Start the next frame's GPU zones, reads back the timestamps of the frame that used its slot before.
+	/// While that frame still executes the slot is kept and zones go on in the current one.
+	void beginFrame();
+
+	/// Read back the GPU zones of all frames, call when the device is idle
+	void flush();
+
+	/// Record a CPU zone of the calling thread, name must outlive the profiler (string literal)
+	void recordCpuZone(const char* name, Clock::time_point start, Clock::time_point end);
+
+	/// Write a timestamp at the start of a GPU zone into commandBuffer (submitted to a queue of
+	/// queueFamilyIndex), returns the zone for endGpuZone(). Opens a debug label when enabled.
+	uint32_t beginGpuZone(VkCommandBuffer commandBuffer, uint32_t queueFamilyIndex, const char* name);
+	void endGpuZone(VkCommandBuffer commandBuffer, uint32_t zone);
+
+	/// Write all zones recorded so far as Chrome trace event JSON, CPU threads and GPU queue families are tracks
+	bool writeChromeTrace(const std::string& path) const;
+
+	/// Drop all recorded zones
+	void clear();
+
+	ProfilerStatistics getStatistics() const;
+private:
+	struct CpuEvent
+	{
+		const char* name;
+		int64_t start;							// ns since mEpoch
+		int64_t duration;						// ns
+	};
+
+	struct ThreadBuffer
+	{
+		std::thread::id threadId;
+		uint32_t index{ 0u };					// track of the thread in the trace
+		std::vector<CpuEvent> events;
+		uint64_t droppedCount{ 0u };
+	};
+
+	struct GpuZone
+	{
+		const char* name{ nullptr };
+		uint32_t queueFamilyIndex{ 0u };
+	};
+
+	struct GpuFrame
+	{
+		std::atomic<uint32_t> zoneCount{ 0u };	// zones begun, may exceed maxGpuZonesPerFrame
+		std::unique_ptr<GpuZone[]> zones;
+		uint64_t frameIndex{ 0u };
+	};
+
+	struct QueueFamilyClock
+	{
+		uint64_t mask{ 0u };					// timestampValidBits as mask, 0 - no timestamps or not calibrated
+		uint64_t anchorTimestamp{ 0u };			// last timestamp placed on the CPU timeline ...
+		int64_t anchorTime{ 0 };				// ... and its time, timestamps are unwrapped relative to it
+	};
+
+	struct GpuEvent
+	{
+		const char* name;
+		uint32_t queueFamilyIndex;
+		uint64_t frameIndex;
+		int64_t start;							// ns since mEpoch
+		int64_t duration;						// ns
+	};
+
+	ThreadBuffer* getThreadBuffer();
+	VkResult calibrate(uint32_t queueFamilyIndex, VkQueue queue, uint64_t mask);
+	bool collectGpuFrame(uint32_t slot, bool idle);
+	int64_t getGpuTime(uint64_t timestamp, QueueFamilyClock& clock);
+
+	VkDevice mDevice;
+	const DeviceDispatch* mDispatch;
+	const VkAllocationCallbacks* mAllocationCallbacks;
+	ProfilerConfig mConfig;
+	std::atomic<bool> mEnabled;
+	bool mDebugLabels;							// VK_EXT_debug_utils functions loaded
+	uint64_t mGeneration;						// tells thread buffers of this init() from older ones
+	Clock::time_point mEpoch;
+
+	std::mutex mThreadBufferMutex;				// registration of threads only
+	std::vector<std::unique_ptr<ThreadBuffer>> mThreadBuffers;
+
+	VkQueryPool mQueryPool;						// 2 queries per zone, maxGpuZonesPerFrame * framesInFlight zones
+	std::vector<QueueFamilyClock> mQueueFamilyClocks;	// per queue family of the device
+	double mTimestampPeriod;					// ns per tick
+	std::unique_ptr<GpuFrame[]> mGpuFrames;
+	uint32_t mGpuSlot;							// slot of the current frame
+	uint64_t mFrameIndex;
+	std::atomic<uint64_t> mGpuZonesDropped;
+	std::atomic<bool> mGpuOverflowReported;		// zones over maxGpuZonesPerFrame are reported once per init()
+	uint64_t mGpuZonesLost;
+	uint64_t mGpuFramesDeferred;
+	std::vector<GpuEvent> mGpuEvents;
+	std::vector<uint64_t> mQueryResults;		// scratch of collectGpuFrame(), timestamp + availability per query
+};
+
+/// CPU zone from construction to destruction
+class ProfilerCpuZone
+{
+public:
+	ProfilerCpuZone(Profiler* profiler, const char* name)
+		: mProfiler(profiler && profiler->isEnabled() ? profiler : nullptr)
+		, mName(name)
+	{
+		if (mProfiler)
+			mStart = Profiler::Clock::now();
+	}
+
+	~ProfilerCpuZone()
+	{
+		if (mProfiler)
+			mProfiler->recordCpuZone(mName, mStart, Profiler::Clock::now());
+	}
+
+	ProfilerCpuZone(const ProfilerCpuZone&) = delete;
+	ProfilerCpuZone& operator=(const ProfilerCpuZone&) = delete;
+private:
+	Profiler* mProfiler;
+	const char* mName;
+	Profiler::Clock::time_point mStart;
+};
+
+/// GPU zone around the commands recorded into commandBuffer during its lifetime
+class ProfilerGpuZone
+{
+public:
+	ProfilerGpuZone(Profiler* profiler, VkCommandBuffer commandBuffer, uint32_t queueFamilyIndex, const char* name)
+		: mProfiler(profiler && profiler->isEnabled() ? profiler : nullptr)
+		, mCommandBuffer(commandBuffer)
+		, mZone(mProfiler ? mProfiler->beginGpuZone(commandBuffer, queueFamilyIndex, name) : Profiler::cInvalidZone)
+	{
+	}
+
+	~ProfilerGpuZone()
+	{
+		if (mProfiler)
+			mProfiler->endGpuZone(mCommandBuffer, mZone);
+	}
+
+	ProfilerGpuZone(const ProfilerGpuZone&) = delete;
+	ProfilerGpuZone& operator=(const ProfilerGpuZone&) = delete;
+private:
+	Profiler* mProfiler;
+	VkCommandBuffer mCommandBuffer;
+	uint32_t mZone;
+};
+
+#define MK_PROFILE_CONCAT_(a, b) a##b
+#define MK_PROFILE_CONCAT(a, b) MK_PROFILE_CONCAT_(a, b)
+
+#ifndef MK_PROFILER_DISABLED
+/// Profile the rest of the scope, profiler is a Profiler* (may be nullptr)
+#define MK_PROFILE_CPU_ZONE(profiler, name) \
+	ProfilerCpuZone MK_PROFILE_CONCAT(mkProfileZone, __LINE__)((profiler), (name))
+/// Profile commands recorded into commandBuffer during the rest of the scope
+#define MK_PROFILE_GPU_ZONE(profiler, commandBuffer, queueFamilyIndex, name) \
+	ProfilerGpuZone MK_PROFILE_CONCAT(mkProfileGpuZone, __LINE__)((profiler), (commandBuffer), (queueFamilyIndex), (name))
+#else
+#define MK_PROFILE_CPU_ZONE(profiler, name) ((void)0)
+#define MK_PROFILE_GPU_ZONE(profiler, commandBuffer, queueFamilyIndex, name) ((void)0)
+#endif
@@ -0,0 +1,805 @@
+#include "ResidencyManager.h"
+#include <algorithm>
+#include <cstdio>
+
+ResidencyManager::ResidencyManager()
+    : mDevice(VK_NULL_HANDLE)
+    , mDispatch(nullptr)
+    , mInstanceDispatch(nullptr)
+    , mPhysicalDevice(VK_NULL_HANDLE)
+    , mAllocator(nullptr)
+    , mAllocationCallbacks(nullptr)
+    , mQueue(VK_NULL_HANDLE)
+    , mQueueFamilyIndex(0u)
+    , mProfiler(nullptr)
+    , mQueueMutex(nullptr)
+    , mMemoryProperties{}
+    , mMemoryBudget(false)
+    , mCanEvict(false)
+    , mVirtualEviction(false)
+    , mCommandPool(VK_NULL_HANDLE)
+    , mCommandBuffer(VK_NULL_HANDLE)
+    , mFence(VK_NULL_HANDLE)
+    , mVirtualHostBytes{}
+    , mManagedBytes{}
+    , mUnmanagedBytes{}
+    , mFrameIndex(0u)
+{
+}
+
+VkResult ResidencyManager::init(VkDevice device, const DeviceDispatch& dispatch, const InstanceDispatch& instanceDispatch, const PhysicalDeviceRecord& record,
+    DeviceMemoryAllocator& allocator, uint32_t queueFamilyIndex, VkQueue queue, const VkAllocationCallbacks* allocationCallbacks,
+    bool memoryBudget, const ResidencyManagerConfig& config)
+{
+    // 1) create command pool, command buffer and fence of moves
+    // 2) first budget of every heap
+
+    VkResult result = VK_SUCCESS;
+
+    if (config.framesInFlight == 0u || config.budgetUsage <= 0.0f || config.fallbackBudget <= 0.0f)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mDevice = device;
+    mDispatch = &dispatch;
+    mInstanceDispatch = &instanceDispatch;
+    mPhysicalDevice = record.getPhysicalDevice();
+    mAllocator = &allocator;
+    mAllocationCallbacks = allocationCallbacks;
+    mQueue = queue;
+    mQueueFamilyIndex = queueFamilyIndex;
+    mConfig = config;
+    mMemoryProperties = record.getMemoryProperties();
+    mMemoryBudget = memoryBudget && instanceDispatch.vkGetPhysicalDeviceMemoryProperties2;
+
+    // Eviction needs host visible memory outside of the device local heaps. All memory is device local on
+    // integrated GPUs and software ICDs, under a budget cap host visible memory of the same heap stands in for it.
+    bool hostVisible{ false };
+    bool hostHeap{ false };
+    for (uint32_t i{ 0u }; i < mMemoryProperties.memoryTypeCount; ++i)
+        if (mMemoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+            hostVisible = true;
+            hostHeap = hostHeap || !isDeviceLocalHeap(mMemoryProperties.memoryTypes[i].heapIndex);
+        }
+    mVirtualEviction = !hostHeap && hostVisible && config.budgetCap != 0u;
+    mCanEvict = hostHeap || mVirtualEviction;
+
+    const VkCommandPoolCreateInfo commandPoolCreateInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, // VkStructureType sType;                   // type of command pool create info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,   // VkCommandPoolCreateFlags flags;              // command buffer is re-recorded for every move
+        queueFamilyIndex                        // uint32_t queueFamilyIndex;                   // family of the queue moves are submitted to
+    };
+
+    result = mDispatch->vkCreateCommandPool(mDevice, &commandPoolCreateInfo, mAllocationCallbacks, &mCommandPool);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, // VkStructureType sType;           // type of command buffer allocate info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            mCommandPool,                       // VkCommandPool commandPool;                   // pool to allocate from
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,    // VkCommandBufferLevel level;                  // submitted directly
+            1u                                  // uint32_t commandBufferCount;                 // moves are waited for, one is enough
+        };
+
+        result = mDispatch->vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &mCommandBuffer);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkFenceCreateInfo fenceCreateInfo = {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,    // VkStructureType sType;                   // type of fence create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u                                  // VkFenceCreateFlags flags;                    // unsignaled, signaled by the move submission
+        };
+
+        result = mDispatch->vkCreateFence(mDevice, &fenceCreateInfo, mAllocationCallbacks, &mFence);
+    }
+
+    mResources.clear();
+    mFreeHandles.clear();
+    mRetiredBuffers.clear();
+    mLruLists.fill(LruList{});
+    mHeapBudgets.fill(MemoryHeapBudget{});
+    mVirtualHostBytes.fill(0u);
+    mManagedBytes.fill(0u);
+    mUnmanagedBytes.fill(0u);
+    mFrameIndex = 0u;
+    mStatistics = ResidencyStatistics{};
+
+    if (result == VK_SUCCESS)
+        refreshBudgets();
+
+    return result;
+}
+
+void ResidencyManager::deinit()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mDevice == VK_NULL_HANDLE)
+        return;
+
+    releaseRetired(true);
+    for (Resource& resource : mResources)
+        if (resource.alive)
+            mAllocator->destroyBuffer(resource.buffer, resource.allocation);
+    mResources.clear();
+    mFreeHandles.clear();
+    mLruLists.fill(LruList{});
+
+    if (mFence != VK_NULL_HANDLE)
+        mDispatch->vkDestroyFence(mDevice, mFence, mAllocationCallbacks);
+    if (mCommandPool != VK_NULL_HANDLE)
+        mDispatch->vkDestroyCommandPool(mDevice, mCommandPool, mAllocationCallbacks); // frees the command buffer too
+    mFence = VK_NULL_HANDLE;
+    mCommandPool = VK_NULL_HANDLE;
+    mCommandBuffer = VK_NULL_HANDLE;
+
+    mDevice = VK_NULL_HANDLE;
+}
+
+VkResult ResidencyManager::createBuffer(const VkBufferCreateInfo& createInfo, ResidencyPriority priority, Handle& handle)
+{
+    VkResult result = VK_SUCCESS;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    handle = cInvalidHandle;
+
+    Handle newHandle;
+    if (!mFreeHandles.empty())
+    {
+        newHandle = mFreeHandles.back();
+        mFreeHandles.pop_back();
+    }
+    else
+    {
+        newHandle = static_cast<Handle>(mResources.size());
+        mResources.emplace_back();
+    }
+
+    Resource& resource = mResources[newHandle];
+    resource.createInfo = createInfo;
+    resource.createInfo.pNext = nullptr;
+    resource.createInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (createInfo.sharingMode == VK_SHARING_MODE_CONCURRENT)
+        resource.queueFamilyIndices.assign(createInfo.pQueueFamilyIndices, createInfo.pQueueFamilyIndices + createInfo.queueFamilyIndexCount);
+    resource.priority = priority;
+    resource.lastUsedFrame = mFrameIndex;
+    resource.alive = true;
+
+    // Device local within budget, otherwise host memory the device reads over the bus
+    VkBuffer buffer;
+    MemoryAllocation allocation;
+    bool resident;
+    result = createResourceBuffer(newHandle, Placement::DeviceLocal, buffer, allocation, resident);
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY)
+    {
+        result = createResourceBuffer(newHandle, Placement::PreferHost, buffer, allocation, resident);
+        if (result == VK_SUCCESS)
+            ++mStatistics.oversubscribedCount;
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        setLocation(newHandle, buffer, allocation, resident);
+        handle = newHandle;
+    }
+    else
+    {
+        mResources[newHandle] = Resource{};
+        mFreeHandles.push_back(newHandle);
+    }
+
+    return result;
+}
+
+void ResidencyManager::destroyBuffer(Handle& handle)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (isValid(handle))
+    {
+        Resource& resource = mResources[handle];
+        subtractUsage(resource.allocation, resource.resident);
+        clearLocation(handle);
+        mAllocator->destroyBuffer(resource.buffer, resource.allocation);
+
+        resource = Resource{};
+        mFreeHandles.push_back(handle);
+    }
+
+    handle = cInvalidHandle;
+}
+
+VkBuffer ResidencyManager::use(Handle handle)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!isValid(handle))
+        return VK_NULL_HANDLE;
+
+    // restore before updating lastUsedFrame, the evicted buffer is retired by the frame it was last used in.
+    // Frames in flight may still write the host copy, then it stays until a later use() finds it idle.
+    if (!mResources[handle].resident && !isIdle(mResources[handle]))
+        ++mStatistics.restoresDeferred;
+    else if (!mResources[handle].resident
+        && (mResources[handle].deviceHeapIndex == UINT32_MAX || !makeRoom(mResources[handle].deviceHeapIndex, mResources[handle].memorySize, mResources[handle].priority, false)
+            || move({ handle }, true) != VK_SUCCESS))
+    {
+        // stays in host memory, the device reads it from there
+        ++mStatistics.restoresDenied;
+    }
+
+    // most recently used now
+    Resource& resource = mResources[handle];
+    if (resource.resident)
+        unlink(handle);
+    resource.lastUsedFrame = mFrameIndex;
+    if (resource.resident)
+        link(handle);
+
+    return resource.buffer;
+}
+
+VkResult ResidencyManager::evict(Handle handle)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!isValid(handle))
+        return VK_ERROR_UNKNOWN;
+    if (!mResources[handle].resident)
+        return VK_SUCCESS;
+    if (!mCanEvict)
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+
+    return move({ handle }, false);
+}
+
+void ResidencyManager::setPriority(Handle handle, ResidencyPriority priority)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!isValid(handle))
+        return;
+
+    Resource& resource = mResources[handle];
+    if (resource.resident)
+        unlink(handle);
+    resource.priority = priority;
+    if (resource.resident)
+        link(handle);
+}
+
+VkBuffer ResidencyManager::getBuffer(Handle handle) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return isValid(handle) ? mResources[handle].buffer : VK_NULL_HANDLE;
+}
+
+bool ResidencyManager::isResident(Handle handle) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return isValid(handle) && mResources[handle].resident;
+}
+
+MemoryAllocation ResidencyManager::getAllocation(Handle handle) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return isValid(handle) ? mResources[handle].allocation : MemoryAllocation{};
+}
+
+void ResidencyManager::beginFrame()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    MK_PROFILE_CPU_ZONE(mProfiler, "ResidencyManager beginFrame");
+
+    ++mFrameIndex;
+    releaseRetired(false);
+    refreshBudgets();
+
+    // Over budget (other allocations grew or the driver lowered the budget), evict what is idle
+    for (uint32_t heapIndex{ 0u }; heapIndex < mMemoryProperties.memoryHeapCount; ++heapIndex)
+        if (isDeviceLocalHeap(heapIndex) && mHeapBudgets[heapIndex].usage > getTargetUsage(heapIndex))
+            makeRoom(heapIndex, 0u, ResidencyPriority::High, true);
+}
+
+MemoryHeapBudget ResidencyManager::getHeapBudget(uint32_t heapIndex) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return heapIndex < mMemoryProperties.memoryHeapCount ? mHeapBudgets[heapIndex] : MemoryHeapBudget{};
+}
+
+ResidencyStatistics ResidencyManager::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStatistics;
+}
+
+void ResidencyManager::printStatistics() const
+{
+    const ResidencyStatistics statistics{ getStatistics() };
+
+    std::printf("ResidencyManager statistics (%s)\n", mMemoryBudget ? "VK_EXT_memory_budget" : "estimated budget");
+    std::printf("%-4s %12s %12s %12s\n", "heap", "budget B", "target B", "usage B");
+
+    for (uint32_t i{ 0u }; i < mMemoryProperties.memoryHeapCount; ++i)
+    {
+        if (!isDeviceLocalHeap(i))
+            continue;
+
+        MemoryHeapBudget heapBudget;
+        VkDeviceSize targetUsage;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            heapBudget = mHeapBudgets[i];
+            targetUsage = getTargetUsage(i);
+        }
+        std::printf("%-4u %12llu %12llu %12llu\n", i,
+            static_cast<unsigned long long>(heapBudget.budget),
+            static_cast<unsigned long long>(targetUsage),
+            static_cast<unsigned long long>(heapBudget.usage));
+    }
+
+    std::printf("resident %u (%llu B), evicted %u (%llu B), oversubscribed at creation %llu\n",
+        statistics.residentCount, static_cast<unsigned long long>(statistics.residentBytes),
+        statistics.evictedCount, static_cast<unsigned long long>(statistics.evictedBytes),
+        static_cast<unsigned long long>(statistics.oversubscribedCount));
+    std::printf("evictions %llu (%llu B), restores %llu (%llu B), denied restores %llu, deferred restores %llu, move batches %llu\n",
+        static_cast<unsigned long long>(statistics.evictionCount), static_cast<unsigned long long>(statistics.bytesEvicted),
+        static_cast<unsigned long long>(statistics.restoreCount), static_cast<unsigned long long>(statistics.bytesRestored),
+        static_cast<unsigned long long>(statistics.restoresDenied), static_cast<unsigned long long>(statistics.restoresDeferred),
+        static_cast<unsigned long long>(statistics.moveBatchCount));
+}
+
+void ResidencyManager::refreshBudgets()
+{
+    // Memory of the allocator per heap - used nodes, and reserved blocks of which free nodes are available to moves
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> usedBytes{};
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> reservedBytes{};
+    for (uint32_t i{ 0u }; i < mMemoryProperties.memoryTypeCount; ++i)
+    {
+        const MemoryTypeStatistics statistics{ mAllocator->getStatistics(i) };
+        const uint32_t heapIndex{ mMemoryProperties.memoryTypes[i].heapIndex };
+        usedBytes[heapIndex] += statistics.usedBytes + statistics.dedicatedBytes + statistics.transientBytes;
+        reservedBytes[heapIndex] += statistics.blockBytes + statistics.dedicatedBytes + statistics.transientBytes;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudgetProperties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT, // VkStructureType sType; // type of memory budget properties structure
+        nullptr,                                // void* pNext;                                 // end of the chain
+        {},                                     // VkDeviceSize heapBudget[VK_MAX_MEMORY_HEAPS]; // written by the driver
+        {}                                      // VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS]; // usage of the whole process
+    };
+
+    if (mMemoryBudget)
+    {
+        VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, // VkStructureType sType;    // type of memory properties 2 structure
+            &memoryBudgetProperties,            // void* pNext;                                 // budgets of the heaps
+            {}                                  // VkPhysicalDeviceMemoryProperties memoryProperties; // static, already known
+        };
+
+        mInstanceDispatch->vkGetPhysicalDeviceMemoryProperties2(mPhysicalDevice, &memoryProperties2);
+    }
+
+    for (uint32_t i{ 0u }; i < mMemoryProperties.memoryHeapCount; ++i)
+    {
+        MemoryHeapBudget& heapBudget = mHeapBudgets[i];
+
+        if (mMemoryBudget)
+        {
+            const VkDeviceSize freeBytes{ reservedBytes[i] - usedBytes[i] };
+            heapBudget.budget = memoryBudgetProperties.heapBudget[i];
+            heapBudget.usage = memoryBudgetProperties.heapUsage[i] > freeBytes ? memoryBudgetProperties.heapUsage[i] - freeBytes : 0u;
+        }
+        else
+        {
+            heapBudget.budget = static_cast<VkDeviceSize>(static_cast<double>(mMemoryProperties.memoryHeaps[i].size) * mConfig.fallbackBudget);
+            heapBudget.usage = usedBytes[i];
+        }
+
+        // evicted buffers in device local heaps are host memory to the budget
+        heapBudget.usage -= std::min(heapBudget.usage, mVirtualHostBytes[i]);
+
+        // the cap limits managed buffers, staging memory and other allocations come on top of it
+        mUnmanagedBytes[i] = heapBudget.usage - std::min(heapBudget.usage, mManagedBytes[i]);
+        if (mConfig.budgetCap && isDeviceLocalHeap(i))
+            heapBudget.budget = std::min(heapBudget.budget, mUnmanagedBytes[i] + mConfig.budgetCap);
+    }
+}
+
+VkDeviceSize ResidencyManager::getTargetUsage(uint32_t heapIndex) const
+{
+    const MemoryHeapBudget& heapBudget = mHeapBudgets[heapIndex];
+
+    // budgetUsage is the share of the capped budget left to managed buffers
+    if (mConfig.budgetCap && isDeviceLocalHeap(heapIndex))
+    {
+        const VkDeviceSize unmanagedBytes{ std::min(heapBudget.budget, mUnmanagedBytes[heapIndex]) };
+        return unmanagedBytes + static_cast<VkDeviceSize>(static_cast<double>(heapBudget.budget - unmanagedBytes) * mConfig.budgetUsage);
+    }
+
+    return static_cast<VkDeviceSize>(static_cast<double>(heapBudget.budget) * mConfig.budgetUsage);
+}
+
+void ResidencyManager::addUsage(const MemoryAllocation& allocation, bool resident)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+        return;
+
+    const uint32_t heapIndex{ getHeapIndex(allocation) };
+    if (resident || !mVirtualEviction)
+    {
+        mHeapBudgets[heapIndex].usage += allocation.size;
+        mManagedBytes[heapIndex] += allocation.size;
+    }
+    else
+        mVirtualHostBytes[heapIndex] += allocation.size;
+}
+
+void ResidencyManager::subtractUsage(const MemoryAllocation& allocation, bool resident)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+        return;
+
+    const uint32_t heapIndex{ getHeapIndex(allocation) };
+    if (resident || !mVirtualEviction)
+    {
+        VkDeviceSize& usage = mHeapBudgets[heapIndex].usage;
+        usage -= std::min(usage, allocation.size);
+        mManagedBytes[heapIndex] -= std::min(mManagedBytes[heapIndex], allocation.size);
+    }
+    else
+        mVirtualHostBytes[heapIndex] -= std::min(mVirtualHostBytes[heapIndex], allocation.size);
+}
+
+void ResidencyManager::link(Handle handle)
+{
+    // Insert by lastUsedFrame, at the head unless setPriority() moved an older buffer
+
+    Resource& resource = mResources[handle];
+    LruList& list = mLruLists[static_cast<size_t>(resource.priority)];
+
+    uint32_t next{ list.head };
+    while (next != cNoLink && mResources[next].lastUsedFrame > resource.lastUsedFrame)
+        next = mResources[next].next;
+
+    const uint32_t prev{ next != cNoLink ? mResources[next].prev : list.tail };
+    resource.prev = prev;
+    resource.next = next;
+    (prev != cNoLink ? mResources[prev].next : list.head) = handle;
+    (next != cNoLink ? mResources[next].prev : list.tail) = handle;
+}
+
+void ResidencyManager::unlink(Handle handle)
+{
+    Resource& resource = mResources[handle];
+    LruList& list = mLruLists[static_cast<size_t>(resource.priority)];
+
+    (resource.prev != cNoLink ? mResources[resource.prev].next : list.head) = resource.next;
+    (resource.next != cNoLink ? mResources[resource.next].prev : list.tail) = resource.prev;
+    resource.prev = cNoLink;
+    resource.next = cNoLink;
+}
+
+void ResidencyManager::setLocation(Handle handle, VkBuffer buffer, const MemoryAllocation& allocation, bool resident)
+{
+    Resource& resource = mResources[handle];
+    resource.buffer = buffer;
+    resource.allocation = allocation;
+    resource.resident = resident;
+
+    if (resource.resident)
+    {
+        link(handle);
+        ++mStatistics.residentCount;
+        mStatistics.residentBytes += resource.createInfo.size;
+    }
+    else
+    {
+        ++mStatistics.evictedCount;
+        mStatistics.evictedBytes += resource.createInfo.size;
+    }
+}
+
+void ResidencyManager::clearLocation(Handle handle)
+{
+    Resource& resource = mResources[handle];
+
+    if (resource.resident)
+    {
+        unlink(handle);
+        --mStatistics.residentCount;
+        mStatistics.residentBytes -= resource.createInfo.size;
+    }
+    else
+    {
+        --mStatistics.evictedCount;
+        mStatistics.evictedBytes -= resource.createInfo.size;
+    }
+
+    resource.resident = false;
+}
+
+VkResult ResidencyManager::createResourceBuffer(Handle handle, Placement placement, VkBuffer& buffer, MemoryAllocation& allocation, bool& resident)
+{
+    // 1) create buffer - vkCreateBuffer, requirements are the same for every buffer of the resource
+    // 2) device local memory only when its heap has room, after evicting idle buffers
+    // 3) allocate and bind, the allocator falls back to other memory types when a heap is exhausted
+
+    VkResult result = VK_SUCCESS;
+
+    Resource& resource = mResources[handle];
+
+    buffer = VK_NULL_HANDLE;
+    allocation = MemoryAllocation{};
+    resident = false;
+
+    VkBufferCreateInfo createInfo{ resource.createInfo };
+    createInfo.pQueueFamilyIndices = resource.queueFamilyIndices.empty() ? nullptr : resource.queueFamilyIndices.data();
+
+    result = mDispatch->vkCreateBuffer(mDevice, &createInfo, mAllocationCallbacks, &buffer);
+
+    VkMemoryRequirements requirements{};
+    if (result == VK_SUCCESS)
+    {
+        mDispatch->vkGetBufferMemoryRequirements(mDevice, buffer, &requirements);
+
+        const uint32_t memoryTypeIndex{ mAllocator->findMemoryType(requirements.memoryTypeBits, MemoryUsage::GpuOnly) };
+        const uint32_t heapIndex{ memoryTypeIndex != UINT32_MAX ? mMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex : UINT32_MAX };
+        resource.memorySize = requirements.size;
+        resource.deviceHeapIndex = heapIndex != UINT32_MAX && isDeviceLocalHeap(heapIndex) ? heapIndex : UINT32_MAX;
+    }
+
+    if (result == VK_SUCCESS && placement == Placement::DeviceLocal
+        && (resource.deviceHeapIndex == UINT32_MAX || !makeRoom(resource.deviceHeapIndex, requirements.size, resource.priority, false)))
+        result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+    if (result == VK_SUCCESS)
+        result = mAllocator->allocate(requirements, placement == Placement::DeviceLocal ? MemoryUsage::GpuOnly : MemoryUsage::CpuToGpu,
+            MemoryTiling::Linear, allocation);
+
+    if (result == VK_SUCCESS)
+    {
+        // with virtual eviction host visible memory in a device local heap counts as evicted
+        const bool deviceLocal{ isDeviceLocalHeap(getHeapIndex(allocation)) };
+        resident = mVirtualEviction ? placement == Placement::DeviceLocal : deviceLocal;
+        if (placement == Placement::DeviceLocal && !deviceLocal)
+            result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        else if (placement == Placement::Host && resident)
+            result = VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    if (result == VK_SUCCESS)
+        result = mDispatch->vkBindBufferMemory(mDevice, buffer, allocation.memory, allocation.offset);
+
+    if (result == VK_SUCCESS)
+        addUsage(allocation, resident);
+    else
+        mAllocator->destroyBuffer(buffer, allocation);
+
+    return result;
+}
+
+bool ResidencyManager::makeRoom(uint32_t heapIndex, VkDeviceSize size, ResidencyPriority maxPriority, bool partial)
+{
+    // Evict idle buffers of heapIndex until size more bytes fit the target usage -
+    // lowest priority first, least recently used first within a priority.
+    // Nothing is evicted when that is not enough, unless partial.
+
+    const VkDeviceSize targetUsage{ getTargetUsage(heapIndex) };
+    const VkDeviceSize usage{ mHeapBudgets[heapIndex].usage };
+
+    if (usage + size <= targetUsage)
+        return true;
+    if (!mCanEvict || (size > targetUsage && !partial))
+        return false;
+
+    const VkDeviceSize excessBytes{ usage + size - targetUsage };
+    VkDeviceSize victimBytes{ 0u };
+    std::vector<Handle> victims;
+
+    const size_t maxPriorityIndex{ std::min(static_cast<size_t>(maxPriority), static_cast<size_t>(ResidencyPriority::Pinned) - 1u) };
+    for (size_t priority{ 0u }; priority <= maxPriorityIndex && victimBytes < excessBytes; ++priority)
+        for (uint32_t handle{ mLruLists[priority].tail }; handle != cNoLink && victimBytes < excessBytes; handle = mResources[handle].prev)
+        {
+            const Resource& resource = mResources[handle];
+
+            // the list is ordered by use, the rest was used more recently
+            if (!isIdle(resource))
+                break;
+
+            if (getHeapIndex(resource.allocation) == heapIndex)
+            {
+                victims.push_back(handle);
+                victimBytes += resource.allocation.size;
+            }
+        }
+
+    if (victims.empty() || (victimBytes < excessBytes && !partial))
+        return false;
+
+    move(victims, false);
+
+    return mHeapBudgets[heapIndex].usage + size <= targetUsage;
+}
+
+VkResult ResidencyManager::move(const std::vector<Handle>& handles, bool toDevice)
+{
+    // 1) new buffer of every resource in the destination memory, resources without one stay where they are
+    // 2) copy all of them in one submission and wait for it
+    // 3) retire the old buffers, destroyed once no frame in flight uses them
+
+    MK_PROFILE_CPU_ZONE(mProfiler, toDevice ? "ResidencyManager restore" : "ResidencyManager evict");
+
+    VkResult result = VK_SUCCESS;
+
+    std::vector<Move> moves;
+    moves.reserve(handles.size());
+    for (const Handle handle : handles)
+    {
+        Move move{ handle, VK_NULL_HANDLE, MemoryAllocation{}, false };
+        const VkResult createResult = createResourceBuffer(handle, toDevice ? Placement::DeviceLocal : Placement::Host, move.buffer, move.allocation, move.resident);
+        if (createResult == VK_SUCCESS)
+            moves.push_back(move);
+        else
+            result = createResult;
+    }
+
+    if (moves.empty())
+        return result;
+
+    const VkResult copyResult = submitCopies(moves, toDevice);
+    if (copyResult != VK_SUCCESS)
+        result = copyResult;
+
+    for (Move& move : moves)
+    {
+        Resource& resource = mResources[move.handle];
+
+        if (copyResult == VK_SUCCESS)
+        {
+            retire(resource.buffer, resource.allocation, resource.resident, resource.lastUsedFrame);
+            clearLocation(move.handle);
+            setLocation(move.handle, move.buffer, move.allocation, move.resident);
+
+            if (toDevice)
+            {
+                ++mStatistics.restoreCount;
+                mStatistics.bytesRestored += resource.createInfo.size;
+            }
+            else
+            {
+                ++mStatistics.evictionCount;
+                mStatistics.bytesEvicted += resource.createInfo.size;
+            }
+        }
+        else
+        {
+            subtractUsage(move.allocation, move.resident);
+            mAllocator->destroyBuffer(move.buffer, move.allocation);
+        }
+    }
+
+    return result;
+}
+
+VkResult ResidencyManager::submitCopies(const std::vector<Move>& moves, bool toDevice)
+{
+    VkResult result = VK_SUCCESS;
+
+    // the previous move was waited for, reset all command memory at once
+    result = mDispatch->vkResetCommandPool(mDevice, mCommandPool, 0u);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, // VkStructureType sType;              // type of command buffer begin info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // VkCommandBufferUsageFlags flags;    // recorded again before the next submission
+            nullptr                             // const VkCommandBufferInheritanceInfo* pInheritanceInfo; // primary command buffer
+        };
+
+        result = mDispatch->vkBeginCommandBuffer(mCommandBuffer, &commandBufferBeginInfo);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        MK_PROFILE_GPU_ZONE(mProfiler, mCommandBuffer, mQueueFamilyIndex, toDevice ? "ResidencyManager restore" : "ResidencyManager evict");
+
+        for (const Move& move : moves)
+        {
+            const Resource& resource = mResources[move.handle];
+            const VkBufferCopy bufferCopy{ 0u, 0u, resource.createInfo.size };
+            mDispatch->vkCmdCopyBuffer(mCommandBuffer, resource.buffer, move.buffer, 1u, &bufferCopy);
+        }
+
+        // evicted buffers are mapped, getAllocation() callers may read them
+        if (!toDevice)
+        {
+            const VkMemoryBarrier memoryBarrier = {
+                VK_STRUCTURE_TYPE_MEMORY_BARRIER,   // VkStructureType sType;                   // type of memory barrier structure
+                nullptr,                        // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+                VK_ACCESS_TRANSFER_WRITE_BIT,   // VkAccessFlags srcAccessMask;                 // the copies...
+                VK_ACCESS_HOST_READ_BIT         // VkAccessFlags dstAccessMask;                 // ...are visible to the host once the fence is signaled
+            };
+
+            mDispatch->vkCmdPipelineBarrier(mCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0u,
+                1u, &memoryBarrier, 0u, nullptr, 0u, nullptr);
+        }
+    }
+
+    if (result == VK_SUCCESS)
+        result = mDispatch->vkEndCommandBuffer(mCommandBuffer);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,      // VkStructureType sType;                       // type of submit info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            0u,                                 // uint32_t waitSemaphoreCount;                 // moved buffers are idle on the device
+            nullptr,                            // const VkSemaphore* pWaitSemaphores;
+            nullptr,                            // const VkPipelineStageFlags* pWaitDstStageMask;
+            1u,                                 // uint32_t commandBufferCount;                 // all copies of the move
+            &mCommandBuffer,                    // const VkCommandBuffer* pCommandBuffers;
+            0u,                                 // uint32_t signalSemaphoreCount;               // completion is waited for on the fence
+            nullptr                             // const VkSemaphore* pSignalSemaphores;
+        };
+
+        std::unique_lock<std::mutex> queueLock;
+        if (mQueueMutex)
+            queueLock = std::unique_lock<std::mutex>(*mQueueMutex);
+
+        result = mDispatch->vkQueueSubmit(mQueue, 1u, &submitInfo, mFence);
+    }
+
+    // the old buffers are destroyed by the caller, wait until the copies read them
+    if (result == VK_SUCCESS)
+    {
+        result = mDispatch->vkWaitForFences(mDevice, 1u, &mFence, VK_TRUE, UINT64_MAX);
+        mDispatch->vkResetFences(mDevice, 1u, &mFence);
+        ++mStatistics.moveBatchCount;
+    }
+
+    return result;
+}
+
+void ResidencyManager::retire(VkBuffer buffer, MemoryAllocation allocation, bool resident, uint64_t lastUsedFrame)
+{
+    // Idle buffers go at once, others when the last frame that may use them is done.
+    // Their memory counts as usage until then.
+    const uint64_t releaseFrame{ lastUsedFrame + mConfig.framesInFlight };
+
+    if (releaseFrame <= mFrameIndex)
+    {
+        subtractUsage(allocation, resident);
+        mAllocator->destroyBuffer(buffer, allocation);
+        return;
+    }
+
+    const auto position = std::upper_bound(mRetiredBuffers.begin(), mRetiredBuffers.end(), releaseFrame,
+        [](uint64_t frame, const RetiredBuffer& retired) { return frame < retired.releaseFrame; });
+    mRetiredBuffers.insert(position, RetiredBuffer{ buffer, allocation, resident, releaseFrame });
+}
+
+void ResidencyManager::releaseRetired(bool all)
+{
+    size_t releasedCount{ 0u };
+    for (RetiredBuffer& retired : mRetiredBuffers)
+    {
+        if (!all && retired.releaseFrame > mFrameIndex)
+            break;
+
+        subtractUsage(retired.allocation, retired.resident);
+        mAllocator->destroyBuffer(retired.buffer, retired.allocation);
+        ++releasedCount;
+    }
+
+    mRetiredBuffers.erase(mRetiredBuffers.begin(), mRetiredBuffers.begin() + releasedCount);
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include "DeviceMemoryAllocator.h"
+#include "PhysicalDeviceRecord.h"
+#include "Profiler.h"
+#include "VulkanDispatch.h"
+#include <vulkan/vulkan.h>
+#include <array>
+#include <mutex>
+#include <vector>
+
+/// Eviction order of managed buffers, lower priorities are evicted first
+enum class ResidencyPriority : uint32_t
+{
+	Low,		// streamed data, cheap to demote
+	Normal,
+	High,		// evicted when no idle buffer of a lower priority is left
+	Pinned,		// never evicted
+	Count
+};
+
+constexpr size_t ResidencyPriorityCount{ static_cast<size_t>(ResidencyPriority::Count) };
+
+struct ResidencyManagerConfig
+{
+	uint32_t framesInFlight{ 2u };			// a buffer not used for this many frames is idle on the device and may be evicted (0 - no manager)
+	VkDeviceSize budgetCap{ 0u };			// artificial budget of managed buffers in every device local heap, on top of other allocations of the heap, e.g. to test oversubscription on a software ICD (0 - none)
+	float budgetUsage{ 0.9f };				// share of the budget managed buffers may fill (of budgetCap with a cap), idle buffers are evicted above it
+	float fallbackBudget{ 0.8f };			// budget as share of the heap size without VK_EXT_memory_budget
+};
+
+/// Budget of one memory heap
+struct MemoryHeapBudget
+{
+	VkDeviceSize budget{ 0u };				// bytes the process may use (VK_EXT_memory_budget or fallbackBudget of the heap size, at most other allocations + budgetCap)
+	VkDeviceSize usage{ 0u };				// bytes in use, free space in the allocator's blocks counts as available
+};
+
+/// Counters since init()
+struct ResidencyStatistics
+{
+	uint32_t residentCount{ 0u };			// buffers in device local memory
+	uint32_t evictedCount{ 0u };			// buffers in host memory
+	VkDeviceSize residentBytes{ 0u };
+	VkDeviceSize evictedBytes{ 0u };
+	uint64_t evictionCount{ 0u };			// moves to host memory
+	uint64_t restoreCount{ 0u };			// moves back to device local memory
+	uint64_t bytesEvicted{ 0u };
+	uint64_t bytesRestored{ 0u };
+	uint64_t oversubscribedCount{ 0u };		// buffers created in host memory because the budget was exhausted
+	uint64_t restoresDenied{ 0u };			// use() of an evicted buffer that did not fit the budget
+	uint64_t restoresDeferred{ 0u };		// use() of an evicted buffer frames in flight may still use
+	uint64_t moveBatchCount{ 0u };			// copy submissions, each one waited for
+};
+
+/// Keeps a working set larger than device memory usable. Buffers are created
+/// in device local memory while their heap is within budget. When it is not,
+/// idle buffers are demoted to host visible memory - lowest priority first,
+/// least recently used first within a priority - where the device still
+/// reads them over the bus, and use() brings them back on demand. Budget and
+/// usage of the heaps come from VK_EXT_memory_budget when it is enabled,
+/// otherwise they are estimated from the heap size and the allocator's
+/// statistics. Both are refreshed by beginFrame() and tracked for the
+/// manager's own moves in between.
+/// Moves are copies on queue, waited for before the call returns. The VkBuffer
+/// of a managed buffer changes with every move, take it from use() when
+/// recording and rewrite descriptors that refer to it. The previous buffer of a
+/// move is destroyed framesInFlight frames after its last use, so frames still
+/// executing keep reading valid memory. Without host visible memory outside
+/// of the device local heaps (integrated GPUs, software ICDs) a budgetCap
+/// evicts to host visible memory of the same heap, which counts as host memory
+/// towards the budget, so the policy and its moves still run. Buffers are only
+/// copied on queue, one of another family must be created with concurrent
+/// sharing.
+/// Thread safe. The queue must not be used by other threads during moves,
+/// unless they submit under the lock of setQueueMutex().
+class ResidencyManager
+{
+public:
+	using Handle = uint32_t;
+
+	static constexpr Handle cInvalidHandle{ UINT32_MAX };
+
+	ResidencyManager();
+
+	ResidencyManager(const ResidencyManager&) = delete;
+	ResidencyManager& operator=(const ResidencyManager&) = delete;
+
+	/// Create the command pool and fence of moves for queue of queueFamilyIndex
+	/// memoryBudget - VK_EXT_memory_budget is enabled on the device
+	VkResult init(VkDevice device, const DeviceDispatch& dispatch, const InstanceDispatch& instanceDispatch, const PhysicalDeviceRecord& record,
+		DeviceMemoryAllocator& allocator, uint32_t queueFamilyIndex, VkQueue queue, const VkAllocationCallbacks* allocationCallbacks,
+		bool memoryBudget, const ResidencyManagerConfig& config = ResidencyManagerConfig{});
+
+	/// Destroy remaining buffers and the move objects, the device must be idle
+	void deinit();
+
+	/// Create a buffer (transfer source and destination usage is added). It is
+	/// placed in device local memory when the budget allows, after evicting idle
+	/// buffers of the same or a lower priority, in host memory otherwise.
+	VkResult createBuffer(const VkBufferCreateInfo& createInfo, ResidencyPriority priority, Handle& handle);
+
+	/// Destroy a buffer the device no longer uses
+	void destroyBuffer(Handle& handle);
+
+	/// Mark the buffer used by the current frame and restore it to device local
+	/// memory when it was evicted, fits the budget and is idle. An evicted buffer
+	/// used in the last framesInFlight frames stays in host memory, as those
+	/// frames may still write it, until a later use() finds it idle.
+	/// return buffer to record commands with, valid until the next move of it
+	VkBuffer use(Handle handle);
+
+	/// Move the buffer (Pinned ones too) to host memory now, the device must not use it (no-op for evicted buffers)
+	VkResult evict(Handle handle);
+
+	void setPriority(Handle handle, ResidencyPriority priority);
+
+	/// Current buffer without marking it used, e.g. to upload its contents
+	VkBuffer getBuffer(Handle handle) const;
+
+	bool isResident(Handle handle) const;
+
+	/// Current memory of the buffer, mappedData is set while evicted
+	MemoryAllocation getAllocation(Handle handle) const;
+
+	/// Start the next frame: refresh the heap budgets and evict idle buffers of
+	/// heaps over budget. Call after waiting for the frame submitted framesInFlight frames ago.
+	void beginFrame();
+
+	/// Budget of heapIndex as of the last refresh plus the manager's moves since
+	MemoryHeapBudget getHeapBudget(uint32_t heapIndex) const;
+
+	/// Budgets come from VK_EXT_memory_budget
+	bool hasMemoryBudget() const { return mMemoryBudget; }
+
+	/// Record CPU zones of moves and a GPU zone of every copy submission into profiler (nullptr - none)
+	void setProfiler(Profiler* profiler) { mProfiler = profiler; }
+
+	/// Lock held around submissions when other objects submit to the same queue (nullptr - queue not shared)
+	void setQueueMutex(std::mutex* queueMutex) { mQueueMutex = queueMutex; }
+
+	ResidencyStatistics getStatistics() const;
+
+	/// Print budgets of device local heaps and counters to stdout
+	void printStatistics() const;
+private:
+	static constexpr uint32_t cNoLink{ UINT32_MAX };
+
+	/// Memory a buffer of a resource is created in
+	enum class Placement
+	{
+		DeviceLocal,								// within budget only
+		Host,										// not device local, or host visible in a device local heap with virtual eviction
+		PreferHost									// host memory or where the allocator falls back to
+	};
+
+	struct Resource
+	{
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		MemoryAllocation allocation;
+		VkBufferCreateInfo createInfo{};			// without pNext, pQueueFamilyIndices is set when a buffer is created
+		std::vector<uint32_t> queueFamilyIndices;	// concurrent sharing only
+		VkDeviceSize memorySize{ 0u };				// memory requirements of the buffer
+		uint32_t deviceHeapIndex{ UINT32_MAX };		// heap of device local memory for it (UINT32_MAX - none)
+		ResidencyPriority priority{ ResidencyPriority::Normal };
+		uint64_t lastUsedFrame{ 0u };
+		bool resident{ false };						// allocation counts towards the budget of its device local heap
+		bool alive{ false };
+		uint32_t prev{ cNoLink };					// LRU list of the priority, resident buffers only
+		uint32_t next{ cNoLink };
+	};
+
+	/// Resident buffers of one priority ordered by lastUsedFrame, head is the most recently used
+	struct LruList
+	{
+		uint32_t head{ cNoLink };
+		uint32_t tail{ cNoLink };
+	};
+
+	/// New buffer of a resource being moved
+	struct Move
+	{
+		Handle handle;
+		VkBuffer buffer;
+		MemoryAllocation allocation;
+		bool resident;
+	};
+
+	/// Previous buffer of a move, frames in flight may still read it
+	struct RetiredBuffer
+	{
+		VkBuffer buffer;
+		MemoryAllocation allocation;
+		bool resident;
+		uint64_t releaseFrame;					// destroyed by beginFrame() of this frame
+	};
+
+	bool isValid(Handle handle) const { return handle < mResources.size() && mResources[handle].alive; }
+	uint32_t getHeapIndex(const MemoryAllocation& allocation) const { return mMemoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex; }
+	bool isDeviceLocalHeap(uint32_t heapIndex) const { return (mMemoryProperties.memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0u; }
+	bool isIdle(const Resource& resource) const { return resource.lastUsedFrame + mConfig.framesInFlight <= mFrameIndex; }
+
+	void refreshBudgets();
+	VkDeviceSize getTargetUsage(uint32_t heapIndex) const;
+	void addUsage(const MemoryAllocation& allocation, bool resident);
+	void subtractUsage(const MemoryAllocation& allocation, bool resident);
+
+	void link(Handle handle);
+	void unlink(Handle handle);
+	void setLocation(Handle handle, VkBuffer buffer, const MemoryAllocation& allocation, bool resident);
+	void clearLocation(Handle handle);
+
+	VkResult createResourceBuffer(Handle handle, Placement placement, VkBuffer& buffer, MemoryAllocation& allocation, bool& resident);
+	bool makeRoom(uint32_t heapIndex, VkDeviceSize size, ResidencyPriority maxPriority, bool partial);
+	VkResult move(const std::vector<Handle>& handles, bool toDevice);
+	VkResult submitCopies(const std::vector<Move>& moves, bool toDevice);
+	void retire(VkBuffer buffer, MemoryAllocation allocation, bool resident, uint64_t lastUsedFrame);
+	void releaseRetired(bool all);
+
+	VkDevice mDevice;
+	const DeviceDispatch* mDispatch;
+	const InstanceDispatch* mInstanceDispatch;
+	VkPhysicalDevice mPhysicalDevice;
+	DeviceMemoryAllocator* mAllocator;
+	const VkAllocationCallbacks* mAllocationCallbacks;
+	VkQueue mQueue;
+	uint32_t mQueueFamilyIndex;
+	Profiler* mProfiler;
+	std::mutex* mQueueMutex;
+	ResidencyManagerConfig mConfig;
+	VkPhysicalDeviceMemoryProperties mMemoryProperties;
+	bool mMemoryBudget;
+	bool mCanEvict;									// some host visible memory is not device local, or mVirtualEviction
+	bool mVirtualEviction;							// budget cap without such memory, evicted buffers stay in device local heaps
+
+	mutable std::mutex mMutex;
+	VkCommandPool mCommandPool;
+	VkCommandBuffer mCommandBuffer;
+	VkFence mFence;
+	std::vector<Resource> mResources;				// indexed by Handle
+	std::vector<Handle> mFreeHandles;
+	std::vector<RetiredBuffer> mRetiredBuffers;		// ordered by releaseFrame
+	std::array<LruList, ResidencyPriorityCount> mLruLists;
+	std::array<MemoryHeapBudget, VK_MAX_MEMORY_HEAPS> mHeapBudgets;
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> mVirtualHostBytes;	// evicted memory in each heap with mVirtualEviction, not part of its usage
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> mManagedBytes;		// part of the usage of each heap that is the manager's buffers, retired ones included
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> mUnmanagedBytes;		// rest of the usage as of the last refresh, budgetCap comes on top of it
+	uint64_t mFrameIndex;
+	ResidencyStatistics mStatistics;
+};
@@ -0,0 +1,484 @@
+#include "StagingUploader.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Offset alignment of staging ranges, keeps copies of the driver's memcpy paths aligned
+    constexpr VkDeviceSize cStagingAlignment{ 16u };
+}
+
+StagingUploader::StagingUploader()
+    : mDevice(VK_NULL_HANDLE)
+    , mDispatch(nullptr)
+    , mAllocator(nullptr)
+    , mAllocationCallbacks(nullptr)
+    , mQueue(VK_NULL_HANDLE)
+    , mQueueFamilyIndex(0u)
+    , mProfiler(nullptr)
+    , mQueueMutex(nullptr)
+    , mSemaphore(VK_NULL_HANDLE)
+    , mRingBuffer(VK_NULL_HANDLE)
+    , mFirstPending(0u)
+    , mPendingCount(0u)
+    , mBatchBytes(0u)
+    , mSubmittedTicket(0u)
+    , mCompletedTicket(0u)
+{
+}
+
+VkResult StagingUploader::init(VkDevice device, const DeviceDispatch& dispatch, DeviceMemoryAllocator& allocator, uint32_t queueFamilyIndex,
+    VkQueue queue, const VkAllocationCallbacks* allocationCallbacks, bool timelineSemaphore, const StagingUploaderConfig& config)
+{
+    // 1) create staging buffer in host visible memory, mapped by the allocator for its lifetime
+    // 2) create command pool, command buffer and fence per batch slot
+    // 3) create timeline semaphore of the tickets
+
+    VkResult result = VK_SUCCESS;
+
+    if (config.ringSize == 0u || (config.ringSize & (config.ringSize - 1u)) || config.maxBatches == 0u)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mDevice = device;
+    mDispatch = &dispatch;
+    mAllocator = &allocator;
+    mAllocationCallbacks = allocationCallbacks;
+    mQueue = queue;
+    mQueueFamilyIndex = queueFamilyIndex;
+    mConfig = config;
+    if (mConfig.flushThreshold == 0u || mConfig.flushThreshold > mConfig.ringSize)
+        mConfig.flushThreshold = std::max<VkDeviceSize>(mConfig.ringSize / mConfig.maxBatches, cStagingAlignment);
+
+    const VkBufferCreateInfo bufferCreateInfo = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,   // VkStructureType sType;                       // type of buffer create info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        0u,                                     // VkBufferCreateFlags flags;                   // no sparse binding
+        mConfig.ringSize,                       // VkDeviceSize size;                           // size in bytes
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,       // VkBufferUsageFlags usage;                    // source of vkCmdCopyBuffer
+        VK_SHARING_MODE_EXCLUSIVE,              // VkSharingMode sharingMode;                   // used by the transfer queue only
+        0u,                                     // uint32_t queueFamilyIndexCount;              // (concurrent sharing only)
+        nullptr                                 // const uint32_t* pQueueFamilyIndices;         // (concurrent sharing only)
+    };
+
+    result = mAllocator->createBuffer(bufferCreateInfo, MemoryUsage::CpuToGpu, mRingBuffer, mRingAllocation);
+    if (result == VK_SUCCESS && !mRingAllocation.mappedData)
+        result = VK_ERROR_MEMORY_MAP_FAILED;
+
+    mBatches.resize(mConfig.maxBatches);
+    for (Batch& batch : mBatches)
+    {
+        if (result != VK_SUCCESS)
+            break;
+
+        const VkCommandPoolCreateInfo commandPoolCreateInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, // VkStructureType sType;               // type of command pool create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, // VkCommandPoolCreateFlags flags;            // command buffer is re-recorded for every batch
+            queueFamilyIndex                    // uint32_t queueFamilyIndex;                   // family of the queue batches are submitted to
+        };
+
+        result = mDispatch->vkCreateCommandPool(mDevice, &commandPoolCreateInfo, mAllocationCallbacks, &batch.commandPool);
+
+        if (result == VK_SUCCESS)
+        {
+            const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, // VkStructureType sType;       // type of command buffer allocate info structure
+                nullptr,                        // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+                batch.commandPool,              // VkCommandPool commandPool;                   // pool to allocate from
+                VK_COMMAND_BUFFER_LEVEL_PRIMARY,// VkCommandBufferLevel level;                  // submitted directly
+                1u                              // uint32_t commandBufferCount;                 // one per batch
+            };
+
+            result = mDispatch->vkAllocateCommandBuffers(mDevice, &commandBufferAllocateInfo, &batch.commandBuffer);
+        }
+
+        if (result == VK_SUCCESS)
+        {
+            const VkFenceCreateInfo fenceCreateInfo = {
+                VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,    // VkStructureType sType;               // type of fence create info structure
+                nullptr,                        // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+                0u                              // VkFenceCreateFlags flags;                    // unsignaled, signaled by the batch submission
+            };
+
+            result = mDispatch->vkCreateFence(mDevice, &fenceCreateInfo, mAllocationCallbacks, &batch.fence);
+        }
+    }
+
+    if (result == VK_SUCCESS && timelineSemaphore)
+    {
+        const VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {
+            VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO, // VkStructureType sType;             // type of semaphore type create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_SEMAPHORE_TYPE_TIMELINE,         // VkSemaphoreType semaphoreType;               // 64-bit counter instead of a signaled flag
+            0u                                  // uint64_t initialValue;                       // first batch signals ticket 1
+        };
+
+        const VkSemaphoreCreateInfo semaphoreCreateInfo = {
+            VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, // VkStructureType sType;                  // type of semaphore create info structure
+            &semaphoreTypeCreateInfo,           // const void* pNext;                           // timeline semaphore
+            0u                                  // VkSemaphoreCreateFlags flags;                // reserved for future use
+        };
+
+        result = mDispatch->vkCreateSemaphore(mDevice, &semaphoreCreateInfo, mAllocationCallbacks, &mSemaphore);
+    }
+
+    mRing.reset(new RingAllocator(mConfig.ringSize));
+    mFirstPending = 0u;
+    mPendingCount = 0u;
+    mBatchBytes = 0u;
+    mSubmittedTicket = 0u;
+    mCompletedTicket = 0u;
+    mStatistics = StagingUploaderStatistics{};
+
+    return result;
+}
+
+void StagingUploader::deinit()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mDevice == VK_NULL_HANDLE)
+        return;
+
+    while (mPendingCount > 0u && waitOldestBatch(false) == VK_SUCCESS)
+        ;
+
+    for (Batch& batch : mBatches)
+    {
+        if (batch.fence != VK_NULL_HANDLE)
+            mDispatch->vkDestroyFence(mDevice, batch.fence, mAllocationCallbacks);
+        if (batch.commandPool != VK_NULL_HANDLE)
+            mDispatch->vkDestroyCommandPool(mDevice, batch.commandPool, mAllocationCallbacks); // frees the command buffer too
+    }
+    mBatches.clear();
+
+    if (mSemaphore != VK_NULL_HANDLE)
+        mDispatch->vkDestroySemaphore(mDevice, mSemaphore, mAllocationCallbacks);
+    mSemaphore = VK_NULL_HANDLE;
+
+    mAllocator->destroyBuffer(mRingBuffer, mRingAllocation);
+    mRing.reset();
+    mCopyBuffers.clear();
+    mCopyRegions.clear();
+    mReleaseBarriers.clear();
+    mPendingCount = 0u;
+
+    mDevice = VK_NULL_HANDLE;
+}
+
+VkResult StagingUploader::upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size,
+    uint32_t dstQueueFamilyIndex)
+{
+    VkResult result = VK_SUCCESS;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mStatistics.uploadCount++ == 0u)
+        mFirstUploadTime = Clock::now();
+
+    // Ownership of the whole range is released by the batch of the last chunk,
+    // its barrier also orders the copies of earlier batches on the queue
+    const bool release{ dstQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED && dstQueueFamilyIndex != mQueueFamilyIndex };
+    const VkBufferMemoryBarrier releaseBarrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, // VkStructureType sType;                      // type of buffer memory barrier structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        VK_ACCESS_TRANSFER_WRITE_BIT,           // VkAccessFlags srcAccessMask;                 // the copies
+        0u,                                     // VkAccessFlags dstAccessMask;                 // ignored by a release
+        mQueueFamilyIndex,                      // uint32_t srcQueueFamilyIndex;                // from the transfer family...
+        dstQueueFamilyIndex,                    // uint32_t dstQueueFamilyIndex;                // ...to the family using the buffer next
+        dstBuffer,                              // VkBuffer buffer;
+        dstOffset,                              // VkDeviceSize offset;
+        size                                    // VkDeviceSize size;                           // same range as the acquire of recordAcquire()
+    };
+
+    // Chunks of at most one batch, so a large upload streams through the ring
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    while (size > 0u && result == VK_SUCCESS)
+    {
+        const VkDeviceSize chunkSize{ std::min(size, mConfig.flushThreshold) };
+
+        VkDeviceSize offset;
+        result = allocateRing(chunkSize, offset);
+
+        if (result == VK_SUCCESS)
+        {
+            std::memcpy(static_cast<uint8_t*>(mRingAllocation.mappedData) + offset, src, static_cast<size_t>(chunkSize));
+            result = mAllocator->flush(mRingAllocation, offset, chunkSize);
+        }
+
+        if (result == VK_SUCCESS)
+        {
+            mCopyBuffers.push_back(dstBuffer);
+            mCopyRegions.push_back({ offset, dstOffset, chunkSize });
+            mBatchBytes += chunkSize;
+            mStatistics.bytesUploaded += chunkSize;
+
+            src += chunkSize;
+            dstOffset += chunkSize;
+            size -= chunkSize;
+
+            if (size == 0u && release)
+                mReleaseBarriers.push_back(releaseBarrier);
+
+            if (mBatchBytes >= mConfig.flushThreshold)
+                result = flushLocked(nullptr);
+        }
+    }
+
+    return result;
+}
+
+VkResult StagingUploader::flush(uint64_t* ticket)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return flushLocked(ticket);
+}
+
+bool StagingUploader::isComplete(uint64_t ticket)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    reclaim();
+    return ticket <= mCompletedTicket;
+}
+
+VkResult StagingUploader::wait(uint64_t ticket)
+{
+    VkResult result = VK_SUCCESS;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    reclaim();
+    while (result == VK_SUCCESS && mCompletedTicket < ticket && mPendingCount > 0u)
+        result = waitOldestBatch(false);
+
+    return result;
+}
+
+VkResult StagingUploader::finish()
+{
+    uint64_t ticket{ 0u };
+    VkResult result = flush(&ticket);
+
+    if (result == VK_SUCCESS)
+        result = wait(ticket);
+
+    return result;
+}
+
+void StagingUploader::recordAcquire(VkCommandBuffer commandBuffer, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size,
+    uint32_t dstQueueFamilyIndex, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask) const
+{
+    const VkBufferMemoryBarrier acquireBarrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, // VkStructureType sType;                      // type of buffer memory barrier structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        0u,                                     // VkAccessFlags srcAccessMask;                 // ignored by an acquire
+        dstAccessMask,                          // VkAccessFlags dstAccessMask;                 // first use on the destination family
+        mQueueFamilyIndex,                      // uint32_t srcQueueFamilyIndex;                // same families...
+        dstQueueFamilyIndex,                    // uint32_t dstQueueFamilyIndex;
+        dstBuffer,                              // VkBuffer buffer;
+        dstOffset,                              // VkDeviceSize offset;                         // ...and range as the release of upload()
+        size                                    // VkDeviceSize size;
+    };
+
+    mDispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0u,
+        0u, nullptr, 1u, &acquireBarrier, 0u, nullptr);
+}
+
+StagingUploaderStatistics StagingUploader::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStatistics;
+}
+
+void StagingUploader::resetStatistics()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStatistics = StagingUploaderStatistics{};
+}
+
+VkResult StagingUploader::flushLocked(uint64_t* ticket)
+{
+    // Record all copies since the last flush into the command buffer of a
+    // free batch slot and submit it with the slot's fence
+
+    VkResult result = VK_SUCCESS;
+
+    reclaim();
+
+    if (!mCopyRegions.empty())
+    {
+        MK_PROFILE_CPU_ZONE(mProfiler, "StagingUploader flush");
+
+        if (mPendingCount == mBatches.size())
+            result = waitOldestBatch(true);
+
+        Batch& batch = mBatches[(mFirstPending + mPendingCount) % mBatches.size()];
+
+        if (result == VK_SUCCESS)
+            result = recordBatch(batch);
+
+        if (result == VK_SUCCESS)
+        {
+            const uint64_t value{ mSubmittedTicket + 1u };
+            const VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {
+                VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO, // VkStructureType sType;     // type of timeline semaphore submit info structure
+                nullptr,                        // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+                0u,                             // uint32_t waitSemaphoreValueCount;            // no waits
+                nullptr,                        // const uint64_t* pWaitSemaphoreValues;
+                1u,                             // uint32_t signalSemaphoreValueCount;
+                &value                          // const uint64_t* pSignalSemaphoreValues;      // ticket of the batch
+            };
+
+            const VkSubmitInfo submitInfo = {
+                VK_STRUCTURE_TYPE_SUBMIT_INFO,  // VkStructureType sType;                       // type of submit info structure
+                mSemaphore != VK_NULL_HANDLE ? &timelineSemaphoreSubmitInfo : nullptr, // const void* pNext; // value of the timeline semaphore
+                0u,                             // uint32_t waitSemaphoreCount;                 // staging data is written by the host before submission
+                nullptr,                        // const VkSemaphore* pWaitSemaphores;
+                nullptr,                        // const VkPipelineStageFlags* pWaitDstStageMask;
+                1u,                             // uint32_t commandBufferCount;                 // whole batch is one command buffer
+                &batch.commandBuffer,           // const VkCommandBuffer* pCommandBuffers;
+                mSemaphore != VK_NULL_HANDLE ? 1u : 0u, // uint32_t signalSemaphoreCount;       // other queues wait on the timeline, the host on the fence
+                &mSemaphore                     // const VkSemaphore* pSignalSemaphores;
+            };
+
+            std::unique_lock<std::mutex> queueLock;
+            if (mQueueMutex)
+                queueLock = std::unique_lock<std::mutex>(*mQueueMutex);
+
+            result = mDispatch->vkQueueSubmit(mQueue, 1u, &submitInfo, batch.fence);
+        }
+
+        if (result == VK_SUCCESS)
+        {
+            mRing->endFrame();
+
+            batch.ticket = ++mSubmittedTicket;
+            batch.bytes = mBatchBytes;
+            ++mPendingCount;
+            ++mStatistics.batchCount;
+
+            mCopyBuffers.clear();
+            mCopyRegions.clear();
+            mReleaseBarriers.clear();
+            mBatchBytes = 0u;
+        }
+    }
+
+    if (ticket)
+        *ticket = mSubmittedTicket;
+
+    return result;
+}
+
+VkResult StagingUploader::recordBatch(Batch& batch)
+{
+    VkResult result = VK_SUCCESS;
+
+    // command buffer of the slot finished executing, reset all of its memory at once
+    result = mDispatch->vkResetCommandPool(mDevice, batch.commandPool, 0u);
+
+    if (result == VK_SUCCESS)
+    {
+        const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, // VkStructureType sType;              // type of command buffer begin info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // VkCommandBufferUsageFlags flags;    // recorded again before the next submission
+            nullptr                             // const VkCommandBufferInheritanceInfo* pInheritanceInfo; // primary command buffer
+        };
+
+        result = mDispatch->vkBeginCommandBuffer(batch.commandBuffer, &commandBufferBeginInfo);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        MK_PROFILE_GPU_ZONE(mProfiler, batch.commandBuffer, mQueueFamilyIndex, "StagingUploader batch");
+
+        // one copy command per run of regions with the same destination
+        const size_t len{ mCopyRegions.size() };
+        for (size_t first{ 0u }, last{ 0u }; first < len; first = last)
+        {
+            for (last = first + 1u; last < len && mCopyBuffers[last] == mCopyBuffers[first]; ++last)
+                ;
+
+            mDispatch->vkCmdCopyBuffer(batch.commandBuffer, mRingBuffer, mCopyBuffers[first], static_cast<uint32_t>(last - first), &mCopyRegions[first]);
+            ++mStatistics.copyCount;
+        }
+
+        // host visible destinations are read once the fence is signaled, others are released to their families
+        const VkMemoryBarrier memoryBarrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,   // VkStructureType sType;                       // type of memory barrier structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_ACCESS_TRANSFER_WRITE_BIT,       // VkAccessFlags srcAccessMask;                 // the copies...
+            VK_ACCESS_HOST_READ_BIT             // VkAccessFlags dstAccessMask;                 // ...are visible to the host
+        };
+
+        mDispatch->vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0u, 1u, &memoryBarrier,
+            static_cast<uint32_t>(mReleaseBarriers.size()), mReleaseBarriers.data(), 0u, nullptr);
+    }
+
+    if (result == VK_SUCCESS)
+        result = mDispatch->vkEndCommandBuffer(batch.commandBuffer);
+
+    return result;
+}
+
+void StagingUploader::reclaim()
+{
+    // Batches complete in submission order, release ring memory of the signaled ones
+
+    while (mPendingCount > 0u)
+    {
+        Batch& batch = mBatches[mFirstPending];
+        if (mDispatch->vkGetFenceStatus(mDevice, batch.fence) != VK_SUCCESS)
+            break;
+
+        mDispatch->vkResetFences(mDevice, 1u, &batch.fence);
+        mRing->releaseFrame();
+
+        mCompletedTicket = batch.ticket;
+        mStatistics.bytesCompleted += batch.bytes;
+        mStatistics.elapsedTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - mFirstUploadTime);
+
+        mFirstPending = (mFirstPending + 1u) % static_cast<uint32_t>(mBatches.size());
+        --mPendingCount;
+    }
+}
+
+VkResult StagingUploader::waitOldestBatch(bool stall)
+{
+    const Clock::time_point start{ Clock::now() };
+
+    const VkResult result = mDispatch->vkWaitForFences(mDevice, 1u, &mBatches[mFirstPending].fence, VK_TRUE, UINT64_MAX);
+
+    if (stall)
+        mStatistics.stallTime += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+
+    reclaim();
+
+    return result;
+}
+
+VkResult StagingUploader::allocateRing(VkDeviceSize size, VkDeviceSize& offset)
+{
+    // Make room by submitting the current batch, then by waiting for the oldest batch
+
+    VkResult result = VK_SUCCESS;
+
+    reclaim();
+
+    while (result == VK_SUCCESS && !mRing->allocate(size, cStagingAlignment, offset))
+    {
+        if (!mCopyRegions.empty())
+            result = flushLocked(nullptr);
+        else if (mPendingCount > 0u)
+            result = waitOldestBatch(true);
+        else
+            result = VK_ERROR_OUT_OF_POOL_MEMORY;     // larger than the ring
+    }
+
+    return result;
+}
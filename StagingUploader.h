@@ -0,0 +1,154 @@
+#pragma once
+
+#include "DeviceMemoryAllocator.h"
+#include "Profiler.h"
+#include "SubAllocator.h"
+#include "VulkanDispatch.h"
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct StagingUploaderConfig
+{
+	VkDeviceSize ringSize{ 16u * 1024u * 1024u };	// power of two, persistently mapped staging memory (0 - no uploader)
+	uint32_t maxBatches{ 4u };						// submitted batches in flight before upload() waits
+	VkDeviceSize flushThreshold{ 0u };				// upload() flushes once the batch holds this many bytes (0 - ringSize / maxBatches)
+};
+
+/// Counters since init() or resetStatistics()
+struct StagingUploaderStatistics
+{
+	uint64_t uploadCount{ 0u };
+	uint64_t batchCount{ 0u };						// submitted command buffers
+	uint64_t copyCount{ 0u };						// vkCmdCopyBuffer calls (consecutive copies to one buffer share a call)
+	uint64_t bytesUploaded{ 0u };					// written to the ring
+	uint64_t bytesCompleted{ 0u };					// copied by the device (batch fence signaled)
+	std::chrono::nanoseconds stallTime{ 0 };		// producer blocked on fences for ring space or batch slots
+	std::chrono::nanoseconds elapsedTime{ 0 };		// from first upload to last observed batch completion
+
+	/// Completed bytes per second of elapsed time in MB/s
+	double getThroughput() const
+	{
+		return elapsedTime.count() ? static_cast<double>(bytesCompleted) / (static_cast<double>(elapsedTime.count()) * 1e-9) / (1024.0 * 1024.0) : 0.0;
+	}
+};
+
+/// Streams data to device buffers through a host visible staging ring. Data
+/// is copied into the ring by upload(), the device copies are recorded into
+/// one command buffer per flush() and submitted to a transfer queue. Ring
+/// memory of a batch is reclaimed when its fence is signaled, so the producer
+/// only waits when the ring or all batch slots are in flight.
+/// Every batch signals its ticket on a timeline semaphore (timelineSemaphore
+/// feature), so other queues can wait for uploads on the device. Exclusive
+/// destinations used by another queue family are released to it by the batch
+/// and must be acquired there with recordAcquire(). Copies are made visible
+/// to the host, host visible destinations can be read after wait().
+/// Thread safe. The queue must not be used by other threads during flush(),
+/// unless they submit under the lock of setQueueMutex().
+class StagingUploader
+{
+public:
+	StagingUploader();
+
+	StagingUploader(const StagingUploader&) = delete;
+	StagingUploader& operator=(const StagingUploader&) = delete;
+
+	/// Create the staging ring, command pools and fences for queue of queueFamilyIndex
+	/// timelineSemaphore - the feature is enabled on the device, batches signal getSemaphore()
+	VkResult init(VkDevice device, const DeviceDispatch& dispatch, DeviceMemoryAllocator& allocator, uint32_t queueFamilyIndex,
+		VkQueue queue, const VkAllocationCallbacks* allocationCallbacks, bool timelineSemaphore,
+		const StagingUploaderConfig& config = StagingUploaderConfig{});
+
+	/// Wait for submitted batches and destroy all objects, unflushed uploads are dropped
+	void deinit();
+
+	/// Copy size bytes of data to dstBuffer at dstOffset. Data is in the
+	/// staging ring when the call returns, the device copy is executed after
+	/// the next flush(). Uploads larger than the ring are split. Device copies
+	/// are not ordered against each other, uploads to overlapping destination
+	/// ranges need wait() in between.
+	/// dstQueueFamilyIndex - family using dstBuffer next when it is an exclusive buffer of another family,
+	/// the range is released to it (VK_QUEUE_FAMILY_IGNORED - concurrent sharing or the uploader's family)
+	VkResult upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size,
+		uint32_t dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
+
+	/// Submit all recorded copies as one command buffer
+	/// ticket - optional, output - value to pass to isComplete()/wait()
+	VkResult flush(uint64_t* ticket = nullptr);
+
+	/// Whether the batch of ticket was executed by the device (non-blocking)
+	bool isComplete(uint64_t ticket);
+
+	/// Wait until the batch of ticket was executed by the device
+	VkResult wait(uint64_t ticket);
+
+	/// Flush and wait for all batches
+	VkResult finish();
+
+	/// Timeline semaphore the batch of a ticket signals with the ticket as value, for waits
+	/// of submissions to other queues (VK_NULL_HANDLE - no timelineSemaphore, use wait())
+	VkSemaphore getSemaphore() const { return mSemaphore; }
+
+	uint32_t getQueueFamilyIndex() const { return mQueueFamilyIndex; }
+
+	/// Record the acquire matching an upload() to dstQueueFamilyIndex into commandBuffer of that family.
+	/// Submit it after the batch of the upload, waiting for its ticket on getSemaphore() or by wait().
+	void recordAcquire(VkCommandBuffer commandBuffer, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size,
+		uint32_t dstQueueFamilyIndex, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask) const;
+
+	/// Record CPU zones of flushes and a GPU zone of every batch into profiler (nullptr - none)
+	void setProfiler(Profiler* profiler) { mProfiler = profiler; }
+
+	/// Lock held around submissions when other objects submit to the same queue (nullptr - queue not shared)
+	void setQueueMutex(std::mutex* queueMutex) { mQueueMutex = queueMutex; }
+
+	StagingUploaderStatistics getStatistics() const;
+	void resetStatistics();
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Batch
+	{
+		VkCommandPool commandPool{ VK_NULL_HANDLE };
+		VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+		VkFence fence{ VK_NULL_HANDLE };
+		uint64_t ticket{ 0u };
+		VkDeviceSize bytes{ 0u };
+	};
+
+	VkResult flushLocked(uint64_t* ticket);
+	VkResult recordBatch(Batch& batch);
+	void reclaim();
+	VkResult waitOldestBatch(bool stall);
+	VkResult allocateRing(VkDeviceSize size, VkDeviceSize& offset);
+
+	VkDevice mDevice;
+	const DeviceDispatch* mDispatch;
+	DeviceMemoryAllocator* mAllocator;
+	const VkAllocationCallbacks* mAllocationCallbacks;
+	VkQueue mQueue;
+	uint32_t mQueueFamilyIndex;
+	Profiler* mProfiler;
+	std::mutex* mQueueMutex;
+	StagingUploaderConfig mConfig;
+	VkSemaphore mSemaphore;						// timeline, value of a batch is its ticket
+
+	mutable std::mutex mMutex;
+	VkBuffer mRingBuffer;
+	MemoryAllocation mRingAllocation;
+	std::unique_ptr<RingAllocator> mRing;		// one ring frame per batch
+	std::vector<Batch> mBatches;				// slots, in flight ones are [mFirstPending, mFirstPending + mPendingCount)
+	uint32_t mFirstPending;
+	uint32_t mPendingCount;
+	std::vector<VkBuffer> mCopyBuffers;			// destination of each region recorded by upload() for the next flush()
+	std::vector<VkBufferCopy> mCopyRegions;		// ring range -> destination range
+	std::vector<VkBufferMemoryBarrier> mReleaseBarriers;	// ownership of uploads to other families for the next flush()
+	VkDeviceSize mBatchBytes;
+	uint64_t mSubmittedTicket;					// last submitted
+	uint64_t mCompletedTicket;					// last observed as complete
+
+	StagingUploaderStatistics mStatistics;
+	Clock::time_point mFirstUploadTime;
+};
@@ -0,0 +1,196 @@
+#include "SubAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1u) & ~(alignment - 1u);
+    }
+
+    bool isPowerOfTwo(VkDeviceSize value)
+    {
+        return value != 0u && (value & (value - 1u)) == 0u;
+    }
+
+    VkDeviceSize nextPowerOfTwo(VkDeviceSize value)
+    {
+        VkDeviceSize result{ 1u };
+        while (result < value)
+            result <<= 1u;
+        return result;
+    }
+
+    uint32_t log2(VkDeviceSize value)
+    {
+        uint32_t result{ 0u };
+        while (value > 1u)
+        {
+            value >>= 1u;
+            ++result;
+        }
+        return result;
+    }
+}
+
+BuddyAllocator::BuddyAllocator(VkDeviceSize size, VkDeviceSize minNodeSize)
+    : mSize(size)
+    , mMinNodeSize(minNodeSize)
+    , mMaxOrder(log2(size / minNodeSize))
+    , mFreeNodes(mMaxOrder + 1u)
+    , mUsedSize(0u)
+{
+    assert(isPowerOfTwo(size) && isPowerOfTwo(minNodeSize) && size >= minNodeSize);
+
+    // whole range is one free node
+    mFreeNodes[mMaxOrder].insert(0u);
+}
+
+bool BuddyAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    // Smallest node holding size, nodes are aligned to their size
+    const VkDeviceSize nodeSize{ nextPowerOfTwo(std::max({ size, alignment, mMinNodeSize })) };
+    if (size == 0u || nodeSize > mSize)
+        return false;
+
+    const uint32_t order{ log2(nodeSize / mMinNodeSize) };
+
+    // Smallest free node of at least that order
+    uint32_t freeOrder{ order };
+    while (freeOrder <= mMaxOrder && mFreeNodes[freeOrder].empty())
+        ++freeOrder;
+    if (freeOrder > mMaxOrder)
+        return false;
+
+    offset = *mFreeNodes[freeOrder].begin();
+    mFreeNodes[freeOrder].erase(mFreeNodes[freeOrder].begin());
+
+    // Split down to the requested order, upper halves become free buddies
+    while (freeOrder > order)
+    {
+        --freeOrder;
+        mFreeNodes[freeOrder].insert(offset + getNodeSize(freeOrder));
+    }
+
+    mAllocatedOrders.emplace(offset, order);
+    mUsedSize += nodeSize;
+
+    return true;
+}
+
+void BuddyAllocator::free(VkDeviceSize offset)
+{
+    const auto allocated = mAllocatedOrders.find(offset);
+    assert(allocated != mAllocatedOrders.end());
+    if (allocated == mAllocatedOrders.end())
+        return;
+
+    uint32_t order{ allocated->second };
+    mAllocatedOrders.erase(allocated);
+    mUsedSize -= getNodeSize(order);
+
+    // Merge with the buddy while it is free
+    while (order < mMaxOrder)
+    {
+        const VkDeviceSize buddy{ offset ^ getNodeSize(order) };
+        const auto freeBuddy = mFreeNodes[order].find(buddy);
+        if (freeBuddy == mFreeNodes[order].end())
+            break;
+
+        mFreeNodes[order].erase(freeBuddy);
+        offset = std::min(offset, buddy);
+        ++order;
+    }
+
+    mFreeNodes[order].insert(offset);
+}
+
+VkDeviceSize BuddyAllocator::getLargestFreeNodeSize() const
+{
+    for (uint32_t order{ mMaxOrder + 1u }; order-- > 0u; )
+        if (!mFreeNodes[order].empty())
+            return getNodeSize(order);
+
+    return 0u;
+}
+
+RingAllocator::RingAllocator(VkDeviceSize size)
+    : mSize(size)
+    , mHead(0u)
+    , mTail(0u)
+    , mUsedSize(0u)
+    , mFrameUsedSize(0u)
+{
+}
+
+bool RingAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    if (size == 0u || size > mSize)
+        return false;
+
+    // Nothing live - restart at the beginning, so the whole ring is one free range
+    if (mUsedSize == 0u)
+        mHead = mTail = 0u;
+
+    const VkDeviceSize alignedHead{ alignUp(mHead, alignment) };
+    VkDeviceSize newHead;
+
+    if (mUsedSize == 0u || mHead > mTail)
+    {
+        // Free ranges are [head, size) and [0, tail)
+        if (alignedHead + size <= mSize)
+        {
+            offset = alignedHead;
+            newHead = alignedHead + size;
+        }
+        else if (size <= mTail)
+        {
+            // wrap, the rest of the ring is skipped until the frame is released
+            offset = 0u;
+            newHead = size;
+        }
+        else
+            return false;
+    }
+    else
+    {
+        // Free range is [head, tail), empty when head == tail
+        if (alignedHead + size > mTail)
+            return false;
+
+        offset = alignedHead;
+        newHead = alignedHead + size;
+    }
+
+    const VkDeviceSize consumed{ newHead > mHead ? newHead - mHead : mSize - mHead + newHead };
+    mHead = newHead;
+    mUsedSize += consumed;
+    mFrameUsedSize += consumed;
+
+    return true;
+}
+
+void RingAllocator::endFrame()
+{
+    mFrames.push_back({ mHead, mFrameUsedSize });
+    mFrameUsedSize = 0u;
+}
+
+bool RingAllocator::releaseFrame()
+{
+    if (mFrames.empty())
+        return false;
+
+    const Frame frame{ mFrames.front() };
+    mFrames.pop_front();
+
+    // a frame without allocations has a stale end when the ring restarted since
+    if (frame.usedSize > 0u)
+    {
+        mTail = frame.end;
+        mUsedSize -= frame.usedSize;
+    }
+
+    return true;
+}
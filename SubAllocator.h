@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/// Buddy allocator of offsets in a range of power of two size. Every
+/// allocation is a node of power of two size aligned to its own size, so any
+/// power of two alignment up to the range size is satisfied for free.
+/// Not thread safe.
+class BuddyAllocator
+{
+public:
+	/// size and minNodeSize must be powers of two, size >= minNodeSize
+	BuddyAllocator(VkDeviceSize size, VkDeviceSize minNodeSize);
+
+	/// Allocate node holding size bytes at alignment (power of two)
+	/// return false when no free node is large enough
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+
+	/// Free node at offset returned by allocate(), merging it with free buddies
+	void free(VkDeviceSize offset);
+
+	VkDeviceSize getSize() const { return mSize; }
+	VkDeviceSize getUsedSize() const { return mUsedSize; }				// bytes in allocated nodes
+	VkDeviceSize getLargestFreeNodeSize() const;						// largest allocation that would succeed
+	size_t getAllocationCount() const { return mAllocatedOrders.size(); }
+	bool isEmpty() const { return mAllocatedOrders.empty(); }
+private:
+	VkDeviceSize getNodeSize(uint32_t order) const { return mMinNodeSize << order; }
+
+	VkDeviceSize mSize;
+	VkDeviceSize mMinNodeSize;
+	uint32_t mMaxOrder;												// order of the node spanning the whole range
+	std::vector<std::set<VkDeviceSize>> mFreeNodes;					// offsets of free nodes per order, lowest offset first
+	std::unordered_map<VkDeviceSize, uint32_t> mAllocatedOrders;	// order of each allocated node
+	VkDeviceSize mUsedSize;
+};
+
+/// Ring allocator of offsets for transient per-frame data. Allocations are
+/// released a whole frame at a time, oldest frame first.
+/// Not thread safe.
+class RingAllocator
+{
+public:
+	explicit RingAllocator(VkDeviceSize size);
+
+	/// Allocate size bytes at alignment (power of two) in the current frame
+	/// return false when the ring is full until an older frame is released
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+
+	/// Close the current frame, following allocations belong to the next one
+	void endFrame();
+
+	/// Release the oldest closed frame
+	/// return false when there is no closed frame
+	bool releaseFrame();
+
+	VkDeviceSize getSize() const { return mSize; }
+	VkDeviceSize getUsedSize() const { return mUsedSize; }		// including alignment padding and the gap left by wrapping
+	size_t getPendingFrameCount() const { return mFrames.size(); }	// closed, not released frames
+private:
+	struct Frame
+	{
+		VkDeviceSize end;		// head at endFrame()
+		VkDeviceSize usedSize;	// bytes consumed by the frame
+	};
+
+	VkDeviceSize mSize;
+	VkDeviceSize mHead;			// next free byte
+	VkDeviceSize mTail;			// first byte of the oldest live frame
+	VkDeviceSize mUsedSize;
+	VkDeviceSize mFrameUsedSize;	// bytes consumed by the current frame
+	std::deque<Frame> mFrames;
+};
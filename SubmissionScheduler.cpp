@@ -0,0 +1,303 @@
+#include "SubmissionScheduler.h"
+#include <algorithm>
+
+SubmissionScheduler::SubmissionScheduler()
+    : mDevice(VK_NULL_HANDLE)
+    , mDispatch(nullptr)
+    , mAllocationCallbacks(nullptr)
+    , mMaxBatchesInFlight(0u)
+    , mProfiler(nullptr)
+{
+}
+
+VkResult SubmissionScheduler::init(VkDevice device, const DeviceDispatch& dispatch, const std::vector<VkQueue>& queues,
+    const VkAllocationCallbacks* allocationCallbacks, const SubmissionSchedulerConfig& config)
+{
+    VkResult result = VK_SUCCESS;
+
+    if (config.maxBatchesInFlight == 0u || queues.empty())
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    mDevice = device;
+    mDispatch = &dispatch;
+    mAllocationCallbacks = allocationCallbacks;
+    mMaxBatchesInFlight = config.maxBatchesInFlight;
+    mStatistics = SubmissionSchedulerStatistics{};
+
+    mTimelines.resize(queues.size());
+    for (size_t i{ 0u }; result == VK_SUCCESS && i < queues.size(); ++i)
+    {
+        Timeline& timeline = mTimelines[i];
+        timeline.queue = queues[i];
+
+        const VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {
+            VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO, // VkStructureType sType;             // type of semaphore type create info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            VK_SEMAPHORE_TYPE_TIMELINE,         // VkSemaphoreType semaphoreType;               // 64-bit counter instead of a signaled flag
+            0u                                  // uint64_t initialValue;                       // first submission signals 1
+        };
+
+        const VkSemaphoreCreateInfo semaphoreCreateInfo = {
+            VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, // VkStructureType sType;                  // type of semaphore create info structure
+            &semaphoreTypeCreateInfo,           // const void* pNext;                           // timeline semaphore
+            0u                                  // VkSemaphoreCreateFlags flags;                // reserved for future use
+        };
+
+        result = mDispatch->vkCreateSemaphore(mDevice, &semaphoreCreateInfo, mAllocationCallbacks, &timeline.semaphore);
+    }
+
+    return result;
+}
+
+void SubmissionScheduler::deinit()
+{
+    if (mDevice == VK_NULL_HANDLE)
+        return;
+
+    // resources of retire functions may still be in use until the batches finished
+    waitIdle();
+    collect();
+
+    for (Timeline& timeline : mTimelines)
+    {
+        // functions of failed waits still release their resources, the device is going away
+        for (Retirement& retirement : timeline.retirements)
+        {
+            retirement.function();
+            ++mStatistics.retiredCount;
+        }
+        if (timeline.semaphore != VK_NULL_HANDLE)
+            mDispatch->vkDestroySemaphore(mDevice, timeline.semaphore, mAllocationCallbacks);
+    }
+    mTimelines.clear();
+
+    mDevice = VK_NULL_HANDLE;
+}
+
+VkResult SubmissionScheduler::submit(uint32_t queue, const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount,
+    const std::vector<SubmissionWait>& waits, SubmissionTicket& ticket)
+{
+    // 1) block while the queue is maxBatchesInFlight batches ahead of the device
+    // 2) wait on the device for the highest value of every other timeline (finished ones are dropped)
+    // 3) submit signaling the next value of the queue's timeline
+
+    VkResult result = VK_SUCCESS;
+
+    if (queue >= mTimelines.size())
+        return VK_ERROR_UNKNOWN;
+
+    MK_PROFILE_CPU_ZONE(mProfiler, "SubmissionScheduler::submit");
+
+    Timeline& timeline = mTimelines[queue];
+    const uint64_t value{ timeline.submittedValue + 1u };
+
+    if (value > mMaxBatchesInFlight)
+    {
+        const uint64_t requiredValue{ value - mMaxBatchesInFlight };
+        if (timeline.completedValue < requiredValue && queryCompletedValue(timeline) < requiredValue)
+        {
+            const Clock::time_point start{ Clock::now() };
+            result = waitValue(timeline, requiredValue, UINT64_MAX);
+            mStatistics.throttleTime += Clock::now() - start;
+            ++mStatistics.throttleCount;
+        }
+    }
+
+    mWaitSemaphores.clear();
+    mWaitValues.clear();
+    mWaitStageMasks.clear();
+    for (const SubmissionWait& wait : waits)
+    {
+        if (result != VK_SUCCESS)
+            break;
+
+        // a wait for a value never submitted would block the queue until someone signals it
+        if (wait.ticket.queue >= mTimelines.size() || wait.ticket.value > mTimelines[wait.ticket.queue].submittedValue)
+        {
+            result = VK_ERROR_UNKNOWN;
+            break;
+        }
+
+        const Timeline& waitTimeline = mTimelines[wait.ticket.queue];
+        if (wait.ticket.value <= waitTimeline.completedValue)
+            continue;
+
+        // one wait per timeline, values are reached in order
+        const auto it = std::find(mWaitSemaphores.begin(), mWaitSemaphores.end(), waitTimeline.semaphore);
+        if (it == mWaitSemaphores.end())
+        {
+            mWaitSemaphores.push_back(waitTimeline.semaphore);
+            mWaitValues.push_back(wait.ticket.value);
+            mWaitStageMasks.push_back(wait.stageMask);
+        }
+        else
+        {
+            const size_t index{ static_cast<size_t>(it - mWaitSemaphores.begin()) };
+            mWaitValues[index] = std::max(mWaitValues[index], wait.ticket.value);
+            mWaitStageMasks[index] |= wait.stageMask;
+        }
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        const VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {
+            VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO, // VkStructureType sType;         // type of timeline semaphore submit info structure
+            nullptr,                            // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+            static_cast<uint32_t>(mWaitValues.size()), // uint32_t waitSemaphoreValueCount;     // one value per wait semaphore
+            mWaitValues.data(),                 // const uint64_t* pWaitSemaphoreValues;
+            1u,                                 // uint32_t signalSemaphoreValueCount;
+            &value                              // const uint64_t* pSignalSemaphoreValues;      // next value of the queue's timeline
+        };
+
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,      // VkStructureType sType;                       // type of submit info structure
+            &timelineSemaphoreSubmitInfo,       // const void* pNext;                           // values of the timeline semaphores
+            static_cast<uint32_t>(mWaitSemaphores.size()), // uint32_t waitSemaphoreCount;      // timelines of other batches this one depends on
+            mWaitSemaphores.data(),             // const VkSemaphore* pWaitSemaphores;
+            mWaitStageMasks.data(),             // const VkPipelineStageFlags* pWaitDstStageMask; // stages held back until the values are reached
+            commandBufferCount,                 // uint32_t commandBufferCount;
+            commandBuffers,                     // const VkCommandBuffer* pCommandBuffers;
+            1u,                                 // uint32_t signalSemaphoreCount;               // completion is tracked by the timeline
+            &timeline.semaphore                 // const VkSemaphore* pSignalSemaphores;
+        };
+
+        std::unique_lock<std::mutex> queueLock;
+        if (timeline.queueMutex)
+            queueLock = std::unique_lock<std::mutex>(*timeline.queueMutex);
+
+        result = mDispatch->vkQueueSubmit(timeline.queue, 1u, &submitInfo, VK_NULL_HANDLE);
+    }
+
+    if (result == VK_SUCCESS)
+    {
+        timeline.submittedValue = value;
+        ticket.queue = queue;
+        ticket.value = value;
+
+        ++mStatistics.submitCount;
+        mStatistics.waitCount += mWaitSemaphores.size();
+    }
+
+    return result;
+}
+
+bool SubmissionScheduler::isComplete(const SubmissionTicket& ticket)
+{
+    // never completes, as wait() fails for it
+    if (ticket.queue >= mTimelines.size())
+        return false;
+
+    Timeline& timeline = mTimelines[ticket.queue];
+    return ticket.value <= timeline.completedValue || ticket.value <= queryCompletedValue(timeline);
+}
+
+VkResult SubmissionScheduler::wait(const SubmissionTicket& ticket, uint64_t timeout)
+{
+    if (ticket.queue >= mTimelines.size())
+        return VK_ERROR_UNKNOWN;
+
+    Timeline& timeline = mTimelines[ticket.queue];
+    if (ticket.value <= timeline.completedValue)
+        return VK_SUCCESS;
+
+    return waitValue(timeline, ticket.value, timeout);
+}
+
+VkResult SubmissionScheduler::waitIdle()
+{
+    VkResult result = VK_SUCCESS;
+
+    for (Timeline& timeline : mTimelines)
+        if (result == VK_SUCCESS && timeline.completedValue < timeline.submittedValue)
+            result = waitValue(timeline, timeline.submittedValue, UINT64_MAX);
+
+    return result;
+}
+
+void SubmissionScheduler::retire(const SubmissionTicket& ticket, RetireFunction function)
+{
+    // nothing to wait for
+    if (ticket.queue >= mTimelines.size())
+    {
+        function();
+        ++mStatistics.retiredCount;
+        return;
+    }
+
+    // usually the newest ticket, keep the deque sorted for collect() anyway
+    std::deque<Retirement>& retirements = mTimelines[ticket.queue].retirements;
+    const auto it = std::upper_bound(retirements.begin(), retirements.end(), ticket.value,
+        [](uint64_t value, const Retirement& retirement) { return value < retirement.value; });
+    retirements.insert(it, Retirement{ ticket.value, std::move(function) });
+}
+
+size_t SubmissionScheduler::collect()
+{
+    size_t count{ 0u };
+
+    for (Timeline& timeline : mTimelines)
+    {
+        if (timeline.retirements.empty())
+            continue;
+
+        // query only when the cached value does not cover the oldest retirement
+        if (timeline.retirements.front().value > timeline.completedValue)
+            queryCompletedValue(timeline);
+
+        while (!timeline.retirements.empty() && timeline.retirements.front().value <= timeline.completedValue)
+        {
+            // pop before calling, the function may retire more
+            RetireFunction function{ std::move(timeline.retirements.front().function) };
+            timeline.retirements.pop_front();
+            function();
+            ++count;
+        }
+    }
+
+    mStatistics.retiredCount += count;
+
+    return count;
+}
+
+SubmissionTicket SubmissionScheduler::getLastSubmitted(uint32_t queue) const
+{
+    SubmissionTicket ticket;
+    if (queue < mTimelines.size())
+    {
+        ticket.queue = queue;
+        ticket.value = mTimelines[queue].submittedValue;
+    }
+    return ticket;
+}
+
+uint64_t SubmissionScheduler::queryCompletedValue(Timeline& timeline)
+{
+    uint64_t value{ 0u };
+    if (mDispatch->vkGetSemaphoreCounterValue(mDevice, timeline.semaphore, &value) == VK_SUCCESS)
+        timeline.completedValue = std::max(timeline.completedValue, value);
+    ++mStatistics.counterQueryCount;
+
+    return timeline.completedValue;
+}
+
+VkResult SubmissionScheduler::waitValue(Timeline& timeline, uint64_t value, uint64_t timeout)
+{
+    VkResult result = VK_SUCCESS;
+
+    MK_PROFILE_CPU_ZONE(mProfiler, "SubmissionScheduler wait");
+
+    const VkSemaphoreWaitInfo semaphoreWaitInfo = {
+        VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,  // VkStructureType sType;                       // type of semaphore wait info structure
+        nullptr,                                // const void* pNext;                           // ptr to provide some version extensions, can be set to nullptr
+        0u,                                     // VkSemaphoreWaitFlags flags;                  // all semaphores (only one here)
+        1u,                                     // uint32_t semaphoreCount;
+        &timeline.semaphore,                    // const VkSemaphore* pSemaphores;
+        &value                                  // const uint64_t* pValues;
+    };
+
+    result = mDispatch->vkWaitSemaphores(mDevice, &semaphoreWaitInfo, timeout);
+    if (result == VK_SUCCESS)
+        timeline.completedValue = std::max(timeline.completedValue, value);
+
+    return result;
+}
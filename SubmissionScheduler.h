@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Profiler.h"
+#include "VulkanDispatch.h"
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+struct SubmissionSchedulerConfig
+{
+	uint32_t maxBatchesInFlight{ 3u };			// batches per queue submitted but not finished before submit() blocks (0 - no scheduler)
+};
+
+/// Batch of a queue, done when the timeline of the queue reaches value
+struct SubmissionTicket
+{
+	uint32_t queue{ 0u };						// queue index passed to init()
+	uint64_t value{ 0u };						// timeline value signaled by the batch (0 - nothing, always done)
+};
+
+/// Ticket a batch waits for before stageMask of its commands starts
+struct SubmissionWait
+{
+	SubmissionTicket ticket;
+	VkPipelineStageFlags stageMask{ VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+};
+
+/// Counters since init()
+struct SubmissionSchedulerStatistics
+{
+	uint64_t submitCount{ 0u };					// vkQueueSubmit calls
+	uint64_t waitCount{ 0u };					// timeline waits of submitted batches (cross queue dependencies)
+	uint64_t throttleCount{ 0u };				// submit() calls blocked by maxBatchesInFlight
+	std::chrono::nanoseconds throttleTime{ 0 };	// host time blocked by maxBatchesInFlight
+	uint64_t counterQueryCount{ 0u };			// vkGetSemaphoreCounterValue calls
+	uint64_t retiredCount{ 0u };				// retire functions run
+};
+
+/// Orders submissions of several queues with one timeline semaphore per queue
+/// (Vulkan 1.2 timelineSemaphore feature). Every submit() signals the next
+/// value of its queue's timeline and returns it as a ticket. Dependencies on
+/// other queues are timeline waits on the device, the host blocks only when a
+/// queue runs more than maxBatchesInFlight batches ahead. Resources used by a
+/// batch are released by retire() functions run from collect() once the
+/// ticket is reached, no fence per submission is needed.
+/// Not thread safe. Other objects submitting to the queues from other threads
+/// must do so under the locks of setQueueMutex().
+class SubmissionScheduler
+{
+public:
+	using RetireFunction = std::function<void()>;
+
+	SubmissionScheduler();
+
+	SubmissionScheduler(const SubmissionScheduler&) = delete;
+	SubmissionScheduler& operator=(const SubmissionScheduler&) = delete;
+
+	/// Create a timeline semaphore for every queue, tickets refer to queues by index in queues
+	VkResult init(VkDevice device, const DeviceDispatch& dispatch, const std::vector<VkQueue>& queues,
+		const VkAllocationCallbacks* allocationCallbacks, const SubmissionSchedulerConfig& config = SubmissionSchedulerConfig{});
+
+	/// Wait for all batches, run pending retire functions and destroy the semaphores
+	void deinit();
+
+	/// Submit commandBuffers to queue after waits are reached, ticket is signaled when the batch finished.
+	/// Blocks while maxBatchesInFlight batches of queue are unfinished.
+	VkResult submit(uint32_t queue, const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount,
+		const std::vector<SubmissionWait>& waits, SubmissionTicket& ticket);
+
+	/// Non-blocking, true when the batch of ticket finished executing (false for a queue index out of range)
+	bool isComplete(const SubmissionTicket& ticket);
+
+	/// Wait until the batch of ticket finished, VK_TIMEOUT when timeout (ns) elapsed first
+	VkResult wait(const SubmissionTicket& ticket, uint64_t timeout = UINT64_MAX);
+
+	/// Wait until all submitted batches finished
+	VkResult waitIdle();
+
+	/// Run function from collect() (or deinit()) once ticket is complete
+	void retire(const SubmissionTicket& ticket, RetireFunction function);
+
+	/// Run retire functions of complete tickets, returns the number run
+	size_t collect();
+
+	/// Ticket of the last batch submitted to queue (value 0 - none yet)
+	SubmissionTicket getLastSubmitted(uint32_t queue) const;
+
+	/// Timeline semaphore of queue, e.g. to wait for tickets in submissions made elsewhere
+	VkSemaphore getSemaphore(uint32_t queue) const { return mTimelines[queue].semaphore; }
+
+	uint32_t getQueueCount() const { return static_cast<uint32_t>(mTimelines.size()); }
+
+	/// Record CPU zones of submissions and waits into profiler (nullptr - none)
+	void setProfiler(Profiler* profiler) { mProfiler = profiler; }
+
+	/// Lock held around submissions to queue when other objects submit to it (nullptr - queue not shared)
+	void setQueueMutex(uint32_t queue, std::mutex* queueMutex) { if (queue < mTimelines.size()) mTimelines[queue].queueMutex = queueMutex; }
+
+	const SubmissionSchedulerStatistics& getStatistics() const { return mStatistics; }
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Retirement
+	{
+		uint64_t value;
+		RetireFunction function;
+	};
+
+	struct Timeline
+	{
+		VkQueue queue{ VK_NULL_HANDLE };
+		std::mutex* queueMutex{ nullptr };		// see setQueueMutex()
+		VkSemaphore semaphore{ VK_NULL_HANDLE };
+		uint64_t submittedValue{ 0u };			// signaled by the last submission
+		uint64_t completedValue{ 0u };			// last value read from the semaphore
+		std::deque<Retirement> retirements;		// ascending value
+	};
+
+	uint64_t queryCompletedValue(Timeline& timeline);
+	VkResult waitValue(Timeline& timeline, uint64_t value, uint64_t timeout);
+
+	VkDevice mDevice;
+	const DeviceDispatch* mDispatch;
+	const VkAllocationCallbacks* mAllocationCallbacks;
+	uint32_t mMaxBatchesInFlight;
+	Profiler* mProfiler;
+	std::vector<Timeline> mTimelines;			// one per queue
+	std::vector<VkSemaphore> mWaitSemaphores;	// scratch of submit(), kept to avoid allocations per submission
+	std::vector<uint64_t> mWaitValues;
+	std::vector<VkPipelineStageFlags> mWaitStageMasks;
+
+	SubmissionSchedulerStatistics mStatistics;
+};
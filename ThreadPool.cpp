@@ -0,0 +1,142 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    mRanges.reserve(threadCount + 1u);
+    for (size_t i{ 0u }; i < threadCount + 1u; ++i)
+        mRanges.emplace_back(new Range);
+
+    mThreads.reserve(threadCount);
+    for (size_t i{ 0u }; i < threadCount; ++i)
+        mThreads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mStartCondition.notify_all();
+
+    for (std::thread& thread : mThreads)
+        thread.join();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& function)
+{
+    parallelFor(count, [&function](size_t index, size_t) { function(index); });
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, size_t)>& function)
+{
+    if (count == 0u)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFunction = &function;
+        mFinishedWorkers = 0u;
+        ++mGeneration;
+
+        // contiguous share per slot, neighbouring indices tend to touch neighbouring data
+        const size_t slotCount{ mRanges.size() };
+        for (size_t slot{ 0u }; slot < slotCount; ++slot)
+        {
+            std::lock_guard<std::mutex> rangeLock(mRanges[slot]->mutex);
+            mRanges[slot]->begin = count * slot / slotCount;
+            mRanges[slot]->end = count * (slot + 1u) / slotCount;
+        }
+    }
+    mStartCondition.notify_all();
+
+    runIndices(mThreads.size());
+
+    // every worker has to acknowledge the generation before function goes out of scope
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [this] { return mFinishedWorkers == mThreads.size(); });
+    mFunction = nullptr;
+}
+
+void ThreadPool::workerLoop(size_t threadIndex)
+{
+    uint64_t generation{ 0u };
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mStartCondition.wait(lock, [this, generation] { return mStop || mGeneration != generation; });
+            if (mStop)
+                return;
+            generation = mGeneration;
+        }
+
+        runIndices(threadIndex);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            ++mFinishedWorkers;
+        }
+        mDoneCondition.notify_one();
+    }
+}
+
+void ThreadPool::runIndices(size_t threadIndex)
+{
+    Range& range = *mRanges[threadIndex];
+
+    for (;;)
+    {
+        size_t index{ 0u };
+        {
+            std::lock_guard<std::mutex> lock(range.mutex);
+            if (range.begin < range.end)
+                index = range.begin++;
+            else
+                index = SIZE_MAX;
+        }
+
+        if (index != SIZE_MAX)
+            (*mFunction)(index, threadIndex);
+        else if (!steal(threadIndex))
+            return;
+    }
+}
+
+bool ThreadPool::steal(size_t threadIndex)
+{
+    // Indices only move between ranges, when all ranges are empty the remaining
+    // indices are already taken by running threads and this thread is done.
+    const size_t slotCount{ mRanges.size() };
+
+    for (size_t i{ 1u }; i < slotCount; ++i)
+    {
+        Range& victim = *mRanges[(threadIndex + i) % slotCount];
+
+        size_t begin{ 0u };
+        size_t end{ 0u };
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.begin >= victim.end)
+                continue;
+
+            // back half (rounded up), the victim continues at its front
+            end = victim.end;
+            begin = victim.end - (victim.end - victim.begin + 1u) / 2u;
+            victim.end = begin;
+        }
+
+        Range& range = *mRanges[threadIndex];
+        {
+            std::lock_guard<std::mutex> lock(range.mutex);
+            range.begin = begin;
+            range.end = end;
+        }
+
+        mStealCount.fetch_add(1u, std::memory_order_relaxed);
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fixed set of worker threads running index ranges in parallel. The range is
+/// split evenly between the threads, a thread that runs out of indices steals
+/// half of the remaining indices of another thread, so uneven jobs still keep
+/// all threads busy.
+class ThreadPool
+{
+public:
+	/// Start threadCount workers (the calling thread of parallelFor() helps as well)
+	explicit ThreadPool(size_t threadCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t getThreadCount() const { return mThreads.size(); }
+
+	/// Number of distinct threadIndex values passed to functions: the workers
+	/// are 0..getThreadCount()-1, the calling thread of parallelFor() is getThreadCount()
+	size_t getSlotCount() const { return mThreads.size() + 1u; }
+
+	/// Run function(i) for every i in [0, count) and return when all calls finished.
+	/// Not reentrant - only one parallelFor() may run at a time.
+	void parallelFor(size_t count, const std::function<void(size_t)>& function);
+
+	/// As above, function(i, threadIndex) also gets the index of the thread
+	/// running it, e.g. to use per-thread resources without locking
+	void parallelFor(size_t count, const std::function<void(size_t, size_t)>& function);
+
+	/// Index ranges taken from other threads since construction
+	uint64_t getStealCount() const { return mStealCount.load(std::memory_order_relaxed); }
+private:
+	// Remaining indices [begin, end) of one thread, the owner takes from the front, thieves from the back
+	struct alignas(64) Range
+	{
+		std::mutex mutex;
+		size_t begin{ 0u };
+		size_t end{ 0u };
+	};
+
+	void workerLoop(size_t threadIndex);
+	void runIndices(size_t threadIndex);
+	bool steal(size_t threadIndex);
+
+	std::vector<std::thread> mThreads;
+	std::vector<std::unique_ptr<Range>> mRanges;	// one per slot
+
+	std::mutex mMutex;
+	std::condition_variable mStartCondition;
+	std::condition_variable mDoneCondition;
+	const std::function<void(size_t, size_t)>* mFunction{ nullptr };
+	uint64_t mGeneration{ 0u };					// incremented for every parallelFor()
+	size_t mFinishedWorkers{ 0u };				// workers done with the current generation
+	bool mStop{ false };
+	std::atomic<uint64_t> mStealCount{ 0u };
+};
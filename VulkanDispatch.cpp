@@ -0,0 +1,95 @@
+#include "VulkanDispatch.h"
+
+#ifdef MK_VULKAN_DYNAMIC_LOADING
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+#endif
+
+VulkanLibrary::~VulkanLibrary()
+{
+    unload();
+}
+
+VkResult VulkanLibrary::load()
+{
+    if (mGetInstanceProcAddr)
+        return VK_SUCCESS;
+
+#ifdef MK_VULKAN_DYNAMIC_LOADING
+#ifdef _WIN32
+    HMODULE module = LoadLibraryA("vulkan-1.dll");
+    if (module)
+        mGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(GetProcAddress(module, "vkGetInstanceProcAddr"));
+    mHandle = module;
+#else
+    // libvulkan.so is the development symlink, not installed everywhere
+    mHandle = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (!mHandle)
+        mHandle = dlopen("libvulkan.so", RTLD_NOW | RTLD_LOCAL);
+    if (mHandle)
+        mGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(dlsym(mHandle, "vkGetInstanceProcAddr"));
+#endif
+    if (!mGetInstanceProcAddr)
+    {
+        unload();
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+#else
+    mGetInstanceProcAddr = &::vkGetInstanceProcAddr;
+#endif
+
+    return VK_SUCCESS;
+}
+
+void VulkanLibrary::unload()
+{
+#ifdef MK_VULKAN_DYNAMIC_LOADING
+    if (mHandle)
+    {
+#ifdef _WIN32
+        FreeLibrary(static_cast<HMODULE>(mHandle));
+#else
+        dlclose(mHandle);
+#endif
+    }
+#endif
+    mHandle = nullptr;
+    mGetInstanceProcAddr = nullptr;
+}
+
+VkResult GlobalDispatch::load(PFN_vkGetInstanceProcAddr getInstanceProcAddr)
+{
+    vkGetInstanceProcAddr = getInstanceProcAddr;
+    if (!vkGetInstanceProcAddr)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+#define MK_VULKAN_LOAD_FUNCTION(name) \
+    name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(VK_NULL_HANDLE, #name)); \
+    if (!name) return VK_ERROR_INITIALIZATION_FAILED;
+    MK_VULKAN_GLOBAL_FUNCTIONS(MK_VULKAN_LOAD_FUNCTION)
+#undef MK_VULKAN_LOAD_FUNCTION
+
+    return VK_SUCCESS;
+}
+
+void InstanceDispatch::load(const GlobalDispatch& global, VkInstance instance)
+{
+#define MK_VULKAN_LOAD_FUNCTION(name) \
+    name = reinterpret_cast<PFN_##name>(global.vkGetInstanceProcAddr(instance, #name));
+    MK_VULKAN_INSTANCE_FUNCTIONS(MK_VULKAN_LOAD_FUNCTION)
+#undef MK_VULKAN_LOAD_FUNCTION
+}
+
+void DeviceDispatch::load(const InstanceDispatch& instance, VkDevice device)
+{
+    // vkGetDeviceProcAddr of the instance is the loader's, the pointers it returns are the driver's
+#define MK_VULKAN_LOAD_FUNCTION(name) \
+    name = reinterpret_cast<PFN_##name>(instance.vkGetDeviceProcAddr(device, #name));
+    MK_VULKAN_DEVICE_FUNCTIONS(MK_VULKAN_LOAD_FUNCTION)
+#undef MK_VULKAN_LOAD_FUNCTION
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Functions called through the dispatch tables, one X(name) per function.
+// A function used anywhere in the project must be listed at its level.
+
+/// Functions without an instance (vkGetInstanceProcAddr with VK_NULL_HANDLE)
+#define MK_VULKAN_GLOBAL_FUNCTIONS(X) \
+	X(vkCreateInstance) \
+	X(vkEnumerateInstanceExtensionProperties) \
+	X(vkEnumerateInstanceLayerProperties)
+
+/// Functions of the instance and its physical devices
+#define MK_VULKAN_INSTANCE_FUNCTIONS(X) \
+	X(vkCreateDevice) \
+	X(vkDestroyInstance) \
+	X(vkEnumerateDeviceExtensionProperties) \
+	X(vkEnumerateDeviceLayerProperties) \
+	X(vkEnumeratePhysicalDevices) \
+	X(vkGetDeviceProcAddr) \
+	X(vkGetPhysicalDeviceFeatures) \
+	X(vkGetPhysicalDeviceFeatures2) \
+	X(vkGetPhysicalDeviceMemoryProperties) \
+	X(vkGetPhysicalDeviceMemoryProperties2) \
+	X(vkGetPhysicalDeviceProperties) \
+	X(vkGetPhysicalDeviceProperties2) \
+	X(vkGetPhysicalDeviceQueueFamilyProperties)
+
+/// Functions of the logical device, its queues and command buffers
+#define MK_VULKAN_DEVICE_FUNCTIONS(X) \
+	X(vkAllocateCommandBuffers) \
+	X(vkAllocateDescriptorSets) \
+	X(vkAllocateMemory) \
+	X(vkBeginCommandBuffer) \
+	X(vkBindBufferMemory) \
+	X(vkBindImageMemory) \
+	X(vkCmdBeginDebugUtilsLabelEXT) \
+	X(vkCmdBeginRenderPass) \
+	X(vkCmdBindDescriptorSets) \
+	X(vkCmdBindPipeline) \
+	X(vkCmdCopyBuffer) \
+	X(vkCmdCopyImageToBuffer) \
+	X(vkCmdDispatch) \
+	X(vkCmdDraw) \
+	X(vkCmdEndDebugUtilsLabelEXT) \
+	X(vkCmdEndRenderPass) \
+	X(vkCmdExecuteCommands) \
+	X(vkCmdPipelineBarrier) \
+	X(vkCmdPushConstants) \
+	X(vkCmdSetScissor) \
+	X(vkCmdSetViewport) \
+	X(vkCmdWriteTimestamp) \
+	X(vkCreateBuffer) \
+	X(vkCreateCommandPool) \
+	X(vkCreateComputePipelines) \
+	X(vkCreateDescriptorPool) \
+	X(vkCreateDescriptorSetLayout) \
+	X(vkCreateFence) \
+	X(vkCreateFramebuffer) \
+	X(vkCreateGraphicsPipelines) \
+	X(vkCreateImage) \
+	X(vkCreateImageView) \
+	X(vkCreatePipelineCache) \
+	X(vkCreatePipelineLayout) \
+	X(vkCreateQueryPool) \
+	X(vkCreateRenderPass) \
+	X(vkCreateSemaphore) \
+	X(vkCreateShaderModule) \
+	X(vkDestroyBuffer) \
+	X(vkDestroyCommandPool) \
+	X(vkDestroyDescriptorPool) \
+	X(vkDestroyDescriptorSetLayout) \
+	X(vkDestroyDevice) \
+	X(vkDestroyFence) \
+	X(vkDestroyFramebuffer) \
+	X(vkDestroyImage) \
+	X(vkDestroyImageView) \
+	X(vkDestroyPipeline) \
+	X(vkDestroyPipelineCache) \
+	X(vkDestroyPipelineLayout) \
+	X(vkDestroyQueryPool) \
+	X(vkDestroyRenderPass) \
+	X(vkDestroySemaphore) \
+	X(vkDestroyShaderModule) \
+	X(vkDeviceWaitIdle) \
+	X(vkEndCommandBuffer) \
+	X(vkFlushMappedMemoryRanges) \
+	X(vkFreeDescriptorSets) \
+	X(vkFreeMemory) \
+	X(vkGetBufferMemoryRequirements) \
+	X(vkGetDeviceQueue) \
+	X(vkGetFenceStatus) \
+	X(vkGetImageMemoryRequirements) \
+	X(vkGetPipelineCacheData) \
+	X(vkGetQueryPoolResults) \
+	X(vkGetSemaphoreCounterValue) \
+	X(vkInvalidateMappedMemoryRanges) \
+	X(vkMapMemory) \
+	X(vkMergePipelineCaches) \
+	X(vkQueueSubmit) \
+	X(vkResetCommandBuffer) \
+	X(vkResetCommandPool) \
+	X(vkResetFences) \
+	X(vkResetQueryPool) \
+	X(vkUnmapMemory) \
+	X(vkUpdateDescriptorSets) \
+	X(vkWaitForFences) \
+	X(vkWaitSemaphores)
+
+#define MK_VULKAN_DECLARE_FUNCTION(name) PFN_##name name{ nullptr };
+
+/// Vulkan loader library. Linked at build time by default, with
+/// MK_VULKAN_DYNAMIC_LOADING (and VK_NO_PROTOTYPES) it is opened in load(),
+/// so the executable starts without it and runs without Vulkan installed.
+class VulkanLibrary
+{
+public:
+	VulkanLibrary() = default;
+	~VulkanLibrary();
+
+	VulkanLibrary(const VulkanLibrary&) = delete;
+	VulkanLibrary& operator=(const VulkanLibrary&) = delete;
+
+	/// Open the loader and find vkGetInstanceProcAddr, VK_ERROR_INITIALIZATION_FAILED when there is none
+	VkResult load();
+
+	/// Close the loader, all instances must be destroyed
+	void unload();
+
+	PFN_vkGetInstanceProcAddr getInstanceProcAddr() const { return mGetInstanceProcAddr; }
+private:
+	void* mHandle{ nullptr };					// dynamic loading only
+	PFN_vkGetInstanceProcAddr mGetInstanceProcAddr{ nullptr };
+};
+
+/// Global functions of the loader
+struct GlobalDispatch
+{
+	PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr{ nullptr };
+	MK_VULKAN_GLOBAL_FUNCTIONS(MK_VULKAN_DECLARE_FUNCTION)
+
+	/// VK_ERROR_INITIALIZATION_FAILED when a function is missing
+	VkResult load(PFN_vkGetInstanceProcAddr getInstanceProcAddr);
+};
+
+/// Instance functions, pointers to the loader's instance level dispatch.
+/// Functions the instance does not support stay nullptr.
+struct InstanceDispatch
+{
+	MK_VULKAN_INSTANCE_FUNCTIONS(MK_VULKAN_DECLARE_FUNCTION)
+
+	void load(const GlobalDispatch& global, VkInstance instance);
+};
+
+/// Device functions from vkGetDeviceProcAddr. They point into the driver
+/// (or the first enabled layer), calls skip the loader's trampoline and its
+/// dispatch lookup through the handle. Functions of extensions or versions
+/// the device does not enable stay nullptr. Valid for the device they were
+/// loaded for only, shared read-only by all threads.
+struct DeviceDispatch
+{
+	MK_VULKAN_DEVICE_FUNCTIONS(MK_VULKAN_DECLARE_FUNCTION)
+
+	void load(const InstanceDispatch& instance, VkDevice device);
+};
@@ -0,0 +1,582 @@
+// Compute benchmark - runs standard kernels through App's ComputeEngine on the
+// AsyncCompute queue and reports bandwidth and dispatch rate.
+//
+// Usage: mkComputeBenchmark [--size MB] [--iterations N] [--dispatches N] [--shaders dir] [--format text|json] [--icd path]
+//
+// --size        bytes per buffer (default 64 MB)
+// --iterations  timed repetitions of each kernel, recorded into one submission (default 10)
+// --dispatches  empty dispatches of the dispatch rate test (default 10000)
+// --shaders     directory of the compiled kernels (default: shaders/ of the build tree)
+// --icd         selects the Vulkan driver manifest (sets VK_ICD_FILENAMES), e.g. a software ICD:
+//   lavapipe    /usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+//   SwiftShader <build>/Linux/vk_swiftshader_icd.json
+//
+// Kernels (shaders/*.comp):
+//   memcpy  dst = src                      2 x size bytes moved per iteration
+//   saxpy   y = a * x + y                  3 x size
+//   reduce  sum of uints, 2 passes         1 x size
+//   scan    exclusive prefix sum of uints  4 x size (block scan + add pass)
+//   dispatch empty dispatches without barriers, dispatch rate only
+//
+// Each kernel is run once on uploaded data and read back for verification
+// before the timed run. Time is the wall time of submit + wait, so it includes
+// the submission overhead (negligible at the default size). Exit code is
+// non-zero when a kernel fails or produces a wrong result.
+
+#include "App.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#ifndef MK_SHADER_DIR
+#define MK_SHADER_DIR "shaders"
+#endif
+
+namespace
+{
+	enum class OutputFormat { Text, Json };
+
+	struct Options
+	{
+		VkDeviceSize size{ 64u * 1024u * 1024u };
+		uint32_t iterations{ 10u };
+		uint32_t dispatches{ 10000u };
+		std::string shaderDir{ MK_SHADER_DIR };
+		OutputFormat format{ OutputFormat::Text };
+		const char* icd{ nullptr };
+	};
+
+	struct Result
+	{
+		const char* name;
+		double bytes;				// moved per iteration
+		uint32_t dispatches;		// per iteration
+		uint32_t iterations;		// timed
+		double seconds;				// all iterations
+		bool verified;
+	};
+
+	// Device local storage buffer with its descriptor range
+	struct Buffer
+	{
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		MemoryAllocation allocation;
+		VkDeviceSize size{ 0u };
+
+		VkDescriptorBufferInfo getDescriptor() const { return { buffer, 0u, size }; }
+	};
+
+	constexpr uint32_t cGroupSize{ 256u };		// local_size_x of all kernels
+	constexpr uint32_t cScanBlockSize{ 1024u };	// elements per group of scan.comp/scan_add.comp
+	constexpr uint32_t cReduceGroups{ 1024u };	// partials of the first reduce pass
+
+	void printUsage()
+	{
+		std::printf("Usage: mkComputeBenchmark [--size MB] [--iterations N] [--dispatches N] [--shaders dir] [--format text|json] [--icd path]\n");
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i{ 1 }; i < argc; ++i)
+		{
+			const bool hasValue{ i + 1 < argc };
+
+			if (std::strcmp(argv[i], "--size") == 0 && hasValue)
+				options.size = std::strtoull(argv[++i], nullptr, 10) * 1024u * 1024u;
+			else if (std::strcmp(argv[i], "--iterations") == 0 && hasValue)
+				options.iterations = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--dispatches") == 0 && hasValue)
+				options.dispatches = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--shaders") == 0 && hasValue)
+				options.shaderDir = argv[++i];
+			else if (std::strcmp(argv[i], "--icd") == 0 && hasValue)
+				options.icd = argv[++i];
+			else if (std::strcmp(argv[i], "--format") == 0 && hasValue)
+			{
+				const std::string format{ argv[++i] };
+				if (format == "text")
+					options.format = OutputFormat::Text;
+				else if (format == "json")
+					options.format = OutputFormat::Json;
+				else
+					return false;
+			}
+			else
+				return false;
+		}
+
+		return options.size >= 16u && options.iterations > 0u && options.dispatches > 0u;
+	}
+
+	void setIcd(const char* icd)
+	{
+#ifdef _WIN32
+		_putenv_s("VK_ICD_FILENAMES", icd);
+#else
+		setenv("VK_ICD_FILENAMES", icd, 1);
+#endif
+	}
+
+	uint32_t divideRoundUp(VkDeviceSize value, VkDeviceSize divisor)
+	{
+		return static_cast<uint32_t>((value + divisor - 1u) / divisor);
+	}
+
+	class Benchmark
+	{
+	public:
+		Benchmark(App& app, const Options& options)
+			: mAllocator(app.getMemoryAllocator())
+			, mEngine(app.getComputeEngine())
+			, mOptions(options)
+		{
+		}
+
+		~Benchmark()
+		{
+			for (VkDescriptorSet& descriptorSet : mDescriptorSets)
+				mEngine.destroyBindings(descriptorSet);
+			for (ComputeKernel& kernel : mKernels)
+				mEngine.destroyKernel(kernel);
+			for (Buffer& buffer : mBuffers)
+				mAllocator.destroyBuffer(buffer.buffer, buffer.allocation);
+		}
+
+		VkResult runMemcpy(Result& result);
+		VkResult runSaxpy(Result& result);
+		VkResult runReduce(Result& result);
+		VkResult runScan(Result& result);
+		VkResult runDispatch(Result& result);
+	private:
+		VkResult createKernel(const char* name, uint32_t storageBufferCount, uint32_t pushConstantSize, ComputeKernel*& kernel);
+		VkResult createBuffer(VkDeviceSize size, Buffer*& buffer);
+		VkResult createBindings(const ComputeKernel& kernel, std::initializer_list<const Buffer*> buffers, VkDescriptorSet& descriptorSet);
+
+		// Record once and verify with verify(), then record iterations times and time submit + wait
+		VkResult run(const std::function<void()>& record, const std::function<bool()>& verify, uint32_t iterations, Result& result);
+
+		uint32_t getGroupCount(VkDeviceSize count) const
+		{
+			return std::max(1u, std::min(divideRoundUp(count, cGroupSize), mEngine.getMaxGroupCountX()));
+		}
+
+		DeviceMemoryAllocator& mAllocator;
+		ComputeEngine& mEngine;
+		const Options& mOptions;
+		std::deque<ComputeKernel> mKernels;		// deque - handed out pointers stay valid
+		std::deque<Buffer> mBuffers;
+		std::vector<VkDescriptorSet> mDescriptorSets;
+	};
+
+	VkResult Benchmark::createKernel(const char* name, uint32_t storageBufferCount, uint32_t pushConstantSize, ComputeKernel*& kernel)
+	{
+		mKernels.emplace_back();
+		kernel = &mKernels.back();
+
+		const std::string path{ mOptions.shaderDir + "/" + name + ".spv" };
+		const VkResult result{ mEngine.createKernel(path, storageBufferCount, pushConstantSize, *kernel) };
+		if (result != VK_SUCCESS)
+			std::fprintf(stderr, "cannot create kernel %s: VkResult %d\n", path.c_str(), static_cast<int>(result));
+
+		return result;
+	}
+
+	VkResult Benchmark::createBuffer(VkDeviceSize size, Buffer*& buffer)
+	{
+		mBuffers.emplace_back();
+		buffer = &mBuffers.back();
+		buffer->size = size;
+
+		const VkBufferCreateInfo bufferCreateInfo = {
+			VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0u, size,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_SHARING_MODE_EXCLUSIVE, 0u, nullptr
+		};
+
+		return mAllocator.createBuffer(bufferCreateInfo, MemoryUsage::GpuOnly, buffer->buffer, buffer->allocation);
+	}
+
+	VkResult Benchmark::createBindings(const ComputeKernel& kernel, std::initializer_list<const Buffer*> buffers, VkDescriptorSet& descriptorSet)
+	{
+		std::vector<VkDescriptorBufferInfo> descriptors;
+		for (const Buffer* buffer : buffers)
+			descriptors.push_back(buffer->getDescriptor());
+
+		const VkResult result{ mEngine.createBindings(kernel, descriptors.data(), descriptorSet) };
+		if (result == VK_SUCCESS)
+			mDescriptorSets.push_back(descriptorSet);
+
+		return result;
+	}
+
+	VkResult Benchmark::run(const std::function<void()>& record, const std::function<bool()>& verify, uint32_t iterations, Result& result)
+	{
+		VkResult vkResult = mEngine.begin();
+		if (vkResult == VK_SUCCESS)
+		{
+			record();
+			vkResult = mEngine.submit();
+		}
+		if (vkResult == VK_SUCCESS)
+			vkResult = mEngine.wait();
+
+		result.verified = vkResult == VK_SUCCESS && verify();
+		result.iterations = iterations;
+
+		if (vkResult == VK_SUCCESS)
+			vkResult = mEngine.begin();
+		if (vkResult == VK_SUCCESS)
+		{
+			for (uint32_t i{ 0u }; i < iterations; ++i)
+			{
+				record();
+				mEngine.barrier();
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			vkResult = mEngine.submit();
+			if (vkResult == VK_SUCCESS)
+				vkResult = mEngine.wait();
+			result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		return vkResult;
+	}
+
+	VkResult Benchmark::runMemcpy(Result& result)
+	{
+		const VkDeviceSize count{ mOptions.size / 16u };	// uvec4 elements
+		const VkDeviceSize size{ count * 16u };
+		result = { "memcpy", 2.0 * static_cast<double>(size), 1u, 0u, 0.0, false };
+
+		ComputeKernel* kernel{ nullptr };
+		Buffer* src{ nullptr };
+		Buffer* dst{ nullptr };
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+
+		VkResult vkResult = createKernel("memcpy", 2u, 4u, kernel);
+		if (vkResult == VK_SUCCESS) vkResult = createBuffer(size, src);
+		if (vkResult == VK_SUCCESS) vkResult = createBuffer(size, dst);
+		if (vkResult == VK_SUCCESS) vkResult = createBindings(*kernel, { src, dst }, descriptorSet);
+
+		std::vector<uint32_t> data(static_cast<size_t>(size / 4u));
+		for (size_t i{ 0u }; i < data.size(); ++i)
+			data[i] = static_cast<uint32_t>(i * 2654435761u);
+		if (vkResult == VK_SUCCESS) vkResult = mEngine.upload(src->buffer, 0u, data.data(), size);
+
+		const uint32_t pushConstants{ static_cast<uint32_t>(count) };
+
+		if (vkResult == VK_SUCCESS)
+			vkResult = run(
+				[&]() { mEngine.dispatch(*kernel, descriptorSet, &pushConstants, getGroupCount(count)); },
+				[&]()
+				{
+					std::vector<uint32_t> output(data.size());
+					return mEngine.readback(dst->buffer, 0u, output.data(), size) == VK_SUCCESS && output == data;
+				},
+				mOptions.iterations, result);
+
+		return vkResult;
+	}
+
+	VkResult Benchmark::runSaxpy(Result& result)
+	{
+		const VkDeviceSize count{ mOptions.size / 4u };
+		const VkDeviceSize size{ count * 4u };
+		result = { "saxpy", 3.0 * static_cast<double>(size), 1u, 0u, 0.0, false };
+
+		ComputeKernel* kernel{ nullptr };
+		Buffer* x{ nullptr };
+		Buffer* y{ nullptr };
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+
+		VkResult vkResult = createKernel("saxpy", 2u, 8u, kernel);
+		if (vkResult == VK_SUCCESS) vkResult = createBuffer(size, x);
+		if (vkResult == VK_SUCCESS) vkResult = createBuffer(size, y);
+		if (vkResult == VK_SUCCESS) vkResult = createBindings(*kernel, { x, y }, descriptorSet);
+
+		// small integers, a * x + y is exact in float whether or not the device fuses it
+		std::vector<float> dataX(static_cast<size_t>(count));
+		std::vector<float> dataY(static_cast<size_t>(count));
+		for (size_t i{ 0u }; i < dataX.size(); ++i)
+		{
+			dataX[i] = static_cast<float>(i % 1024u);
+			dataY[i] = static_cast<float>(i % 7u);
+		}
+		if (vkResult == VK_SUCCESS) vkResult = mEngine.upload(x->buffer, 0u, dataX.data(), size);
+		if (vkResult == VK_SUCCESS) vkResult = mEngine.upload(y->buffer, 0u, dataY.data(), size);
+
+		struct
+		{
+			uint32_t count;
+			float a;
+		} pushConstants{ static_cast<uint32_t>(count), 2.0f };
+
+		if (vkResult == VK_SUCCESS)
+			vkResult = run(
+				[&]() { mEngine.dispatch(*kernel, descriptorSet, &pushConstants, getGroupCount(count)); },
+				[&]()
+				{
+					std::vector<float> output(dataY.size());
+					if (mEngine.readback(y->buffer, 0u, output.data(), size) != VK_SUCCESS)
+						return false;
+					for (size_t i{ 0u }; i < output.size(); ++i)
+						if (output[i] != pushConstants.a * dataX[i] + dataY[i])
+							return false;
+					return true;
+				},
+				mOptions.iterations, result);
+
+		return vkResult;
+	}
+
+	VkResult Benchmark::runReduce(Result& result)
+	{
+		const VkDeviceSize count{ mOptions.size / 4u };
+		const VkDeviceSize size{ count * 4u };
+		result = { "reduce", static_cast<double>(size), 2u, 0u, 0.0, false };
+
+		const uint32_t groupCount{ std::min(getGroupCount(count), cReduceGroups) };
+
+		ComputeKernel* kernel{ nullptr };
+		Buffer* input{ nullptr };
+		Buffer* partials{ nullptr };
+		Buffer* sum{ nullptr };
+		VkDescriptorSet firstPass{ VK_NULL_HANDLE };
+		VkDescriptorSet secondPass{ VK_NULL_HANDLE };
+
+		VkResult vkResult = createKernel("reduce", 2u, 4u, kernel);
+		if (vkResult == VK_SUCCESS) vkResult = createBuffer(size, input);
+		if (vkResult == VK_SUCCESS) vkResult = createBuffer(groupCount * 4u, partials);
+		if (vkResult == VK_SUCCESS) vkResult = createBuffer(4u, sum);
+		if (vkResult == VK_SUCCESS) vkResult = createBindings(*kernel, { input, partials }, firstPass);
+		if (vkResult == VK_SUCCESS) vkResult = createBindings(*kernel, { partials, sum }, secondPass);
+
+		std::vector<uint32_t> data(static_cast<size_t>(count));
+		uint32_t expected{ 0u };
+		for (size_t i{ 0u }; i < data.size(); ++i)
+		{
+			data[i] = static_cast<uint32_t>(i * 2654435761u) >> 8u;
+			expected += data[i];
+		}
+		if (vkResult == VK_SUCCESS) vkResult = mEngine.upload(input->buffer, 0u, data.data(), size);
+
+		const uint32_t firstPassCount{ static_cast<uint32_t>(count) };
+
+		if (vkResult == VK_SUCCESS)
+			vkResult = run(
+				[&]()
+				{
+					mEngine.dispatch(*kernel, firstPass, &firstPassCount, groupCount);
+					mEngine.barrier();
+					mEngine.dispatch(*kernel, secondPass, &groupCount, 1u);
+				},
+				[&]()
+				{
+					uint32_t output{ 0u };
+					return mEngine.readback(sum->buffer, 0u, &output, 4u) == VK_SUCCESS && output == expected;
+				},
+				mOptions.iterations, result);
+
+		return vkResult;
+	}
+
+	VkResult Benchmark::runScan(Result& result)
+	{
+		const VkDeviceSize count{ mOptions.size / 4u };
+		const VkDeviceSize size{ count * 4u };
+		result = { "scan", 4.0 * static_cast<double>(size), 0u, 0u, 0.0, false };
+
+		// level 0 is the data, level k + 1 holds the block sums of level k, the last level is one block
+		std::vector<uint32_t> levelCounts{ static_cast<uint32_t>(count) };
+		while (levelCounts.back() > cScanBlockSize)
+			levelCounts.push_back(divideRoundUp(levelCounts.back(), cScanBlockSize));
+
+		if (divideRoundUp(count, cScanBlockSize) > mEngine.getMaxGroupCountX())
+		{
+			std::fprintf(stderr, "scan: %llu elements exceed maxComputeWorkGroupCount[0] blocks\n", static_cast<unsigned long long>(count));
+			return VK_ERROR_INITIALIZATION_FAILED;
+		}
+
+		ComputeKernel* scanKernel{ nullptr };
+		ComputeKernel* addKernel{ nullptr };
+		VkResult vkResult = createKernel("scan", 2u, 4u, scanKernel);
+		if (vkResult == VK_SUCCESS) vkResult = createKernel("scan_add", 2u, 4u, addKernel);
+
+		const size_t levelCount{ levelCounts.size() };
+		std::vector<Buffer*> levels(levelCount + 1u, nullptr);	// + total of the last level
+		for (size_t level{ 0u }; vkResult == VK_SUCCESS && level <= levelCount; ++level)
+			vkResult = createBuffer(level == 0u ? size : divideRoundUp(levelCounts[level - 1u], cScanBlockSize) * 4u, levels[level]);
+
+		std::vector<VkDescriptorSet> scanSets(levelCount, VK_NULL_HANDLE);
+		std::vector<VkDescriptorSet> addSets(levelCount, VK_NULL_HANDLE);
+		for (size_t level{ 0u }; vkResult == VK_SUCCESS && level < levelCount; ++level)
+		{
+			vkResult = createBindings(*scanKernel, { levels[level], levels[level + 1u] }, scanSets[level]);
+			if (vkResult == VK_SUCCESS)
+				vkResult = createBindings(*addKernel, { levels[level], levels[level + 1u] }, addSets[level]);
+		}
+
+		std::vector<uint32_t> data(static_cast<size_t>(count));
+		for (size_t i{ 0u }; i < data.size(); ++i)
+			data[i] = static_cast<uint32_t>(i * 2654435761u) >> 24u;
+		if (vkResult == VK_SUCCESS) vkResult = mEngine.upload(levels[0]->buffer, 0u, data.data(), size);
+
+		result.dispatches = static_cast<uint32_t>(2u * levelCount - 1u);
+
+		if (vkResult == VK_SUCCESS)
+			vkResult = run(
+				[&]()
+				{
+					for (size_t level{ 0u }; level < levelCount; ++level)
+					{
+						mEngine.dispatch(*scanKernel, scanSets[level], &levelCounts[level], divideRoundUp(levelCounts[level], cScanBlockSize));
+						mEngine.barrier();
+					}
+					// the last level is a single block, its scan is complete
+					for (size_t level{ levelCount - 1u }; level-- > 0u; )
+					{
+						mEngine.dispatch(*addKernel, addSets[level], &levelCounts[level], divideRoundUp(levelCounts[level], cScanBlockSize));
+						if (level > 0u)
+							mEngine.barrier();
+					}
+				},
+				[&]()
+				{
+					std::vector<uint32_t> output(data.size());
+					if (mEngine.readback(levels[0]->buffer, 0u, output.data(), size) != VK_SUCCESS)
+						return false;
+					uint32_t prefix{ 0u };
+					for (size_t i{ 0u }; i < output.size(); ++i)
+					{
+						if (output[i] != prefix)
+							return false;
+						prefix += data[i];
+					}
+					return true;
+				},
+				mOptions.iterations, result);
+
+		return vkResult;
+	}
+
+	VkResult Benchmark::runDispatch(Result& result)
+	{
+		result = { "dispatch", 0.0, mOptions.dispatches, 1u, 0.0, true };
+
+		ComputeKernel* kernel{ nullptr };
+		Buffer* buffer{ nullptr };
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+
+		VkResult vkResult = createKernel("memcpy", 2u, 4u, kernel);
+		if (vkResult == VK_SUCCESS) vkResult = createBuffer(16u, buffer);
+		if (vkResult == VK_SUCCESS) vkResult = createBindings(*kernel, { buffer, buffer }, descriptorSet);
+
+		// count 0 - the kernel returns immediately
+		const uint32_t pushConstants{ 0u };
+
+		if (vkResult == VK_SUCCESS)
+			vkResult = mEngine.begin();
+		if (vkResult == VK_SUCCESS)
+		{
+			for (uint32_t i{ 0u }; i < mOptions.dispatches; ++i)
+				mEngine.dispatch(*kernel, descriptorSet, &pushConstants, 1u);
+
+			const auto start = std::chrono::steady_clock::now();
+			vkResult = mEngine.submit();
+			if (vkResult == VK_SUCCESS)
+				vkResult = mEngine.wait();
+			result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		return vkResult;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return -1;
+	}
+
+	if (options.icd)
+		setIcd(options.icd);
+
+	AppConfig config;
+	config.printDeviceMemoryStatistics = false;
+	config.printPipelineCacheStatistics = false;
+	config.printHostAllocatorSummary = false;
+	config.deviceSelection.log = false;
+	config.staging.ringSize = 0u;
+	config.headless.framesInFlight = 0u;
+
+	App app(config);
+	VkResult result = app.init();
+	if (result != VK_SUCCESS)
+	{
+		std::fprintf(stderr, "App::init() failed: VkResult %d\n", static_cast<int>(result));
+		return -1;
+	}
+
+	std::vector<Result> results;
+	bool passed{ true };
+	{
+		Benchmark benchmark(app, options);
+
+		using Run = VkResult (Benchmark::*)(Result&);
+		const Run runs[] = { &Benchmark::runMemcpy, &Benchmark::runSaxpy, &Benchmark::runReduce, &Benchmark::runScan, &Benchmark::runDispatch };
+
+		for (Run run : runs)
+		{
+			Result kernelResult{};
+			result = (benchmark.*run)(kernelResult);
+			if (result != VK_SUCCESS)
+				std::fprintf(stderr, "%s failed: VkResult %d\n", kernelResult.name, static_cast<int>(result));
+			passed = passed && result == VK_SUCCESS && kernelResult.verified;
+			results.push_back(kernelResult);
+		}
+	}
+
+	const double sizeMB{ static_cast<double>(options.size) / (1024.0 * 1024.0) };
+	const uint32_t iterations{ options.iterations };
+
+	if (options.format == OutputFormat::Text)
+		std::printf("%-10s %12s %12s %14s %10s\n", "kernel", "ms/iter", "GB/s", "dispatches/s", "verified");
+	else
+		std::printf("{\"benchmark\":\"compute\",\"size_mb\":%.1f,\"iterations\":%u,\"kernels\":[", sizeMB, iterations);
+
+	for (size_t i{ 0u }; i < results.size(); ++i)
+	{
+		const Result& kernelResult = results[i];
+		const uint32_t runs{ std::max(kernelResult.iterations, 1u) };
+		const double seconds{ kernelResult.seconds > 0.0 ? kernelResult.seconds : 1e-9 };
+		const double msPerIteration{ 1000.0 * seconds / runs };
+		const double gigabytesPerSecond{ kernelResult.bytes * runs / seconds / 1e9 };
+		const double dispatchesPerSecond{ static_cast<double>(kernelResult.dispatches) * runs / seconds };
+
+		if (options.format == OutputFormat::Text)
+			std::printf("%-10s %12.3f %12.2f %14.0f %10s\n", kernelResult.name, msPerIteration, gigabytesPerSecond, dispatchesPerSecond,
+				kernelResult.verified ? "passed" : "FAILED");
+		else
+			std::printf("%s{\"kernel\":\"%s\",\"ms_per_iteration\":%.6f,\"gb_per_s\":%.3f,\"dispatches_per_s\":%.1f,\"verified\":%s}",
+				i ? "," : "", kernelResult.name, msPerIteration, gigabytesPerSecond, dispatchesPerSecond, kernelResult.verified ? "true" : "false");
+	}
+
+	if (options.format == OutputFormat::Json)
+		std::printf("]}\n");
+
+	app.deinit();
+
+	return passed ? 0 : -1;
+}
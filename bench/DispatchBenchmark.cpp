@@ -0,0 +1,299 @@
+// Dispatch benchmark - measures the host cost of one Vulkan call through the
+// loader and through App's device dispatch table (see VulkanDispatch.h).
+//
+// Usage: mkDispatchBenchmark [--calls N] [--repeat N] [--format text|json] [--icd path]
+//
+// --calls   calls per measurement (default 4M)
+// --repeat  measurements per path and function, the fastest one is reported (default 3)
+// --icd     selects the Vulkan driver manifest (sets VK_ICD_FILENAMES), e.g. a software ICD:
+//   lavapipe    /usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+//   SwiftShader <build>/Linux/vk_swiftshader_icd.json
+//
+// Functions:
+//   vkCmdSetViewport  recorded into a command buffer (dispatched through the command buffer handle)
+//   vkGetFenceStatus  on an unsignaled fence (dispatched through the device handle)
+//
+// Paths:
+//   export     symbol exported by the loader library (not built with VK_NO_PROTOTYPES)
+//   loader     pointer from vkGetInstanceProcAddr - the same loader trampoline, found at runtime
+//   table      pointer from vkGetDeviceProcAddr - the driver's (or first layer's) function
+//
+// Both functions do almost nothing in the driver, so the difference between
+// the paths is the trampoline and its dispatch lookup per call.
+
+#include "App.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	enum class OutputFormat { Text, Json };
+
+	struct Options
+	{
+		uint32_t calls{ 4u * 1024u * 1024u };
+		uint32_t repeat{ 3u };
+		OutputFormat format{ OutputFormat::Text };
+		const char* icd{ nullptr };
+	};
+
+	void printUsage()
+	{
+		std::printf("Usage: mkDispatchBenchmark [--calls N] [--repeat N] [--format text|json] [--icd path]\n");
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i{ 1 }; i < argc; ++i)
+		{
+			const bool hasValue{ i + 1 < argc };
+
+			if (std::strcmp(argv[i], "--calls") == 0 && hasValue)
+				options.calls = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--repeat") == 0 && hasValue)
+				options.repeat = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--icd") == 0 && hasValue)
+				options.icd = argv[++i];
+			else if (std::strcmp(argv[i], "--format") == 0 && hasValue)
+			{
+				const std::string format{ argv[++i] };
+				if (format == "text")
+					options.format = OutputFormat::Text;
+				else if (format == "json")
+					options.format = OutputFormat::Json;
+				else
+					return false;
+			}
+			else
+				return false;
+		}
+
+		return options.calls > 0u && options.repeat > 0u;
+	}
+
+	void setIcd(const char* icd)
+	{
+#ifdef _WIN32
+		_putenv_s("VK_ICD_FILENAMES", icd);
+#else
+		setenv("VK_ICD_FILENAMES", icd, 1);
+#endif
+	}
+
+	using Clock = std::chrono::steady_clock;
+
+	// commands recorded per command buffer before it is reset, keeps its memory small
+	constexpr uint32_t cCommandsPerRecording{ 4096u };
+
+	struct Path
+	{
+		const char* name;
+		PFN_vkCmdSetViewport cmdSetViewport;
+		PFN_vkGetFenceStatus getFenceStatus;
+	};
+
+	struct Result
+	{
+		const char* function;
+		const char* path;
+		double nanosecondsPerCall;
+	};
+
+	// Fastest of options.repeat runs, only the calls are timed (not begin/end/reset of the command buffer)
+	VkResult measureCmdSetViewport(const DeviceDispatch& dispatch, VkCommandBuffer commandBuffer, PFN_vkCmdSetViewport cmdSetViewport,
+		const Options& options, double& nanosecondsPerCall)
+	{
+		const VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr };
+		VkViewport viewport = { 0.0f, 0.0f, 256.0f, 256.0f, 0.0f, 1.0f };
+
+		VkResult result = VK_SUCCESS;
+		Clock::duration best{ Clock::duration::max() };
+		for (uint32_t run{ 0u }; result == VK_SUCCESS && run < options.repeat; ++run)
+		{
+			Clock::duration elapsed{ 0 };
+			for (uint32_t call{ 0u }; result == VK_SUCCESS && call < options.calls; call += cCommandsPerRecording)
+			{
+				result = dispatch.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+				if (result != VK_SUCCESS)
+					break;
+
+				const uint32_t count{ std::min(cCommandsPerRecording, options.calls - call) };
+				const Clock::time_point start{ Clock::now() };
+				for (uint32_t i{ 0u }; i < count; ++i)
+				{
+					viewport.x = static_cast<float>(i & 0xffu);
+					cmdSetViewport(commandBuffer, 0u, 1u, &viewport);
+				}
+				elapsed += Clock::now() - start;
+
+				result = dispatch.vkEndCommandBuffer(commandBuffer);
+				if (result == VK_SUCCESS)
+					result = dispatch.vkResetCommandBuffer(commandBuffer, 0u);
+			}
+			best = std::min(best, elapsed);
+		}
+
+		nanosecondsPerCall = std::chrono::duration<double, std::nano>(best).count() / options.calls;
+		return result;
+	}
+
+	VkResult measureGetFenceStatus(VkDevice device, VkFence fence, PFN_vkGetFenceStatus getFenceStatus, const Options& options,
+		double& nanosecondsPerCall)
+	{
+		VkResult result = VK_SUCCESS;
+		Clock::duration best{ Clock::duration::max() };
+		for (uint32_t run{ 0u }; result == VK_SUCCESS && run < options.repeat; ++run)
+		{
+			const Clock::time_point start{ Clock::now() };
+			for (uint32_t i{ 0u }; i < options.calls && result == VK_SUCCESS; ++i)
+				result = getFenceStatus(device, fence) == VK_NOT_READY ? VK_SUCCESS : VK_ERROR_UNKNOWN;
+			best = std::min(best, Clock::now() - start);
+		}
+
+		nanosecondsPerCall = std::chrono::duration<double, std::nano>(best).count() / options.calls;
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return -1;
+	}
+
+	if (options.icd)
+		setIcd(options.icd);
+
+	// only the device and its dispatch table are needed
+	AppConfig config;
+	config.printDeviceMemoryStatistics = false;
+	config.printPipelineCacheStatistics = false;
+	config.printHostAllocatorSummary = false;
+	config.deviceSelection.log = false;
+	config.staging.ringSize = 0u;
+	config.compute.maxDescriptorSets = 0u;
+	config.commandRecorder.framesInFlight = 0u;
+	config.submission.maxBatchesInFlight = 0u;
+	config.headless.framesInFlight = 0u;
+
+	App app(config);
+	VkResult result = app.init();
+	if (result != VK_SUCCESS)
+	{
+		std::fprintf(stderr, "App::init() failed: VkResult %d\n", static_cast<int>(result));
+		return -1;
+	}
+
+	const VkDevice device{ app.getDevice() };
+	const DeviceDispatch& dispatch = app.getDeviceDispatch();
+	const GlobalDispatch& global = app.getGlobalDispatch();
+
+	std::vector<Path> paths;
+#ifndef VK_NO_PROTOTYPES
+	paths.push_back({ "export", &vkCmdSetViewport, &vkGetFenceStatus });
+#endif
+	paths.push_back({ "loader",
+		reinterpret_cast<PFN_vkCmdSetViewport>(global.vkGetInstanceProcAddr(app.getInstance(), "vkCmdSetViewport")),
+		reinterpret_cast<PFN_vkGetFenceStatus>(global.vkGetInstanceProcAddr(app.getInstance(), "vkGetFenceStatus")) });
+	paths.push_back({ "table", dispatch.vkCmdSetViewport, dispatch.vkGetFenceStatus });
+
+	const VkCommandPoolCreateInfo commandPoolCreateInfo = {
+		VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		app.getQueueFamilyIndex(QueueType::Graphics)
+	};
+	const VkFenceCreateInfo fenceCreateInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, nullptr, 0u };
+
+	VkCommandPool commandPool{ VK_NULL_HANDLE };
+	VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+	VkFence fence{ VK_NULL_HANDLE };
+
+	result = dispatch.vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool);
+	if (result == VK_SUCCESS)
+	{
+		const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr, commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1u
+		};
+		result = dispatch.vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer);
+	}
+	if (result == VK_SUCCESS)
+		result = dispatch.vkCreateFence(device, &fenceCreateInfo, nullptr, &fence);
+
+	std::vector<Result> results;
+	for (const Path& path : paths)
+	{
+		if (result != VK_SUCCESS)
+			break;
+
+		if (!path.cmdSetViewport || !path.getFenceStatus)
+		{
+			std::fprintf(stderr, "%s: function pointer missing\n", path.name);
+			result = VK_ERROR_INITIALIZATION_FAILED;
+			break;
+		}
+
+		double nanosecondsPerCall{ 0.0 };
+		result = measureCmdSetViewport(dispatch, commandBuffer, path.cmdSetViewport, options, nanosecondsPerCall);
+		results.push_back({ "vkCmdSetViewport", path.name, nanosecondsPerCall });
+
+		if (result == VK_SUCCESS)
+			result = measureGetFenceStatus(device, fence, path.getFenceStatus, options, nanosecondsPerCall);
+		results.push_back({ "vkGetFenceStatus", path.name, nanosecondsPerCall });
+	}
+
+	// paths of a function next to each other
+	std::stable_sort(results.begin(), results.end(),
+		[](const Result& a, const Result& b) { return std::strcmp(a.function, b.function) < 0; });
+
+	if (result == VK_SUCCESS)
+	{
+		// relative to the loader path, the one available in every build
+		const auto getLoaderTime = [&results](const char* function)
+		{
+			for (const Result& entry : results)
+				if (std::strcmp(entry.function, function) == 0 && std::strcmp(entry.path, "loader") == 0)
+					return entry.nanosecondsPerCall;
+			return 0.0;
+		};
+
+		if (options.format == OutputFormat::Text)
+			std::printf("%-18s %-8s %10s %12s\n", "function", "path", "ns/call", "vs loader");
+		else
+			std::printf("{\"benchmark\":\"dispatch\",\"calls\":%u,\"repeat\":%u,\"results\":[", options.calls, options.repeat);
+
+		for (size_t i{ 0u }; i < results.size(); ++i)
+		{
+			const Result& entry = results[i];
+			const double loaderTime{ getLoaderTime(entry.function) };
+			const double speedup{ entry.nanosecondsPerCall > 0.0 ? loaderTime / entry.nanosecondsPerCall : 0.0 };
+
+			if (options.format == OutputFormat::Text)
+				std::printf("%-18s %-8s %10.2f %11.2fx\n", entry.function, entry.path, entry.nanosecondsPerCall, speedup);
+			else
+				std::printf("%s{\"function\":\"%s\",\"path\":\"%s\",\"ns_per_call\":%.3f,\"speedup\":%.3f}",
+					i ? "," : "", entry.function, entry.path, entry.nanosecondsPerCall, speedup);
+		}
+
+		if (options.format == OutputFormat::Json)
+			std::printf("]}\n");
+	}
+	else
+		std::fprintf(stderr, "dispatch benchmark failed: VkResult %d\n", static_cast<int>(result));
+
+	if (fence != VK_NULL_HANDLE)
+		dispatch.vkDestroyFence(device, fence, nullptr);
+	if (commandPool != VK_NULL_HANDLE)
+		dispatch.vkDestroyCommandPool(device, commandPool, nullptr);
+
+	app.deinit();
+
+	return result == VK_SUCCESS ? 0 : -1;
+}
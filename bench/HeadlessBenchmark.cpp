@@ -0,0 +1,434 @@
+// Headless rendering benchmark - renders a rotating triangle offscreen with
+// HeadlessRenderer on the Graphics queue and reports frames per second and
+// the latency from renderFrame() to the frame arriving on the host.
+//
+// Usage: mkHeadlessBenchmark [--width N] [--height N] [--frames N] [--frames-in-flight N] [--output dir] [--raw]
+//                            [--shaders dir] [--trace path] [--format text|json] [--icd path]
+//
+// --width, --height    color target size (default 1920 x 1080)
+// --frames             timed frames per mode (default 300)
+// --frames-in-flight   frames of the pipelined mode (default 2)
+// --output             write every frame to dir as frame_<mode>_<index>.ppm (or .raw with --raw)
+// --shaders            directory of the compiled shaders (default: shaders/ of the build tree)
+// --trace              profile CPU and GPU zones of all frames, written to path as Chrome trace JSON
+//                      (open in chrome://tracing or ui.perfetto.dev)
+// --icd                selects the Vulkan driver manifest (sets VK_ICD_FILENAMES), e.g. a software ICD:
+//   lavapipe    /usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+//   SwiftShader <build>/Linux/vk_swiftshader_icd.json
+//
+// Modes:
+//   sync       1 frame in flight - render, wait, read back, repeat
+//   pipelined  frames-in-flight frames - frame N is read back while N+1 renders
+//
+// Every frame is consumed by summing all of its texels in place (stand-in for
+// an encoder), so the host side of the readback is part of the measurement.
+// The first frame of each mode is checked: the center pixel has to be covered
+// by the triangle, the corner pixel has to be the clear color. Exit code is
+// non-zero when a mode fails or the check does not pass.
+
+#include "App.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef MK_SHADER_DIR
+#define MK_SHADER_DIR "shaders"
+#endif
+
+namespace
+{
+	enum class OutputFormat { Text, Json };
+
+	struct Options
+	{
+		uint32_t width{ 1920u };
+		uint32_t height{ 1080u };
+		uint32_t frames{ 300u };
+		uint32_t framesInFlight{ 2u };
+		std::string outputDir;
+		bool raw{ false };
+		std::string shaderDir{ MK_SHADER_DIR };
+		std::string tracePath;
+		OutputFormat format{ OutputFormat::Text };
+		const char* icd{ nullptr };
+	};
+
+	struct Result
+	{
+		const char* mode;
+		uint32_t framesInFlight;
+		uint32_t frames;			// timed
+		double seconds;				// all timed frames, first renderFrame() to flush()
+		double latencySum;			// seconds
+		double latencyMax;
+		uint64_t checksum;			// texel sum of all timed frames, keeps the consumer from being optimized away
+		bool verified;
+	};
+
+	void printUsage()
+	{
+		std::printf("Usage: mkHeadlessBenchmark [--width N] [--height N] [--frames N] [--frames-in-flight N] [--output dir] [--raw]\n"
+			"                           [--shaders dir] [--trace path] [--format text|json] [--icd path]\n");
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i{ 1 }; i < argc; ++i)
+		{
+			const bool hasValue{ i + 1 < argc };
+
+			if (std::strcmp(argv[i], "--width") == 0 && hasValue)
+				options.width = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--height") == 0 && hasValue)
+				options.height = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--frames") == 0 && hasValue)
+				options.frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--frames-in-flight") == 0 && hasValue)
+				options.framesInFlight = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--output") == 0 && hasValue)
+				options.outputDir = argv[++i];
+			else if (std::strcmp(argv[i], "--raw") == 0)
+				options.raw = true;
+			else if (std::strcmp(argv[i], "--shaders") == 0 && hasValue)
+				options.shaderDir = argv[++i];
+			else if (std::strcmp(argv[i], "--trace") == 0 && hasValue)
+				options.tracePath = argv[++i];
+			else if (std::strcmp(argv[i], "--icd") == 0 && hasValue)
+				options.icd = argv[++i];
+			else if (std::strcmp(argv[i], "--format") == 0 && hasValue)
+			{
+				const std::string format{ argv[++i] };
+				if (format == "text")
+					options.format = OutputFormat::Text;
+				else if (format == "json")
+					options.format = OutputFormat::Json;
+				else
+					return false;
+			}
+			else
+				return false;
+		}
+
+		return options.width > 0u && options.height > 0u && options.frames > 0u && options.framesInFlight > 0u;
+	}
+
+	void setIcd(const char* icd)
+	{
+#ifdef _WIN32
+		_putenv_s("VK_ICD_FILENAMES", icd);
+#else
+		setenv("VK_ICD_FILENAMES", icd, 1);
+#endif
+	}
+
+	// Triangle pipeline of shaders/triangle.vert + color.frag, created per renderer (render pass)
+	class TrianglePipeline
+	{
+	public:
+		explicit TrianglePipeline(App& app)
+			: mDevice(app.getDevice())
+			, mDispatch(app.getDeviceDispatch())
+			, mPipelineCache(app.getPipelineCache())
+		{
+		}
+
+		~TrianglePipeline()
+		{
+			if (mPipeline != VK_NULL_HANDLE)
+				mDispatch.vkDestroyPipeline(mDevice, mPipeline, nullptr);
+			if (mPipelineLayout != VK_NULL_HANDLE)
+				mDispatch.vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+			for (VkShaderModule shaderModule : mShaderModules)
+				if (shaderModule != VK_NULL_HANDLE)
+					mDispatch.vkDestroyShaderModule(mDevice, shaderModule, nullptr);
+		}
+
+		VkResult create(const std::string& shaderDir, VkRenderPass renderPass);
+
+		// Draw the triangle rotated by angle
+		void draw(VkCommandBuffer commandBuffer, float angle) const
+		{
+			mDispatch.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline);
+			mDispatch.vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0u, sizeof(angle), &angle);
+			mDispatch.vkCmdDraw(commandBuffer, 3u, 1u, 0u, 0u);
+		}
+	private:
+		VkResult createShaderModule(const std::string& path, VkShaderModule& shaderModule);
+
+		VkDevice mDevice;
+		const DeviceDispatch& mDispatch;
+		PipelineCache& mPipelineCache;
+		VkShaderModule mShaderModules[2]{ VK_NULL_HANDLE, VK_NULL_HANDLE };	// vertex, fragment
+		VkPipelineLayout mPipelineLayout{ VK_NULL_HANDLE };
+		VkPipeline mPipeline{ VK_NULL_HANDLE };
+	};
+
+	VkResult TrianglePipeline::createShaderModule(const std::string& path, VkShaderModule& shaderModule)
+	{
+		std::vector<uint32_t> code;
+		if (!ComputeEngine::loadSpirv(path, code))
+		{
+			std::fprintf(stderr, "cannot load shader %s\n", path.c_str());
+			return VK_ERROR_INITIALIZATION_FAILED;
+		}
+
+		const VkShaderModuleCreateInfo shaderModuleCreateInfo = {
+			VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0u, code.size() * sizeof(uint32_t), code.data()
+		};
+
+		return mDispatch.vkCreateShaderModule(mDevice, &shaderModuleCreateInfo, nullptr, &shaderModule);
+	}
+
+	VkResult TrianglePipeline::create(const std::string& shaderDir, VkRenderPass renderPass)
+	{
+		VkResult result = createShaderModule(shaderDir + "/triangle.spv", mShaderModules[0]);
+		if (result == VK_SUCCESS)
+			result = createShaderModule(shaderDir + "/color.spv", mShaderModules[1]);
+
+		if (result == VK_SUCCESS)
+		{
+			const VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, 0u, sizeof(float) };
+			const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+				VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, nullptr, 0u, 0u, nullptr, 1u, &pushConstantRange
+			};
+
+			result = mDispatch.vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, nullptr, &mPipelineLayout);
+		}
+
+		if (result == VK_SUCCESS)
+		{
+			const VkPipelineShaderStageCreateInfo stages[] = {
+				{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0u, VK_SHADER_STAGE_VERTEX_BIT, mShaderModules[0], "main", nullptr },
+				{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0u, VK_SHADER_STAGE_FRAGMENT_BIT, mShaderModules[1], "main", nullptr }
+			};
+			const VkPipelineVertexInputStateCreateInfo vertexInputState = {
+				VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO, nullptr, 0u, 0u, nullptr, 0u, nullptr	// positions come from the shader
+			};
+			const VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {
+				VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO, nullptr, 0u, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_FALSE
+			};
+			const VkPipelineViewportStateCreateInfo viewportState = {
+				VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO, nullptr, 0u, 1u, nullptr, 1u, nullptr	// dynamic, set by the renderer
+			};
+			const VkPipelineRasterizationStateCreateInfo rasterizationState = {
+				VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO, nullptr, 0u, VK_FALSE, VK_FALSE,
+				VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, VK_FALSE, 0.0f, 0.0f, 0.0f, 1.0f
+			};
+			const VkPipelineMultisampleStateCreateInfo multisampleState = {
+				VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO, nullptr, 0u, VK_SAMPLE_COUNT_1_BIT, VK_FALSE, 1.0f, nullptr, VK_FALSE, VK_FALSE
+			};
+			const VkPipelineColorBlendAttachmentState colorBlendAttachment = {
+				VK_FALSE, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO, VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO, VK_BLEND_OP_ADD,
+				VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+			};
+			const VkPipelineColorBlendStateCreateInfo colorBlendState = {
+				VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO, nullptr, 0u, VK_FALSE, VK_LOGIC_OP_COPY, 1u, &colorBlendAttachment,
+				{ 0.0f, 0.0f, 0.0f, 0.0f }
+			};
+			const VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+			const VkPipelineDynamicStateCreateInfo dynamicState = {
+				VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO, nullptr, 0u, 2u, dynamicStates
+			};
+			const VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {
+				VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, nullptr, 0u, 2u, stages, &vertexInputState, &inputAssemblyState, nullptr,
+				&viewportState, &rasterizationState, &multisampleState, nullptr, &colorBlendState, &dynamicState, mPipelineLayout,
+				renderPass, 0u, VK_NULL_HANDLE, -1
+			};
+
+			result = mPipelineCache.createGraphicsPipelines(1u, &graphicsPipelineCreateInfo, &mPipeline);
+		}
+
+		return result;
+	}
+
+	// Sum of the texels, reads every byte of the mapped readback buffer
+	uint64_t consume(const HeadlessFrame& frame)
+	{
+		uint64_t sum{ 0u };
+		for (uint32_t y{ 0u }; y < frame.height; ++y)
+		{
+			const uint8_t* row{ frame.data + y * frame.rowPitch };
+			for (VkDeviceSize x{ 0u }; x < frame.rowPitch; x += sizeof(uint32_t))
+			{
+				uint32_t texel;
+				std::memcpy(&texel, row + x, sizeof(texel));
+				sum += texel;
+			}
+		}
+		return sum;
+	}
+
+	// RGBA8 texel at x, y
+	uint32_t getTexel(const HeadlessFrame& frame, uint32_t x, uint32_t y)
+	{
+		uint32_t texel;
+		std::memcpy(&texel, frame.data + y * frame.rowPitch + x * sizeof(texel), sizeof(texel));
+		return texel;
+	}
+
+	VkResult runMode(App& app, const Options& options, const char* mode, uint32_t framesInFlight, Result& result)
+	{
+		result = { mode, framesInFlight, options.frames, 0.0, 0.0, 0.0, 0u, false };
+
+		HeadlessRendererConfig config;
+		config.width = options.width;
+		config.height = options.height;
+		config.framesInFlight = framesInFlight;
+		config.format = VK_FORMAT_R8G8B8A8_UNORM;
+		config.clearColor = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+
+		HeadlessRenderer renderer;
+		VkResult vkResult = renderer.init(app.getDevice(), app.getDeviceDispatch(), app.getMemoryAllocator(),
+			app.getQueueFamilyIndex(QueueType::Graphics), app.getQueue(QueueType::Graphics), nullptr, config);
+
+		// zones of the renderer, one profiler frame per rendered frame
+		Profiler* profiler{ options.tracePath.empty() ? nullptr : &app.getProfiler() };
+		renderer.setProfiler(profiler);
+
+		TrianglePipeline pipeline(app);
+		if (vkResult == VK_SUCCESS)
+			vkResult = pipeline.create(options.shaderDir, renderer.getRenderPass());
+
+		const auto record = [&pipeline](VkCommandBuffer commandBuffer, uint64_t frameIndex)
+		{
+			pipeline.draw(commandBuffer, 0.01f * static_cast<float>(frameIndex));
+		};
+
+		// first frame (pipeline warm-up) is checked, not timed
+		if (vkResult == VK_SUCCESS)
+			vkResult = renderer.renderFrame(record, [&result](const HeadlessFrame& frame)
+			{
+				const uint32_t clear{ 0xff000000u };	// opaque black, RGBA8 little endian
+				const uint32_t center{ getTexel(frame, frame.width / 2u, frame.height / 2u) };
+				result.verified = getTexel(frame, 0u, 0u) == clear && center != clear && (center >> 24u) == 0xffu;
+			});
+		if (vkResult == VK_SUCCESS)
+			vkResult = renderer.flush();
+
+		const auto output = [&options, &result, mode](const HeadlessFrame& frame)
+		{
+			const double latency{ std::chrono::duration<double>(frame.latency).count() };
+			result.latencySum += latency;
+			result.latencyMax = std::max(result.latencyMax, latency);
+			result.checksum += consume(frame);
+
+			if (!options.outputDir.empty())
+			{
+				const std::string path{ options.outputDir + "/frame_" + mode + "_" + std::to_string(frame.index) + (options.raw ? ".raw" : ".ppm") };
+				if (!(options.raw ? HeadlessRenderer::writeRaw(path, frame) : HeadlessRenderer::writePpm(path, frame)))
+					std::fprintf(stderr, "cannot write %s\n", path.c_str());
+			}
+		};
+
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32_t i{ 0u }; vkResult == VK_SUCCESS && i < options.frames; ++i)
+		{
+			if (profiler)
+				profiler->beginFrame();
+			vkResult = renderer.renderFrame(record, output);
+		}
+		if (vkResult == VK_SUCCESS)
+			vkResult = renderer.flush();
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		renderer.deinit();
+
+		return vkResult;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return -1;
+	}
+
+	if (options.icd)
+		setIcd(options.icd);
+
+	// renderers are created per mode, the subsystems of App are not needed
+	AppConfig config;
+	config.printDeviceMemoryStatistics = false;
+	config.printPipelineCacheStatistics = false;
+	config.printHostAllocatorSummary = false;
+	config.deviceSelection.log = false;
+	config.staging.ringSize = 0u;
+	config.compute.maxDescriptorSets = 0u;
+	config.commandRecorder.framesInFlight = 0u;
+	config.headless.framesInFlight = 0u;
+	config.profiler.enabled = !options.tracePath.empty();
+	config.profiler.framesInFlight = options.framesInFlight + 1u;	// a slot is reused after its frame was read back
+	config.profiler.tracePath = options.tracePath;
+
+	App app(config);
+	VkResult result = app.init();
+	if (result != VK_SUCCESS)
+	{
+		std::fprintf(stderr, "App::init() failed: VkResult %d\n", static_cast<int>(result));
+		return -1;
+	}
+
+	std::vector<Result> results;
+	bool passed{ true };
+	{
+		struct Mode
+		{
+			const char* name;
+			uint32_t framesInFlight;
+		};
+		std::vector<Mode> modes{ { "sync", 1u } };
+		if (options.framesInFlight > 1u)
+			modes.push_back({ "pipelined", options.framesInFlight });
+
+		for (const Mode& mode : modes)
+		{
+			Result modeResult{};
+			result = runMode(app, options, mode.name, mode.framesInFlight, modeResult);
+			if (result != VK_SUCCESS)
+				std::fprintf(stderr, "%s failed: VkResult %d\n", mode.name, static_cast<int>(result));
+			passed = passed && result == VK_SUCCESS && modeResult.verified;
+			results.push_back(modeResult);
+		}
+	}
+
+	const double frameMB{ static_cast<double>(options.width) * options.height * 4.0 / (1024.0 * 1024.0) };
+
+	if (options.format == OutputFormat::Text)
+		std::printf("%-10s %9s %10s %12s %12s %10s %10s\n", "mode", "in flight", "fps", "latency ms", "max ms", "MB/s", "verified");
+	else
+		std::printf("{\"benchmark\":\"headless\",\"width\":%u,\"height\":%u,\"frames\":%u,\"modes\":[", options.width, options.height, options.frames);
+
+	for (size_t i{ 0u }; i < results.size(); ++i)
+	{
+		const Result& modeResult = results[i];
+		const double seconds{ modeResult.seconds > 0.0 ? modeResult.seconds : 1e-9 };
+		const double framesPerSecond{ modeResult.frames / seconds };
+		const double latencyMs{ 1000.0 * modeResult.latencySum / modeResult.frames };
+		const double latencyMaxMs{ 1000.0 * modeResult.latencyMax };
+		const double megabytesPerSecond{ frameMB * framesPerSecond };
+
+		if (options.format == OutputFormat::Text)
+			std::printf("%-10s %9u %10.1f %12.3f %12.3f %10.1f %10s\n", modeResult.mode, modeResult.framesInFlight, framesPerSecond,
+				latencyMs, latencyMaxMs, megabytesPerSecond, modeResult.verified ? "passed" : "FAILED");
+		else
+			std::printf("%s{\"mode\":\"%s\",\"frames_in_flight\":%u,\"fps\":%.2f,\"latency_ms\":%.4f,\"latency_max_ms\":%.4f,\"mb_per_s\":%.1f,"
+				"\"checksum\":%llu,\"verified\":%s}",
+				i ? "," : "", modeResult.mode, modeResult.framesInFlight, framesPerSecond, latencyMs, latencyMaxMs, megabytesPerSecond,
+				static_cast<unsigned long long>(modeResult.checksum), modeResult.verified ? "true" : "false");
+	}
+
+	if (options.format == OutputFormat::Json)
+		std::printf("]}\n");
+
+	app.deinit();
+
+	return passed ? 0 : -1;
+}
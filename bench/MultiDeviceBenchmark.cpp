@@ -0,0 +1,336 @@
+// Multi-device benchmark - saxpy batches split by App's MultiDeviceScheduler
+// across logical devices on all eligible physical devices.
+//
+// Usage: mkMultiDeviceBenchmark [--size MB] [--batches N] [--devices N] [--per-device N] [--chunks N]
+//                               [--throttle-device I] [--throttle-ms N] [--host] [--shaders dir] [--format text|json] [--icd path]
+//
+// --size             bytes of x (and of y) per batch (default 64 MB)
+// --batches          timed batches, throughput is measured from the first one on (default 8)
+// --devices          physical devices to use, selected device first (default 0 - all eligible)
+// --per-device       logical devices per physical device (default 1), e.g. 4 to run on one software ICD
+// --chunks           chunks per device and batch (default 8)
+// --throttle-device  device index made to fall behind by sleeping before each of its chunks (default none)
+// --throttle-ms      sleep of the throttled device per chunk (default 5)
+// --host             chunks compute saxpy on the thread driving the device instead of the kernel, tests the
+//                    scheduler without compiled shaders
+// --shaders          directory of the compiled kernels (default: shaders/ of the build tree)
+// --icd              selects the Vulkan driver manifest (sets VK_ICD_FILENAMES), e.g. a software ICD:
+//   lavapipe    /usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+//   SwiftShader <build>/Linux/vk_swiftshader_icd.json
+//
+// Every chunk uploads its part of x and y, runs saxpy and reads y back into
+// one host result array, so a chunk is the unit a device can be given or have
+// stolen. Bandwidth counts the 3 x 4 bytes per element saxpy moves. The result
+// of the last batch is verified. Exit code is non-zero on a mismatch, when
+// fewer than --per-device devices were created, when the work was not split
+// over at least two of them and when the other devices stole nothing while
+// one was throttled.
+
+#include "App.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef MK_SHADER_DIR
+#define MK_SHADER_DIR "shaders"
+#endif
+
+namespace
+{
+	enum class OutputFormat { Text, Json };
+
+	struct Options
+	{
+		VkDeviceSize size{ 64u * 1024u * 1024u };
+		uint32_t batches{ 8u };
+		uint32_t devices{ 0u };
+		uint32_t perDevice{ 1u };
+		uint32_t chunks{ 8u };
+		uint32_t throttleDevice{ UINT32_MAX };
+		uint32_t throttleMs{ 5u };
+		bool host{ false };
+		std::string shaderDir{ MK_SHADER_DIR };
+		OutputFormat format{ OutputFormat::Text };
+		const char* icd{ nullptr };
+	};
+
+	// Kernel and buffers of one chunk on one device
+	struct DeviceResources
+	{
+		ComputeKernel kernel;
+		VkBuffer x{ VK_NULL_HANDLE };
+		MemoryAllocation xAllocation;
+		VkBuffer y{ VK_NULL_HANDLE };
+		MemoryAllocation yAllocation;
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+	};
+
+	constexpr uint32_t cGroupSize{ 256u };		// local_size_x of saxpy.comp
+	constexpr float cA{ 2.0f };
+
+	void printUsage()
+	{
+		std::printf("Usage: mkMultiDeviceBenchmark [--size MB] [--batches N] [--devices N] [--per-device N] [--chunks N]\n"
+			"                              [--throttle-device I] [--throttle-ms N] [--host] [--shaders dir] [--format text|json] [--icd path]\n");
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i{ 1 }; i < argc; ++i)
+		{
+			const bool hasValue{ i + 1 < argc };
+
+			if (std::strcmp(argv[i], "--size") == 0 && hasValue)
+				options.size = std::strtoull(argv[++i], nullptr, 10) * 1024u * 1024u;
+			else if (std::strcmp(argv[i], "--batches") == 0 && hasValue)
+				options.batches = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--devices") == 0 && hasValue)
+				options.devices = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--per-device") == 0 && hasValue)
+				options.perDevice = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--chunks") == 0 && hasValue)
+				options.chunks = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--throttle-device") == 0 && hasValue)
+				options.throttleDevice = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--throttle-ms") == 0 && hasValue)
+				options.throttleMs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--host") == 0)
+				options.host = true;
+			else if (std::strcmp(argv[i], "--shaders") == 0 && hasValue)
+				options.shaderDir = argv[++i];
+			else if (std::strcmp(argv[i], "--icd") == 0 && hasValue)
+				options.icd = argv[++i];
+			else if (std::strcmp(argv[i], "--format") == 0 && hasValue)
+			{
+				const std::string format{ argv[++i] };
+				if (format == "text")
+					options.format = OutputFormat::Text;
+				else if (format == "json")
+					options.format = OutputFormat::Json;
+				else
+					return false;
+			}
+			else
+				return false;
+		}
+
+		return options.size >= 4u && options.batches > 0u && options.perDevice > 0u && options.chunks > 0u;
+	}
+
+	void setIcd(const char* icd)
+	{
+#ifdef _WIN32
+		_putenv_s("VK_ICD_FILENAMES", icd);
+#else
+		setenv("VK_ICD_FILENAMES", icd, 1);
+#endif
+	}
+
+	VkResult createResources(DeviceContext& device, const std::string& shaderDir, VkDeviceSize chunkBytes, DeviceResources& resources)
+	{
+		ComputeEngine& engine = device.getComputeEngine();
+		DeviceMemoryAllocator& allocator = device.getMemoryAllocator();
+
+		const VkBufferCreateInfo bufferCreateInfo = {
+			VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0u, chunkBytes,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_SHARING_MODE_EXCLUSIVE, 0u, nullptr
+		};
+
+		VkResult result = engine.createKernel(shaderDir + "/saxpy.spv", 2u, 8u, resources.kernel);
+		if (result != VK_SUCCESS)
+			std::fprintf(stderr, "cannot create kernel %s/saxpy.spv on %s: VkResult %d\n", shaderDir.c_str(),
+				device.getRecord().getProperties().deviceName, static_cast<int>(result));
+
+		if (result == VK_SUCCESS)
+			result = allocator.createBuffer(bufferCreateInfo, MemoryUsage::GpuOnly, resources.x, resources.xAllocation);
+		if (result == VK_SUCCESS)
+			result = allocator.createBuffer(bufferCreateInfo, MemoryUsage::GpuOnly, resources.y, resources.yAllocation);
+		if (result == VK_SUCCESS)
+		{
+			const VkDescriptorBufferInfo descriptors[] = { { resources.x, 0u, chunkBytes }, { resources.y, 0u, chunkBytes } };
+			result = engine.createBindings(resources.kernel, descriptors, resources.descriptorSet);
+		}
+
+		return result;
+	}
+
+	void destroyResources(DeviceContext& device, DeviceResources& resources)
+	{
+		ComputeEngine& engine = device.getComputeEngine();
+		DeviceMemoryAllocator& allocator = device.getMemoryAllocator();
+
+		engine.destroyBindings(resources.descriptorSet);
+		if (resources.y != VK_NULL_HANDLE)
+			allocator.destroyBuffer(resources.y, resources.yAllocation);
+		if (resources.x != VK_NULL_HANDLE)
+			allocator.destroyBuffer(resources.x, resources.xAllocation);
+		engine.destroyKernel(resources.kernel);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return -1;
+	}
+
+	if (options.icd)
+		setIcd(options.icd);
+
+	AppConfig config;
+	config.printDeviceMemoryStatistics = false;
+	config.printPipelineCacheStatistics = false;
+	config.printHostAllocatorSummary = false;
+	config.deviceSelection.log = false;
+	config.headless.framesInFlight = 0u;
+	config.residency.framesInFlight = 0u;
+	config.multiDevice.maxPhysicalDevices = options.devices > 0u ? options.devices : UINT32_MAX;
+	config.multiDevice.devicesPerPhysicalDevice = options.perDevice;
+	config.multiDevice.chunksPerDevice = options.chunks;
+
+	App app(config);
+	VkResult result = app.init();
+	if (result != VK_SUCCESS)
+	{
+		std::fprintf(stderr, "App::init() failed: VkResult %d\n", static_cast<int>(result));
+		return -1;
+	}
+
+	MultiDeviceScheduler& scheduler = app.getMultiDeviceScheduler();
+	const uint32_t deviceCount{ scheduler.getDeviceCount() };
+
+	const uint64_t count{ options.size / 4u };
+	const VkDeviceSize chunkBytes{ scheduler.getChunkSize(count) * 4u };
+
+	// small integers, a * x + y is exact in float whether or not the device fuses it
+	std::vector<float> dataX(static_cast<size_t>(count));
+	std::vector<float> dataY(static_cast<size_t>(count));
+	std::vector<float> output(static_cast<size_t>(count));
+	for (size_t i{ 0u }; i < dataX.size(); ++i)
+	{
+		dataX[i] = static_cast<float>(i % 1024u);
+		dataY[i] = static_cast<float>(i % 7u);
+	}
+
+	std::vector<DeviceResources> resources(deviceCount);
+	for (uint32_t i{ 0u }; result == VK_SUCCESS && !options.host && i < deviceCount; ++i)
+		result = createResources(scheduler.getDevice(i), options.shaderDir, chunkBytes, resources[i]);
+
+	// Upload the chunk, run saxpy on it and read y back, on the thread driving the device
+	const MultiDeviceScheduler::ChunkFunction saxpy = [&](uint32_t deviceIndex, uint64_t first, uint64_t chunkCount)
+	{
+		ComputeEngine& engine = scheduler.getDevice(deviceIndex).getComputeEngine();
+		const DeviceResources& chunkResources = resources[deviceIndex];
+		const VkDeviceSize bytes{ chunkCount * 4u };
+
+		if (deviceIndex == options.throttleDevice)
+			std::this_thread::sleep_for(std::chrono::milliseconds(options.throttleMs));
+
+		if (options.host)
+		{
+			for (uint64_t i{ first }; i < first + chunkCount; ++i)
+				output[i] = cA * dataX[i] + dataY[i];
+			return VK_SUCCESS;
+		}
+
+		struct
+		{
+			uint32_t count;
+			float a;
+		} pushConstants{ static_cast<uint32_t>(chunkCount), cA };
+
+		const uint32_t groupCount{ std::max(1u, std::min(static_cast<uint32_t>((chunkCount + cGroupSize - 1u) / cGroupSize), engine.getMaxGroupCountX())) };
+
+		VkResult chunkResult = engine.upload(chunkResources.x, 0u, dataX.data() + first, bytes);
+		if (chunkResult == VK_SUCCESS)
+			chunkResult = engine.upload(chunkResources.y, 0u, dataY.data() + first, bytes);
+		if (chunkResult == VK_SUCCESS)
+			chunkResult = engine.begin();
+		if (chunkResult == VK_SUCCESS)
+		{
+			engine.dispatch(chunkResources.kernel, chunkResources.descriptorSet, &pushConstants, groupCount);
+			chunkResult = engine.submit();
+		}
+		if (chunkResult == VK_SUCCESS)
+			chunkResult = engine.readback(chunkResources.y, 0u, output.data() + first, bytes);
+
+		return chunkResult;
+	};
+
+	std::vector<double> batchSeconds;
+	for (uint32_t batch{ 0u }; result == VK_SUCCESS && batch < options.batches; ++batch)
+	{
+		std::fill(output.begin(), output.end(), -1.0f);
+
+		const auto start = std::chrono::steady_clock::now();
+		result = scheduler.run(count, saxpy);
+		batchSeconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	bool verified{ result == VK_SUCCESS };
+	for (size_t i{ 0u }; verified && i < output.size(); ++i)
+		verified = output[i] == cA * dataX[i] + dataY[i];
+
+	double seconds{ 0.0 };
+	for (double batch : batchSeconds)
+		seconds += batch;
+	const double firstMs{ batchSeconds.empty() ? 0.0 : 1000.0 * batchSeconds.front() };
+	const double lastMs{ batchSeconds.empty() ? 0.0 : 1000.0 * batchSeconds.back() };
+	const double gbPerSecond{ seconds > 0.0 ? 12.0 * static_cast<double>(count) * batchSeconds.size() / seconds / 1e9 : 0.0 };
+
+	// steals of the throttled device itself are not a sign of rebalancing, it ran out of its own work
+	uint64_t stealCount{ 0u };
+	uint64_t rebalanceCount{ 0u };
+	uint32_t workingDeviceCount{ 0u };
+	const std::vector<DeviceWorkStatistics>& deviceStatistics = scheduler.getStatistics();
+	for (uint32_t i{ 0u }; i < deviceStatistics.size(); ++i)
+	{
+		stealCount += deviceStatistics[i].stealCount;
+		rebalanceCount += i != options.throttleDevice ? deviceStatistics[i].stealCount : 0u;
+		workingDeviceCount += deviceStatistics[i].itemCount > 0u ? 1u : 0u;
+	}
+
+	// Work was split (a device may lose its whole range to the others in a batch,
+	// not in all of them), and the other devices took over work of a device made to fall behind
+	const bool throttled{ options.throttleDevice < deviceCount && deviceCount > 1u };
+	const bool exercised{ deviceCount >= options.perDevice && workingDeviceCount >= std::min(deviceCount, 2u)
+		&& (!throttled || rebalanceCount > 0u) };
+	verified = verified && exercised;
+
+	if (options.format == OutputFormat::Text)
+	{
+		std::printf("devices         %u (%u per physical device), %llu elements per batch, %u chunks per device\n", deviceCount,
+			options.perDevice, static_cast<unsigned long long>(count), options.chunks);
+		std::printf("batches         %u, first %.3f ms, last %.3f ms, %.3f GB/s average\n", options.batches, firstMs, lastMs, gbPerSecond);
+		std::printf("steals          %llu\n", static_cast<unsigned long long>(stealCount));
+		std::printf("verification    %s\n", verified ? "passed" : "FAILED");
+		scheduler.printStatistics();
+	}
+	else
+		std::printf("{\"benchmark\":\"multi_device\",\"devices\":%u,\"per_device\":%u,\"elements\":%llu,\"chunks\":%u,\"batches\":%u,"
+			"\"first_batch_ms\":%.6f,\"last_batch_ms\":%.6f,\"gb_per_s\":%.6f,\"steals\":%llu,\"verified\":%s}\n",
+			deviceCount, options.perDevice, static_cast<unsigned long long>(count), options.chunks, options.batches,
+			firstMs, lastMs, gbPerSecond, static_cast<unsigned long long>(stealCount), verified ? "true" : "false");
+
+	for (uint32_t i{ 0u }; !options.host && i < deviceCount; ++i)
+		destroyResources(scheduler.getDevice(i), resources[i]);
+	app.deinit();
+
+	if (result != VK_SUCCESS)
+		std::fprintf(stderr, "multi-device benchmark failed: VkResult %d\n", static_cast<int>(result));
+	else if (!exercised)
+		std::fprintf(stderr, "multi-device benchmark failed: %u devices, %u processed items, %llu steals by the devices not throttled\n", deviceCount,
+			workingDeviceCount, static_cast<unsigned long long>(rebalanceCount));
+
+	return result == VK_SUCCESS && verified ? 0 : -1;
+}
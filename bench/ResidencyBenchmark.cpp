@@ -0,0 +1,252 @@
+// Residency benchmark - a working set of buffers larger than an artificial
+// device memory budget, used through App's ResidencyManager.
+//
+// Usage: mkResidencyBenchmark [--buffers N] [--buffer-size MB] [--budget MB] [--working-set N] [--frames N]
+//                             [--format text|json] [--icd path]
+//
+// --buffers      managed buffers (default 64)
+// --buffer-size  bytes per buffer (default 8 MB)
+// --budget       budget of the buffers in every device local heap, on top of the staging memory and other
+//                allocations of the heap, 0 - the driver's or estimated budget (default 256 MB)
+// --working-set  buffers used per frame (default 16), a quarter of them are High priority and used every
+//                frame, the others a window sliding over the Normal and Low priority buffers
+// --frames       frames to run (default 120)
+// --icd          selects the Vulkan driver manifest (sets VK_ICD_FILENAMES), e.g. a software ICD:
+//   lavapipe    /usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+//   SwiftShader <build>/Linux/vk_swiftshader_icd.json
+//
+// Buffers are filled through the StagingUploader. After the last frame every
+// buffer is evicted to host memory and compared with its pattern, so data
+// survived all moves. Exit code is non-zero on a mismatch, and when a budget
+// smaller than all buffers caused no evictions or no restores.
+
+#include "App.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	enum class OutputFormat { Text, Json };
+
+	struct Options
+	{
+		uint32_t buffers{ 64u };
+		VkDeviceSize bufferSize{ 8u * 1024u * 1024u };
+		VkDeviceSize budget{ 256u * 1024u * 1024u };
+		uint32_t workingSet{ 16u };
+		uint32_t frames{ 120u };
+		OutputFormat format{ OutputFormat::Text };
+		const char* icd{ nullptr };
+	};
+
+	void printUsage()
+	{
+		std::printf("Usage: mkResidencyBenchmark [--buffers N] [--buffer-size MB] [--budget MB] [--working-set N] [--frames N]\n"
+			"                            [--format text|json] [--icd path]\n");
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i{ 1 }; i < argc; ++i)
+		{
+			const bool hasValue{ i + 1 < argc };
+
+			if (std::strcmp(argv[i], "--buffers") == 0 && hasValue)
+				options.buffers = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--buffer-size") == 0 && hasValue)
+				options.bufferSize = std::strtoull(argv[++i], nullptr, 10) * 1024u * 1024u;
+			else if (std::strcmp(argv[i], "--budget") == 0 && hasValue)
+				options.budget = std::strtoull(argv[++i], nullptr, 10) * 1024u * 1024u;
+			else if (std::strcmp(argv[i], "--working-set") == 0 && hasValue)
+				options.workingSet = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--frames") == 0 && hasValue)
+				options.frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--icd") == 0 && hasValue)
+				options.icd = argv[++i];
+			else if (std::strcmp(argv[i], "--format") == 0 && hasValue)
+			{
+				const std::string format{ argv[++i] };
+				if (format == "text")
+					options.format = OutputFormat::Text;
+				else if (format == "json")
+					options.format = OutputFormat::Json;
+				else
+					return false;
+			}
+			else
+				return false;
+		}
+
+		return options.buffers > 0u && options.bufferSize > 0u && options.workingSet > 0u && options.workingSet <= options.buffers;
+	}
+
+	void setIcd(const char* icd)
+	{
+#ifdef _WIN32
+		_putenv_s("VK_ICD_FILENAMES", icd);
+#else
+		setenv("VK_ICD_FILENAMES", icd, 1);
+#endif
+	}
+
+	// byte pattern that differs between buffers and between neighbouring chunks of a buffer
+	uint8_t getPattern(uint32_t bufferIndex, VkDeviceSize offset)
+	{
+		return static_cast<uint8_t>(((offset + bufferIndex * 40503u) * 2654435761u) >> 13u);
+	}
+
+	// High for the always used part of the working set, every third other buffer Low
+	ResidencyPriority getPriority(uint32_t bufferIndex, uint32_t hotCount)
+	{
+		if (bufferIndex < hotCount)
+			return ResidencyPriority::High;
+		return bufferIndex % 3u == 0u ? ResidencyPriority::Low : ResidencyPriority::Normal;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return -1;
+	}
+
+	if (options.icd)
+		setIcd(options.icd);
+
+	AppConfig config;
+	config.printDeviceMemoryStatistics = false;
+	config.printPipelineCacheStatistics = false;
+	config.printHostAllocatorSummary = false;
+	config.deviceSelection.log = false;
+	config.headless.framesInFlight = 0u;
+	config.residency.budgetCap = options.budget;
+
+	App app(config);
+	VkResult result = app.init();
+	if (result != VK_SUCCESS)
+	{
+		std::fprintf(stderr, "App::init() failed: VkResult %d\n", static_cast<int>(result));
+		return -1;
+	}
+
+	DeviceMemoryAllocator& allocator = app.getMemoryAllocator();
+	StagingUploader& uploader = app.getStagingUploader();
+	ResidencyManager& residencyManager = app.getResidencyManager();
+
+	const uint32_t hotCount{ std::max(options.workingSet / 4u, 1u) };
+	const uint32_t coldCount{ options.buffers - hotCount };
+	const uint32_t windowSize{ options.workingSet - hotCount };
+
+	const VkBufferCreateInfo bufferCreateInfo = {
+		VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0u, options.bufferSize,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, 0u, nullptr
+	};
+
+	// Fill every buffer, the ones over budget are created in host memory
+	std::vector<ResidencyManager::Handle> handles(options.buffers, ResidencyManager::cInvalidHandle);
+	std::vector<uint8_t> data(static_cast<size_t>(options.bufferSize));
+	for (uint32_t i{ 0u }; result == VK_SUCCESS && i < options.buffers; ++i)
+	{
+		result = residencyManager.createBuffer(bufferCreateInfo, getPriority(i, hotCount), handles[i]);
+
+		for (size_t offset{ 0u }; offset < data.size(); ++offset)
+			data[offset] = getPattern(i, offset);
+		if (result == VK_SUCCESS)
+			result = uploader.upload(residencyManager.getBuffer(handles[i]), 0u, data.data(), options.bufferSize);
+	}
+	if (result == VK_SUCCESS)
+		result = uploader.finish();
+
+	// Frames of the hot buffers and a window moving by one buffer per frame over the others
+	std::chrono::duration<double, std::milli> maxFrameTime{ 0.0 };
+	const auto start = std::chrono::steady_clock::now();
+	for (uint32_t frame{ 0u }; result == VK_SUCCESS && frame < options.frames; ++frame)
+	{
+		const auto frameStart = std::chrono::steady_clock::now();
+
+		residencyManager.beginFrame();
+
+		for (uint32_t i{ 0u }; i < hotCount; ++i)
+			residencyManager.use(handles[i]);
+		for (uint32_t i{ 0u }; coldCount > 0u && i < windowSize; ++i)
+			residencyManager.use(handles[hotCount + (frame + i) % coldCount]);
+
+		maxFrameTime = std::max<std::chrono::duration<double, std::milli>>(maxFrameTime, std::chrono::steady_clock::now() - frameStart);
+	}
+	const double seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+
+	const ResidencyStatistics statistics{ residencyManager.getStatistics() };
+
+	// A cap the buffers do not fit must move them, on every device - software ICDs evict within their single heap
+	const bool oversubscribed{ options.budget != 0u && options.budget < options.buffers * options.bufferSize };
+	const bool exercised{ !oversubscribed || (statistics.evictionCount > 0u && statistics.restoreCount > 0u) };
+
+	// Contents after all moves, read from host memory (without a cap integrated GPUs have nothing to evict to)
+	bool verified{ result == VK_SUCCESS && exercised };
+	for (uint32_t i{ 0u }; verified && i < options.buffers; ++i)
+	{
+		const VkResult evictResult = residencyManager.evict(handles[i]);
+		const MemoryAllocation allocation{ residencyManager.getAllocation(handles[i]) };
+		if ((evictResult != VK_SUCCESS && (options.budget != 0u || evictResult != VK_ERROR_FEATURE_NOT_PRESENT)) || !allocation.mappedData)
+		{
+			verified = false;
+			break;
+		}
+
+		allocator.invalidate(allocation);
+		const uint8_t* bytes = static_cast<const uint8_t*>(allocation.mappedData);
+		for (VkDeviceSize offset{ 0u }; verified && offset < options.bufferSize; ++offset)
+			verified = bytes[offset] == getPattern(i, offset);
+	}
+
+	const double frameMs{ options.frames ? 1000.0 * seconds / options.frames : 0.0 };
+	const double evictedMB{ static_cast<double>(statistics.bytesEvicted) / (1024.0 * 1024.0) };
+	const double restoredMB{ static_cast<double>(statistics.bytesRestored) / (1024.0 * 1024.0) };
+
+	if (options.format == OutputFormat::Text)
+	{
+		std::printf("buffers         %u x %.1f MB, working set %u, budget %s\n", options.buffers,
+			static_cast<double>(options.bufferSize) / (1024.0 * 1024.0), options.workingSet,
+			residencyManager.hasMemoryBudget() ? "VK_EXT_memory_budget" : "estimated");
+		std::printf("frames          %u, %.3f ms average, %.3f ms max\n", options.frames, frameMs, maxFrameTime.count());
+		std::printf("evictions       %llu (%.1f MB)\n", static_cast<unsigned long long>(statistics.evictionCount), evictedMB);
+		std::printf("restores        %llu (%.1f MB), %llu denied, %llu deferred\n", static_cast<unsigned long long>(statistics.restoreCount), restoredMB,
+			static_cast<unsigned long long>(statistics.restoresDenied), static_cast<unsigned long long>(statistics.restoresDeferred));
+		std::printf("oversubscribed  %llu at creation, %u resident / %u evicted after the last frame\n",
+			static_cast<unsigned long long>(statistics.oversubscribedCount), statistics.residentCount, statistics.evictedCount);
+		std::printf("verification    %s\n", verified ? "passed" : "FAILED");
+		residencyManager.printStatistics();
+	}
+	else
+		std::printf("{\"benchmark\":\"residency\",\"buffers\":%u,\"buffer_mb\":%.1f,\"working_set\":%u,\"budget_mb\":%.1f,\"memory_budget\":%s,"
+			"\"frames\":%u,\"frame_ms\":%.6f,\"max_frame_ms\":%.6f,\"evictions\":%llu,\"evicted_mb\":%.1f,\"restores\":%llu,\"restored_mb\":%.1f,"
+			"\"restores_denied\":%llu,\"restores_deferred\":%llu,\"oversubscribed\":%llu,\"verified\":%s}\n",
+			options.buffers, static_cast<double>(options.bufferSize) / (1024.0 * 1024.0), options.workingSet,
+			static_cast<double>(options.budget) / (1024.0 * 1024.0), residencyManager.hasMemoryBudget() ? "true" : "false",
+			options.frames, frameMs, maxFrameTime.count(),
+			static_cast<unsigned long long>(statistics.evictionCount), evictedMB,
+			static_cast<unsigned long long>(statistics.restoreCount), restoredMB,
+			static_cast<unsigned long long>(statistics.restoresDenied), static_cast<unsigned long long>(statistics.restoresDeferred),
+			static_cast<unsigned long long>(statistics.oversubscribedCount),
+			verified ? "true" : "false");
+
+	for (ResidencyManager::Handle& handle : handles)
+		residencyManager.destroyBuffer(handle);
+	app.deinit();
+
+	if (result != VK_SUCCESS)
+		std::fprintf(stderr, "residency benchmark failed: VkResult %d\n", static_cast<int>(result));
+	else if (!exercised)
+		std::fprintf(stderr, "residency benchmark failed: no evictions or restores under the budget\n");
+
+	return result == VK_SUCCESS && verified ? 0 : -1;
+}
@@ -0,0 +1,215 @@
+// Startup benchmark - runs App::init()/App::deinit() repeatedly and reports
+// min/median/p99 wall time of every init phase.
+//
+// Usage: mkStartupBenchmark [--iterations N] [--warmup N] [--format text|csv|json] [--icd path] [--system-allocator]
+//                           [--capability-cache path] [--pipeline-cache path]
+//
+// --icd selects the Vulkan driver manifest (sets VK_ICD_FILENAMES), e.g. a software ICD:
+//   lavapipe    /usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+//   SwiftShader <build>/Linux/vk_swiftshader_icd.json
+//
+// --system-allocator passes pAllocator = nullptr instead of App's HostAllocator.
+// --capability-cache enables the capability cache (off by default so every iteration
+// is a cold start). The first iteration writes it, the following ones are warm starts.
+// --pipeline-cache does the same for the pipeline cache, which is loaded in init() and
+// written in deinit(). Without it no iteration reads or writes a cache file, run once
+// with and once without to compare warm and cold pipeline cache startup.
+//
+// csv/json output is one record per phase and is meant to be collected by CI
+// to track startup regressions over time.
+
+#include "App.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	enum class OutputFormat { Text, Csv, Json };
+
+	struct Options
+	{
+		size_t iterations{ 100u };
+		size_t warmup{ 5u };
+		OutputFormat format{ OutputFormat::Text };
+		const char* icd{ nullptr };
+		bool systemAllocator{ false };
+		const char* capabilityCachePath{ "" };
+		const char* pipelineCachePath{ "" };
+	};
+
+	struct PhaseStatistics
+	{
+		double minUs{ 0.0 };
+		double medianUs{ 0.0 };
+		double p99Us{ 0.0 };
+		double meanUs{ 0.0 };
+	};
+
+	void printUsage()
+	{
+		std::printf("Usage: mkStartupBenchmark [--iterations N] [--warmup N] [--format text|csv|json] [--icd path] [--system-allocator] [--capability-cache path] [--pipeline-cache path]\n");
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i{ 1 }; i < argc; ++i)
+		{
+			const bool hasValue{ i + 1 < argc };
+
+			if (std::strcmp(argv[i], "--iterations") == 0 && hasValue)
+				options.iterations = std::strtoul(argv[++i], nullptr, 10);
+			else if (std::strcmp(argv[i], "--warmup") == 0 && hasValue)
+				options.warmup = std::strtoul(argv[++i], nullptr, 10);
+			else if (std::strcmp(argv[i], "--icd") == 0 && hasValue)
+				options.icd = argv[++i];
+			else if (std::strcmp(argv[i], "--system-allocator") == 0)
+				options.systemAllocator = true;
+			else if (std::strcmp(argv[i], "--capability-cache") == 0 && hasValue)
+				options.capabilityCachePath = argv[++i];
+			else if (std::strcmp(argv[i], "--pipeline-cache") == 0 && hasValue)
+				options.pipelineCachePath = argv[++i];
+			else if (std::strcmp(argv[i], "--format") == 0 && hasValue)
+			{
+				const std::string format{ argv[++i] };
+				if (format == "text")
+					options.format = OutputFormat::Text;
+				else if (format == "csv")
+					options.format = OutputFormat::Csv;
+				else if (format == "json")
+					options.format = OutputFormat::Json;
+				else
+					return false;
+			}
+			else
+				return false;
+		}
+
+		return options.iterations > 0u;
+	}
+
+	void setIcd(const char* icd)
+	{
+#ifdef _WIN32
+		_putenv_s("VK_ICD_FILENAMES", icd);
+#else
+		setenv("VK_ICD_FILENAMES", icd, 1);
+#endif
+	}
+
+	// samples are sorted in place, p99 uses nearest-rank
+	PhaseStatistics computeStatistics(std::vector<double>& samples)
+	{
+		PhaseStatistics statistics;
+		std::sort(samples.begin(), samples.end());
+
+		const size_t count{ samples.size() };
+		const size_t p99Rank{ static_cast<size_t>(std::ceil(0.99 * static_cast<double>(count))) };
+
+		statistics.minUs = samples.front();
+		statistics.medianUs = count % 2u ? samples[count / 2u] : 0.5 * (samples[count / 2u - 1u] + samples[count / 2u]);
+		statistics.p99Us = samples[std::max<size_t>(p99Rank, 1u) - 1u];
+
+		for (double sample : samples)
+			statistics.meanUs += sample;
+		statistics.meanUs /= static_cast<double>(count);
+
+		return statistics;
+	}
+
+	bool runIteration(const Options& options, std::vector<std::vector<double>>* samples)
+	{
+		AppConfig config;
+		config.useHostAllocator = !options.systemAllocator;
+		config.printDeviceMemoryStatistics = false;
+		config.printPipelineCacheStatistics = false;
+		config.printHostAllocatorSummary = false;
+		config.capabilityCachePath = options.capabilityCachePath;
+		config.pipelineCachePath = options.pipelineCachePath;
+		config.deviceSelection.log = false;
+
+		App app(config);
+
+		const VkResult initResult{ app.init() };
+		const VkResult deinitResult{ initResult == VK_SUCCESS ? app.deinit() : initResult };
+		if (deinitResult != VK_SUCCESS)
+		{
+			std::fprintf(stderr, "App::init()/deinit() failed: VkResult %d\n", static_cast<int>(deinitResult));
+			return false;
+		}
+
+		if (samples)
+		{
+			const App::InitPhaseDurations& durations{ app.getInitPhaseDurations() };
+			double totalUs{ 0.0 };
+
+			for (size_t phase{ 0u }; phase < durations.size(); ++phase)
+			{
+				const double us{ std::chrono::duration<double, std::micro>(durations[phase]).count() };
+				(*samples)[phase].push_back(us);
+				totalUs += us;
+			}
+			samples->back().push_back(totalUs);
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return -1;
+	}
+
+	if (options.icd)
+		setIcd(options.icd);
+
+	for (size_t i{ 0u }; i < options.warmup; ++i)
+		if (!runIteration(options, nullptr))
+			return -1;
+
+	// one series per phase plus the total over all phases
+	const size_t phaseCount{ static_cast<size_t>(InitPhase::Count) };
+	std::vector<std::vector<double>> samples(phaseCount + 1u);
+	for (auto& series : samples)
+		series.reserve(options.iterations);
+
+	for (size_t i{ 0u }; i < options.iterations; ++i)
+		if (!runIteration(options, &samples))
+			return -1;
+
+	if (options.format == OutputFormat::Text)
+		std::printf("%-42s %12s %12s %12s %12s\n", "phase (us)", "min", "median", "p99", "mean");
+	else if (options.format == OutputFormat::Csv)
+		std::printf("phase,iterations,min_us,median_us,p99_us,mean_us\n");
+	else
+		std::printf("{\"benchmark\":\"startup\",\"iterations\":%zu,\"phases\":[", options.iterations);
+
+	for (size_t phase{ 0u }; phase <= phaseCount; ++phase)
+	{
+		const char* name{ phase < phaseCount ? App::getInitPhaseName(static_cast<InitPhase>(phase)) : "Total" };
+		const PhaseStatistics statistics{ computeStatistics(samples[phase]) };
+
+		if (options.format == OutputFormat::Text)
+			std::printf("%-42s %12.2f %12.2f %12.2f %12.2f\n", name, statistics.minUs, statistics.medianUs, statistics.p99Us, statistics.meanUs);
+		else if (options.format == OutputFormat::Csv)
+			std::printf("%s,%zu,%.3f,%.3f,%.3f,%.3f\n", name, options.iterations, statistics.minUs, statistics.medianUs, statistics.p99Us, statistics.meanUs);
+		else
+			std::printf("%s{\"phase\":\"%s\",\"min_us\":%.3f,\"median_us\":%.3f,\"p99_us\":%.3f,\"mean_us\":%.3f}",
+				phase ? "," : "", name, statistics.minUs, statistics.medianUs, statistics.p99Us, statistics.meanUs);
+	}
+
+	if (options.format == OutputFormat::Json)
+		std::printf("]}\n");
+
+	return 0;
+}
@@ -0,0 +1,185 @@
+// Upload benchmark - streams a dataset to a device buffer through App's
+// StagingUploader and verifies the result.
+//
+// Usage: mkUploadBenchmark [--size MB] [--chunk KB] [--ring MB] [--batches N] [--format text|json] [--icd path]
+//
+// --size    bytes uploaded in total (default 256 MB)
+// --chunk   bytes per upload() call (default 256 KB)
+// --ring    staging ring size, power of two (default 16 MB)
+// --batches batches in flight before the producer stalls (default 4)
+// --icd     selects the Vulkan driver manifest (sets VK_ICD_FILENAMES), e.g. a software ICD:
+//   lavapipe    /usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+//   SwiftShader <build>/Linux/vk_swiftshader_icd.json
+//
+// The destination buffer is in host visible readback memory, so the uploaded
+// data is compared with the source after the last batch completed. Exit code
+// is non-zero on a mismatch.
+
+#include "App.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	enum class OutputFormat { Text, Json };
+
+	struct Options
+	{
+		VkDeviceSize size{ 256u * 1024u * 1024u };
+		VkDeviceSize chunk{ 256u * 1024u };
+		VkDeviceSize ringSize{ 16u * 1024u * 1024u };
+		uint32_t batches{ 4u };
+		OutputFormat format{ OutputFormat::Text };
+		const char* icd{ nullptr };
+	};
+
+	void printUsage()
+	{
+		std::printf("Usage: mkUploadBenchmark [--size MB] [--chunk KB] [--ring MB] [--batches N] [--format text|json] [--icd path]\n");
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i{ 1 }; i < argc; ++i)
+		{
+			const bool hasValue{ i + 1 < argc };
+
+			if (std::strcmp(argv[i], "--size") == 0 && hasValue)
+				options.size = std::strtoull(argv[++i], nullptr, 10) * 1024u * 1024u;
+			else if (std::strcmp(argv[i], "--chunk") == 0 && hasValue)
+				options.chunk = std::strtoull(argv[++i], nullptr, 10) * 1024u;
+			else if (std::strcmp(argv[i], "--ring") == 0 && hasValue)
+				options.ringSize = std::strtoull(argv[++i], nullptr, 10) * 1024u * 1024u;
+			else if (std::strcmp(argv[i], "--batches") == 0 && hasValue)
+				options.batches = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--icd") == 0 && hasValue)
+				options.icd = argv[++i];
+			else if (std::strcmp(argv[i], "--format") == 0 && hasValue)
+			{
+				const std::string format{ argv[++i] };
+				if (format == "text")
+					options.format = OutputFormat::Text;
+				else if (format == "json")
+					options.format = OutputFormat::Json;
+				else
+					return false;
+			}
+			else
+				return false;
+		}
+
+		return options.size > 0u && options.chunk > 0u && options.batches > 0u;
+	}
+
+	void setIcd(const char* icd)
+	{
+#ifdef _WIN32
+		_putenv_s("VK_ICD_FILENAMES", icd);
+#else
+		setenv("VK_ICD_FILENAMES", icd, 1);
+#endif
+	}
+
+	// byte pattern that differs between neighbouring chunks and passes
+	uint8_t getPattern(VkDeviceSize offset)
+	{
+		return static_cast<uint8_t>((offset * 2654435761u) >> 13u);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return -1;
+	}
+
+	if (options.icd)
+		setIcd(options.icd);
+
+	AppConfig config;
+	config.printDeviceMemoryStatistics = false;
+	config.printPipelineCacheStatistics = false;
+	config.printHostAllocatorSummary = false;
+	config.deviceSelection.log = false;
+	config.staging.ringSize = options.ringSize;
+	config.staging.maxBatches = options.batches;
+	config.headless.framesInFlight = 0u;
+
+	App app(config);
+	VkResult result = app.init();
+	if (result != VK_SUCCESS)
+	{
+		std::fprintf(stderr, "App::init() failed: VkResult %d\n", static_cast<int>(result));
+		return -1;
+	}
+
+	DeviceMemoryAllocator& allocator = app.getMemoryAllocator();
+	StagingUploader& uploader = app.getStagingUploader();
+
+	// source dataset, generated up front so only the upload is timed
+	std::vector<uint8_t> source(static_cast<size_t>(options.size));
+	for (size_t i{ 0u }; i < source.size(); ++i)
+		source[i] = getPattern(i);
+
+	const VkBufferCreateInfo bufferCreateInfo = {
+		VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0u, options.size,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, 0u, nullptr
+	};
+
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	MemoryAllocation allocation;
+	result = allocator.createBuffer(bufferCreateInfo, MemoryUsage::GpuToCpu, buffer, allocation);
+
+	// Stream the dataset, the uploader flushes whenever a batch is full
+	const auto start = std::chrono::steady_clock::now();
+	for (VkDeviceSize offset{ 0u }; result == VK_SUCCESS && offset < options.size; offset += options.chunk)
+		result = uploader.upload(buffer, offset, source.data() + offset, std::min(options.chunk, options.size - offset));
+	if (result == VK_SUCCESS)
+		result = uploader.finish();
+	const double seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+
+	// batches end with a transfer to host barrier, the copies are visible once finish() waited for them
+	bool verified{ false };
+	if (result == VK_SUCCESS && allocation.mappedData)
+	{
+		allocator.invalidate(allocation);
+		verified = std::memcmp(allocation.mappedData, source.data(), source.size()) == 0;
+	}
+
+	const StagingUploaderStatistics statistics{ uploader.getStatistics() };
+	const double sizeMB{ static_cast<double>(options.size) / (1024.0 * 1024.0) };
+	const double stallMs{ std::chrono::duration<double, std::milli>(statistics.stallTime).count() };
+
+	if (options.format == OutputFormat::Text)
+	{
+		std::printf("uploaded        %.1f MB in %.3f s (%.1f MB/s wall, %.1f MB/s uploader)\n", sizeMB, seconds, sizeMB / seconds, statistics.getThroughput());
+		std::printf("uploads         %llu (%llu batches, %llu copy commands)\n",
+			static_cast<unsigned long long>(statistics.uploadCount), static_cast<unsigned long long>(statistics.batchCount),
+			static_cast<unsigned long long>(statistics.copyCount));
+		std::printf("stall           %.3f ms\n", stallMs);
+		std::printf("verification    %s\n", verified ? "passed" : "FAILED");
+	}
+	else
+		std::printf("{\"benchmark\":\"upload\",\"size_mb\":%.1f,\"seconds\":%.6f,\"mb_per_s\":%.3f,\"uploader_mb_per_s\":%.3f,"
+			"\"uploads\":%llu,\"batches\":%llu,\"copies\":%llu,\"stall_ms\":%.3f,\"verified\":%s}\n",
+			sizeMB, seconds, sizeMB / seconds, statistics.getThroughput(),
+			static_cast<unsigned long long>(statistics.uploadCount), static_cast<unsigned long long>(statistics.batchCount),
+			static_cast<unsigned long long>(statistics.copyCount), stallMs, verified ? "true" : "false");
+
+	allocator.destroyBuffer(buffer, allocation);
+	app.deinit();
+
+	if (result != VK_SUCCESS)
+		std::fprintf(stderr, "upload failed: VkResult %d\n", static_cast<int>(result));
+
+	return result == VK_SUCCESS && verified ? 0 : -1;
+}
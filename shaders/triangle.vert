@@ -0,0 +1,24 @@
+#version 450
+
+// Triangle centered on the origin without vertex buffers, rotated by angle
+// so consecutive frames differ. The origin stays covered at any angle.
+
+layout(push_constant) uniform Params
+{
+	float angle;	// radians
+};
+
+layout(location = 0) out vec3 color;
+
+const vec2 positions[3] = vec2[](vec2(0.0, -0.8), vec2(0.7, 0.4), vec2(-0.7, 0.4));
+const vec3 colors[3] = vec3[](vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, 1.0));
+
+void main()
+{
+	const float c = cos(angle);
+	const float s = sin(angle);
+	const vec2 position = positions[gl_VertexIndex];
+
+	gl_Position = vec4(c * position.x - s * position.y, s * position.x + c * position.y, 0.0, 1.0);
+	color = colors[gl_VertexIndex];
+}